@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <endian.h>
+#include <string.h>
+
+#include "bitstream.h"
+
+#define BITSTREAM_EPB				0x03
+
+/* Set the high bit of each byte of the word that is zero. */
+#define BITSTREAM_HAS_ZERO(v) \
+	(((v) - 0x0101010101010101ULL) & ~(v) & 0x8080808080808080ULL)
+
+static void bitstream_refill(struct bitstream *bitstream)
+{
+	unsigned int count = (64 - bitstream->cache_bits) / 8;
+	uint64_t value, mask;
+	uint8_t byte;
+
+	if (count == 0)
+		return;
+
+	/*
+	 * Fast path: load whole bytes at once when none of them is zero, which
+	 * guarantees that no emulation prevention byte is part of the chunk.
+	 */
+	if ((bitstream->raw || bitstream->zeros < 2) &&
+	    bitstream->offset + 8 <= bitstream->size) {
+		memcpy(&value, bitstream->data + bitstream->offset, sizeof(value));
+		value = be64toh(value);
+
+		mask = count == 8 ? ~0ULL : ~(~0ULL >> (count * 8));
+		value &= mask;
+
+		if (bitstream->raw || !BITSTREAM_HAS_ZERO(value | ~mask)) {
+			bitstream->cache |= value >> bitstream->cache_bits;
+			bitstream->cache_bits += count * 8;
+			bitstream->offset += count;
+			bitstream->zeros = 0;
+			return;
+		}
+	}
+
+	while (bitstream->cache_bits <= 56 &&
+	       bitstream->offset < bitstream->size) {
+		byte = bitstream->data[bitstream->offset++];
+
+		if (!bitstream->raw && bitstream->zeros >= 2 &&
+		    byte == BITSTREAM_EPB) {
+			bitstream->zeros = 0;
+			continue;
+		}
+
+		if (byte == 0)
+			bitstream->zeros++;
+		else
+			bitstream->zeros = 0;
+
+		bitstream->cache |= (uint64_t)byte << (56 - bitstream->cache_bits);
+		bitstream->cache_bits += 8;
+	}
+}
+
+void bitstream_init(struct bitstream *bitstream, const void *data,
+		    unsigned int size)
+{
+	memset(bitstream, 0, sizeof(*bitstream));
+
+	bitstream->data = data;
+	bitstream->size = size;
+
+	bitstream_refill(bitstream);
+}
+
+void bitstream_init_raw(struct bitstream *bitstream, const void *data,
+			unsigned int size)
+{
+	memset(bitstream, 0, sizeof(*bitstream));
+
+	bitstream->data = data;
+	bitstream->size = size;
+	bitstream->raw = true;
+
+	bitstream_refill(bitstream);
+}
+
+unsigned int bitstream_read(struct bitstream *bitstream, unsigned int count)
+{
+	unsigned int value;
+
+	if (count == 0)
+		return 0;
+
+	if (bitstream->cache_bits < count)
+		bitstream_refill(bitstream);
+
+	if (bitstream->cache_bits < count) {
+		bitstream->overflow = true;
+		bitstream->cache = 0;
+		bitstream->cache_bits = 0;
+		return 0;
+	}
+
+	value = bitstream->cache >> (64 - count);
+
+	bitstream->cache <<= count;
+	bitstream->cache_bits -= count;
+	bitstream->position += count;
+
+	return value;
+}
+
+bool bitstream_read_flag(struct bitstream *bitstream)
+{
+	return bitstream_read(bitstream, 1);
+}
+
+void bitstream_skip(struct bitstream *bitstream, unsigned int count)
+{
+	while (count > 32) {
+		bitstream_read(bitstream, 32);
+		count -= 32;
+	}
+
+	bitstream_read(bitstream, count);
+}
+
+unsigned int bitstream_read_ue(struct bitstream *bitstream)
+{
+	unsigned int leading;
+	unsigned int length;
+	uint64_t value;
+
+	if (bitstream->cache_bits < 32)
+		bitstream_refill(bitstream);
+
+	/* Count the leading zero bits of the code at once. */
+	leading = bitstream->cache ? __builtin_clzll(bitstream->cache) : 64;
+	length = leading * 2 + 1;
+
+	/* Long codes may extend past the cached bits: refill and count again. */
+	if (length > bitstream->cache_bits) {
+		bitstream_refill(bitstream);
+
+		leading = bitstream->cache ? __builtin_clzll(bitstream->cache) :
+			  64;
+		length = leading * 2 + 1;
+	}
+
+	if (leading > 31) {
+		bitstream->overflow = true;
+		bitstream->cache = 0;
+		bitstream->cache_bits = 0;
+		return 0;
+	}
+
+	/*
+	 * A refilled cache holds at least 57 bits, so only the longest codes
+	 * or the end of the data remain: read the zeros and the value apart.
+	 */
+	if (length > bitstream->cache_bits) {
+		bitstream_read(bitstream, leading);
+		value = bitstream_read(bitstream, leading + 1);
+
+		return bitstream->overflow ? 0 : value - 1;
+	}
+
+	value = bitstream->cache >> (64 - length);
+
+	bitstream->cache <<= length;
+	bitstream->cache_bits -= length;
+	bitstream->position += length;
+
+	return value - 1;
+}
+
+int bitstream_read_se(struct bitstream *bitstream)
+{
+	unsigned int value = bitstream_read_ue(bitstream);
+
+	if (value & 1)
+		return (value + 1) / 2;
+	else
+		return -(int)(value / 2);
+}
+
+unsigned int bitstream_position(struct bitstream *bitstream)
+{
+	return bitstream->position;
+}
+
+/*
+ * Convert the current RBSP position back to a position in the escaped data,
+ * accounting for the emulation prevention bytes skipped so far. Both are the
+ * same for raw readers.
+ */
+unsigned int bitstream_raw_position(struct bitstream *bitstream)
+{
+	unsigned int target = bitstream->position / 8;
+	unsigned int offset = 0;
+	unsigned int count = 0;
+	unsigned int zeros = 0;
+	uint8_t byte;
+
+	if (bitstream->raw)
+		return bitstream->position;
+
+	while (offset < bitstream->size) {
+		byte = bitstream->data[offset];
+
+		if (zeros >= 2 && byte == BITSTREAM_EPB) {
+			zeros = 0;
+			offset++;
+			continue;
+		}
+
+		if (count == target)
+			break;
+
+		if (byte == 0)
+			zeros++;
+		else
+			zeros = 0;
+
+		offset++;
+		count++;
+	}
+
+	return offset * 8 + bitstream->position % 8;
+}
+
+bool bitstream_error(struct bitstream *bitstream)
+{
+	return bitstream->overflow;
+}
+
+unsigned int bitstream_ceil_log2(unsigned int value)
+{
+	if (value <= 1)
+		return 0;
+
+	return 32 - __builtin_clz(value - 1);
+}
+
+void bitstream_writer_init(struct bitstream_writer *writer, void *data,
+			   unsigned int size)
+{
+	memset(writer, 0, sizeof(*writer));
+
+	writer->data = data;
+	writer->size = size;
+
+	memset(data, 0, size);
+}
+
+/* Write the low bits of a value, most significant first. */
+void bitstream_write(struct bitstream_writer *writer, unsigned int value,
+		     unsigned int count)
+{
+	unsigned int offset;
+	unsigned int bits;
+	unsigned int free;
+
+	if (writer->position + count > writer->size * 8) {
+		writer->overflow = true;
+		return;
+	}
+
+	while (count > 0) {
+		offset = writer->position / 8;
+		free = 8 - writer->position % 8;
+		bits = count < free ? count : free;
+
+		writer->data[offset] |= ((value >> (count - bits)) &
+					 ((1 << bits) - 1)) << (free - bits);
+
+		writer->position += bits;
+		count -= bits;
+	}
+}
+
+void bitstream_write_flag(struct bitstream_writer *writer, bool value)
+{
+	bitstream_write(writer, value ? 1 : 0, 1);
+}
+
+void bitstream_write_ue(struct bitstream_writer *writer, unsigned int value)
+{
+	uint64_t code = (uint64_t) value + 1;
+	unsigned int length = 64 - __builtin_clzll(code);
+
+	bitstream_write(writer, 0, length - 1);
+
+	/* Codes of 32 bits and more are split to fit the value argument. */
+	if (length > 32) {
+		bitstream_write(writer, code >> 32, length - 32);
+		length = 32;
+	}
+
+	bitstream_write(writer, code, length);
+}
+
+void bitstream_write_se(struct bitstream_writer *writer, int value)
+{
+	if (value > 0)
+		bitstream_write_ue(writer, (unsigned int) value * 2 - 1);
+	else
+		bitstream_write_ue(writer, (unsigned int) -value * 2);
+}
+
+void bitstream_write_align(struct bitstream_writer *writer)
+{
+	if (writer->position % 8)
+		bitstream_write(writer, 0, 8 - writer->position % 8);
+}
+
+void bitstream_write_trailing(struct bitstream_writer *writer)
+{
+	bitstream_write(writer, 1, 1);
+	bitstream_write_align(writer);
+}
+
+unsigned int bitstream_writer_size(struct bitstream_writer *writer)
+{
+	return (writer->position + 7) / 8;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BITSTREAM_H_
+#define _BITSTREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Structures
+ */
+
+/*
+ * Bit reader over an escaped NAL unit payload: emulation prevention bytes are
+ * skipped when filling the cache, so all reads happen on the RBSP. Raw readers
+ * are for payloads that were already unescaped and read every byte.
+ */
+struct bitstream {
+	const uint8_t *data;
+	unsigned int size;
+	unsigned int offset;
+	unsigned int zeros;
+	bool raw;
+
+	uint64_t cache;
+	unsigned int cache_bits;
+
+	unsigned int position;
+	bool overflow;
+};
+
+/* Bit writer for RBSPs, emulation prevention is left to the caller. */
+struct bitstream_writer {
+	uint8_t *data;
+	unsigned int size;
+	unsigned int position;
+	bool overflow;
+};
+
+/*
+ * Functions
+ */
+
+void bitstream_init(struct bitstream *bitstream, const void *data,
+		    unsigned int size);
+void bitstream_init_raw(struct bitstream *bitstream, const void *data,
+			unsigned int size);
+unsigned int bitstream_read(struct bitstream *bitstream, unsigned int count);
+bool bitstream_read_flag(struct bitstream *bitstream);
+void bitstream_skip(struct bitstream *bitstream, unsigned int count);
+unsigned int bitstream_read_ue(struct bitstream *bitstream);
+int bitstream_read_se(struct bitstream *bitstream);
+unsigned int bitstream_position(struct bitstream *bitstream);
+unsigned int bitstream_raw_position(struct bitstream *bitstream);
+bool bitstream_error(struct bitstream *bitstream);
+unsigned int bitstream_ceil_log2(unsigned int value);
+
+void bitstream_writer_init(struct bitstream_writer *writer, void *data,
+			   unsigned int size);
+void bitstream_write(struct bitstream_writer *writer, unsigned int value,
+		     unsigned int count);
+void bitstream_write_flag(struct bitstream_writer *writer, bool value);
+void bitstream_write_ue(struct bitstream_writer *writer, unsigned int value);
+void bitstream_write_se(struct bitstream_writer *writer, int value);
+void bitstream_write_align(struct bitstream_writer *writer);
+void bitstream_write_trailing(struct bitstream_writer *writer);
+unsigned int bitstream_writer_size(struct bitstream_writer *writer);
+
+#endif
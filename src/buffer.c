@@ -22,11 +22,15 @@
 
 #include "dump.h"
 #include "buffer.h"
+#include "probe.h"
+#include "trace.h"
 
 VAStatus DumpCreateBuffer(VADriverContextP context, VAContextID context_id,
 	VABufferType type, unsigned int size, unsigned int count, void *data,
 	VABufferID *buffer_id)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_buffer *buffer_object;
 	void *buffer_data;
@@ -65,11 +69,15 @@ VAStatus DumpCreateBuffer(VADriverContextP context, VAContextID context_id,
 
 	*buffer_id = id;
 
+	PROBE4(create_buffer, context_id, id, type, size * count);
+
 	return VA_STATUS_SUCCESS;
 }
 
 VAStatus DumpDestroyBuffer(VADriverContextP context, VABufferID buffer_id)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_buffer *buffer_object;
 
@@ -77,6 +85,9 @@ VAStatus DumpDestroyBuffer(VADriverContextP context, VABufferID buffer_id)
 	if (buffer_object == NULL)
 		return VA_STATUS_ERROR_INVALID_BUFFER;
 
+	PROBE3(destroy_buffer, buffer_id, buffer_object->type,
+	       buffer_object->size * buffer_object->count);
+
 	if (buffer_object->data != NULL)
 		free(buffer_object->data);
 
@@ -88,6 +99,8 @@ VAStatus DumpDestroyBuffer(VADriverContextP context, VABufferID buffer_id)
 VAStatus DumpMapBuffer(VADriverContextP context, VABufferID buffer_id,
 	void **data_map)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_buffer *buffer_object;
 
@@ -103,6 +116,8 @@ VAStatus DumpMapBuffer(VADriverContextP context, VABufferID buffer_id,
 
 VAStatus DumpUnmapBuffer(VADriverContextP context, VABufferID buffer_id)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_buffer *buffer_object;
 
@@ -118,6 +133,8 @@ VAStatus DumpUnmapBuffer(VADriverContextP context, VABufferID buffer_id)
 VAStatus DumpBufferSetNumElements(VADriverContextP context,
 	VABufferID buffer_id, unsigned int count)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_buffer *buffer_object;
 
@@ -136,6 +153,8 @@ VAStatus DumpBufferSetNumElements(VADriverContextP context,
 VAStatus DumpBufferInfo(VADriverContextP context, VABufferID buffer_id,
 	VABufferType *type, unsigned int *size, unsigned int *count)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_buffer *buffer_object;
 
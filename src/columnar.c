@@ -0,0 +1,590 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "columnar.h"
+#include "trace.h"
+#include "log.h"
+
+#define COLUMNAR_ALIGN(size) \
+	(((size) + COLUMNAR_ALIGNMENT - 1) & ~((uint64_t) COLUMNAR_ALIGNMENT - 1))
+
+static int columnar_write(int fd, const void *data, size_t size)
+{
+	const uint8_t *buffer = data;
+	ssize_t written;
+
+	while (size > 0) {
+		written = write(fd, buffer, size);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return -errno;
+		}
+
+		buffer += written;
+		size -= written;
+	}
+
+	return 0;
+}
+
+static void columnar_column_free(struct columnar_column *column)
+{
+	free(column->name);
+	free(column->validity);
+	free(column->values);
+	free(column->offsets);
+	free(column->data);
+}
+
+static void columnar_group_free(struct columnar_group *group)
+{
+	unsigned int i;
+
+	if (group == NULL)
+		return;
+
+	for (i = 0; i < group->columns_count; i++)
+		columnar_column_free(&group->columns[i]);
+
+	free(group->columns);
+	free(group);
+}
+
+static int columnar_column_init(struct columnar_column *column,
+				const char *name, enum columnar_type type,
+				unsigned int rows)
+{
+	memset(column, 0, sizeof(*column));
+
+	column->name = strdup(name);
+	column->type = type;
+	column->validity = calloc((rows + 7) / 8, 1);
+
+	if (type == COLUMNAR_TYPE_INT64)
+		column->values = calloc(rows, sizeof(*column->values));
+	else
+		column->offsets = calloc(rows + 1, sizeof(*column->offsets));
+
+	if (column->name == NULL || column->validity == NULL ||
+	    (column->values == NULL && column->offsets == NULL)) {
+		columnar_column_free(column);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Start a new row group with the columns of the previous one, in order. */
+static struct columnar_group *columnar_group_create(struct columnar *columnar,
+						    struct columnar_group *previous)
+{
+	struct columnar_group *group;
+	unsigned int count = previous != NULL ? previous->columns_count : 0;
+	unsigned int i;
+	int rc;
+
+	group = calloc(1, sizeof(*group));
+	if (group == NULL)
+		return NULL;
+
+	if (count == 0)
+		return group;
+
+	group->columns = calloc(count, sizeof(*group->columns));
+	if (group->columns == NULL) {
+		free(group);
+		return NULL;
+	}
+
+	group->columns_allocated = count;
+
+	for (i = 0; i < count; i++) {
+		rc = columnar_column_init(&group->columns[i],
+					  previous->columns[i].name,
+					  previous->columns[i].type,
+					  columnar->group_rows);
+		if (rc < 0) {
+			columnar_group_free(group);
+			return NULL;
+		}
+
+		group->columns_count++;
+	}
+
+	return group;
+}
+
+static int columnar_group_serialize(struct columnar_group *group, void **data,
+				    uint64_t *size)
+{
+	struct columnar_group_header *header;
+	struct columnar_column_entry *entry;
+	struct columnar_column *column;
+	uint64_t offset;
+	uint8_t *buffer;
+	unsigned int rows = group->rows;
+	unsigned int i;
+
+	offset = sizeof(*header) + group->columns_count * sizeof(*entry);
+
+	for (i = 0; i < group->columns_count; i++)
+		offset += strlen(group->columns[i].name);
+
+	offset = COLUMNAR_ALIGN(offset);
+
+	for (i = 0; i < group->columns_count; i++) {
+		column = &group->columns[i];
+
+		offset += COLUMNAR_ALIGN((rows + 7) / 8);
+
+		if (column->type == COLUMNAR_TYPE_INT64)
+			offset += COLUMNAR_ALIGN(rows * sizeof(int64_t));
+		else
+			offset += COLUMNAR_ALIGN((rows + 1) * sizeof(uint32_t)) +
+				  COLUMNAR_ALIGN(column->data_size);
+	}
+
+	buffer = calloc(1, offset);
+	if (buffer == NULL)
+		return -1;
+
+	*data = buffer;
+	*size = offset;
+
+	header = (struct columnar_group_header *) buffer;
+	header->magic = COLUMNAR_GROUP_MAGIC;
+	header->rows = rows;
+	header->columns_count = group->columns_count;
+	header->size = offset;
+
+	entry = (struct columnar_column_entry *) (header + 1);
+	offset = sizeof(*header) + group->columns_count * sizeof(*entry);
+
+	for (i = 0; i < group->columns_count; i++) {
+		column = &group->columns[i];
+
+		entry[i].name_offset = offset;
+		entry[i].name_size = strlen(column->name);
+		entry[i].type = column->type;
+
+		memcpy(buffer + offset, column->name, entry[i].name_size);
+		offset += entry[i].name_size;
+	}
+
+	offset = COLUMNAR_ALIGN(offset);
+
+	for (i = 0; i < group->columns_count; i++) {
+		column = &group->columns[i];
+
+		entry[i].validity_offset = offset;
+		memcpy(buffer + offset, column->validity, (rows + 7) / 8);
+		offset += COLUMNAR_ALIGN((rows + 7) / 8);
+
+		entry[i].values_offset = offset;
+
+		if (column->type == COLUMNAR_TYPE_INT64) {
+			entry[i].values_size = rows * sizeof(int64_t);
+			memcpy(buffer + offset, column->values,
+			       entry[i].values_size);
+			offset += COLUMNAR_ALIGN(entry[i].values_size);
+		} else {
+			entry[i].values_size = (rows + 1) * sizeof(uint32_t);
+			memcpy(buffer + offset, column->offsets,
+			       entry[i].values_size);
+			offset += COLUMNAR_ALIGN(entry[i].values_size);
+
+			entry[i].data_offset = offset;
+			entry[i].data_size = column->data_size;
+			memcpy(buffer + offset, column->data, column->data_size);
+			offset += COLUMNAR_ALIGN(column->data_size);
+		}
+	}
+
+	return 0;
+}
+
+static void columnar_group_write(struct columnar *columnar,
+				 struct columnar_group *group)
+{
+	struct columnar_footer_entry *footer;
+	uint64_t size;
+	void *data;
+	int rc;
+
+	if (columnar->error != 0)
+		return;
+
+	rc = columnar_group_serialize(group, &data, &size);
+	if (rc < 0) {
+		columnar->error = ENOMEM;
+		log_error("Unable to allocate columnar row group\n");
+		return;
+	}
+
+	rc = columnar_write(columnar->fd, data, size);
+	free(data);
+
+	if (rc < 0) {
+		columnar->error = -rc;
+		log_error("Unable to write columnar row group: %s\n",
+			  strerror(-rc));
+		return;
+	}
+
+	footer = realloc(columnar->footer,
+			 (columnar->footer_count + 1) * sizeof(*footer));
+	if (footer == NULL) {
+		columnar->error = ENOMEM;
+		return;
+	}
+
+	footer[columnar->footer_count].offset = columnar->position;
+	footer[columnar->footer_count].rows = group->rows;
+	footer[columnar->footer_count].reserved = 0;
+
+	columnar->footer = footer;
+	columnar->footer_count++;
+	columnar->position += size;
+}
+
+/* Row groups are serialized and written off the decoding thread. */
+static void *columnar_thread(void *data)
+{
+	struct columnar *columnar = data;
+	struct columnar_group *group;
+
+	pthread_mutex_lock(&columnar->lock);
+
+	while (1) {
+		while (columnar->pending == NULL && !columnar->stop)
+			pthread_cond_wait(&columnar->cond, &columnar->lock);
+
+		if (columnar->pending == NULL)
+			break;
+
+		group = columnar->pending;
+		pthread_mutex_unlock(&columnar->lock);
+
+		TRACE_BEGIN("columnar write");
+		columnar_group_write(columnar, group);
+		columnar_group_free(group);
+		TRACE_END("columnar write");
+
+		pthread_mutex_lock(&columnar->lock);
+		columnar->pending = NULL;
+		pthread_cond_broadcast(&columnar->cond);
+	}
+
+	pthread_mutex_unlock(&columnar->lock);
+
+	return NULL;
+}
+
+/* Hand the current row group to the writer thread, waiting for the previous. */
+static void columnar_submit(struct columnar *columnar)
+{
+	struct columnar_group *group = columnar->current;
+
+	columnar->current = columnar_group_create(columnar, group);
+	columnar->cursor = 0;
+
+	TRACE_BEGIN("columnar wait");
+
+	pthread_mutex_lock(&columnar->lock);
+
+	while (columnar->pending != NULL)
+		pthread_cond_wait(&columnar->cond, &columnar->lock);
+
+	TRACE_END("columnar wait");
+
+	columnar->pending = group;
+	pthread_cond_broadcast(&columnar->cond);
+	pthread_mutex_unlock(&columnar->lock);
+}
+
+int columnar_open(struct columnar *columnar, const char *path,
+		  unsigned int group_rows)
+{
+	struct columnar_header header;
+	int rc;
+
+	memset(columnar, 0, sizeof(*columnar));
+
+	columnar->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			    0644);
+	if (columnar->fd < 0) {
+		log_error("Unable to open columnar output %s: %s\n", path,
+			  strerror(errno));
+		return -1;
+	}
+
+	columnar->group_rows = group_rows > 0 ? group_rows : COLUMNAR_GROUP_ROWS;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = COLUMNAR_MAGIC;
+	header.version = COLUMNAR_VERSION;
+	header.header_size = sizeof(header);
+
+	rc = columnar_write(columnar->fd, &header, sizeof(header));
+	if (rc < 0)
+		goto error;
+
+	columnar->position = sizeof(header);
+
+	columnar->current = columnar_group_create(columnar, NULL);
+	if (columnar->current == NULL)
+		goto error;
+
+	pthread_mutex_init(&columnar->lock, NULL);
+	pthread_cond_init(&columnar->cond, NULL);
+
+	rc = pthread_create(&columnar->thread, NULL, columnar_thread, columnar);
+	if (rc != 0) {
+		pthread_cond_destroy(&columnar->cond);
+		pthread_mutex_destroy(&columnar->lock);
+		goto error;
+	}
+
+	return 0;
+
+error:
+	log_error("Unable to set up columnar output %s\n", path);
+
+	columnar_group_free(columnar->current);
+	columnar->current = NULL;
+
+	close(columnar->fd);
+	columnar->fd = -1;
+	columnar->group_rows = 0;
+
+	return -1;
+}
+
+void columnar_row_begin(struct columnar *columnar)
+{
+	if (columnar->current == NULL)
+		return;
+
+	if (columnar->current->rows == columnar->group_rows)
+		columnar_submit(columnar);
+
+	columnar->cursor = 0;
+	columnar->row_open = columnar->current != NULL;
+}
+
+/*
+ * Fields are usually emitted in the same order for every row, so the column
+ * following the last one is checked first. Columns have a fixed type and
+ * values of another type are dropped.
+ */
+static struct columnar_column *columnar_column_find(struct columnar *columnar,
+						    const char *name,
+						    enum columnar_type type)
+{
+	struct columnar_group *group = columnar->current;
+	struct columnar_column *columns;
+	struct columnar_column *column;
+	unsigned int allocated;
+	unsigned int i;
+	int rc;
+
+	if (columnar->cursor < group->columns_count &&
+	    strcmp(group->columns[columnar->cursor].name, name) == 0) {
+		column = &group->columns[columnar->cursor++];
+		return column->type == type ? column : NULL;
+	}
+
+	for (i = 0; i < group->columns_count; i++) {
+		if (strcmp(group->columns[i].name, name) == 0) {
+			columnar->cursor = i + 1;
+			column = &group->columns[i];
+			return column->type == type ? column : NULL;
+		}
+	}
+
+	if (group->columns_count == group->columns_allocated) {
+		allocated = group->columns_allocated * 2 + 16;
+
+		columns = realloc(group->columns, allocated * sizeof(*columns));
+		if (columns == NULL)
+			return NULL;
+
+		group->columns = columns;
+		group->columns_allocated = allocated;
+	}
+
+	rc = columnar_column_init(&group->columns[group->columns_count], name,
+				  type, columnar->group_rows);
+	if (rc < 0)
+		return NULL;
+
+	columnar->cursor = group->columns_count + 1;
+
+	return &group->columns[group->columns_count++];
+}
+
+static int columnar_data_append(struct columnar_column *column,
+				const char *value, unsigned int size)
+{
+	unsigned int allocated;
+	char *data;
+
+	if (column->data_size + size > column->data_allocated) {
+		allocated = column->data_allocated * 2 + size + 256;
+
+		data = realloc(column->data, allocated);
+		if (data == NULL)
+			return -1;
+
+		column->data = data;
+		column->data_allocated = allocated;
+	}
+
+	memcpy(column->data + column->data_size, value, size);
+	column->data_size += size;
+
+	return 0;
+}
+
+void columnar_int(struct columnar *columnar, const char *name, int64_t value)
+{
+	struct columnar_column *column;
+	unsigned int row;
+
+	if (!columnar->row_open)
+		return;
+
+	column = columnar_column_find(columnar, name, COLUMNAR_TYPE_INT64);
+	if (column == NULL)
+		return;
+
+	row = columnar->current->rows;
+
+	/* Only keep the first value emitted for a field in a row. */
+	if (column->validity[row / 8] & (1 << (row % 8)))
+		return;
+
+	column->values[row] = value;
+	column->validity[row / 8] |= 1 << (row % 8);
+}
+
+void columnar_string(struct columnar *columnar, const char *name,
+		     const char *value, unsigned int size)
+{
+	struct columnar_column *column;
+	unsigned int row;
+	int rc;
+
+	if (!columnar->row_open)
+		return;
+
+	column = columnar_column_find(columnar, name, COLUMNAR_TYPE_STRING);
+	if (column == NULL)
+		return;
+
+	row = columnar->current->rows;
+
+	if (column->validity[row / 8] & (1 << (row % 8)))
+		return;
+
+	rc = columnar_data_append(column, value, size);
+	if (rc < 0)
+		return;
+
+	column->offsets[row + 1] = column->data_size;
+	column->validity[row / 8] |= 1 << (row % 8);
+}
+
+void columnar_row_end(struct columnar *columnar)
+{
+	struct columnar_group *group = columnar->current;
+	struct columnar_column *column;
+	unsigned int i;
+
+	if (!columnar->row_open)
+		return;
+
+	/* Rows without a value still need their string offsets. */
+	for (i = 0; i < group->columns_count; i++) {
+		column = &group->columns[i];
+
+		if (column->type == COLUMNAR_TYPE_STRING)
+			column->offsets[group->rows + 1] = column->data_size;
+	}
+
+	group->rows++;
+	columnar->row_open = false;
+}
+
+void columnar_close(struct columnar *columnar)
+{
+	struct columnar_trailer trailer;
+	int rc;
+
+	/* The row group size is only set once opened. */
+	if (columnar->group_rows == 0)
+		return;
+
+	if (columnar->row_open)
+		columnar_row_end(columnar);
+
+	if (columnar->current != NULL && columnar->current->rows > 0)
+		columnar_submit(columnar);
+
+	pthread_mutex_lock(&columnar->lock);
+	columnar->stop = true;
+	pthread_cond_broadcast(&columnar->cond);
+	pthread_mutex_unlock(&columnar->lock);
+
+	pthread_join(columnar->thread, NULL);
+
+	pthread_cond_destroy(&columnar->cond);
+	pthread_mutex_destroy(&columnar->lock);
+
+	memset(&trailer, 0, sizeof(trailer));
+	trailer.footer_offset = columnar->position;
+	trailer.groups_count = columnar->footer_count;
+	trailer.magic = COLUMNAR_TRAILER_MAGIC;
+
+	rc = columnar_write(columnar->fd, columnar->footer,
+			    columnar->footer_count * sizeof(*columnar->footer));
+	if (rc == 0)
+		rc = columnar_write(columnar->fd, &trailer, sizeof(trailer));
+
+	if (rc < 0)
+		log_error("Unable to write columnar footer: %s\n",
+			  strerror(-rc));
+
+	columnar_group_free(columnar->current);
+	columnar->current = NULL;
+
+	free(columnar->footer);
+	columnar->footer = NULL;
+
+	close(columnar->fd);
+	columnar->fd = -1;
+	columnar->group_rows = 0;
+}
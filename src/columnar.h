@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _COLUMNAR_H_
+#define _COLUMNAR_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Values
+ */
+
+#define COLUMNAR_MAGIC				0x4c4f4344
+#define COLUMNAR_GROUP_MAGIC			0x50524743
+#define COLUMNAR_TRAILER_MAGIC			0x444e4543
+#define COLUMNAR_VERSION			1
+#define COLUMNAR_ALIGNMENT			8
+#define COLUMNAR_GROUP_ROWS			1024
+
+enum columnar_type {
+	COLUMNAR_TYPE_INT64 = 0,
+	COLUMNAR_TYPE_STRING = 1,
+};
+
+/*
+ * Structures
+ */
+
+/*
+ * A columnar file starts with a header, followed by self-describing row
+ * groups and ends with a footer listing the row groups and a trailer pointing
+ * to the footer. Readers start from the trailer and only need to map the
+ * columns they scan. All values are in host byte order, offsets within a row
+ * group are relative to its header and aligned to COLUMNAR_ALIGNMENT.
+ *
+ * Each column of a row group has a validity bitmap with one bit per row, set
+ * when the row has a value. Integer columns then hold an int64_t per row and
+ * string columns hold rows + 1 uint32_t offsets into their character data.
+ * Columns missing from a row group have no value for its rows.
+ */
+
+struct columnar_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t reserved;
+};
+
+struct columnar_group_header {
+	uint32_t magic;
+	uint32_t rows;
+	uint32_t columns_count;
+	uint32_t reserved;
+	uint64_t size;
+};
+
+struct columnar_column_entry {
+	uint32_t name_offset;
+	uint16_t name_size;
+	uint8_t type;
+	uint8_t reserved;
+	uint64_t validity_offset;
+	uint64_t values_offset;
+	uint64_t values_size;
+	uint64_t data_offset;
+	uint64_t data_size;
+};
+
+struct columnar_footer_entry {
+	uint64_t offset;
+	uint32_t rows;
+	uint32_t reserved;
+};
+
+struct columnar_trailer {
+	uint64_t footer_offset;
+	uint32_t groups_count;
+	uint32_t magic;
+};
+
+struct columnar_column {
+	char *name;
+	enum columnar_type type;
+
+	uint8_t *validity;
+	int64_t *values;
+	uint32_t *offsets;
+	char *data;
+	unsigned int data_size;
+	unsigned int data_allocated;
+};
+
+struct columnar_group {
+	struct columnar_column *columns;
+	unsigned int columns_count;
+	unsigned int columns_allocated;
+	unsigned int rows;
+};
+
+struct columnar {
+	int fd;
+	unsigned int group_rows;
+
+	struct columnar_group *current;
+	unsigned int cursor;
+	bool row_open;
+
+	struct columnar_group *pending;
+	struct columnar_footer_entry *footer;
+	unsigned int footer_count;
+	uint64_t position;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool stop;
+	int error;
+};
+
+/*
+ * Functions
+ */
+
+int columnar_open(struct columnar *columnar, const char *path,
+		  unsigned int group_rows);
+void columnar_row_begin(struct columnar *columnar);
+void columnar_int(struct columnar *columnar, const char *name, int64_t value);
+void columnar_string(struct columnar *columnar, const char *name,
+		     const char *value, unsigned int size);
+void columnar_row_end(struct columnar *columnar);
+void columnar_close(struct columnar *columnar);
+
+#endif
@@ -19,11 +19,14 @@
 #include <string.h>
 
 #include "config.h"
+#include "trace.h"
 
 VAStatus DumpCreateConfig(VADriverContextP context, VAProfile profile,
 	VAEntrypoint entrypoint, VAConfigAttrib *attributes,
 	int attributes_count, VAConfigID *config_id)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_config *config_object;
 	VAConfigID id;
@@ -73,6 +76,8 @@ VAStatus DumpCreateConfig(VADriverContextP context, VAProfile profile,
 
 VAStatus DumpDestroyConfig(VADriverContextP context, VAConfigID config_id)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_config *config_object;
 
@@ -89,6 +94,8 @@ VAStatus DumpQueryConfigAttributes(VADriverContextP context,
 	VAConfigID config_id, VAProfile *profile, VAEntrypoint *entrypoint,
 	VAConfigAttrib *attributes, int *attributes_count)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_config *config_object;
 	int i;
@@ -118,6 +125,8 @@ VAStatus DumpGetConfigAttributes(VADriverContextP context, VAProfile profile,
 	VAEntrypoint entrypoint, VAConfigAttrib *attributes,
 	int attributes_count)
 {
+	TRACE_FUNCTION();
+
 	unsigned int i;
 
 	for (i = 0; i < attributes_count; i++) {
@@ -137,6 +146,8 @@ VAStatus DumpGetConfigAttributes(VADriverContextP context, VAProfile profile,
 VAStatus DumpQueryConfigProfiles(VADriverContextP context, VAProfile *profiles,
 	int *profiles_count)
 {
+	TRACE_FUNCTION();
+
 	VAProfile supported_profiles[] = {
 		VAProfileMPEG2Main,
 		VAProfileMPEG2Simple,
@@ -161,6 +172,8 @@ VAStatus DumpQueryConfigProfiles(VADriverContextP context, VAProfile *profiles,
 VAStatus DumpQueryConfigEntrypoints(VADriverContextP context, VAProfile profile,
 	VAEntrypoint *entrypoints, int *entrypoints_count)
 {
+	TRACE_FUNCTION();
+
 	switch (profile) {
 		case VAProfileMPEG2Simple:
 		case VAProfileMPEG2Main:
@@ -185,17 +198,23 @@ VAStatus DumpQueryConfigEntrypoints(VADriverContextP context, VAProfile profile,
 VAStatus DumpQueryDisplayAttributes(VADriverContextP context,
 	VADisplayAttribute *attributes, int *attributes_count)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_ERROR_UNIMPLEMENTED;
 }
 
 VAStatus DumpGetDisplayAttributes(VADriverContextP context,
 	VADisplayAttribute *attributes, int attributes_count)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_ERROR_UNIMPLEMENTED;
 }
 
 VAStatus DumpSetDisplayAttributes(VADriverContextP context,
 	VADisplayAttribute *attributes, int attributes_count)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_ERROR_UNIMPLEMENTED;
 }
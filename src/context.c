@@ -21,11 +21,80 @@
 #include "dump.h"
 #include "context.h"
 #include "config.h"
+#include "surface.h"
+#include "trace.h"
+
+/*
+ * Worst-case size of the slice data for a picture of the context. Coded
+ * pictures are not expected to exceed the raw 4:2:0 picture, while H.264 and
+ * HEVC may carry PCM samples with extra syntax for each block.
+ */
+unsigned int context_staging_size(VAProfile profile, int width, int height)
+{
+	unsigned int size;
+
+	if (width <= 0 || height <= 0)
+		return CONTEXT_STAGING_SIZE_DEFAULT;
+
+	switch (profile) {
+		case VAProfileMPEG2Simple:
+		case VAProfileMPEG2Main:
+			width = (width + 15) & ~15;
+			height = (height + 15) & ~15;
+			size = width * height * 3 / 2;
+			break;
+
+		case VAProfileHEVCMain:
+			width = (width + 63) & ~63;
+			height = (height + 63) & ~63;
+			size = width * height * 3 / 2;
+			size += size / 8;
+			break;
+
+		default:
+			width = (width + 15) & ~15;
+			height = (height + 15) & ~15;
+			size = width * height * 3 / 2;
+			size += size / 8;
+			break;
+	}
+
+	return size + CONTEXT_STAGING_MARGIN;
+}
+
+/*
+ * Release the slice staging of the surfaces of the context, either all of it
+ * or only for surfaces that were not rendered to for a while. Golden mode may
+ * need the last frame of any surface that is still referenced.
+ */
+void context_staging_release(struct dump_driver_data *driver_data,
+	struct object_context *context_object, bool idle)
+{
+	struct object_surface *surface_object;
+	unsigned int i;
+
+	if (idle && driver_data->output.mode == OUTPUT_MODE_GOLDEN)
+		return;
+
+	for (i = 0; i < context_object->surfaces_count; i++) {
+		surface_object = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, context_object->surfaces_ids[i]);
+		if (surface_object == NULL || surface_object->slice_staging == NULL)
+			continue;
+
+		if (idle && (surface_object->status == VASurfaceRendering ||
+		    driver_data->frame_index - surface_object->index < SURFACE_STAGING_IDLE_FRAMES))
+			continue;
+
+		surface_staging_release(surface_object);
+	}
+}
 
 VAStatus DumpCreateContext(VADriverContextP context, VAConfigID config_id,
 	int picture_width, int picture_height, int flag,
 	VASurfaceID *surfaces_ids, int surfaces_count, VAContextID *context_id)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_config *config_object;
 	struct object_surface *surface_object;
@@ -66,6 +135,11 @@ VAStatus DumpCreateContext(VADriverContextP context, VAConfigID config_id,
 
 	context_object->config_id = config_id;
 	context_object->surfaces_ids = ids;
+	context_object->surfaces_count = surfaces_count;
+	context_object->picture_width = picture_width;
+	context_object->picture_height = picture_height;
+	context_object->flags = flag;
+	context_object->staging_size = context_staging_size(config_object->profile, picture_width, picture_height);
 
 	*context_id = id;
 
@@ -85,6 +159,8 @@ complete:
 
 VAStatus DumpDestroyContext(VADriverContextP context, VAContextID context_id)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_context *context_object;
 
@@ -92,6 +168,9 @@ VAStatus DumpDestroyContext(VADriverContextP context, VAContextID context_id)
 	if (context_object == NULL)
 		return VA_STATUS_ERROR_INVALID_CONTEXT;
 
+	context_staging_release(driver_data, context_object, false);
+	free(context_object->surfaces_ids);
+
 	object_heap_free(&driver_data->context_heap, (struct object_base *) context_object);
 
 	return VA_STATUS_SUCCESS;
@@ -18,16 +18,25 @@
 #ifndef _CONTEXT_H_
 #define _CONTEXT_H_
 
+#include <stdbool.h>
+
 #include <va/va_backend.h>
 
 #include "object_heap.h"
 
+struct dump_driver_data;
+
 /*
  * Values
  */
 
 #define CONTEXT_ID_OFFSET					0x02000000
 
+/* Slice staging size used when the context has no picture dimensions. */
+#define CONTEXT_STAGING_SIZE_DEFAULT				(1024 * 1024)
+/* Room for picture, slice and parameter set headers. */
+#define CONTEXT_STAGING_MARGIN					4096
+
 /*
  * Structures
  */
@@ -43,6 +52,11 @@ struct object_context {
 	int picture_width;
 	int picture_height;
 	int flags;
+
+	unsigned int staging_size;
+
+	/* Picture being rendered, as counted ahead of the capture. */
+	unsigned int passthrough_index;
 };
 
 /*
@@ -53,5 +67,8 @@ VAStatus DumpCreateContext(VADriverContextP context, VAConfigID config_id,
 	int picture_width, int picture_height, int flag,
 	VASurfaceID *surfaces_ids, int surfaces_count, VAContextID *context_id);
 VAStatus DumpDestroyContext(VADriverContextP context, VAContextID context_id);
+unsigned int context_staging_size(VAProfile profile, int width, int height);
+void context_staging_release(struct dump_driver_data *driver_data,
+	struct object_context *context_object, bool idle);
 
 #endif
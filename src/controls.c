@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "controls.h"
+#include "log.h"
+
+#include "autoconfig.h"
+
+#define CONTROLS_ALIGN(size) \
+	(((size) + CONTROLS_ALIGNMENT - 1) & ~(CONTROLS_ALIGNMENT - 1))
+
+#define CONTROLS_RECORD_ALIGN(size) \
+	(((size) + CONTROLS_RECORD_SIZE - 1) / CONTROLS_RECORD_SIZE * \
+	 CONTROLS_RECORD_SIZE)
+
+/* Grow the record, keeping everything past the used part zeroed. */
+static int controls_grow(struct controls *controls, unsigned int size)
+{
+	uint8_t *record;
+
+	size = CONTROLS_RECORD_ALIGN(size);
+	if (size <= controls->record_allocated)
+		return 0;
+
+	if (size > CONTROLS_RECORD_SIZE_MAX)
+		return -1;
+
+	record = realloc(controls->record, size);
+	if (record == NULL)
+		return -1;
+
+	memset(record + controls->record_allocated, 0,
+	       size - controls->record_allocated);
+
+	controls->record = record;
+	controls->record_allocated = size;
+
+	return 0;
+}
+
+int controls_open(struct controls *controls, const char *directory)
+{
+	struct controls_header header;
+	char *path;
+	int rc;
+
+#ifndef HAVE_V4L2_STATELESS
+	log_warning("V4L2 stateless controls are not supported by this build\n");
+	return -1;
+#endif
+
+	rc = asprintf(&path, "%s/%s", directory, CONTROLS_FILENAME);
+	if (rc < 0)
+		return -1;
+
+	controls->file = fopen(path, "w");
+	if (controls->file == NULL) {
+		log_error("Unable to open controls file %s: %s\n", path,
+			strerror(errno));
+		free(path);
+		return -1;
+	}
+
+	free(path);
+
+	controls->record = calloc(1, CONTROLS_RECORD_SIZE);
+	if (controls->record == NULL) {
+		fclose(controls->file);
+		controls->file = NULL;
+		return -1;
+	}
+
+	controls->record_allocated = CONTROLS_RECORD_SIZE;
+	controls->record_used = 0;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = CONTROLS_MAGIC;
+	header.version = CONTROLS_VERSION;
+	header.layout_version = CONTROLS_LAYOUT_VERSION;
+	header.record_size = CONTROLS_RECORD_SIZE;
+
+	fwrite(&header, sizeof(header), 1, controls->file);
+
+	return 0;
+}
+
+void controls_begin(struct controls *controls, unsigned int frame,
+		    unsigned int codec)
+{
+	struct controls_record *record =
+		(struct controls_record *) controls->record;
+
+	if (controls->file == NULL)
+		return;
+
+	memset(controls->record, 0, controls->record_used);
+
+	record->frame = frame;
+	record->codec = codec;
+	record->slices_count = 1;
+
+	controls->record_used = CONTROLS_ALIGN(sizeof(*record));
+}
+
+/* Mark the current record as holding a single slice of the frame. */
+void controls_slice(struct controls *controls, unsigned int slice,
+		    unsigned int slices_count)
+{
+	struct controls_record *record =
+		(struct controls_record *) controls->record;
+
+	if (controls->file == NULL)
+		return;
+
+	record->slice = slice;
+	record->slices_count = slices_count;
+}
+
+/*
+ * Reserve a zeroed payload in the current record, to be filled in place before
+ * the next payload is reserved, which may move the record.
+ */
+void *controls_add(struct controls *controls, uint32_t id, unsigned int size)
+{
+	struct controls_record *record =
+		(struct controls_record *) controls->record;
+	struct controls_entry *entry;
+	void *payload;
+
+	if (controls->file == NULL)
+		return NULL;
+
+	if (record->count >= CONTROLS_COUNT_MAX ||
+	    controls_grow(controls, controls->record_used + size) < 0) {
+		if (!controls->overflow)
+			log_warning("Controls of frame %u exceed the record size\n",
+				    record->frame);
+
+		controls->overflow = true;
+		return NULL;
+	}
+
+	record = (struct controls_record *) controls->record;
+
+	entry = &record->entries[record->count++];
+	entry->id = id;
+	entry->size = size;
+	entry->offset = controls->record_used;
+
+	payload = controls->record + controls->record_used;
+	controls->record_used += CONTROLS_ALIGN(size);
+
+	return payload;
+}
+
+void controls_end(struct controls *controls)
+{
+	struct controls_record *record =
+		(struct controls_record *) controls->record;
+	unsigned int frame;
+	uint8_t *empty;
+
+	if (controls->file == NULL)
+		return;
+
+	/* Only the slices of the last frame may follow its first record. */
+	frame = record->frame;
+	if (frame < controls->frames_count &&
+	    (record->slice == 0 || frame + 1 != controls->frames_count))
+		return;
+
+	record->flags |= CONTROLS_FLAG_VALID;
+	record->size = CONTROLS_RECORD_ALIGN(controls->record_used);
+
+	/* Frames that were not dumped get an empty record. */
+	if (controls->frames_count < frame) {
+		empty = calloc(1, CONTROLS_RECORD_SIZE);
+		if (empty == NULL)
+			return;
+
+		((struct controls_record *) empty)->size = CONTROLS_RECORD_SIZE;
+		((struct controls_record *) empty)->slices_count = 1;
+
+		while (controls->frames_count < frame) {
+			((struct controls_record *) empty)->frame =
+				controls->frames_count++;
+			fwrite(empty, CONTROLS_RECORD_SIZE, 1, controls->file);
+		}
+
+		free(empty);
+	}
+
+	fwrite(controls->record, record->size, 1, controls->file);
+	controls->frames_count = frame + 1;
+}
+
+void controls_close(struct controls *controls)
+{
+	if (controls->file != NULL) {
+		fclose(controls->file);
+		controls->file = NULL;
+	}
+
+	free(controls->record);
+	controls->record = NULL;
+	controls->record_allocated = 0;
+	controls->record_used = 0;
+}
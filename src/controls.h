@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CONTROLS_H_
+#define _CONTROLS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Values
+ */
+
+#define CONTROLS_FILENAME			"controls.bin"
+
+#define CONTROLS_MAGIC				0x4c525443
+#define CONTROLS_VERSION			2
+
+/*
+ * Version of the v4l2_ctrl_* payload layouts, bumped whenever one of them
+ * changes: 1 stands for the stateless codec uAPI of Linux 6.0, where the H.265
+ * controls left staging.
+ */
+#define CONTROLS_LAYOUT_VERSION			1
+
+#define CONTROLS_RECORD_SIZE			4096
+#define CONTROLS_RECORD_SIZE_MAX		(256 * CONTROLS_RECORD_SIZE)
+#define CONTROLS_COUNT_MAX			8
+#define CONTROLS_ALIGNMENT			8
+
+/* Records are only missing for frames that could not be dumped. */
+#define CONTROLS_FLAG_VALID			(1 << 0)
+
+/*
+ * Reference timestamps in the payloads identify frames by index: frame N is
+ * expected to be queued with a timestamp of N microseconds.
+ */
+#define CONTROLS_TIMESTAMP(index)		((uint64_t) (index) * 1000)
+
+/*
+ * Structures
+ */
+
+/*
+ * The controls file starts with this header, followed by records in host byte
+ * order, in frame order. Each record takes a multiple of record_size bytes,
+ * given by its size, and holds up to CONTROLS_COUNT_MAX payloads, ready to be
+ * passed as is in the p_u8 pointer of a struct v4l2_ext_control. Dynamic array
+ * controls hold all their elements in a single payload.
+ *
+ * Every frame has at least one record. Frames that are decoded one slice at a
+ * time have one record per slice, all with the same frame and slices count.
+ */
+struct controls_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t layout_version;
+	uint32_t record_size;
+	uint32_t reserved[4];
+};
+
+/* Payload offsets are relative to the start of the record. */
+struct controls_entry {
+	uint32_t id;
+	uint32_t size;
+	uint32_t offset;
+	uint32_t reserved;
+};
+
+/* Codecs are given as in the frame index. */
+struct controls_record {
+	uint32_t frame;
+	uint32_t flags;
+	uint32_t codec;
+	uint32_t count;
+	uint32_t size;
+	uint32_t slice;
+	uint32_t slices_count;
+	uint32_t reserved;
+	struct controls_entry entries[CONTROLS_COUNT_MAX];
+};
+
+struct controls {
+	FILE *file;
+	unsigned int frames_count;
+
+	uint8_t *record;
+	unsigned int record_used;
+	unsigned int record_allocated;
+	bool overflow;
+};
+
+/*
+ * Functions
+ */
+
+int controls_open(struct controls *controls, const char *directory);
+void controls_begin(struct controls *controls, unsigned int frame,
+		    unsigned int codec);
+void controls_slice(struct controls *controls, unsigned int slice,
+		    unsigned int slices_count);
+void *controls_add(struct controls *controls, uint32_t id, unsigned int size);
+void controls_end(struct controls *controls);
+void controls_close(struct controls *controls);
+
+#endif
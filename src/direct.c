@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "direct.h"
+#include "trace.h"
+#include "log.h"
+
+static unsigned int direct_align(unsigned int size)
+{
+	return (size + DIRECT_ALIGNMENT - 1) & ~(DIRECT_ALIGNMENT - 1);
+}
+
+static void *direct_thread(void *arg)
+{
+	struct direct *direct = arg;
+	struct direct_buffer *buffer;
+	unsigned int written;
+	unsigned int size;
+	ssize_t rc;
+
+	pthread_mutex_lock(&direct->lock);
+
+	while (1) {
+		while (direct->pending_count == 0 && !direct->stop)
+			pthread_cond_wait(&direct->cond, &direct->lock);
+
+		if (direct->pending_count == 0)
+			break;
+
+		buffer = direct->pending_buffers[direct->pending_head];
+		direct->pending_head = (direct->pending_head + 1) %
+				       direct->buffer_count;
+		direct->pending_count--;
+
+		pthread_mutex_unlock(&direct->lock);
+
+		TRACE_BEGIN("direct write");
+
+		/* Buffers are always written whole, padded to the alignment. */
+		size = direct_align(buffer->size);
+		written = 0;
+
+		while (written < size) {
+			rc = pwrite(direct->fd, buffer->data + written,
+				    size - written, buffer->offset + written);
+			if (rc < 0 && errno == EINTR)
+				continue;
+			if (rc <= 0) {
+				log_error("Unable to write direct dump: %s\n",
+					strerror(errno));
+				direct->error = errno;
+				break;
+			}
+
+			written += rc;
+		}
+
+		TRACE_END("direct write");
+
+		pthread_mutex_lock(&direct->lock);
+
+		direct->free_buffers[direct->free_count++] = buffer;
+		pthread_cond_broadcast(&direct->cond);
+	}
+
+	pthread_mutex_unlock(&direct->lock);
+
+	return NULL;
+}
+
+static struct direct_buffer *direct_acquire(struct direct *direct)
+{
+	struct direct_buffer *buffer;
+
+	TRACE_BEGIN("direct wait");
+
+	pthread_mutex_lock(&direct->lock);
+
+	while (direct->free_count == 0)
+		pthread_cond_wait(&direct->cond, &direct->lock);
+
+	buffer = direct->free_buffers[--direct->free_count];
+
+	pthread_mutex_unlock(&direct->lock);
+
+	TRACE_END("direct wait");
+
+	buffer->size = 0;
+	buffer->offset = direct->position;
+
+	return buffer;
+}
+
+static void direct_submit(struct direct *direct, struct direct_buffer *buffer)
+{
+	unsigned int index;
+
+	pthread_mutex_lock(&direct->lock);
+
+	index = (direct->pending_head + direct->pending_count) %
+		direct->buffer_count;
+	direct->pending_buffers[index] = buffer;
+	direct->pending_count++;
+
+	pthread_cond_broadcast(&direct->cond);
+	pthread_mutex_unlock(&direct->lock);
+}
+
+int direct_open(struct direct *direct, const char *path,
+		unsigned int buffer_size, unsigned int buffer_count)
+{
+	unsigned int i;
+	int rc;
+
+	memset(direct, 0, sizeof(*direct));
+
+	direct->buffer_size = direct_align(buffer_size > 0 ? buffer_size :
+					   DIRECT_BUFFER_SIZE);
+	direct->buffer_count = buffer_count > 0 ? buffer_count :
+			       DIRECT_BUFFER_COUNT;
+
+	direct->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT |
+			  O_CLOEXEC, 0644);
+	if (direct->fd < 0 && errno == EINVAL) {
+		log_warning("Direct I/O is not supported for %s, using buffered I/O\n",
+			path);
+		direct->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC |
+				  O_CLOEXEC, 0644);
+	}
+
+	if (direct->fd < 0) {
+		log_error("Unable to open direct dump path %s: %s\n",
+			path, strerror(errno));
+		return -1;
+	}
+
+	direct->buffers = calloc(direct->buffer_count, sizeof(*direct->buffers));
+	direct->free_buffers = calloc(direct->buffer_count,
+				      sizeof(*direct->free_buffers));
+	direct->pending_buffers = calloc(direct->buffer_count,
+					 sizeof(*direct->pending_buffers));
+	if (direct->buffers == NULL || direct->free_buffers == NULL ||
+	    direct->pending_buffers == NULL)
+		goto error;
+
+	/* The staging pool is allocated once for the whole capture. */
+	for (i = 0; i < direct->buffer_count; i++) {
+		rc = posix_memalign((void **) &direct->buffers[i].data,
+				    DIRECT_ALIGNMENT, direct->buffer_size);
+		if (rc != 0)
+			goto error;
+
+		direct->free_buffers[direct->free_count++] = &direct->buffers[i];
+	}
+
+	pthread_mutex_init(&direct->lock, NULL);
+	pthread_cond_init(&direct->cond, NULL);
+
+	rc = pthread_create(&direct->thread, NULL, direct_thread, direct);
+	if (rc != 0) {
+		pthread_cond_destroy(&direct->cond);
+		pthread_mutex_destroy(&direct->lock);
+		goto error;
+	}
+
+	return 0;
+
+error:
+	log_error("Unable to allocate direct dump buffers\n");
+
+	if (direct->buffers != NULL)
+		for (i = 0; i < direct->buffer_count; i++)
+			free(direct->buffers[i].data);
+
+	free(direct->buffers);
+	free(direct->free_buffers);
+	free(direct->pending_buffers);
+	direct->buffers = NULL;
+
+	close(direct->fd);
+	direct->fd = -1;
+
+	return -1;
+}
+
+int direct_write(struct direct *direct, const void *data, unsigned int size)
+{
+	const uint8_t *source = data;
+	struct direct_buffer *buffer;
+	unsigned int count;
+
+	if (direct->fd < 0 || direct->error != 0)
+		return -1;
+
+	while (size > 0) {
+		if (direct->current == NULL)
+			direct->current = direct_acquire(direct);
+
+		buffer = direct->current;
+
+		count = direct->buffer_size - buffer->size;
+		if (count > size)
+			count = size;
+
+		memcpy(buffer->data + buffer->size, source, count);
+		buffer->size += count;
+		direct->position += count;
+
+		source += count;
+		size -= count;
+
+		if (buffer->size == direct->buffer_size) {
+			direct_submit(direct, buffer);
+			direct->current = NULL;
+		}
+	}
+
+	return 0;
+}
+
+uint64_t direct_position(struct direct *direct)
+{
+	return direct->position;
+}
+
+void direct_close(struct direct *direct)
+{
+	struct direct_buffer *buffer = direct->current;
+	unsigned int i;
+	int rc;
+
+	if (direct->fd < 0)
+		return;
+
+	/* Pad the tail to the alignment, the file is truncated afterwards. */
+	if (buffer != NULL && buffer->size > 0) {
+		memset(buffer->data + buffer->size, 0,
+		       direct_align(buffer->size) - buffer->size);
+		direct_submit(direct, buffer);
+	} else if (buffer != NULL) {
+		pthread_mutex_lock(&direct->lock);
+		direct->free_buffers[direct->free_count++] = buffer;
+		pthread_mutex_unlock(&direct->lock);
+	}
+
+	direct->current = NULL;
+
+	pthread_mutex_lock(&direct->lock);
+	direct->stop = true;
+	pthread_cond_broadcast(&direct->cond);
+	pthread_mutex_unlock(&direct->lock);
+
+	pthread_join(direct->thread, NULL);
+
+	rc = ftruncate(direct->fd, direct->position);
+	if (rc < 0)
+		log_error("Unable to truncate direct dump: %s\n",
+			strerror(errno));
+
+	close(direct->fd);
+	direct->fd = -1;
+
+	for (i = 0; i < direct->buffer_count; i++)
+		free(direct->buffers[i].data);
+
+	free(direct->buffers);
+	free(direct->free_buffers);
+	free(direct->pending_buffers);
+	direct->buffers = NULL;
+
+	pthread_cond_destroy(&direct->cond);
+	pthread_mutex_destroy(&direct->lock);
+}
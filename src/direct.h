@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DIRECT_H_
+#define _DIRECT_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Values
+ */
+
+#define DIRECT_ALIGNMENT			4096
+#define DIRECT_BUFFER_SIZE			(4 * 1024 * 1024)
+#define DIRECT_BUFFER_COUNT			4
+
+/*
+ * Structures
+ */
+
+struct direct_buffer {
+	uint8_t *data;
+	unsigned int size;
+	uint64_t offset;
+};
+
+struct direct {
+	int fd;
+
+	struct direct_buffer *buffers;
+	unsigned int buffer_size;
+	unsigned int buffer_count;
+
+	struct direct_buffer **free_buffers;
+	unsigned int free_count;
+	struct direct_buffer **pending_buffers;
+	unsigned int pending_head;
+	unsigned int pending_count;
+
+	struct direct_buffer *current;
+	uint64_t position;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool stop;
+	int error;
+};
+
+/*
+ * Functions
+ */
+
+int direct_open(struct direct *direct, const char *path,
+		unsigned int buffer_size, unsigned int buffer_count);
+int direct_write(struct direct *direct, const void *data, unsigned int size);
+uint64_t direct_position(struct direct *direct);
+void direct_close(struct direct *direct);
+
+#endif
@@ -15,6 +15,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdarg.h>
@@ -30,7 +31,18 @@
 #include "picture.h"
 #include "subpicture.h"
 #include "surface.h"
+#include "output.h"
+#include "direct.h"
+#include "es.h"
+#include "governor.h"
+#include "passthrough.h"
+#include "ring.h"
+#include "stream.h"
+#include "stats.h"
+#include "timing.h"
+#include "trace.h"
 #include "config.h"
+#include "log.h"
 
 #include "autoconfig.h"
 
@@ -41,7 +53,10 @@ VAStatus VA_DRIVER_INIT_FUNC(VADriverContextP context)
 {
 	struct dump_driver_data *driver_data;
 	struct VADriverVTable *vtable = context->vtable;
+	unsigned long long budget_bytes = 0;
+	unsigned int budget_cpu = 0;
 	char *env;
+	int rc;
 
 	context->version_major = VA_MAJOR_VERSION;
 	context->version_minor = VA_MINOR_VERSION;
@@ -106,6 +121,13 @@ VAStatus VA_DRIVER_INIT_FUNC(VADriverContextP context)
 
 	context->pDriverData = (void *) driver_data;
 
+	env = getenv("DUMP_LOG_LEVEL");
+	log_init(env);
+
+	env = getenv("DUMP_TRACE");
+	if (env != NULL)
+		trace_init(env);
+
 	object_heap_init(&driver_data->config_heap, sizeof(struct object_config), CONFIG_ID_OFFSET);
 	object_heap_init(&driver_data->context_heap, sizeof(struct object_context), CONTEXT_ID_OFFSET);
 	object_heap_init(&driver_data->surface_heap, sizeof(struct object_surface), SURFACE_ID_OFFSET);
@@ -122,6 +144,176 @@ VAStatus VA_DRIVER_INIT_FUNC(VADriverContextP context)
 	if (env != NULL)
 		driver_data->dump_count = atoi(env);
 
+	env = getenv("DUMP_RBSP");
+	if (env != NULL)
+		driver_data->slices_rbsp = atoi(env) != 0;
+
+	env = getenv("DUMP_PATH");
+	if (env != NULL)
+		driver_data->slices_path = env;
+
+	env = getenv("DUMP_FILENAME");
+	if (env != NULL)
+		driver_data->slices_filename_format = env;
+
+	driver_data->output.shard_format = "shard-%s";
+
+	env = getenv("DUMP_SHARD_FORMAT");
+	if (env != NULL)
+		driver_data->output.shard_format = env;
+
+	env = getenv("DUMP_SHARD_FRAMES");
+	if (env != NULL)
+		driver_data->output.shard_frames = atoi(env);
+
+	env = getenv("DUMP_SHARD_BYTES");
+	if (env != NULL)
+		driver_data->output.shard_bytes = strtoull(env, NULL, 0);
+
+	driver_data->output.stream_queue_size = STREAM_QUEUE_SIZE;
+	driver_data->output.stream_policy = STREAM_POLICY_DROP;
+
+	env = getenv("DUMP_STREAM");
+	if (env != NULL) {
+		driver_data->output.mode = OUTPUT_MODE_STREAM;
+		driver_data->output.stream_path = env;
+	}
+
+	env = getenv("DUMP_STREAM_QUEUE");
+	if (env != NULL)
+		driver_data->output.stream_queue_size = atoi(env);
+
+	env = getenv("DUMP_STREAM_POLICY");
+	if (env != NULL && strcmp(env, "block") == 0)
+		driver_data->output.stream_policy = STREAM_POLICY_BLOCK;
+
+	driver_data->output.ring_size = RING_DATA_SIZE;
+	driver_data->output.ring_slots = RING_SLOT_COUNT;
+
+	env = getenv("DUMP_RING");
+	if (env != NULL) {
+		driver_data->output.mode = OUTPUT_MODE_RING;
+		driver_data->output.ring_name = env;
+	}
+
+	env = getenv("DUMP_RING_SIZE");
+	if (env != NULL)
+		driver_data->output.ring_size = strtoull(env, NULL, 0);
+
+	env = getenv("DUMP_RING_SLOTS");
+	if (env != NULL)
+		driver_data->output.ring_slots = atoi(env);
+
+	env = getenv("DUMP_DIRECT");
+	if (env != NULL && atoi(env) != 0)
+		driver_data->output.mode = OUTPUT_MODE_DIRECT;
+
+	driver_data->output.direct_buffer_size = DIRECT_BUFFER_SIZE;
+	driver_data->output.direct_buffer_count = DIRECT_BUFFER_COUNT;
+
+	env = getenv("DUMP_DIRECT_BUFFER_SIZE");
+	if (env != NULL)
+		driver_data->output.direct_buffer_size = strtoul(env, NULL, 0);
+
+	env = getenv("DUMP_DIRECT_BUFFERS");
+	if (env != NULL)
+		driver_data->output.direct_buffer_count = atoi(env);
+
+	env = getenv("DUMP_HASH");
+	if (env != NULL && atoi(env) != 0)
+		driver_data->output.mode = OUTPUT_MODE_HASH;
+
+	env = getenv("DUMP_GOLDEN");
+	if (env != NULL) {
+		driver_data->output.mode = OUTPUT_MODE_GOLDEN;
+		driver_data->output.golden_path = env;
+	}
+
+	env = getenv("DUMP_ES");
+	if (env != NULL && atoi(env) != 0)
+		driver_data->output.mode = OUTPUT_MODE_ES;
+
+	driver_data->output.es_buffer_size = ES_BUFFER_SIZE;
+
+	env = getenv("DUMP_ES_BUFFER_SIZE");
+	if (env != NULL)
+		driver_data->output.es_buffer_size = strtoul(env, NULL, 0);
+
+	/* Slices of an elementary stream keep their emulation prevention bytes. */
+	if (driver_data->output.mode == OUTPUT_MODE_ES)
+		driver_data->slices_rbsp = false;
+
+	env = getenv("DUMP_CONTROLS");
+	if (env != NULL && atoi(env) != 0)
+		driver_data->output.controls_enabled = true;
+
+	env = getenv("DUMP_COLUMNAR");
+	if (env != NULL)
+		driver_data->output.columnar_path = env;
+
+	driver_data->output.columnar_rows = COLUMNAR_GROUP_ROWS;
+
+	env = getenv("DUMP_COLUMNAR_ROWS");
+	if (env != NULL)
+		driver_data->output.columnar_rows = atoi(env);
+
+	env = getenv("DUMP_BUDGET_BYTES");
+	if (env != NULL)
+		budget_bytes = strtoull(env, NULL, 0);
+
+	env = getenv("DUMP_BUDGET_CPU");
+	if (env != NULL)
+		budget_cpu = atoi(env);
+
+	governor_init(&driver_data->governor, budget_bytes, budget_cpu);
+
+	timing_init(&driver_data->timing);
+
+	env = getenv("DUMP_TIMING");
+	if (env != NULL && atoi(env) != 0)
+		driver_data->timing.enabled = true;
+
+	env = getenv("DUMP_TIMING_MPEG2");
+	if (env != NULL)
+		driver_data->timing.picture_us[NAL_CODEC_MPEG2] = atoi(env);
+
+	env = getenv("DUMP_TIMING_H264");
+	if (env != NULL)
+		driver_data->timing.picture_us[NAL_CODEC_H264] = atoi(env);
+
+	env = getenv("DUMP_TIMING_H265");
+	if (env != NULL)
+		driver_data->timing.picture_us[NAL_CODEC_H265] = atoi(env);
+
+	env = getenv("DUMP_TIMING_DEPTH");
+	if (env != NULL && atoi(env) > 0)
+		driver_data->timing.depth = atoi(env) < TIMING_DEPTH_MAX ?
+					    atoi(env) : TIMING_DEPTH_MAX;
+
+	env = getenv("DUMP_TIMING_JITTER");
+	if (env != NULL && atoi(env) > 0)
+		driver_data->timing.jitter = atoi(env) < 100 ? atoi(env) : 100;
+
+	env = getenv("DUMP_STATS");
+	if (env != NULL) {
+		driver_data->stats_name = env;
+		driver_data->stats = stats_create(env);
+	}
+
+	rc = output_init(driver_data);
+	if (rc < 0)
+		log_error("Unable to initialize dump output at %s\n", driver_data->slices_path);
+
+	/* Decode with another driver, dumping what goes through. */
+	env = getenv("DUMP_BACKEND");
+	if (env != NULL) {
+		rc = passthrough_init(driver_data, context, env);
+		if (rc < 0) {
+			DumpTerminate(context);
+			return VA_STATUS_ERROR_OPERATION_FAILED;
+		}
+	}
+
 	return VA_STATUS_SUCCESS;
 }
 
@@ -133,6 +325,8 @@ VAStatus DumpTerminate(VADriverContextP context)
 	struct object_surface *surface_object;
 	struct object_context *context_object;
 	struct object_config *config_object;
+	VASurfaceID *surfaces_ids;
+	int surfaces_count;
 	int iterator;
 
 	image_object = (struct object_image *) object_heap_first(&driver_data->image_heap, &iterator);
@@ -151,14 +345,6 @@ VAStatus DumpTerminate(VADriverContextP context)
 
 	object_heap_destroy(&driver_data->buffer_heap);
 
-	surface_object = (struct object_surface *) object_heap_first(&driver_data->surface_heap, &iterator);
-	while (surface_object != NULL) {
-		DumpDestroySurfaces(context, (VASurfaceID *) &surface_object->base.id, 1);
-		surface_object = (struct object_surface *) object_heap_next(&driver_data->surface_heap, &iterator);
-	}
-
-	object_heap_destroy(&driver_data->surface_heap);
-
 	context_object = (struct object_context *) object_heap_first(&driver_data->context_heap, &iterator);
 	while (context_object != NULL) {
 		DumpDestroyContext(context, (VAContextID) context_object->base.id);
@@ -167,6 +353,27 @@ VAStatus DumpTerminate(VADriverContextP context)
 
 	object_heap_destroy(&driver_data->context_heap);
 
+	/* Destroy all the surfaces at once, falling back to one at a time. */
+	surfaces_ids = malloc(driver_data->surface_heap.heap_size * sizeof(*surfaces_ids));
+	surfaces_count = 0;
+
+	surface_object = (struct object_surface *) object_heap_first(&driver_data->surface_heap, &iterator);
+	while (surface_object != NULL) {
+		if (surfaces_ids != NULL)
+			surfaces_ids[surfaces_count++] = surface_object->base.id;
+		else
+			DumpDestroySurfaces(context, (VASurfaceID *) &surface_object->base.id, 1);
+
+		surface_object = (struct object_surface *) object_heap_next(&driver_data->surface_heap, &iterator);
+	}
+
+	if (surfaces_ids != NULL) {
+		DumpDestroySurfaces(context, surfaces_ids, surfaces_count);
+		free(surfaces_ids);
+	}
+
+	object_heap_destroy(&driver_data->surface_heap);
+
 	config_object = (struct object_config *) object_heap_first(&driver_data->config_heap, &iterator);
 	while (config_object != NULL) {
 		DumpDestroyConfig(context, (VAConfigID) config_object->base.id);
@@ -175,6 +382,24 @@ VAStatus DumpTerminate(VADriverContextP context)
 
 	object_heap_destroy(&driver_data->config_heap);
 
+	output_terminate(driver_data);
+
+	nal_index_destroy(&driver_data->nal_index);
+
+	free(driver_data->slices);
+	driver_data->slices = NULL;
+	driver_data->slices_allocated = 0;
+
+	governor_report(&driver_data->governor);
+
+	timing_destroy(&driver_data->timing);
+
+	stats_destroy(driver_data->stats, driver_data->stats_name);
+
+	trace_destroy();
+
+	log_destroy();
+
 	free(context->pDriverData);
 	context->pDriverData = NULL;
 
@@ -18,9 +18,17 @@
 #ifndef _DUMP_H_
 #define _DUMP_H_
 
+#include <stdbool.h>
+
 #include <va/va_backend.h>
 
+#include "governor.h"
 #include "object_heap.h"
+#include "nal.h"
+#include "output.h"
+#include "passthrough.h"
+#include "stats.h"
+#include "timing.h"
 
 /*
  * Values
@@ -40,6 +48,16 @@
  * Structures
  */
 
+/* Parameters of one slice of the picture and offset of its slice data. */
+struct dump_slice {
+	union {
+		VASliceParameterBufferMPEG2 mpeg2;
+		VASliceParameterBufferH264 h264;
+		VASliceParameterBufferHEVC h265;
+	} params;
+	unsigned int offset;
+};
+
 struct dump_driver_data {
 	struct object_heap config_heap;
 	struct object_heap context_heap;
@@ -49,11 +67,25 @@ struct dump_driver_data {
 
 	char *slices_path;
 	char *slices_filename_format;
+	bool slices_rbsp;
 	unsigned int dump_count;
 
 	int dump_fd;
 	unsigned int frame_index;
 
+	struct nal_index nal_index;
+	struct dump_slice *slices;
+	unsigned int slices_count;
+	unsigned int slices_allocated;
+
+	struct output output;
+	struct governor governor;
+	struct passthrough passthrough;
+	struct timing timing;
+
+	char *stats_name;
+	struct stats *stats;
+
 	union {
 		struct {
 			VAPictureParameterBufferMPEG2 picture;
@@ -0,0 +1,989 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dump.h"
+#include "bitstream.h"
+#include "es.h"
+#include "picture.h"
+#include "log.h"
+
+#define ES_H264_NAL_SPS				7
+#define ES_H264_NAL_PPS				8
+#define ES_H264_NAL_SLICE_EXT			20
+
+#define ES_H265_NAL_IRAP_FIRST			16
+#define ES_H265_NAL_IRAP_LAST			23
+#define ES_H265_NAL_VPS				32
+#define ES_H265_NAL_SPS				33
+#define ES_H265_NAL_PPS				34
+
+/* Sub-layers are declared up to the maximum so that any temporal id is valid. */
+#define ES_H265_SUB_LAYERS_MAX_MINUS1		6
+
+#define ES_MPEG2_PICTURE_START_CODE		0x00
+#define ES_MPEG2_SEQUENCE_HEADER_CODE		0xb3
+#define ES_MPEG2_EXTENSION_START_CODE		0xb5
+#define ES_MPEG2_SEQUENCE_END_CODE		0xb7
+
+#define ES_MPEG2_SEQUENCE_EXTENSION_ID		1
+#define ES_MPEG2_QUANT_MATRIX_EXTENSION_ID	3
+#define ES_MPEG2_PICTURE_CODING_EXTENSION_ID	8
+
+#define ES_MPEG2_PICTURE_TYPE_I			1
+#define ES_MPEG2_PICTURE_TYPE_P			2
+#define ES_MPEG2_PICTURE_TYPE_B			3
+
+static const uint8_t es_zigzag_4x4[16] = {
+	0, 1, 4, 8, 5, 2, 3, 6, 9, 12, 13, 10, 7, 11, 14, 15,
+};
+
+static const uint8_t es_zigzag_8x8[64] = {
+	0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+static const char *es_filename(enum nal_codec codec)
+{
+	switch (codec) {
+	case NAL_CODEC_H264:
+		return ES_H264_FILENAME;
+	case NAL_CODEC_H265:
+		return ES_H265_FILENAME;
+	default:
+		return ES_MPEG2_FILENAME;
+	}
+}
+
+int es_open(struct es *es, const char *directory, unsigned int buffer_size)
+{
+	es->directory = strdup(directory);
+	if (es->directory == NULL)
+		return -1;
+
+	es->buffer_size = buffer_size > 0 ? buffer_size : ES_BUFFER_SIZE;
+
+	return 0;
+}
+
+/* The stream file is named after the codec of the first frame. */
+static int es_file_open(struct es *es, enum nal_codec codec)
+{
+	char *path;
+	int rc;
+
+	rc = asprintf(&path, "%s/%s", es->directory, es_filename(codec));
+	if (rc < 0)
+		return -1;
+
+	es->file = fopen(path, "w");
+	if (es->file == NULL) {
+		log_error("Unable to open elementary stream %s: %s\n", path,
+			strerror(errno));
+		free(path);
+		return -1;
+	}
+
+	free(path);
+
+	es->buffer = malloc(es->buffer_size);
+	if (es->buffer != NULL)
+		setvbuf(es->file, es->buffer, _IOFBF, es->buffer_size);
+
+	es->codec = codec;
+	es->started = false;
+
+	return 0;
+}
+
+int es_frame_begin(struct es *es, VAProfile profile)
+{
+	enum nal_codec codec = picture_nal_codec(profile);
+	int rc;
+
+	if (es->directory == NULL)
+		return -1;
+
+	if (es->file == NULL) {
+		rc = es_file_open(es, codec);
+		if (rc < 0)
+			return -1;
+	}
+
+	/* A single stream cannot carry frames of different codecs. */
+	if (codec != es->codec) {
+		if (!es->mixed)
+			log_warning("Skipping frames of a different codec in elementary stream\n");
+
+		es->mixed = true;
+		return -1;
+	}
+
+	es->profile = profile;
+	es->headers = false;
+
+	return 0;
+}
+
+static void es_put(struct es *es, const uint8_t *data, unsigned int size)
+{
+	fwrite(data, 1, size, es->file);
+	es->position += size;
+}
+
+static void es_start_code(struct es *es, unsigned int length, int code)
+{
+	static const uint8_t start_code[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+	es_put(es, start_code + 4 - length, length);
+
+	if (code >= 0) {
+		putc(code, es->file);
+		es->position++;
+	}
+}
+
+/* Write a NAL unit from its RBSP, inserting emulation prevention bytes. */
+static void es_put_nal(struct es *es, const uint8_t *data, unsigned int size)
+{
+	unsigned int zeros = 0;
+	unsigned int i;
+
+	es_start_code(es, 4, -1);
+
+	for (i = 0; i < size; i++) {
+		if (zeros >= 2 && data[i] <= 0x03) {
+			putc(0x03, es->file);
+			es->position++;
+			zeros = 0;
+		}
+
+		putc(data[i], es->file);
+		es->position++;
+
+		zeros = data[i] == 0x00 ? zeros + 1 : 0;
+	}
+}
+
+static void es_put_writer(struct es *es, struct bitstream_writer *writer,
+			  bool nal)
+{
+	if (writer->overflow) {
+		log_warning("Elementary stream header exceeds %u bytes\n",
+			    ES_HEADER_SIZE);
+		return;
+	}
+
+	if (nal)
+		es_put_nal(es, writer->data, bitstream_writer_size(writer));
+	else
+		es_put(es, writer->data, bitstream_writer_size(writer));
+}
+
+static bool es_has_start_code(const uint8_t *data, unsigned int size)
+{
+	if (size >= 3 && data[0] == 0x00 && data[1] == 0x00 && data[2] == 0x01)
+		return true;
+
+	if (size >= 4 && data[0] == 0x00 && data[1] == 0x00 &&
+	    data[2] == 0x00 && data[3] == 0x01)
+		return true;
+
+	return false;
+}
+
+static unsigned int es_start_code_size(const uint8_t *data, unsigned int size)
+{
+	if (!es_has_start_code(data, size))
+		return 0;
+
+	return data[2] == 0x01 ? 3 : 4;
+}
+
+static int es_scaling_delta(unsigned int value, unsigned int last)
+{
+	int delta = ((int) value - (int) last + 256) % 256;
+
+	return delta > 127 ? delta - 256 : delta;
+}
+
+static bool es_scaling_flat(const uint8_t *list, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		if (list[i] != 16)
+			return false;
+
+	return true;
+}
+
+static unsigned int es_h264_profile_idc(VAProfile profile,
+					VAPictureParameterBufferH264 *picture)
+{
+	if (picture->seq_fields.bits.chroma_format_idc != 1 ||
+	    picture->bit_depth_luma_minus8 > 0 ||
+	    picture->bit_depth_chroma_minus8 > 0)
+		return 244;
+
+	switch (profile) {
+	case VAProfileH264ConstrainedBaseline:
+		return 66;
+	case VAProfileH264Main:
+		return 77;
+	default:
+		return 100;
+	}
+}
+
+static void es_h264_sps(struct es *es, struct dump_driver_data *driver_data)
+{
+	VAPictureParameterBufferH264 *picture = &driver_data->params.h264.picture;
+	struct bitstream_writer writer;
+	unsigned int profile_idc;
+	unsigned int constraints = 0;
+	unsigned int map_units;
+
+	profile_idc = es_h264_profile_idc(es->profile, picture);
+	if (es->profile == VAProfileH264ConstrainedBaseline)
+		constraints = 0xc0;
+	else if (es->profile == VAProfileH264Main)
+		constraints = 0x40;
+
+	bitstream_writer_init(&writer, es->header, sizeof(es->header));
+
+	bitstream_write(&writer, (3 << 5) | ES_H264_NAL_SPS, 8);
+	bitstream_write(&writer, profile_idc, 8);
+	bitstream_write(&writer, constraints, 8);
+	bitstream_write(&writer, ES_H264_LEVEL_IDC, 8);
+	bitstream_write_ue(&writer, 0);
+
+	if (profile_idc >= 100) {
+		bitstream_write_ue(&writer, picture->seq_fields.bits.chroma_format_idc);
+		if (picture->seq_fields.bits.chroma_format_idc == 3)
+			bitstream_write_flag(&writer, picture->seq_fields.bits.residual_colour_transform_flag);
+
+		bitstream_write_ue(&writer, picture->bit_depth_luma_minus8);
+		bitstream_write_ue(&writer, picture->bit_depth_chroma_minus8);
+		bitstream_write_flag(&writer, false);
+		bitstream_write_flag(&writer, false);
+	}
+
+	bitstream_write_ue(&writer, picture->seq_fields.bits.log2_max_frame_num_minus4);
+	bitstream_write_ue(&writer, picture->seq_fields.bits.pic_order_cnt_type);
+
+	/* Picture order count cycles are not provided, none are declared. */
+	if (picture->seq_fields.bits.pic_order_cnt_type == 0) {
+		bitstream_write_ue(&writer, picture->seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4);
+	} else if (picture->seq_fields.bits.pic_order_cnt_type == 1) {
+		bitstream_write_flag(&writer, picture->seq_fields.bits.delta_pic_order_always_zero_flag);
+		bitstream_write_se(&writer, 0);
+		bitstream_write_se(&writer, 0);
+		bitstream_write_ue(&writer, 0);
+	}
+
+	map_units = (picture->picture_height_in_mbs_minus1 + 1) /
+		    (2 - picture->seq_fields.bits.frame_mbs_only_flag);
+
+	bitstream_write_ue(&writer, picture->num_ref_frames);
+	bitstream_write_flag(&writer, picture->seq_fields.bits.gaps_in_frame_num_value_allowed_flag);
+	bitstream_write_ue(&writer, picture->picture_width_in_mbs_minus1);
+	bitstream_write_ue(&writer, map_units > 0 ? map_units - 1 : 0);
+	bitstream_write_flag(&writer, picture->seq_fields.bits.frame_mbs_only_flag);
+	if (!picture->seq_fields.bits.frame_mbs_only_flag)
+		bitstream_write_flag(&writer, picture->seq_fields.bits.mb_adaptive_frame_field_flag);
+
+	bitstream_write_flag(&writer, picture->seq_fields.bits.direct_8x8_inference_flag);
+	bitstream_write_flag(&writer, false);
+	bitstream_write_flag(&writer, false);
+	bitstream_write_trailing(&writer);
+
+	es_put_writer(es, &writer, true);
+}
+
+static void es_h264_scaling_list(struct bitstream_writer *writer,
+				 const uint8_t *list, const uint8_t *zigzag,
+				 unsigned int count)
+{
+	unsigned int last = 8;
+	unsigned int i;
+
+	bitstream_write_flag(writer, true);
+
+	for (i = 0; i < count; i++) {
+		bitstream_write_se(writer, es_scaling_delta(list[zigzag[i]], last));
+		last = list[zigzag[i]];
+	}
+}
+
+static void es_h264_pps(struct es *es, struct dump_driver_data *driver_data,
+			unsigned int pps_id)
+{
+	VAPictureParameterBufferH264 *picture = &driver_data->params.h264.picture;
+	VASliceParameterBufferH264 *slice = &driver_data->params.h264.slice;
+	VAIQMatrixBufferH264 *quantization = &driver_data->params.h264.quantization;
+	struct bitstream_writer writer;
+	unsigned int lists_8x8;
+	bool scaling;
+	unsigned int i;
+
+	bitstream_writer_init(&writer, es->header, sizeof(es->header));
+
+	bitstream_write(&writer, (3 << 5) | ES_H264_NAL_PPS, 8);
+	bitstream_write_ue(&writer, pps_id);
+	bitstream_write_ue(&writer, 0);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.entropy_coding_mode_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.pic_order_present_flag);
+	bitstream_write_ue(&writer, picture->num_slice_groups_minus1);
+
+	/* Explicit slice group maps are not provided, only changing maps are. */
+	if (picture->num_slice_groups_minus1 > 0) {
+		bitstream_write_ue(&writer, picture->slice_group_map_type);
+		if (picture->slice_group_map_type >= 3 &&
+		    picture->slice_group_map_type <= 5) {
+			bitstream_write_flag(&writer, false);
+			bitstream_write_ue(&writer, picture->slice_group_change_rate_minus1);
+		}
+	}
+
+	/* Active counts of the current slice stand for the defaults. */
+	bitstream_write_ue(&writer, slice->num_ref_idx_l0_active_minus1);
+	bitstream_write_ue(&writer, slice->num_ref_idx_l1_active_minus1);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.weighted_pred_flag);
+	bitstream_write(&writer, picture->pic_fields.bits.weighted_bipred_idc, 2);
+	bitstream_write_se(&writer, picture->pic_init_qp_minus26);
+	bitstream_write_se(&writer, picture->pic_init_qs_minus26);
+	bitstream_write_se(&writer, picture->chroma_qp_index_offset);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.deblocking_filter_control_present_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.constrained_intra_pred_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.redundant_pic_cnt_present_flag);
+
+	if (es_h264_profile_idc(es->profile, picture) >= 100) {
+		lists_8x8 = picture->pic_fields.bits.transform_8x8_mode_flag ?
+			    (picture->seq_fields.bits.chroma_format_idc == 3 ? 6 : 2) : 0;
+		scaling = !es_scaling_flat(&quantization->ScalingList4x4[0][0],
+					   sizeof(quantization->ScalingList4x4)) ||
+			  (lists_8x8 > 0 &&
+			   !es_scaling_flat(&quantization->ScalingList8x8[0][0],
+					    sizeof(quantization->ScalingList8x8)));
+
+		bitstream_write_flag(&writer, picture->pic_fields.bits.transform_8x8_mode_flag);
+		bitstream_write_flag(&writer, scaling);
+
+		if (scaling) {
+			for (i = 0; i < 6; i++)
+				es_h264_scaling_list(&writer,
+						     quantization->ScalingList4x4[i],
+						     es_zigzag_4x4, 16);
+
+			/* Chroma 8x8 lists of 4:4:4 fall back to the luma ones. */
+			for (i = 0; i < lists_8x8; i++) {
+				if (i < 2)
+					es_h264_scaling_list(&writer,
+							     quantization->ScalingList8x8[i],
+							     es_zigzag_8x8, 64);
+				else
+					bitstream_write_flag(&writer, false);
+			}
+		}
+
+		bitstream_write_se(&writer, picture->second_chroma_qp_index_offset);
+	}
+
+	bitstream_write_trailing(&writer);
+
+	es_put_writer(es, &writer, true);
+}
+
+static void es_h265_profile_tier_level(struct bitstream_writer *writer,
+				       VAPictureParameterBufferHEVC *picture)
+{
+	unsigned int profile_idc;
+	unsigned int i;
+
+	profile_idc = picture->bit_depth_luma_minus8 > 0 ||
+		      picture->bit_depth_chroma_minus8 > 0 ? 2 : 1;
+
+	bitstream_write(writer, 0, 2);
+	bitstream_write_flag(writer, false);
+	bitstream_write(writer, profile_idc, 5);
+
+	/* Main streams are compatible with Main 10 as well. */
+	for (i = 0; i < 32; i++)
+		bitstream_write_flag(writer, i == profile_idc ||
+					     (profile_idc == 1 && i == 2));
+
+	bitstream_write_flag(writer, true);
+	bitstream_write_flag(writer, false);
+	bitstream_write_flag(writer, false);
+	bitstream_write_flag(writer, true);
+	bitstream_write(writer, 0, 32);
+	bitstream_write(writer, 0, 12);
+	bitstream_write(writer, ES_H265_LEVEL_IDC, 8);
+
+	for (i = 0; i < ES_H265_SUB_LAYERS_MAX_MINUS1; i++) {
+		bitstream_write_flag(writer, false);
+		bitstream_write_flag(writer, false);
+	}
+
+	for (i = ES_H265_SUB_LAYERS_MAX_MINUS1; i < 8; i++)
+		bitstream_write(writer, 0, 2);
+}
+
+static void es_h265_nal_header(struct bitstream_writer *writer,
+			       unsigned int type)
+{
+	bitstream_write(writer, type << 1, 8);
+	bitstream_write(writer, 1, 8);
+}
+
+static void es_h265_sub_layer_ordering(struct bitstream_writer *writer,
+				       VAPictureParameterBufferHEVC *picture)
+{
+	bitstream_write_flag(writer, false);
+	bitstream_write_ue(writer, picture->sps_max_dec_pic_buffering_minus1);
+	bitstream_write_ue(writer, picture->sps_max_dec_pic_buffering_minus1);
+	bitstream_write_ue(writer, 0);
+}
+
+static void es_h265_vps(struct es *es, struct dump_driver_data *driver_data)
+{
+	VAPictureParameterBufferHEVC *picture = &driver_data->params.h265.picture;
+	struct bitstream_writer writer;
+
+	bitstream_writer_init(&writer, es->header, sizeof(es->header));
+
+	es_h265_nal_header(&writer, ES_H265_NAL_VPS);
+	bitstream_write(&writer, 0, 4);
+	bitstream_write_flag(&writer, true);
+	bitstream_write_flag(&writer, true);
+	bitstream_write(&writer, 0, 6);
+	bitstream_write(&writer, ES_H265_SUB_LAYERS_MAX_MINUS1, 3);
+	bitstream_write_flag(&writer, false);
+	bitstream_write(&writer, 0xffff, 16);
+	es_h265_profile_tier_level(&writer, picture);
+	es_h265_sub_layer_ordering(&writer, picture);
+	bitstream_write(&writer, 0, 6);
+	bitstream_write_ue(&writer, 0);
+	bitstream_write_flag(&writer, false);
+	bitstream_write_flag(&writer, false);
+	bitstream_write_trailing(&writer);
+
+	es_put_writer(es, &writer, true);
+}
+
+/* Up-right diagonal scan of a square block, as raster positions. */
+static void es_h265_diagonal_scan(uint8_t *scan, unsigned int size)
+{
+	unsigned int i = 0;
+	int x = 0;
+	int y = 0;
+
+	while (i < size * size) {
+		while (y >= 0) {
+			if (x < (int) size && y < (int) size)
+				scan[i++] = y * size + x;
+
+			y--;
+			x++;
+		}
+
+		y = x;
+		x = 0;
+	}
+}
+
+static void es_h265_scaling_list_data(struct bitstream_writer *writer,
+				      VAIQMatrixBufferHEVC *quantization)
+{
+	const uint8_t *list;
+	uint8_t scan_4x4[16];
+	uint8_t scan_8x8[64];
+	unsigned int size_id;
+	unsigned int matrix_id;
+	unsigned int count;
+	unsigned int last;
+	unsigned int i;
+
+	es_h265_diagonal_scan(scan_4x4, 4);
+	es_h265_diagonal_scan(scan_8x8, 8);
+
+	for (size_id = 0; size_id < 4; size_id++) {
+		for (matrix_id = 0; matrix_id < 6;
+		     matrix_id += size_id == 3 ? 3 : 1) {
+			bitstream_write_flag(writer, true);
+
+			last = 8;
+
+			switch (size_id) {
+			case 0:
+				list = quantization->ScalingList4x4[matrix_id];
+				break;
+			case 1:
+				list = quantization->ScalingList8x8[matrix_id];
+				break;
+			case 2:
+				list = quantization->ScalingList16x16[matrix_id];
+				last = quantization->ScalingListDC16x16[matrix_id];
+				break;
+			default:
+				list = quantization->ScalingList32x32[matrix_id / 3];
+				last = quantization->ScalingListDC32x32[matrix_id / 3];
+				break;
+			}
+
+			if (size_id > 1)
+				bitstream_write_se(writer, (int) last - 8);
+
+			count = size_id == 0 ? 16 : 64;
+
+			for (i = 0; i < count; i++) {
+				unsigned int value = list[size_id == 0 ?
+							  scan_4x4[i] :
+							  scan_8x8[i]];
+
+				bitstream_write_se(writer,
+						   es_scaling_delta(value, last));
+				last = value;
+			}
+		}
+	}
+}
+
+static void es_h265_sps(struct es *es, struct dump_driver_data *driver_data)
+{
+	VAPictureParameterBufferHEVC *picture = &driver_data->params.h265.picture;
+	struct bitstream_writer writer;
+
+	bitstream_writer_init(&writer, es->header, sizeof(es->header));
+
+	es_h265_nal_header(&writer, ES_H265_NAL_SPS);
+	bitstream_write(&writer, 0, 4);
+	bitstream_write(&writer, ES_H265_SUB_LAYERS_MAX_MINUS1, 3);
+	bitstream_write_flag(&writer, false);
+	es_h265_profile_tier_level(&writer, picture);
+
+	bitstream_write_ue(&writer, 0);
+	bitstream_write_ue(&writer, picture->pic_fields.bits.chroma_format_idc);
+	if (picture->pic_fields.bits.chroma_format_idc == 3)
+		bitstream_write_flag(&writer, picture->pic_fields.bits.separate_colour_plane_flag);
+
+	bitstream_write_ue(&writer, picture->pic_width_in_luma_samples);
+	bitstream_write_ue(&writer, picture->pic_height_in_luma_samples);
+	bitstream_write_flag(&writer, false);
+	bitstream_write_ue(&writer, picture->bit_depth_luma_minus8);
+	bitstream_write_ue(&writer, picture->bit_depth_chroma_minus8);
+	bitstream_write_ue(&writer, picture->log2_max_pic_order_cnt_lsb_minus4);
+	es_h265_sub_layer_ordering(&writer, picture);
+
+	bitstream_write_ue(&writer, picture->log2_min_luma_coding_block_size_minus3);
+	bitstream_write_ue(&writer, picture->log2_diff_max_min_luma_coding_block_size);
+	bitstream_write_ue(&writer, picture->log2_min_transform_block_size_minus2);
+	bitstream_write_ue(&writer, picture->log2_diff_max_min_transform_block_size);
+	bitstream_write_ue(&writer, picture->max_transform_hierarchy_depth_inter);
+	bitstream_write_ue(&writer, picture->max_transform_hierarchy_depth_intra);
+
+	bitstream_write_flag(&writer, picture->pic_fields.bits.scaling_list_enabled_flag);
+	if (picture->pic_fields.bits.scaling_list_enabled_flag) {
+		bitstream_write_flag(&writer, true);
+		es_h265_scaling_list_data(&writer,
+					  &driver_data->params.h265.quantization);
+	}
+
+	bitstream_write_flag(&writer, picture->pic_fields.bits.amp_enabled_flag);
+	bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.sample_adaptive_offset_enabled_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.pcm_enabled_flag);
+	if (picture->pic_fields.bits.pcm_enabled_flag) {
+		bitstream_write(&writer, picture->pcm_sample_bit_depth_luma_minus1, 4);
+		bitstream_write(&writer, picture->pcm_sample_bit_depth_chroma_minus1, 4);
+		bitstream_write_ue(&writer, picture->log2_min_pcm_luma_coding_block_size_minus3);
+		bitstream_write_ue(&writer, picture->log2_diff_max_min_pcm_luma_coding_block_size);
+		bitstream_write_flag(&writer, picture->pic_fields.bits.pcm_loop_filter_disabled_flag);
+	}
+
+	/* Reference picture sets are all carried by the slice headers. */
+	bitstream_write_ue(&writer, 0);
+	bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.long_term_ref_pics_present_flag);
+	if (picture->slice_parsing_fields.bits.long_term_ref_pics_present_flag)
+		bitstream_write_ue(&writer, 0);
+
+	bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.sps_temporal_mvp_enabled_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.strong_intra_smoothing_enabled_flag);
+	bitstream_write_flag(&writer, false);
+	bitstream_write_flag(&writer, false);
+	bitstream_write_trailing(&writer);
+
+	es_put_writer(es, &writer, true);
+}
+
+static void es_h265_pps(struct es *es, struct dump_driver_data *driver_data,
+			unsigned int pps_id)
+{
+	VAPictureParameterBufferHEVC *picture = &driver_data->params.h265.picture;
+	struct bitstream_writer writer;
+	bool deblocking;
+	unsigned int i;
+
+	bitstream_writer_init(&writer, es->header, sizeof(es->header));
+
+	es_h265_nal_header(&writer, ES_H265_NAL_PPS);
+	bitstream_write_ue(&writer, pps_id);
+	bitstream_write_ue(&writer, 0);
+	bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.dependent_slice_segments_enabled_flag);
+	bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.output_flag_present_flag);
+	bitstream_write(&writer, picture->num_extra_slice_header_bits, 3);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.sign_data_hiding_enabled_flag);
+	bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.cabac_init_present_flag);
+	bitstream_write_ue(&writer, picture->num_ref_idx_l0_default_active_minus1);
+	bitstream_write_ue(&writer, picture->num_ref_idx_l1_default_active_minus1);
+	bitstream_write_se(&writer, picture->init_qp_minus26);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.constrained_intra_pred_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.transform_skip_enabled_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.cu_qp_delta_enabled_flag);
+	if (picture->pic_fields.bits.cu_qp_delta_enabled_flag)
+		bitstream_write_ue(&writer, picture->diff_cu_qp_delta_depth);
+
+	bitstream_write_se(&writer, picture->pps_cb_qp_offset);
+	bitstream_write_se(&writer, picture->pps_cr_qp_offset);
+	bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.pps_slice_chroma_qp_offsets_present_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.weighted_pred_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.weighted_bipred_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.transquant_bypass_enabled_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.tiles_enabled_flag);
+	bitstream_write_flag(&writer, picture->pic_fields.bits.entropy_coding_sync_enabled_flag);
+
+	/* Tile sizes are always given explicitly, the last one is implied. */
+	if (picture->pic_fields.bits.tiles_enabled_flag) {
+		bitstream_write_ue(&writer, picture->num_tile_columns_minus1);
+		bitstream_write_ue(&writer, picture->num_tile_rows_minus1);
+		bitstream_write_flag(&writer, false);
+
+		for (i = 0; i < picture->num_tile_columns_minus1; i++)
+			bitstream_write_ue(&writer, picture->column_width_minus1[i]);
+
+		for (i = 0; i < picture->num_tile_rows_minus1; i++)
+			bitstream_write_ue(&writer, picture->row_height_minus1[i]);
+
+		bitstream_write_flag(&writer, picture->pic_fields.bits.loop_filter_across_tiles_enabled_flag);
+	}
+
+	bitstream_write_flag(&writer, picture->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag);
+
+	deblocking = picture->slice_parsing_fields.bits.deblocking_filter_override_enabled_flag ||
+		     picture->slice_parsing_fields.bits.pps_disable_deblocking_filter_flag ||
+		     picture->pps_beta_offset_div2 != 0 ||
+		     picture->pps_tc_offset_div2 != 0;
+
+	bitstream_write_flag(&writer, deblocking);
+	if (deblocking) {
+		bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.deblocking_filter_override_enabled_flag);
+		bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.pps_disable_deblocking_filter_flag);
+		if (!picture->slice_parsing_fields.bits.pps_disable_deblocking_filter_flag) {
+			bitstream_write_se(&writer, picture->pps_beta_offset_div2);
+			bitstream_write_se(&writer, picture->pps_tc_offset_div2);
+		}
+	}
+
+	bitstream_write_flag(&writer, false);
+	bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.lists_modification_present_flag);
+	bitstream_write_ue(&writer, picture->log2_parallel_merge_level_minus2);
+	bitstream_write_flag(&writer, picture->slice_parsing_fields.bits.slice_segment_header_extension_present_flag);
+	bitstream_write_flag(&writer, false);
+	bitstream_write_trailing(&writer);
+
+	es_put_writer(es, &writer, true);
+}
+
+/* Find the id of the picture parameter set referenced by a slice. */
+static unsigned int es_pps_id(enum nal_codec codec, const uint8_t *data,
+			      unsigned int size)
+{
+	struct bitstream bitstream;
+	unsigned int nal_unit_type;
+	unsigned int pps_id;
+
+	if (size < 2)
+		return 0;
+
+	bitstream_init(&bitstream, data, size);
+
+	if (codec == NAL_CODEC_H264) {
+		nal_unit_type = data[0] & 0x1f;
+
+		bitstream_skip(&bitstream, nal_unit_type == ES_H264_NAL_SLICE_EXT ?
+					   32 : 8);
+		bitstream_read_ue(&bitstream);
+		bitstream_read_ue(&bitstream);
+	} else {
+		nal_unit_type = (data[0] >> 1) & 0x3f;
+
+		bitstream_skip(&bitstream, 17);
+		if (nal_unit_type >= ES_H265_NAL_IRAP_FIRST &&
+		    nal_unit_type <= ES_H265_NAL_IRAP_LAST)
+			bitstream_skip(&bitstream, 1);
+	}
+
+	pps_id = bitstream_read_ue(&bitstream);
+
+	return bitstream_error(&bitstream) ? 0 : pps_id;
+}
+
+static void es_mpeg2_sequence(struct es *es,
+			      struct dump_driver_data *driver_data)
+{
+	VAPictureParameterBufferMPEG2 *picture = &driver_data->params.mpeg2.picture;
+	struct bitstream_writer writer;
+
+	bitstream_writer_init(&writer, es->header, sizeof(es->header));
+
+	bitstream_write(&writer, picture->horizontal_size & 0xfff, 12);
+	bitstream_write(&writer, picture->vertical_size & 0xfff, 12);
+	bitstream_write(&writer, 1, 4);
+	bitstream_write(&writer, ES_MPEG2_FRAME_RATE_CODE, 4);
+	bitstream_write(&writer, 0x3ffff, 18);
+	bitstream_write_flag(&writer, true);
+	bitstream_write(&writer, ES_MPEG2_VBV_BUFFER_SIZE, 10);
+	bitstream_write_flag(&writer, false);
+	bitstream_write_flag(&writer, false);
+	bitstream_write_flag(&writer, false);
+
+	es_start_code(es, 3, ES_MPEG2_SEQUENCE_HEADER_CODE);
+	es_put_writer(es, &writer, false);
+
+	bitstream_writer_init(&writer, es->header, sizeof(es->header));
+
+	bitstream_write(&writer, ES_MPEG2_SEQUENCE_EXTENSION_ID, 4);
+	bitstream_write(&writer, es->profile == VAProfileMPEG2Simple ?
+				 0x58 : 0x48, 8);
+	bitstream_write_flag(&writer, false);
+	bitstream_write(&writer, 1, 2);
+	bitstream_write(&writer, (picture->horizontal_size >> 12) & 0x3, 2);
+	bitstream_write(&writer, (picture->vertical_size >> 12) & 0x3, 2);
+	bitstream_write(&writer, 0, 12);
+	bitstream_write_flag(&writer, true);
+	bitstream_write(&writer, 0, 8);
+	bitstream_write_flag(&writer, false);
+	bitstream_write(&writer, 0, 2);
+	bitstream_write(&writer, 0, 5);
+
+	es_start_code(es, 3, ES_MPEG2_EXTENSION_START_CODE);
+	es_put_writer(es, &writer, false);
+}
+
+static void es_mpeg2_picture(struct es *es,
+			     struct dump_driver_data *driver_data)
+{
+	VAPictureParameterBufferMPEG2 *picture = &driver_data->params.mpeg2.picture;
+	VAIQMatrixBufferMPEG2 *quantization = &driver_data->params.mpeg2.quantization;
+	struct bitstream_writer writer;
+	const uint8_t *matrices[4] = {
+		quantization->intra_quantiser_matrix,
+		quantization->non_intra_quantiser_matrix,
+		quantization->chroma_intra_quantiser_matrix,
+		quantization->chroma_non_intra_quantiser_matrix,
+	};
+	const int32_t loads[4] = {
+		quantization->load_intra_quantiser_matrix,
+		quantization->load_non_intra_quantiser_matrix,
+		quantization->load_chroma_intra_quantiser_matrix,
+		quantization->load_chroma_non_intra_quantiser_matrix,
+	};
+	unsigned int i, j;
+
+	/* Forward and backward f_code are carried by the extension instead. */
+	bitstream_writer_init(&writer, es->header, sizeof(es->header));
+
+	bitstream_write(&writer, 0, 10);
+	bitstream_write(&writer, picture->picture_coding_type, 3);
+	bitstream_write(&writer, 0xffff, 16);
+
+	if (picture->picture_coding_type == ES_MPEG2_PICTURE_TYPE_P ||
+	    picture->picture_coding_type == ES_MPEG2_PICTURE_TYPE_B) {
+		bitstream_write_flag(&writer, false);
+		bitstream_write(&writer, 7, 3);
+	}
+
+	if (picture->picture_coding_type == ES_MPEG2_PICTURE_TYPE_B) {
+		bitstream_write_flag(&writer, false);
+		bitstream_write(&writer, 7, 3);
+	}
+
+	bitstream_write_flag(&writer, false);
+
+	es_start_code(es, 3, ES_MPEG2_PICTURE_START_CODE);
+	es_put_writer(es, &writer, false);
+
+	bitstream_writer_init(&writer, es->header, sizeof(es->header));
+
+	bitstream_write(&writer, ES_MPEG2_PICTURE_CODING_EXTENSION_ID, 4);
+	bitstream_write(&writer, picture->f_code & 0xffff, 16);
+	bitstream_write(&writer, picture->picture_coding_extension.bits.intra_dc_precision, 2);
+	bitstream_write(&writer, picture->picture_coding_extension.bits.picture_structure, 2);
+	bitstream_write_flag(&writer, picture->picture_coding_extension.bits.top_field_first);
+	bitstream_write_flag(&writer, picture->picture_coding_extension.bits.frame_pred_frame_dct);
+	bitstream_write_flag(&writer, picture->picture_coding_extension.bits.concealment_motion_vectors);
+	bitstream_write_flag(&writer, picture->picture_coding_extension.bits.q_scale_type);
+	bitstream_write_flag(&writer, picture->picture_coding_extension.bits.intra_vlc_format);
+	bitstream_write_flag(&writer, picture->picture_coding_extension.bits.alternate_scan);
+	bitstream_write_flag(&writer, picture->picture_coding_extension.bits.repeat_first_field);
+	bitstream_write_flag(&writer, picture->picture_coding_extension.bits.progressive_frame);
+	bitstream_write_flag(&writer, picture->picture_coding_extension.bits.progressive_frame);
+	bitstream_write_flag(&writer, false);
+
+	es_start_code(es, 3, ES_MPEG2_EXTENSION_START_CODE);
+	es_put_writer(es, &writer, false);
+
+	if (!loads[0] && !loads[1] && !loads[2] && !loads[3])
+		return;
+
+	/* Matrices are given in zigzag scan order, as they are coded. */
+	bitstream_writer_init(&writer, es->header, sizeof(es->header));
+
+	bitstream_write(&writer, ES_MPEG2_QUANT_MATRIX_EXTENSION_ID, 4);
+
+	for (i = 0; i < 4; i++) {
+		bitstream_write_flag(&writer, loads[i] != 0);
+		if (!loads[i])
+			continue;
+
+		for (j = 0; j < 64; j++)
+			bitstream_write(&writer, matrices[i][j], 8);
+	}
+
+	es_start_code(es, 3, ES_MPEG2_EXTENSION_START_CODE);
+	es_put_writer(es, &writer, false);
+}
+
+/*
+ * Parameter sets are not passed to the driver, so they are rebuilt from the
+ * picture parameters ahead of the first slice of each frame. H.265 sequence
+ * parameter sets can only be rebuilt when reference picture sets are all
+ * carried by the slice headers.
+ */
+static void es_headers(struct es *es, struct dump_driver_data *driver_data,
+		       const uint8_t *data, unsigned int size)
+{
+	VAPictureParameterBufferHEVC *h265 = &driver_data->params.h265.picture;
+	VAPictureParameterBufferMPEG2 *mpeg2 = &driver_data->params.mpeg2.picture;
+	unsigned int pps_id;
+
+	switch (es->codec) {
+	case NAL_CODEC_H264:
+		pps_id = es_pps_id(es->codec, data, size);
+
+		es_h264_sps(es, driver_data);
+		es_h264_pps(es, driver_data, pps_id);
+		break;
+	case NAL_CODEC_H265:
+		if (h265->num_short_term_ref_pic_sets > 0 ||
+		    h265->num_long_term_ref_pic_sps > 0) {
+			if (!es->unsupported)
+				log_warning("Unable to rebuild H.265 parameter sets with reference picture sets\n");
+
+			es->unsupported = true;
+			break;
+		}
+
+		pps_id = es_pps_id(es->codec, data, size);
+
+		es_h265_vps(es, driver_data);
+		es_h265_sps(es, driver_data);
+		es_h265_pps(es, driver_data, pps_id);
+		break;
+	default:
+		if (!es->started ||
+		    mpeg2->picture_coding_type == ES_MPEG2_PICTURE_TYPE_I)
+			es_mpeg2_sequence(es, driver_data);
+
+		es_mpeg2_picture(es, driver_data);
+		break;
+	}
+
+	es->started = true;
+}
+
+/*
+ * Write a slice to the stream, preceded by the headers of the frame for its
+ * first slice. Slices are written as they are when they come with a start
+ * code. The offset of the slice in the stream is returned along with the
+ * number of bytes written for it.
+ */
+int es_write(struct dump_driver_data *driver_data, const uint8_t *data,
+	     unsigned int size, unsigned long long *offset)
+{
+	struct es *es = &driver_data->output.es;
+	unsigned int start_code_size;
+	unsigned long long start;
+
+	if (es->file == NULL)
+		return -1;
+
+	start_code_size = es_start_code_size(data, size);
+
+	if (!es->headers) {
+		es_headers(es, driver_data, data + start_code_size,
+			   size - start_code_size);
+		es->headers = true;
+	}
+
+	start = es->position;
+
+	if (start_code_size == 0) {
+		if (es->codec == NAL_CODEC_MPEG2)
+			es_start_code(es, 3, driver_data->params.mpeg2.slice.slice_vertical_position + 1);
+		else
+			es_start_code(es, 4, -1);
+	}
+
+	es_put(es, data, size);
+
+	if (ferror(es->file)) {
+		log_error("Unable to write elementary stream: %s\n",
+			strerror(errno));
+		clearerr(es->file);
+		return -1;
+	}
+
+	if (offset != NULL)
+		*offset = start;
+
+	return es->position - start;
+}
+
+void es_close(struct es *es)
+{
+	if (es->file != NULL) {
+		if (es->codec == NAL_CODEC_MPEG2 && es->started)
+			es_start_code(es, 3, ES_MPEG2_SEQUENCE_END_CODE);
+
+		fclose(es->file);
+		es->file = NULL;
+	}
+
+	free(es->buffer);
+	es->buffer = NULL;
+
+	free(es->directory);
+	es->directory = NULL;
+}
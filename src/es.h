@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ES_H_
+#define _ES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <va/va_backend.h>
+
+#include "nal.h"
+
+struct dump_driver_data;
+
+/*
+ * Values
+ */
+
+#define ES_H264_FILENAME			"stream.h264"
+#define ES_H265_FILENAME			"stream.h265"
+#define ES_MPEG2_FILENAME			"stream.m2v"
+
+#define ES_BUFFER_SIZE				(1024 * 1024)
+#define ES_HEADER_SIZE				4096
+
+/* Parameters that VA-API does not provide. */
+#define ES_H264_LEVEL_IDC			51
+#define ES_H265_LEVEL_IDC			153
+#define ES_MPEG2_FRAME_RATE_CODE		4
+#define ES_MPEG2_VBV_BUFFER_SIZE		112
+
+/*
+ * Structures
+ */
+
+struct es {
+	char *directory;
+	unsigned int buffer_size;
+
+	FILE *file;
+	char *buffer;
+	unsigned long long position;
+
+	VAProfile profile;
+	enum nal_codec codec;
+	bool started;
+	bool headers;
+	bool mixed;
+	bool unsupported;
+
+	uint8_t header[ES_HEADER_SIZE];
+};
+
+/*
+ * Functions
+ */
+
+int es_open(struct es *es, const char *directory, unsigned int buffer_size);
+int es_frame_begin(struct es *es, VAProfile profile);
+int es_write(struct dump_driver_data *driver_data, const uint8_t *data,
+	     unsigned int size, unsigned long long *offset);
+void es_close(struct es *es);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "field.h"
+#include "header.h"
+
+/*
+ * Find the bits set in the mask of a bitfield descriptor. Bitfields are laid
+ * out from the least significant bit on the little-endian hosts we run on.
+ */
+static void field_resolve(struct field *field)
+{
+	const uint8_t *mask = field->mask;
+	unsigned int first = 0;
+	unsigned int bits = 0;
+	unsigned int i;
+
+	for (i = 0; i < field->mask_size * 8; i++) {
+		if (!(mask[i / 8] & (1 << (i % 8)))) {
+			if (bits > 0)
+				break;
+
+			continue;
+		}
+
+		if (bits++ == 0)
+			first = i;
+	}
+
+	field->offset = first / 8;
+	field->shift = first % 8;
+	field->bits = bits;
+	field->size = (field->shift + bits + 7) / 8;
+	field->is_signed = false;
+}
+
+static void field_table_resolve(struct field_table *table)
+{
+	unsigned int i;
+
+	for (i = 0; i < table->count; i++)
+		if (table->fields[i].kind == FIELD_KIND_BITS)
+			field_resolve(&table->fields[i]);
+
+	table->resolved = true;
+}
+
+static int64_t field_value(const struct field *field, const void **sources,
+			   unsigned int index)
+{
+	const uint8_t *data;
+	uint64_t value = 0;
+
+	if (field->kind == FIELD_KIND_CONSTANT)
+		return field->constant;
+
+	data = (const uint8_t *) sources[field->source] + field->offset +
+	       index * field->size;
+
+	if (field->kind == FIELD_KIND_BITS) {
+		memcpy(&value, data, field->size);
+
+		return (value >> field->shift) & ((1ULL << field->bits) - 1);
+	}
+
+	memcpy(&value, data, field->size);
+
+	/* Sign-extend from the width of the member. */
+	if (field->is_signed && field->size < sizeof(value))
+		return (int64_t) (value << (64 - field->size * 8)) >>
+		       (64 - field->size * 8);
+
+	return value;
+}
+
+/* Print the fields as C designated initializers, one per line. */
+void field_print(struct field_table *table, const void **sources,
+		 unsigned int indent)
+{
+	const struct field *field;
+	unsigned int i, j;
+
+	if (!table->resolved)
+		field_table_resolve(table);
+
+	for (i = 0; i < table->count; i++) {
+		field = &table->fields[i];
+
+		if (field->kind == FIELD_KIND_ARRAY) {
+			print_indent(indent, ".%s = { ", field->name);
+			for (j = 0; j < field->count; j++)
+				print_indent(0, "%lld, ", (long long)
+					     field_value(field, sources, j));
+			print_indent(0, "},\n");
+		} else if (field->is_signed) {
+			print_indent(indent, ".%s = %lld,\n", field->name,
+				     (long long) field_value(field, sources, 0));
+		} else {
+			print_indent(indent, ".%s = %llu,\n", field->name,
+				     (unsigned long long)
+				     field_value(field, sources, 0));
+		}
+	}
+}
+
+/* Name the columns once, with one column per array element. */
+static int field_table_columns(struct field_table *table)
+{
+	const struct field *field;
+	unsigned int count = 0;
+	unsigned int i, j, k;
+	char **columns;
+	int rc;
+
+	for (i = 0; i < table->count; i++)
+		count += table->fields[i].count;
+
+	columns = calloc(count, sizeof(*columns));
+	if (columns == NULL)
+		return -1;
+
+	for (i = 0, k = 0; i < table->count; i++) {
+		field = &table->fields[i];
+
+		for (j = 0; j < field->count; j++, k++) {
+			if (field->kind == FIELD_KIND_ARRAY)
+				rc = asprintf(&columns[k], "%s.%s[%u]",
+					      table->prefix, field->name, j);
+			else
+				rc = asprintf(&columns[k], "%s.%s",
+					      table->prefix, field->name);
+
+			if (rc < 0)
+				goto error;
+		}
+	}
+
+	table->columns = columns;
+
+	return 0;
+
+error:
+	for (i = 0; i < k; i++)
+		free(columns[i]);
+
+	free(columns);
+
+	return -1;
+}
+
+/* Store the fields of the current row in integer columns. */
+void field_columnar(struct field_table *table, const void **sources,
+		    struct columnar *columnar)
+{
+	const struct field *field;
+	unsigned int i, j, k;
+	int rc;
+
+	if (columnar->group_rows == 0)
+		return;
+
+	if (!table->resolved)
+		field_table_resolve(table);
+
+	if (table->columns == NULL) {
+		rc = field_table_columns(table);
+		if (rc < 0)
+			return;
+	}
+
+	for (i = 0, k = 0; i < table->count; i++) {
+		field = &table->fields[i];
+
+		for (j = 0; j < field->count; j++, k++)
+			columnar_int(columnar, table->columns[k],
+				     field_value(field, sources, j));
+	}
+}
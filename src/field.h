@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FIELD_H_
+#define _FIELD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "columnar.h"
+
+/*
+ * Values
+ */
+
+enum field_kind {
+	FIELD_KIND_VALUE,
+	FIELD_KIND_BITS,
+	FIELD_KIND_ARRAY,
+	FIELD_KIND_CONSTANT,
+};
+
+/*
+ * Field lists are X-macros taking the descriptor macro as argument, with one
+ * entry per field:
+ * - X(VALUE, name, SOURCE, member) for plain integer members;
+ * - X(BITS, name, SOURCE, member) for (unsigned) bitfield members;
+ * - X(ARRAY, name, SOURCE, member, count) for arrays of integers;
+ * - X(CONSTANT, name, value) for values that are not provided by VA.
+ *
+ * SOURCE is an index in the sources array passed to the serializers and
+ * SOURCE##_TYPE must name the matching structure type. Members may be nested.
+ * Tables are declared with the path of their fields in the printed metadata,
+ * used as prefix for their column names.
+ */
+
+#define FIELD_DESCRIPTOR(kind, ...)	FIELD_DESCRIPTOR_##kind(__VA_ARGS__)
+
+#define FIELD_MEMBER(source, member)	(((source##_TYPE *) 0)->member)
+#define FIELD_SIGNED(source, member) \
+	((__typeof__(FIELD_MEMBER(source, member))) -1 < 0)
+
+#define FIELD_DESCRIPTOR_VALUE(name_, source_, member_) \
+	{ \
+		.name = #name_, \
+		.kind = FIELD_KIND_VALUE, \
+		.source = source_, \
+		.offset = offsetof(source_##_TYPE, member_), \
+		.size = sizeof(FIELD_MEMBER(source_, member_)), \
+		.is_signed = FIELD_SIGNED(source_, member_), \
+		.count = 1, \
+	},
+
+/* Bitfield positions are only known from the mask, resolved on first use. */
+#define FIELD_DESCRIPTOR_BITS(name_, source_, member_) \
+	{ \
+		.name = #name_, \
+		.kind = FIELD_KIND_BITS, \
+		.source = source_, \
+		.mask = &(const source_##_TYPE) { .member_ = -1 }, \
+		.mask_size = sizeof(source_##_TYPE), \
+		.count = 1, \
+	},
+
+#define FIELD_DESCRIPTOR_ARRAY(name_, source_, member_, count_) \
+	{ \
+		.name = #name_, \
+		.kind = FIELD_KIND_ARRAY, \
+		.source = source_, \
+		.offset = offsetof(source_##_TYPE, member_), \
+		.size = sizeof(FIELD_MEMBER(source_, member_)[0]), \
+		.is_signed = FIELD_SIGNED(source_, member_[0]), \
+		.count = count_, \
+	},
+
+#define FIELD_DESCRIPTOR_CONSTANT(name_, value_) \
+	{ \
+		.name = #name_, \
+		.kind = FIELD_KIND_CONSTANT, \
+		.size = sizeof(int), \
+		.is_signed = true, \
+		.constant = value_, \
+		.count = 1, \
+	},
+
+#define FIELD_TABLE(table, prefix_, list) \
+	static struct field table##_fields[] = { list(FIELD_DESCRIPTOR) }; \
+	static struct field_table table = { \
+		.prefix = prefix_, \
+		.fields = table##_fields, \
+		.count = sizeof(table##_fields) / sizeof(table##_fields[0]), \
+	}
+
+/*
+ * Structures
+ */
+
+struct field {
+	const char *name;
+	enum field_kind kind;
+	unsigned int source;
+
+	unsigned int offset;
+	unsigned int size;
+	unsigned int count;
+	bool is_signed;
+
+	unsigned int shift;
+	unsigned int bits;
+	const void *mask;
+	unsigned int mask_size;
+
+	int64_t constant;
+};
+
+struct field_table {
+	const char *prefix;
+	struct field *fields;
+	unsigned int count;
+	bool resolved;
+
+	char **columns;
+};
+
+/*
+ * Functions
+ */
+
+void field_print(struct field_table *table, const void **sources,
+		 unsigned int indent);
+void field_columnar(struct field_table *table, const void **sources,
+		    struct columnar *columnar);
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dump.h"
+#include "golden.h"
+#include "output.h"
+#include "picture.h"
+#include "surface.h"
+#include "trace.h"
+#include "log.h"
+
+/* Load a manifest written in hash mode. */
+int golden_load(struct golden *golden, const char *path)
+{
+	struct golden_frame *frames;
+	unsigned long long size;
+	unsigned int parameters_crc;
+	unsigned int allocated;
+	unsigned int index;
+	unsigned int crc;
+	char line[256];
+	FILE *file;
+	int rc;
+
+	file = fopen(path, "r");
+	if (file == NULL) {
+		log_error("Unable to open golden manifest %s: %s\n", path,
+			strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		/* Slice checksums may not fit, skip the rest of the line. */
+		if (strchr(line, '\n') == NULL) {
+			int c;
+
+			do {
+				c = fgetc(file);
+			} while (c != '\n' && c != EOF);
+		}
+
+		if (line[0] == '#')
+			continue;
+
+		rc = sscanf(line, "%u %x %x %llu", &index, &crc,
+			    &parameters_crc, &size);
+		if (rc != 4)
+			continue;
+
+		if (index >= golden->frames_count) {
+			allocated = index + 1 > golden->frames_count * 2 ?
+				    index + 1 : golden->frames_count * 2;
+
+			frames = realloc(golden->frames,
+					 allocated * sizeof(*frames));
+			if (frames == NULL)
+				break;
+
+			memset(frames + golden->frames_count, 0,
+			       (allocated - golden->frames_count) *
+			       sizeof(*frames));
+
+			golden->frames = frames;
+			golden->frames_count = allocated;
+		}
+
+		golden->frames[index].valid = true;
+		golden->frames[index].crc = crc;
+		golden->frames[index].parameters_crc = parameters_crc;
+		golden->frames[index].size = size;
+	}
+
+	fclose(file);
+
+	return 0;
+}
+
+void golden_destroy(struct golden *golden)
+{
+	if (golden->report != NULL) {
+		log_info("Found %u divergent frames\n",
+			golden->divergent_count);
+		fclose(golden->report);
+		golden->report = NULL;
+	}
+
+	free(golden->frames);
+	golden->frames = NULL;
+	golden->frames_count = 0;
+
+	free(golden->dumped);
+	golden->dumped = NULL;
+	golden->dumped_count = 0;
+}
+
+static void golden_dump(struct dump_driver_data *driver_data,
+			unsigned int index, void *slice_data,
+			unsigned int slice_size, char *metadata,
+			size_t metadata_size)
+{
+	struct golden *golden = &driver_data->output.golden;
+	unsigned int count;
+	bool *dumped;
+
+	if (index >= golden->dumped_count) {
+		count = index + 1 > golden->dumped_count * 2 ?
+			index + 1 : golden->dumped_count * 2;
+
+		dumped = realloc(golden->dumped, count * sizeof(*dumped));
+		if (dumped == NULL)
+			return;
+
+		memset(dumped + golden->dumped_count, 0,
+		       (count - golden->dumped_count) * sizeof(*dumped));
+
+		golden->dumped = dumped;
+		golden->dumped_count = count;
+	}
+
+	if (golden->dumped[index])
+		return;
+
+	golden->dumped[index] = true;
+
+	output_save(driver_data, index, slice_data, slice_size);
+
+	if (metadata != NULL)
+		fwrite(metadata, 1, metadata_size, stdout);
+}
+
+/*
+ * Save the frames referenced by a frame, and the frames they reference in turn,
+ * as long as their surfaces still hold them. The walk stops at frames that
+ * were already saved and at keyframes. Each frame is saved once, which bounds
+ * the depth by the number of surfaces.
+ */
+static void golden_dump_references(struct dump_driver_data *driver_data,
+				   struct object_surface *surface,
+				   unsigned int index)
+{
+	struct golden *golden = &driver_data->output.golden;
+	struct object_surface *reference;
+	unsigned int i;
+
+	if (surface->keyframe)
+		return;
+
+	for (i = 0; i < surface->references_count; i++) {
+		reference = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, surface->references[i]);
+		if (reference == NULL || reference == surface ||
+		    reference->index != surface->references_indexes[i] ||
+		    reference->dump_size == 0)
+			continue;
+
+		if (reference->index < golden->dumped_count &&
+		    golden->dumped[reference->index])
+			continue;
+
+		if (golden->report != NULL)
+			fprintf(golden->report, "%u reference %u\n",
+				reference->index, index);
+
+		golden_dump(driver_data, reference->index,
+			    reference->slice_data, reference->dump_size,
+			    reference->metadata, reference->metadata_size);
+
+		golden_dump_references(driver_data, reference,
+				       reference->index);
+	}
+}
+
+/*
+ * Compare the checksums of the current frame with the golden manifest and save
+ * it in full when it diverges, along with the frames it depends on that are
+ * still held by their surfaces. The metadata and references of the frame are
+ * kept with its surface in case it is referenced by a divergent frame later on.
+ */
+void golden_check(struct dump_driver_data *driver_data, VAProfile profile,
+		  struct object_surface *surface)
+{
+	TRACE_FUNCTION();
+
+	struct output *output = &driver_data->output;
+	struct golden *golden = &output->golden;
+	struct object_surface *reference;
+	struct golden_frame *frame = NULL;
+	unsigned int index = output->frame_index;
+	VASurfaceID surfaces[16];
+	const char *reason = NULL;
+	unsigned int count;
+	unsigned int i;
+
+	count = picture_references(driver_data, profile, surfaces);
+
+	surface->references_count = 0;
+	surface->keyframe = picture_keyframe(driver_data, profile);
+
+	for (i = 0; i < count; i++) {
+		reference = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, surfaces[i]);
+		if (reference == NULL || reference == surface)
+			continue;
+
+		surface->references[surface->references_count] = surfaces[i];
+		surface->references_indexes[surface->references_count] =
+			reference->index;
+		surface->references_count++;
+	}
+
+	if (index < golden->frames_count && golden->frames[index].valid)
+		frame = &golden->frames[index];
+
+	if (frame == NULL)
+		reason = "missing";
+	else if (frame->crc != output->frame_crc ||
+		 frame->size != output->frame_size)
+		reason = "slices";
+	else if (frame->parameters_crc != output->parameters_crc)
+		reason = "parameters";
+
+	if (reason != NULL) {
+		golden->divergent_count++;
+
+		if (golden->report != NULL)
+			fprintf(golden->report, "%u %s\n", index, reason);
+
+		golden_dump(driver_data, index, surface->slice_data,
+			    surface->slice_size, output->metadata_buffer,
+			    output->metadata_size);
+
+		golden_dump_references(driver_data, surface, index);
+
+		if (golden->report != NULL)
+			fflush(golden->report);
+	}
+
+	free(surface->metadata);
+	surface->metadata = output->metadata_buffer;
+	surface->metadata_size = output->metadata_size;
+
+	output->metadata_buffer = NULL;
+	output->metadata_size = 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GOLDEN_H_
+#define _GOLDEN_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <va/va_backend.h>
+
+struct dump_driver_data;
+struct object_surface;
+
+/*
+ * Values
+ */
+
+#define GOLDEN_REPORT_FILENAME			"divergences.txt"
+
+/*
+ * Structures
+ */
+
+struct golden_frame {
+	bool valid;
+	uint32_t crc;
+	uint32_t parameters_crc;
+	unsigned long long size;
+};
+
+struct golden {
+	struct golden_frame *frames;
+	unsigned int frames_count;
+
+	bool *dumped;
+	unsigned int dumped_count;
+
+	FILE *report;
+	unsigned int divergent_count;
+};
+
+/*
+ * Functions
+ */
+
+int golden_load(struct golden *golden, const char *path);
+void golden_destroy(struct golden *golden);
+void golden_check(struct dump_driver_data *driver_data, VAProfile profile,
+		  struct object_surface *surface);
+
+#endif
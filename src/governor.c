@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "dump.h"
+#include "governor.h"
+#include "header.h"
+#include "output.h"
+#include "log.h"
+
+static const char *governor_level_names[GOVERNOR_LEVEL_COUNT] = {
+	[GOVERNOR_FULL] = "full",
+	[GOVERNOR_KEYFRAMES] = "keyframes",
+	[GOVERNOR_HASH] = "hash",
+	[GOVERNOR_SKIP] = "skip",
+};
+
+static bool governor_enabled(struct governor *governor)
+{
+	return governor->bytes.rate > 0 || governor->cpu.rate > 0;
+}
+
+static void governor_bucket_init(struct governor_bucket *bucket,
+				 uint64_t rate)
+{
+	bucket->rate = rate;
+	bucket->burst = rate * GOVERNOR_BURST_MS / 1000;
+	bucket->tokens = bucket->burst;
+}
+
+static void governor_bucket_take(struct governor_bucket *bucket,
+				 int64_t tokens)
+{
+	if (bucket->rate == 0)
+		return;
+
+	bucket->tokens -= tokens;
+	if (bucket->tokens < -bucket->burst)
+		bucket->tokens = -bucket->burst;
+}
+
+void governor_init(struct governor *governor, uint64_t bytes_rate,
+		   unsigned int cpu_percent)
+{
+	memset(governor, 0, sizeof(*governor));
+
+	governor_bucket_init(&governor->bytes, bytes_rate);
+	governor_bucket_init(&governor->cpu, cpu_percent * 10000000ULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &governor->refill);
+}
+
+/*
+ * Refill both buckets for the time elapsed since the last decision and pick
+ * the level of the next frame from the emptiest one. Hashing writes nothing,
+ * so only running out of CPU time skips frames.
+ */
+enum governor_level governor_decide(struct governor *governor)
+{
+	struct governor_bucket *buckets[2] = { &governor->bytes, &governor->cpu };
+	enum governor_level level = GOVERNOR_FULL;
+	enum governor_level bucket_level;
+	struct governor_bucket *bucket;
+	struct timespec now;
+	uint64_t elapsed;
+	unsigned int i;
+
+	governor->level = GOVERNOR_FULL;
+
+	if (!governor_enabled(governor))
+		return GOVERNOR_FULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	elapsed = (now.tv_sec - governor->refill.tv_sec) * 1000000000ULL +
+		  now.tv_nsec - governor->refill.tv_nsec;
+	governor->refill = now;
+
+	for (i = 0; i < 2; i++) {
+		bucket = buckets[i];
+		if (bucket->rate == 0)
+			continue;
+
+		bucket->tokens += (double) bucket->rate * elapsed / 1000000000.0;
+		if (bucket->tokens > bucket->burst)
+			bucket->tokens = bucket->burst;
+
+		if (bucket->tokens >= bucket->burst / 2)
+			bucket_level = GOVERNOR_FULL;
+		else if (bucket->tokens >= bucket->burst / 4)
+			bucket_level = GOVERNOR_KEYFRAMES;
+		else if (bucket->tokens > 0 || bucket == &governor->bytes)
+			bucket_level = GOVERNOR_HASH;
+		else
+			bucket_level = GOVERNOR_SKIP;
+
+		if (bucket_level > level)
+			level = bucket_level;
+	}
+
+	governor->level = level;
+
+	return level;
+}
+
+void governor_clock(struct governor *governor, struct timespec *start)
+{
+	if (governor->cpu.rate > 0)
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, start);
+}
+
+/* Take the bytes written and the CPU time spent since the clock was read. */
+void governor_charge(struct governor *governor, unsigned long long bytes,
+		     struct timespec *start)
+{
+	struct timespec now;
+	int64_t elapsed;
+
+	governor_bucket_take(&governor->bytes, bytes);
+
+	if (governor->cpu.rate == 0)
+		return;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+
+	elapsed = (now.tv_sec - start->tv_sec) * 1000000000LL +
+		  now.tv_nsec - start->tv_nsec;
+
+	governor_bucket_take(&governor->cpu, elapsed);
+}
+
+/* Charge the end of the frame and count the level it was captured at. */
+void governor_end(struct governor *governor, unsigned long long bytes,
+		  struct timespec *start)
+{
+	if (!governor_enabled(governor))
+		return;
+
+	governor_charge(governor, bytes, start);
+
+	governor->decisions[governor->level]++;
+}
+
+/* Frames reduced to a checksum carry it in place of their slices. */
+void governor_print(struct dump_driver_data *driver_data, unsigned int indent)
+{
+	struct governor *governor = &driver_data->governor;
+	struct output *output = &driver_data->output;
+
+	if (!governor_enabled(governor))
+		return;
+
+	print_indent(indent, ".sampling = \"%s\",\n",
+		     governor_level_names[governor->level]);
+
+	if (governor->level != GOVERNOR_HASH)
+		return;
+
+	print_indent(indent, ".sampling_crc = 0x%08x,\n", output->frame_crc);
+	print_indent(indent, ".sampling_size = %llu,\n", output->frame_size);
+}
+
+/* Skipped frames only get a record of the decision. */
+void governor_print_skip(struct dump_driver_data *driver_data,
+			 unsigned int index)
+{
+	unsigned int indent = 1;
+
+	/* Only divergent frames are described in golden mode. */
+	if (driver_data->output.mode == OUTPUT_MODE_GOLDEN)
+		return;
+
+	print_indent(indent++, "{\n");
+	print_indent(indent, ".index = %d,\n", index);
+	print_indent(indent, ".sampling = \"%s\",\n",
+		     governor_level_names[GOVERNOR_SKIP]);
+	print_indent(--indent, "},\n");
+}
+
+void governor_report(struct governor *governor)
+{
+	if (!governor_enabled(governor))
+		return;
+
+	log_info("Captured %u full, %u keyframe, %u hashed and %u skipped frames\n",
+		 governor->decisions[GOVERNOR_FULL],
+		 governor->decisions[GOVERNOR_KEYFRAMES],
+		 governor->decisions[GOVERNOR_HASH],
+		 governor->decisions[GOVERNOR_SKIP]);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GOVERNOR_H_
+#define _GOVERNOR_H_
+
+#include <stdint.h>
+#include <time.h>
+
+struct dump_driver_data;
+
+/*
+ * Values
+ */
+
+/* Buckets hold one burst of their rate, and owe at most as much. */
+#define GOVERNOR_BURST_MS			1000
+
+/* Levels are ordered from the most expensive to the cheapest. */
+enum governor_level {
+	GOVERNOR_FULL,
+	GOVERNOR_KEYFRAMES,
+	GOVERNOR_HASH,
+	GOVERNOR_SKIP,
+	GOVERNOR_LEVEL_COUNT,
+};
+
+/*
+ * Structures
+ */
+
+struct governor_bucket {
+	uint64_t rate;
+	int64_t burst;
+	int64_t tokens;
+};
+
+/*
+ * Bytes are counted in bytes per second and CPU time in nanoseconds per
+ * second. A bucket with no rate places no limit.
+ */
+struct governor {
+	struct governor_bucket bytes;
+	struct governor_bucket cpu;
+	struct timespec refill;
+
+	enum governor_level level;
+	unsigned int decisions[GOVERNOR_LEVEL_COUNT];
+};
+
+/*
+ * Functions
+ */
+
+void governor_init(struct governor *governor, uint64_t bytes_rate,
+		   unsigned int cpu_percent);
+enum governor_level governor_decide(struct governor *governor);
+void governor_clock(struct governor *governor, struct timespec *start);
+void governor_charge(struct governor *governor, unsigned long long bytes,
+		     struct timespec *start);
+void governor_end(struct governor *governor, unsigned long long bytes,
+		  struct timespec *start);
+void governor_print(struct dump_driver_data *driver_data, unsigned int indent);
+void governor_print_skip(struct dump_driver_data *driver_data,
+			 unsigned int index);
+void governor_report(struct governor *governor);
+
+#endif
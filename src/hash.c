@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include "hash.h"
+
+#define HASH_CRC32C_POLYNOMIAL			0x82f63b78
+
+static uint32_t hash_crc32c_table[8][256];
+
+static void hash_crc32c_table_init(void)
+{
+	uint32_t crc;
+	unsigned int i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (HASH_CRC32C_POLYNOMIAL & -(crc & 1));
+
+		hash_crc32c_table[0][i] = crc;
+	}
+
+	for (i = 0; i < 256; i++)
+		for (j = 1; j < 8; j++)
+			hash_crc32c_table[j][i] =
+				(hash_crc32c_table[j - 1][i] >> 8) ^
+				hash_crc32c_table[0][hash_crc32c_table[j - 1][i] & 0xff];
+}
+
+/* Slicing-by-8 fallback, processing 8 bytes per iteration. */
+static uint32_t hash_crc32c_scalar(uint32_t crc, const uint8_t *data,
+				   size_t size)
+{
+	uint32_t low, high;
+
+	while (size >= 8) {
+		memcpy(&low, data, sizeof(low));
+		memcpy(&high, data + 4, sizeof(high));
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		low = __builtin_bswap32(low);
+		high = __builtin_bswap32(high);
+#endif
+		low ^= crc;
+
+		crc = hash_crc32c_table[7][low & 0xff] ^
+		      hash_crc32c_table[6][(low >> 8) & 0xff] ^
+		      hash_crc32c_table[5][(low >> 16) & 0xff] ^
+		      hash_crc32c_table[4][low >> 24] ^
+		      hash_crc32c_table[3][high & 0xff] ^
+		      hash_crc32c_table[2][(high >> 8) & 0xff] ^
+		      hash_crc32c_table[1][(high >> 16) & 0xff] ^
+		      hash_crc32c_table[0][high >> 24];
+
+		data += 8;
+		size -= 8;
+	}
+
+	while (size-- > 0)
+		crc = (crc >> 8) ^ hash_crc32c_table[0][(crc ^ *data++) & 0xff];
+
+	return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse4.2")))
+static uint32_t hash_crc32c_sse42(uint32_t crc, const uint8_t *data,
+				  size_t size)
+{
+#ifdef __x86_64__
+	uint64_t crc64 = crc;
+	uint64_t value;
+
+	while (size >= 8) {
+		memcpy(&value, data, sizeof(value));
+		crc64 = _mm_crc32_u64(crc64, value);
+
+		data += 8;
+		size -= 8;
+	}
+
+	crc = crc64;
+#else
+	uint32_t value;
+
+	while (size >= 4) {
+		memcpy(&value, data, sizeof(value));
+		crc = _mm_crc32_u32(crc, value);
+
+		data += 4;
+		size -= 4;
+	}
+#endif
+
+	while (size-- > 0)
+		crc = _mm_crc32_u8(crc, *data++);
+
+	return crc;
+}
+
+#elif defined(__aarch64__)
+
+__attribute__((target("+crc")))
+static uint32_t hash_crc32c_arm(uint32_t crc, const uint8_t *data,
+				size_t size)
+{
+	uint64_t value;
+
+	while (size >= 8) {
+		memcpy(&value, data, sizeof(value));
+		crc = __crc32cd(crc, value);
+
+		data += 8;
+		size -= 8;
+	}
+
+	while (size-- > 0)
+		crc = __crc32cb(crc, *data++);
+
+	return crc;
+}
+
+#endif
+
+static uint32_t (*hash_crc32c_impl)(uint32_t crc, const uint8_t *data,
+				    size_t size);
+static pthread_once_t hash_crc32c_once = PTHREAD_ONCE_INIT;
+
+static void hash_crc32c_select(void)
+{
+	hash_crc32c_table_init();
+	hash_crc32c_impl = hash_crc32c_scalar;
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2"))
+		hash_crc32c_impl = hash_crc32c_sse42;
+#elif defined(__aarch64__)
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+		hash_crc32c_impl = hash_crc32c_arm;
+#endif
+}
+
+/*
+ * Update a CRC32C (Castagnoli) checksum, starting from zero. Hashing buffers
+ * one after the other gives the checksum of their concatenation.
+ */
+uint32_t hash_crc32c(uint32_t crc, const void *data, size_t size)
+{
+	/* Decode threads may be the first to hash at the same time. */
+	pthread_once(&hash_crc32c_once, hash_crc32c_select);
+
+	return ~hash_crc32c_impl(~crc, data, size);
+}
@@ -24,18 +24,27 @@
 
 #include "dump.h"
 #include "header.h"
+#include "nal.h"
 #include "surface.h"
 
+static FILE *print_output;
+
+void print_set_output(FILE *output)
+{
+	print_output = output;
+}
+
 void print_indent(unsigned indent, const char *fmt, ...)
 {
+	FILE *output = print_output != NULL ? print_output : stdout;
 	va_list args;
 	int i;
 
 	for (i = 0; i < indent; i++)
-		printf("\t");
+		fputc('\t', output);
 
 	va_start(args, fmt);
-	vprintf(fmt, args);
+	vfprintf(output, fmt, args);
 	va_end(args);
 }
 
@@ -46,9 +55,9 @@ void print_u8_array(unsigned indent, const char *name,
 
 	print_indent(indent, ".%s = { ", name);
 	for (i = 0; i < x; i++) {
-		printf("%d, ", array[i]);
+		print_indent(0, "%d, ", array[i]);
 	}
-	printf("},\n");
+	print_indent(0, "},\n");
 }
 
 void print_s8_array(unsigned indent, const char *name,
@@ -58,9 +67,9 @@ void print_s8_array(unsigned indent, const char *name,
 
 	print_indent(indent, ".%s = { ", name);
 	for (i = 0; i < x; i++) {
-		printf("%d, ", array[i]);
+		print_indent(0, "%d, ", array[i]);
 	}
-	printf("},\n");
+	print_indent(0, "},\n");
 }
 
 void print_s16_array(unsigned indent, const char *name,
@@ -70,9 +79,9 @@ void print_s16_array(unsigned indent, const char *name,
 
 	print_indent(indent, ".%s = { ", name);
 	for (i = 0; i < x; i++) {
-		printf("%d, ", array[i]);
+		print_indent(0, "%d, ", array[i]);
 	}
-	printf("},\n");
+	print_indent(0, "},\n");
 }
 
 void print_u8_matrix(unsigned indent, const char *name,
@@ -83,9 +92,9 @@ void print_u8_matrix(unsigned indent, const char *name,
 	print_indent(indent, ".%s = {", name);
 
 	if (x > 1)
-		printf("\n");
+		print_indent(0, "\n");
 	else
-		printf(" ");
+		print_indent(0, " ");
 
 	for (i = 0; i < x; i++) {
 		int j;
@@ -94,16 +103,16 @@ void print_u8_matrix(unsigned indent, const char *name,
 			print_indent(indent + 1, "{ ");
 
 		for (j = 0; j < y; j++)
-			printf("%u, ", *(array + i * y + j));
+			print_indent(0, "%u, ", *(array + i * y + j));
 
 		if (x > 1)
-			printf("},\n");
+			print_indent(0, "},\n");
 	}
 
 	if (x > 1)
 		print_indent(indent, "},\n", name);
 	else
-		printf("},\n");
+		print_indent(0, "},\n");
 }
 
 void print_s8_matrix(unsigned indent, const char *name,
@@ -113,15 +122,15 @@ void print_s8_matrix(unsigned indent, const char *name,
 
 	print_indent(indent, ".%s = {", name);
 
-	printf("\n");
+	print_indent(0, "\n");
 
 	for (i = 0; i < x; i++) {
 		int j;
 
 		print_indent(indent + 1, "{ ");
 		for (j = 0; j < y; j++)
-			printf("%d, ", *(matrix + i * y + j));
-		printf("},\n");
+			print_indent(0, "%d, ", *(matrix + i * y + j));
+		print_indent(0, "},\n");
 	}
 
 	print_indent(indent, "},\n", name);
@@ -138,8 +147,44 @@ void print_s16_matrix(unsigned indent, const char *name,
 
 		print_indent(indent + 1, "{ ", i);
 		for (j = 0; j < y; j++)
-			printf("%d, ", *(matrix + i * y + j));
-		printf("},\n");
+			print_indent(0, "%d, ", *(matrix + i * y + j));
+		print_indent(0, "},\n");
 	}
 	print_indent(indent, "},\n", name);
 }
+
+void print_nal_units(unsigned indent, struct nal_index *index)
+{
+	struct nal_unit *unit;
+	int i;
+
+	print_indent(indent++, ".nal_units = {\n");
+	for (i = 0; i < index->count; i++) {
+		unit = &index->units[i];
+
+		print_indent(indent, "{ .type = %u, .temporal_id = %u, .offset = %u, .size = %u, .epb_count = %u },\n",
+			     unit->type, unit->temporal_id, unit->offset,
+			     unit->size, unit->epb_count);
+	}
+	print_indent(--indent, "},\n");
+	print_indent(indent, ".nal_units_count = %u,\n", index->count);
+}
+
+/*
+ * Size of the slice at offset in the dump, which is smaller than the size
+ * provided by VAAPI when emulation prevention bytes are stripped.
+ */
+unsigned int slice_dump_size(struct dump_driver_data *driver_data,
+			     unsigned int offset, unsigned int size)
+{
+	struct nal_unit *unit;
+
+	if (!driver_data->slices_rbsp)
+		return size;
+
+	unit = nal_index_lookup(&driver_data->nal_index, offset);
+	if (unit == NULL || unit->epb_count > size)
+		return size;
+
+	return size - unit->epb_count;
+}
@@ -18,9 +18,15 @@
 #ifndef _HEADER_H_
 #define _HEADER_H_
 
+#include <stdio.h>
+
+#include <va/va_backend.h>
+
 struct dump_driver_data;
 struct object_surface;
+struct nal_index;
 
+void print_set_output(FILE *output);
 void print_indent(unsigned indent, const char *fmt, ...);
 void print_u8_array(unsigned indent, const char *name,
 		    unsigned char *array, unsigned x);
@@ -34,16 +40,23 @@ void print_s8_matrix(unsigned indent, const char *name,
 		     signed char *matrix, unsigned x, unsigned y);
 void print_s16_matrix(unsigned indent, const char *name,
 		      signed short *matrix, unsigned x, unsigned y);
+void print_nal_units(unsigned indent, struct nal_index *index);
+
+unsigned int slice_dump_size(struct dump_driver_data *driver_data,
+			     unsigned int offset, unsigned int size);
 
 void mpeg2_dump_prepare(struct dump_driver_data *driver_data);
-void mpeg2_dump_header(struct dump_driver_data *driver_data, void *slice_data,
-		       unsigned int slice_size);
+void mpeg2_dump_header(struct dump_driver_data *driver_data, VAProfile profile,
+		       void *slice_data, unsigned int slice_size);
 
 void h264_dump_prepare(struct dump_driver_data *driver_data);
-void h264_dump_header(struct dump_driver_data *driver_data, struct object_surface *surface);
+void h264_dump_header(struct dump_driver_data *driver_data, VAProfile profile,
+		      struct object_surface *surface);
 
 void h265_dump_prepare(struct dump_driver_data *driver_data);
-void h265_dump_header(struct dump_driver_data *driver_data, void *slice_data,
-		      unsigned int slice_size);
+void h265_dump_header(struct dump_driver_data *driver_data,
+		      struct object_surface *surface);
+void h265_dump_slice_layout(struct dump_driver_data *driver_data,
+			    void *data, unsigned int size);
 
 #endif
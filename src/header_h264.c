@@ -24,12 +24,32 @@
 #include <string.h>
 
 #include "dump.h"
+#include "bitstream.h"
+#include "controls.h"
+#include "field.h"
+#include "governor.h"
 #include "header.h"
+#include "index.h"
 #include "surface.h"
+#include "trace.h"
+#include "log.h"
 
+#include "autoconfig.h"
+
+#ifdef HAVE_V4L2_STATELESS
+#include <linux/v4l2-controls.h>
+#endif
 
 #define DPB_SIZE	16
 
+#define H264_NAL_UNIT_TYPE_MASK			((1 << 5) - 1)
+#define H264_NAL_REF_IDC_SHIFT			5
+#define H264_NAL_REF_IDC_MASK			((1 << 2) - 1)
+
+#define H264_NAL_SLICE_IDR			5
+#define H264_NAL_SLICE_EXT			20
+#define H264_NAL_SLICE_EXT_DEPTH		21
+
 struct dpb_entry {
 	VAPictureH264	pic;
 	unsigned int	age;
@@ -212,31 +232,67 @@ static void h264_dump_dpb(struct dump_driver_data *driver_data,
 	print_indent(--indent, "},\n");
 }
 
+enum h264_field_source {
+	H264_FIELD_PICTURE,
+	H264_FIELD_SLICE,
+};
+
+#define H264_FIELD_PICTURE_TYPE			VAPictureParameterBufferH264
+#define H264_FIELD_SLICE_TYPE			VASliceParameterBufferH264
+
+#define H264_DECODE_FIELDS(X) \
+	X(VALUE, top_field_order_cnt, H264_FIELD_PICTURE, CurrPic.TopFieldOrderCnt) \
+	X(VALUE, bottom_field_order_cnt, H264_FIELD_PICTURE, CurrPic.BottomFieldOrderCnt)
+
+#define H264_PPS_FIELDS(X) \
+	X(BITS, weighted_bipred_idc, H264_FIELD_PICTURE, pic_fields.bits.weighted_bipred_idc) \
+	X(VALUE, pic_init_qp_minus26, H264_FIELD_PICTURE, pic_init_qp_minus26) \
+	X(VALUE, pic_init_qs_minus26, H264_FIELD_PICTURE, pic_init_qs_minus26) \
+	X(VALUE, chroma_qp_index_offset, H264_FIELD_PICTURE, chroma_qp_index_offset) \
+	X(VALUE, second_chroma_qp_index_offset, H264_FIELD_PICTURE, second_chroma_qp_index_offset)
+
+#define H264_SPS_FIELDS(X) \
+	X(BITS, chroma_format_idc, H264_FIELD_PICTURE, seq_fields.bits.chroma_format_idc) \
+	X(VALUE, bit_depth_luma_minus8, H264_FIELD_PICTURE, bit_depth_luma_minus8) \
+	X(VALUE, bit_depth_chroma_minus8, H264_FIELD_PICTURE, bit_depth_chroma_minus8) \
+	X(BITS, log2_max_frame_num_minus4, H264_FIELD_PICTURE, seq_fields.bits.log2_max_frame_num_minus4) \
+	X(BITS, log2_max_pic_order_cnt_lsb_minus4, H264_FIELD_PICTURE, seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4) \
+	X(BITS, pic_order_cnt_type, H264_FIELD_PICTURE, seq_fields.bits.pic_order_cnt_type) \
+	X(VALUE, pic_width_in_mbs_minus1, H264_FIELD_PICTURE, picture_width_in_mbs_minus1) \
+	X(VALUE, pic_height_in_map_units_minus1, H264_FIELD_PICTURE, picture_height_in_mbs_minus1)
+
+#define H264_SLICE_FIELDS(X) \
+	X(VALUE, first_mb_in_slice, H264_FIELD_SLICE, first_mb_in_slice) \
+	X(VALUE, slice_type, H264_FIELD_SLICE, slice_type) \
+	X(VALUE, cabac_init_idc, H264_FIELD_SLICE, cabac_init_idc) \
+	X(VALUE, slice_qp_delta, H264_FIELD_SLICE, slice_qp_delta) \
+	X(VALUE, disable_deblocking_filter_idc, H264_FIELD_SLICE, disable_deblocking_filter_idc) \
+	X(VALUE, slice_alpha_c0_offset_div2, H264_FIELD_SLICE, slice_alpha_c0_offset_div2) \
+	X(VALUE, slice_beta_offset_div2, H264_FIELD_SLICE, slice_beta_offset_div2)
+
+FIELD_TABLE(h264_decode_table, "frame.h264.decode_params", H264_DECODE_FIELDS);
+FIELD_TABLE(h264_pps_table, "frame.h264.pps", H264_PPS_FIELDS);
+FIELD_TABLE(h264_sps_table, "frame.h264.sps", H264_SPS_FIELDS);
+FIELD_TABLE(h264_slice_table, "slice.h264", H264_SLICE_FIELDS);
+
 static void h264_emit_picture_parameter(struct dump_driver_data *driver_data,
 					unsigned int indent)
 {
 	VAPictureParameterBufferH264 *picture_params =
 		&driver_data->params.h264.picture;
+	const void *sources[] = {
+		[H264_FIELD_PICTURE] = picture_params,
+	};
 
 	print_indent(indent++, ".decode_params = {\n");
-	print_indent(indent, ".top_field_order_cnt = %d,\n",
-		     picture_params->CurrPic.TopFieldOrderCnt);
-	print_indent(indent, ".bottom_field_order_cnt = %d,\n",
-		     picture_params->CurrPic.BottomFieldOrderCnt);
+	field_print(&h264_decode_table, sources, indent);
+	field_columnar(&h264_decode_table, sources, &driver_data->output.columnar);
 	h264_dump_dpb(driver_data, picture_params, indent);
 	print_indent(--indent, "},\n");
 
 	print_indent(indent++, ".pps = {\n");
-	print_indent(indent, ".weighted_bipred_idc = %d,\n",
-		     picture_params->pic_fields.bits.weighted_bipred_idc);
-	print_indent(indent, ".pic_init_qp_minus26 = %d,\n",
-		     picture_params->pic_init_qp_minus26);
-	print_indent(indent, ".pic_init_qs_minus26 = %d,\n",
-		     picture_params->pic_init_qs_minus26);
-	print_indent(indent, ".chroma_qp_index_offset = %d,\n",
-		     picture_params->chroma_qp_index_offset);
-	print_indent(indent, ".second_chroma_qp_index_offset = %d,\n",
-		     picture_params->second_chroma_qp_index_offset);
+	field_print(&h264_pps_table, sources, indent);
+	field_columnar(&h264_pps_table, sources, &driver_data->output.columnar);
 	print_indent(indent, ".flags = %s | %s | %s | %s | %s,\n",
 		     picture_params->pic_fields.bits.entropy_coding_mode_flag ?
 			"V4L2_H264_PPS_FLAG_ENTROPY_CODING_MODE " : " 0 ",
@@ -255,22 +311,8 @@ static void h264_emit_picture_parameter(struct dump_driver_data *driver_data,
 	print_indent(--indent, "},\n");
 
 	print_indent(indent++, ".sps = {\n");
-	print_indent(indent, ".chroma_format_idc = %u,\n",
-		     picture_params->seq_fields.bits.chroma_format_idc);
-	print_indent(indent, ".bit_depth_luma_minus8 = %u,\n",
-		     picture_params->bit_depth_luma_minus8);
-	print_indent(indent, ".bit_depth_chroma_minus8 = %u,\n",
-		     picture_params->bit_depth_chroma_minus8);
-	print_indent(indent, ".log2_max_frame_num_minus4 = %u,\n",
-		     picture_params->seq_fields.bits.log2_max_frame_num_minus4);
-	print_indent(indent, ".log2_max_pic_order_cnt_lsb_minus4 = %u,\n",
-		     picture_params->seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4);
-	print_indent(indent, ".pic_order_cnt_type = %u,\n",
-		     picture_params->seq_fields.bits.pic_order_cnt_type);
-	print_indent(indent, ".pic_width_in_mbs_minus1 = %u,\n",
-		     picture_params->picture_width_in_mbs_minus1);
-	print_indent(indent, ".pic_height_in_map_units_minus1 = %u,\n",
-		     picture_params->picture_height_in_mbs_minus1);
+	field_print(&h264_sps_table, sources, indent);
+	field_columnar(&h264_sps_table, sources, &driver_data->output.columnar);
 
 	print_indent(indent, ".flags = %s | %s | %s | %s | %s,\n",
 		     picture_params->seq_fields.bits.residual_colour_transform_flag ?
@@ -306,24 +348,347 @@ static void h264_emit_quantization_matrix(struct dump_driver_data *driver_data,
 
 #define H264_SLICE_P	0
 #define H264_SLICE_B	1
+#define H264_SLICE_I	2
+#define H264_SLICE_SP	3
+#define H264_SLICE_SI	4
+
+static void h264_parse_ref_pic_list_modification(struct bitstream *bitstream)
+{
+	unsigned int idc;
+
+	if (!bitstream_read_flag(bitstream))
+		return;
+
+	do {
+		idc = bitstream_read_ue(bitstream);
+
+		/* Both picture numbers and view indexes are a single ue(v). */
+		if (idc != 3)
+			bitstream_read_ue(bitstream);
+	} while (idc != 3 && !bitstream_error(bitstream));
+}
+
+static void h264_parse_pred_weight_table(struct bitstream *bitstream,
+					 unsigned int chroma_array_type,
+					 unsigned int num_ref_idx_l0,
+					 unsigned int num_ref_idx_l1)
+{
+	unsigned int count;
+	unsigned int i, j;
+
+	bitstream_read_ue(bitstream);
+
+	if (chroma_array_type != 0)
+		bitstream_read_ue(bitstream);
+
+	for (j = 0; j < 2; j++) {
+		count = j ? num_ref_idx_l1 : num_ref_idx_l0;
+
+		for (i = 0; i < count; i++) {
+			if (bitstream_read_flag(bitstream)) {
+				bitstream_read_se(bitstream);
+				bitstream_read_se(bitstream);
+			}
+
+			if (chroma_array_type != 0 &&
+			    bitstream_read_flag(bitstream)) {
+				bitstream_read_se(bitstream);
+				bitstream_read_se(bitstream);
+				bitstream_read_se(bitstream);
+				bitstream_read_se(bitstream);
+			}
+		}
+	}
+}
+
+static void h264_parse_dec_ref_pic_marking(struct bitstream *bitstream,
+					   bool idr)
+{
+	unsigned int operation;
+
+	if (idr) {
+		bitstream_skip(bitstream, 2);
+		return;
+	}
+
+	if (!bitstream_read_flag(bitstream))
+		return;
+
+	do {
+		operation = bitstream_read_ue(bitstream);
+
+		if (operation == 1 || operation == 3)
+			bitstream_read_ue(bitstream);
+		if (operation == 2)
+			bitstream_read_ue(bitstream);
+		if (operation == 3 || operation == 6)
+			bitstream_read_ue(bitstream);
+		if (operation == 4)
+			bitstream_read_ue(bitstream);
+	} while (operation != 0 && !bitstream_error(bitstream));
+}
+
+/* Slice header values that VAAPI does not provide. */
+struct h264_slice_header {
+	unsigned int header_bit_size;
+	unsigned int nal_ref_idc;
+	bool idr;
+	unsigned int colour_plane_id;
+	unsigned int frame_num;
+	bool field_pic;
+	bool bottom_field;
+	unsigned int idr_pic_id;
+	unsigned int pic_order_cnt_lsb;
+	int delta_pic_order_cnt_bottom;
+	int delta_pic_order_cnt[2];
+	unsigned int pic_order_cnt_bit_size;
+	unsigned int redundant_pic_cnt;
+	unsigned int dec_ref_pic_marking_bit_size;
+	bool sp_for_switch;
+	int slice_qs_delta;
+	unsigned int slice_group_change_cycle;
+};
+
+/*
+ * Parse the slice header up to slice_data() to find its exact size in bits,
+ * counted from the start of the NAL unit in the slice data, either escaped or
+ * already stripped of its emulation prevention bytes in RBSP mode.
+ */
+static int h264_parse_slice_header(struct dump_driver_data *driver_data,
+				   uint8_t *data, unsigned int size, bool rbsp,
+				   struct h264_slice_header *header)
+{
+	VAPictureParameterBufferH264 *picture_params =
+		&driver_data->params.h264.picture;
+	VASliceParameterBufferH264 *slice_params =
+		&driver_data->params.h264.slice;
+	struct bitstream bitstream;
+	unsigned int nal_unit_type;
+	unsigned int nal_ref_idc;
+	unsigned int chroma_array_type;
+	unsigned int num_ref_idx_l0;
+	unsigned int num_ref_idx_l1;
+	unsigned int map_units;
+	unsigned int rate;
+	unsigned int slice_type;
+	unsigned int position;
+	bool field_pic_flag = false;
+	bool idr;
+
+	memset(header, 0, sizeof(*header));
+
+	if (size < 2)
+		return -1;
+
+	nal_unit_type = data[0] & H264_NAL_UNIT_TYPE_MASK;
+	nal_ref_idc = (data[0] >> H264_NAL_REF_IDC_SHIFT) &
+		      H264_NAL_REF_IDC_MASK;
+	idr = nal_unit_type == H264_NAL_SLICE_IDR;
+
+	if (rbsp)
+		bitstream_init_raw(&bitstream, data, size);
+	else
+		bitstream_init(&bitstream, data, size);
+
+	/* Skip the NAL unit header, including the MVC extension. */
+	if (nal_unit_type == H264_NAL_SLICE_EXT ||
+	    nal_unit_type == H264_NAL_SLICE_EXT_DEPTH) {
+		bitstream_skip(&bitstream, 9);
+		idr = !bitstream_read_flag(&bitstream);
+		bitstream_skip(&bitstream, 22);
+	} else {
+		bitstream_skip(&bitstream, 8);
+	}
+
+	header->nal_ref_idc = nal_ref_idc;
+	header->idr = idr;
+
+	bitstream_read_ue(&bitstream);
+	slice_type = bitstream_read_ue(&bitstream) % 5;
+	bitstream_read_ue(&bitstream);
+
+	if (picture_params->seq_fields.bits.residual_colour_transform_flag) {
+		header->colour_plane_id = bitstream_read(&bitstream, 2);
+		chroma_array_type = 0;
+	} else {
+		chroma_array_type =
+			picture_params->seq_fields.bits.chroma_format_idc;
+	}
+
+	header->frame_num = bitstream_read(&bitstream,
+					   picture_params->seq_fields.bits.log2_max_frame_num_minus4 + 4);
+
+	if (!picture_params->seq_fields.bits.frame_mbs_only_flag) {
+		field_pic_flag = bitstream_read_flag(&bitstream);
+		if (field_pic_flag)
+			header->bottom_field = bitstream_read_flag(&bitstream);
+	}
+
+	header->field_pic = field_pic_flag;
+
+	if (idr)
+		header->idr_pic_id = bitstream_read_ue(&bitstream);
+
+	position = bitstream_position(&bitstream);
+
+	if (picture_params->seq_fields.bits.pic_order_cnt_type == 0) {
+		header->pic_order_cnt_lsb =
+			bitstream_read(&bitstream,
+				       picture_params->seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4 + 4);
+
+		if (picture_params->pic_fields.bits.pic_order_present_flag &&
+		    !field_pic_flag)
+			header->delta_pic_order_cnt_bottom =
+				bitstream_read_se(&bitstream);
+	} else if (picture_params->seq_fields.bits.pic_order_cnt_type == 1 &&
+		   !picture_params->seq_fields.bits.delta_pic_order_always_zero_flag) {
+		header->delta_pic_order_cnt[0] = bitstream_read_se(&bitstream);
+
+		if (picture_params->pic_fields.bits.pic_order_present_flag &&
+		    !field_pic_flag)
+			header->delta_pic_order_cnt[1] =
+				bitstream_read_se(&bitstream);
+	}
+
+	header->pic_order_cnt_bit_size = bitstream_position(&bitstream) -
+					 position;
+
+	if (picture_params->pic_fields.bits.redundant_pic_cnt_present_flag)
+		header->redundant_pic_cnt = bitstream_read_ue(&bitstream);
+
+	if (slice_type == H264_SLICE_B)
+		bitstream_skip(&bitstream, 1);
+
+	num_ref_idx_l0 = slice_params->num_ref_idx_l0_active_minus1 + 1;
+	num_ref_idx_l1 = slice_params->num_ref_idx_l1_active_minus1 + 1;
+
+	if (slice_type == H264_SLICE_P || slice_type == H264_SLICE_SP ||
+	    slice_type == H264_SLICE_B) {
+		if (bitstream_read_flag(&bitstream)) {
+			num_ref_idx_l0 = bitstream_read_ue(&bitstream) + 1;
+
+			if (slice_type == H264_SLICE_B)
+				num_ref_idx_l1 = bitstream_read_ue(&bitstream) + 1;
+		}
+	}
+
+	if (slice_type != H264_SLICE_B)
+		num_ref_idx_l1 = 0;
+
+	if (slice_type != H264_SLICE_I && slice_type != H264_SLICE_SI) {
+		h264_parse_ref_pic_list_modification(&bitstream);
+
+		if (slice_type == H264_SLICE_B)
+			h264_parse_ref_pic_list_modification(&bitstream);
+	}
+
+	if ((picture_params->pic_fields.bits.weighted_pred_flag &&
+	     (slice_type == H264_SLICE_P || slice_type == H264_SLICE_SP)) ||
+	    (picture_params->pic_fields.bits.weighted_bipred_idc == 1 &&
+	     slice_type == H264_SLICE_B))
+		h264_parse_pred_weight_table(&bitstream, chroma_array_type,
+					     num_ref_idx_l0, num_ref_idx_l1);
+
+	if (nal_ref_idc != 0) {
+		position = bitstream_position(&bitstream);
+		h264_parse_dec_ref_pic_marking(&bitstream, idr);
+		header->dec_ref_pic_marking_bit_size =
+			bitstream_position(&bitstream) - position;
+	}
+
+	if (picture_params->pic_fields.bits.entropy_coding_mode_flag &&
+	    slice_type != H264_SLICE_I && slice_type != H264_SLICE_SI)
+		bitstream_read_ue(&bitstream);
+
+	bitstream_read_se(&bitstream);
+
+	if (slice_type == H264_SLICE_SP || slice_type == H264_SLICE_SI) {
+		if (slice_type == H264_SLICE_SP)
+			header->sp_for_switch = bitstream_read_flag(&bitstream);
+
+		header->slice_qs_delta = bitstream_read_se(&bitstream);
+	}
+
+	if (picture_params->pic_fields.bits.deblocking_filter_control_present_flag &&
+	    bitstream_read_ue(&bitstream) != 1) {
+		bitstream_read_se(&bitstream);
+		bitstream_read_se(&bitstream);
+	}
+
+	if (picture_params->num_slice_groups_minus1 > 0 &&
+	    picture_params->slice_group_map_type >= 3 &&
+	    picture_params->slice_group_map_type <= 5) {
+		map_units = (picture_params->picture_width_in_mbs_minus1 + 1) *
+			    (picture_params->picture_height_in_mbs_minus1 + 1);
+		if (!picture_params->seq_fields.bits.frame_mbs_only_flag)
+			map_units /= 2;
+
+		/* The division is exact, so round it up before taking the log. */
+		rate = picture_params->slice_group_change_rate_minus1 + 1;
+		header->slice_group_change_cycle =
+			bitstream_read(&bitstream,
+				       bitstream_ceil_log2((map_units + rate - 1) / rate + 1));
+	}
+
+	if (bitstream_error(&bitstream))
+		return -1;
+
+	header->header_bit_size = bitstream_raw_position(&bitstream);
+
+	return 0;
+}
+
+static unsigned int h264_slice_header(struct dump_driver_data *driver_data,
+				      struct object_surface *surface,
+				      VASliceParameterBufferH264 *slice_params,
+				      unsigned int offset,
+				      struct h264_slice_header *header)
+{
+	unsigned int size;
+	uint8_t *data;
+	int rc;
+
+	offset += slice_params->slice_data_offset;
+
+	data = (uint8_t *)surface->slice_data + offset;
+	size = slice_dump_size(driver_data, offset,
+			       slice_params->slice_data_size);
+
+	rc = h264_parse_slice_header(driver_data, data, size,
+				     driver_data->slices_rbsp, header);
+
+	/*
+	 * Fallback to the offset provided by VAAPI if parsing fails. It counts
+	 * emulation prevention bytes, so it is left unknown (zero) in RBSP mode.
+	 */
+	if (rc < 0 && !driver_data->slices_rbsp)
+		header->header_bit_size = slice_params->slice_data_bit_offset;
+	else if (rc < 0)
+		log_warning("Unable to parse slice header, header size unknown\n");
+
+	return size;
+}
 
 static void h264_emit_slice_parameter(struct dump_driver_data *driver_data,
+				      struct object_surface *surface,
 				      unsigned int indent)
 {
 	VASliceParameterBufferH264 *slice_params =
 		&driver_data->params.h264.slice;
+	const void *sources[] = {
+		[H264_FIELD_SLICE] = slice_params,
+	};
+	struct h264_slice_header header;
+	unsigned int size;
 	int i;
 
+	size = h264_slice_header(driver_data, surface, slice_params,
+				 surface->slice_offset, &header);
+
 	print_indent(indent++, ".slice_params = {\n");
-	print_indent(indent, ".size = %u,\n", slice_params->slice_data_size);
-	print_indent(indent, ".header_bit_size = %u,\n", slice_params->slice_data_bit_offset);
-	print_indent(indent, ".first_mb_in_slice = %u,\n", slice_params->first_mb_in_slice);
-	print_indent(indent, ".slice_type = %u,\n", slice_params->slice_type);
-	print_indent(indent, ".cabac_init_idc = %u,\n", slice_params->cabac_init_idc);
-	print_indent(indent, ".slice_qp_delta = %d,\n", slice_params->slice_qp_delta);
-	print_indent(indent, ".disable_deblocking_filter_idc = %u,\n", slice_params->disable_deblocking_filter_idc);
-	print_indent(indent, ".slice_alpha_c0_offset_div2 = %d,\n", slice_params->slice_alpha_c0_offset_div2);
-	print_indent(indent, ".slice_beta_offset_div2 = %d,\n", slice_params->slice_beta_offset_div2);
+	print_indent(indent, ".size = %u,\n", size);
+	print_indent(indent, ".header_bit_size = %u,\n", header.header_bit_size);
+	field_print(&h264_slice_table, sources, indent);
 
 	if (((slice_params->slice_type % 5) == H264_SLICE_P) ||
 	    ((slice_params->slice_type % 5) == H264_SLICE_B)) {
@@ -336,9 +701,9 @@ static void h264_emit_slice_parameter(struct dump_driver_data *driver_data,
 			unsigned int idx = 0;
 
 			entry = dpb_lookup(pic, &idx);
-			printf(" %u, ", entry ? idx : 0);
+			print_indent(0, " %u, ", entry ? idx : 0);
 		}
-		printf("},\n");
+		print_indent(0, "},\n");
 	}
 
 	if ((slice_params->slice_type % 5) == H264_SLICE_B) {
@@ -351,9 +716,9 @@ static void h264_emit_slice_parameter(struct dump_driver_data *driver_data,
 			unsigned int idx = 0;
 
 			entry = dpb_lookup(pic, &idx);
-			printf(" %u, ", entry ? idx : 0);
+			print_indent(0, " %u, ", entry ? idx : 0);
 		}
-		printf("},\n");
+		print_indent(0, "},\n");
 	}
 
 	if (slice_params->direct_spatial_mv_pred_flag)
@@ -388,12 +753,346 @@ static void h264_emit_slice_parameter(struct dump_driver_data *driver_data,
 	print_indent(--indent, "},\n");
 }
 
+/* Export the fields of every slice of the picture, with one row each. */
+static void h264_columnar_slices(struct dump_driver_data *driver_data,
+				 struct object_surface *surface)
+{
+	struct columnar *columnar = &driver_data->output.columnar_slices;
+	VASliceParameterBufferH264 *slice_params;
+	const void *sources[] = {
+		[H264_FIELD_SLICE] = NULL,
+	};
+	struct h264_slice_header header;
+	struct dump_slice *slice;
+	unsigned int size;
+	unsigned int i;
+
+	if (columnar->group_rows == 0)
+		return;
+
+	for (i = 0; i < driver_data->slices_count; i++) {
+		slice = &driver_data->slices[i];
+		slice_params = &slice->params.h264;
+		sources[H264_FIELD_SLICE] = slice_params;
+
+		size = h264_slice_header(driver_data, surface, slice_params,
+					 slice->offset, &header);
+
+		columnar_row_begin(columnar);
+		columnar_int(columnar, "index", driver_data->frame_index);
+		columnar_int(columnar, "slice", i);
+		columnar_int(columnar, "slice.h264.size", size);
+		columnar_int(columnar, "slice.h264.header_bit_size",
+			     header.header_bit_size);
+		field_columnar(&h264_slice_table, sources, columnar);
+		columnar_row_end(columnar);
+	}
+}
+
+#ifdef HAVE_V4L2_STATELESS
+
+static unsigned int h264_controls_profile_idc(VAProfile profile,
+					      VAPictureParameterBufferH264 *picture_params)
+{
+	if (picture_params->seq_fields.bits.chroma_format_idc != 1 ||
+	    picture_params->bit_depth_luma_minus8 > 0 ||
+	    picture_params->bit_depth_chroma_minus8 > 0)
+		return 244;
+
+	switch (profile) {
+	case VAProfileH264ConstrainedBaseline:
+		return 66;
+	case VAProfileH264Main:
+		return 77;
+	default:
+		return 100;
+	}
+}
+
+static void h264_controls_ref_pic_list(struct v4l2_h264_reference *list,
+				       VAPictureH264 *pics, unsigned int count)
+{
+	unsigned int idx;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (dpb_lookup(&pics[i], &idx) == NULL)
+			continue;
+
+		list[i].index = idx;
+
+		if (pics[i].flags & VA_PICTURE_H264_TOP_FIELD)
+			list[i].fields = V4L2_H264_TOP_FIELD_REF;
+		else if (pics[i].flags & VA_PICTURE_H264_BOTTOM_FIELD)
+			list[i].fields = V4L2_H264_BOTTOM_FIELD_REF;
+		else
+			list[i].fields = V4L2_H264_FRAME_REF;
+	}
+}
+
+/*
+ * Fill the payloads of the mainline stateless H.264 controls for one slice of
+ * the frame, as expected for slice-based decoding.
+ */
+static void h264_emit_controls_slice(struct dump_driver_data *driver_data,
+				     VAProfile profile,
+				     struct object_surface *surface,
+				     VASliceParameterBufferH264 *slice_params,
+				     unsigned int offset, unsigned int index,
+				     unsigned int count)
+{
+	struct controls *controls = &driver_data->output.controls;
+	VAPictureParameterBufferH264 *picture_params =
+		&driver_data->params.h264.picture;
+	VAIQMatrixBufferH264 *quantization_params =
+		&driver_data->params.h264.quantization;
+	struct v4l2_ctrl_h264_sps *sps;
+	struct v4l2_ctrl_h264_pps *pps;
+	struct v4l2_ctrl_h264_scaling_matrix *scaling_matrix;
+	struct v4l2_ctrl_h264_pred_weights *pred_weights;
+	struct v4l2_ctrl_h264_slice_params *slice;
+	struct v4l2_ctrl_h264_decode_params *decode;
+	struct h264_slice_header header;
+	unsigned int slice_type = slice_params->slice_type % 5;
+	unsigned int max_frame_num;
+	unsigned int map_units;
+	unsigned int i, j;
+
+	h264_slice_header(driver_data, surface, slice_params, offset, &header);
+
+	max_frame_num = 1 << (picture_params->seq_fields.bits.log2_max_frame_num_minus4 + 4);
+
+	/* Field pictures count map units in pairs of macroblock rows. */
+	map_units = (picture_params->picture_height_in_mbs_minus1 + 1) /
+		    (2 - picture_params->seq_fields.bits.frame_mbs_only_flag);
+
+	controls_begin(controls, driver_data->frame_index, INDEX_CODEC_H264);
+	controls_slice(controls, index, count);
+
+	sps = controls_add(controls, V4L2_CID_STATELESS_H264_SPS, sizeof(*sps));
+	if (sps != NULL) {
+		sps->profile_idc = h264_controls_profile_idc(profile,
+							     picture_params);
+		sps->chroma_format_idc = picture_params->seq_fields.bits.chroma_format_idc;
+		sps->bit_depth_luma_minus8 = picture_params->bit_depth_luma_minus8;
+		sps->bit_depth_chroma_minus8 = picture_params->bit_depth_chroma_minus8;
+		sps->log2_max_frame_num_minus4 = picture_params->seq_fields.bits.log2_max_frame_num_minus4;
+		sps->pic_order_cnt_type = picture_params->seq_fields.bits.pic_order_cnt_type;
+		sps->log2_max_pic_order_cnt_lsb_minus4 = picture_params->seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4;
+		sps->max_num_ref_frames = picture_params->num_ref_frames;
+		sps->pic_width_in_mbs_minus1 = picture_params->picture_width_in_mbs_minus1;
+		sps->pic_height_in_map_units_minus1 = map_units > 0 ? map_units - 1 : 0;
+
+		if (picture_params->seq_fields.bits.residual_colour_transform_flag)
+			sps->flags |= V4L2_H264_SPS_FLAG_SEPARATE_COLOUR_PLANE;
+		if (picture_params->seq_fields.bits.gaps_in_frame_num_value_allowed_flag)
+			sps->flags |= V4L2_H264_SPS_FLAG_GAPS_IN_FRAME_NUM_VALUE_ALLOWED;
+		if (picture_params->seq_fields.bits.frame_mbs_only_flag)
+			sps->flags |= V4L2_H264_SPS_FLAG_FRAME_MBS_ONLY;
+		if (picture_params->seq_fields.bits.mb_adaptive_frame_field_flag)
+			sps->flags |= V4L2_H264_SPS_FLAG_MB_ADAPTIVE_FRAME_FIELD;
+		if (picture_params->seq_fields.bits.direct_8x8_inference_flag)
+			sps->flags |= V4L2_H264_SPS_FLAG_DIRECT_8X8_INFERENCE;
+		if (picture_params->seq_fields.bits.delta_pic_order_always_zero_flag)
+			sps->flags |= V4L2_H264_SPS_FLAG_DELTA_PIC_ORDER_ALWAYS_ZERO;
+	}
+
+	pps = controls_add(controls, V4L2_CID_STATELESS_H264_PPS, sizeof(*pps));
+	if (pps != NULL) {
+		pps->num_ref_idx_l0_default_active_minus1 = slice_params->num_ref_idx_l0_active_minus1;
+		pps->num_ref_idx_l1_default_active_minus1 = slice_params->num_ref_idx_l1_active_minus1;
+		pps->weighted_bipred_idc = picture_params->pic_fields.bits.weighted_bipred_idc;
+		pps->pic_init_qp_minus26 = picture_params->pic_init_qp_minus26;
+		pps->pic_init_qs_minus26 = picture_params->pic_init_qs_minus26;
+		pps->chroma_qp_index_offset = picture_params->chroma_qp_index_offset;
+		pps->second_chroma_qp_index_offset = picture_params->second_chroma_qp_index_offset;
+
+		if (picture_params->pic_fields.bits.entropy_coding_mode_flag)
+			pps->flags |= V4L2_H264_PPS_FLAG_ENTROPY_CODING_MODE;
+		if (picture_params->pic_fields.bits.pic_order_present_flag)
+			pps->flags |= V4L2_H264_PPS_FLAG_BOTTOM_FIELD_PIC_ORDER_IN_FRAME_PRESENT;
+		if (picture_params->pic_fields.bits.weighted_pred_flag)
+			pps->flags |= V4L2_H264_PPS_FLAG_WEIGHTED_PRED;
+		if (picture_params->pic_fields.bits.deblocking_filter_control_present_flag)
+			pps->flags |= V4L2_H264_PPS_FLAG_DEBLOCKING_FILTER_CONTROL_PRESENT;
+		if (picture_params->pic_fields.bits.constrained_intra_pred_flag)
+			pps->flags |= V4L2_H264_PPS_FLAG_CONSTRAINED_INTRA_PRED;
+		if (picture_params->pic_fields.bits.redundant_pic_cnt_present_flag)
+			pps->flags |= V4L2_H264_PPS_FLAG_REDUNDANT_PIC_CNT_PRESENT;
+		if (picture_params->pic_fields.bits.transform_8x8_mode_flag)
+			pps->flags |= V4L2_H264_PPS_FLAG_TRANSFORM_8X8_MODE;
+
+		/* VAAPI always provides the matrices, flat ones by default. */
+		pps->flags |= V4L2_H264_PPS_FLAG_SCALING_MATRIX_PRESENT;
+	}
+
+	scaling_matrix = controls_add(controls,
+				      V4L2_CID_STATELESS_H264_SCALING_MATRIX,
+				      sizeof(*scaling_matrix));
+	if (scaling_matrix != NULL) {
+		memcpy(scaling_matrix->scaling_list_4x4,
+		       quantization_params->ScalingList4x4,
+		       sizeof(scaling_matrix->scaling_list_4x4));
+		memcpy(scaling_matrix->scaling_list_8x8,
+		       quantization_params->ScalingList8x8,
+		       sizeof(quantization_params->ScalingList8x8));
+	}
+
+	if (slice_type != H264_SLICE_I && slice_type != H264_SLICE_SI) {
+		pred_weights = controls_add(controls,
+					    V4L2_CID_STATELESS_H264_PRED_WEIGHTS,
+					    sizeof(*pred_weights));
+		if (pred_weights != NULL) {
+			pred_weights->luma_log2_weight_denom = slice_params->luma_log2_weight_denom;
+			pred_weights->chroma_log2_weight_denom = slice_params->chroma_log2_weight_denom;
+
+			for (i = 0; i < 32; i++) {
+				pred_weights->weight_factors[0].luma_weight[i] = slice_params->luma_weight_l0[i];
+				pred_weights->weight_factors[0].luma_offset[i] = slice_params->luma_offset_l0[i];
+				pred_weights->weight_factors[1].luma_weight[i] = slice_params->luma_weight_l1[i];
+				pred_weights->weight_factors[1].luma_offset[i] = slice_params->luma_offset_l1[i];
+
+				for (j = 0; j < 2; j++) {
+					pred_weights->weight_factors[0].chroma_weight[i][j] = slice_params->chroma_weight_l0[i][j];
+					pred_weights->weight_factors[0].chroma_offset[i][j] = slice_params->chroma_offset_l0[i][j];
+					pred_weights->weight_factors[1].chroma_weight[i][j] = slice_params->chroma_weight_l1[i][j];
+					pred_weights->weight_factors[1].chroma_offset[i][j] = slice_params->chroma_offset_l1[i][j];
+				}
+			}
+		}
+	}
+
+	slice = controls_add(controls, V4L2_CID_STATELESS_H264_SLICE_PARAMS,
+			     sizeof(*slice));
+	if (slice != NULL) {
+		slice->header_bit_size = header.header_bit_size;
+		slice->first_mb_in_slice = slice_params->first_mb_in_slice;
+		slice->slice_type = slice_type;
+		slice->colour_plane_id = header.colour_plane_id;
+		slice->redundant_pic_cnt = header.redundant_pic_cnt;
+		slice->cabac_init_idc = slice_params->cabac_init_idc;
+		slice->slice_qp_delta = slice_params->slice_qp_delta;
+		slice->slice_qs_delta = header.slice_qs_delta;
+		slice->disable_deblocking_filter_idc = slice_params->disable_deblocking_filter_idc;
+		slice->slice_alpha_c0_offset_div2 = slice_params->slice_alpha_c0_offset_div2;
+		slice->slice_beta_offset_div2 = slice_params->slice_beta_offset_div2;
+
+		if (slice_type == H264_SLICE_P || slice_type == H264_SLICE_SP ||
+		    slice_type == H264_SLICE_B) {
+			slice->num_ref_idx_l0_active_minus1 = slice_params->num_ref_idx_l0_active_minus1;
+			h264_controls_ref_pic_list(slice->ref_pic_list0,
+						   slice_params->RefPicList0,
+						   slice_params->num_ref_idx_l0_active_minus1 + 1);
+		}
+
+		if (slice_type == H264_SLICE_B) {
+			slice->num_ref_idx_l1_active_minus1 = slice_params->num_ref_idx_l1_active_minus1;
+			h264_controls_ref_pic_list(slice->ref_pic_list1,
+						   slice_params->RefPicList1,
+						   slice_params->num_ref_idx_l1_active_minus1 + 1);
+		}
+
+		if (slice_params->direct_spatial_mv_pred_flag)
+			slice->flags |= V4L2_H264_SLICE_FLAG_DIRECT_SPATIAL_MV_PRED;
+		if (header.sp_for_switch)
+			slice->flags |= V4L2_H264_SLICE_FLAG_SP_FOR_SWITCH;
+	}
+
+	decode = controls_add(controls, V4L2_CID_STATELESS_H264_DECODE_PARAMS,
+			      sizeof(*decode));
+	if (decode != NULL) {
+		for (i = 0; i < DPB_SIZE; i++) {
+			struct dpb_entry *entry = &local_dpb.entries[i];
+			struct v4l2_h264_dpb_entry *dpb = &decode->dpb[i];
+			VAPictureH264 *pic = &entry->pic;
+
+			if (!entry->valid)
+				continue;
+
+			dpb->reference_ts = CONTROLS_TIMESTAMP(entry->tag);
+
+			/* Short-term frame numbers wrap around the current one. */
+			if (!(pic->flags & VA_PICTURE_H264_LONG_TERM_REFERENCE) &&
+			    pic->frame_idx > header.frame_num)
+				dpb->pic_num = pic->frame_idx - max_frame_num;
+			else
+				dpb->pic_num = pic->frame_idx;
+
+			dpb->frame_num = pic->frame_idx;
+			dpb->fields = V4L2_H264_FRAME_REF;
+			dpb->top_field_order_cnt = pic->TopFieldOrderCnt;
+			dpb->bottom_field_order_cnt = pic->BottomFieldOrderCnt;
+			dpb->flags = V4L2_H264_DPB_ENTRY_FLAG_VALID;
+
+			if (pic->flags & VA_PICTURE_H264_LONG_TERM_REFERENCE)
+				dpb->flags |= V4L2_H264_DPB_ENTRY_FLAG_LONG_TERM;
+			if (entry->used)
+				dpb->flags |= V4L2_H264_DPB_ENTRY_FLAG_ACTIVE;
+		}
+
+		decode->nal_ref_idc = header.nal_ref_idc;
+		decode->frame_num = header.frame_num;
+		decode->top_field_order_cnt = picture_params->CurrPic.TopFieldOrderCnt;
+		decode->bottom_field_order_cnt = picture_params->CurrPic.BottomFieldOrderCnt;
+		decode->idr_pic_id = header.idr_pic_id;
+		decode->pic_order_cnt_lsb = header.pic_order_cnt_lsb;
+		decode->delta_pic_order_cnt_bottom = header.delta_pic_order_cnt_bottom;
+		decode->delta_pic_order_cnt0 = header.delta_pic_order_cnt[0];
+		decode->delta_pic_order_cnt1 = header.delta_pic_order_cnt[1];
+		decode->dec_ref_pic_marking_bit_size = header.dec_ref_pic_marking_bit_size;
+		decode->pic_order_cnt_bit_size = header.pic_order_cnt_bit_size;
+		decode->slice_group_change_cycle = header.slice_group_change_cycle;
+
+		if (header.idr)
+			decode->flags |= V4L2_H264_DECODE_PARAM_FLAG_IDR_PIC;
+		if (header.field_pic)
+			decode->flags |= V4L2_H264_DECODE_PARAM_FLAG_FIELD_PIC;
+		if (header.bottom_field)
+			decode->flags |= V4L2_H264_DECODE_PARAM_FLAG_BOTTOM_FIELD;
+		if (slice_type == H264_SLICE_P || slice_type == H264_SLICE_SP)
+			decode->flags |= V4L2_H264_DECODE_PARAM_FLAG_PFRAME;
+		else if (slice_type == H264_SLICE_B)
+			decode->flags |= V4L2_H264_DECODE_PARAM_FLAG_BFRAME;
+	}
+
+	controls_end(controls);
+}
+
+/* Emit one controls record per slice of the frame. */
+static void h264_emit_controls(struct dump_driver_data *driver_data,
+			       VAProfile profile,
+			       struct object_surface *surface)
+{
+	struct dump_slice *slice;
+	unsigned int i;
+
+	if (driver_data->slices_count == 0) {
+		h264_emit_controls_slice(driver_data, profile, surface,
+					 &driver_data->params.h264.slice,
+					 surface->slice_offset, 0, 1);
+		return;
+	}
+
+	for (i = 0; i < driver_data->slices_count; i++) {
+		slice = &driver_data->slices[i];
+
+		h264_emit_controls_slice(driver_data, profile, surface,
+					 &slice->params.h264, slice->offset, i,
+					 driver_data->slices_count);
+	}
+}
+
+#endif
+
 void h264_dump_prepare(struct dump_driver_data *driver_data)
 {
 }
 
-void h264_dump_header(struct dump_driver_data *driver_data, struct object_surface *surface)
+void h264_dump_header(struct dump_driver_data *driver_data, VAProfile profile,
+		      struct object_surface *surface)
 {
+	TRACE_FUNCTION();
+
 	VAPictureH264 *pic = &driver_data->params.h264.picture.CurrPic;
 	struct dpb_entry *output;
 	unsigned int index = driver_data->frame_index;
@@ -413,10 +1112,18 @@ void h264_dump_header(struct dump_driver_data *driver_data, struct object_surfac
 
 	h264_emit_picture_parameter(driver_data, indent);
 	h264_emit_quantization_matrix(driver_data, indent);
-	h264_emit_slice_parameter(driver_data, indent);
+	h264_emit_slice_parameter(driver_data, surface, indent);
+	h264_columnar_slices(driver_data, surface);
 
 	print_indent(--indent, "},\n");
+	print_nal_units(indent, &driver_data->nal_index);
+	governor_print(driver_data, indent);
 	print_indent(--indent, "},\n");
 
+#ifdef HAVE_V4L2_STATELESS
+	if (driver_data->output.controls.file != NULL)
+		h264_emit_controls(driver_data, profile, surface);
+#endif
+
 	insert_in_dpb(pic, output, index);
 }
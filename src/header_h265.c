@@ -23,164 +23,636 @@
 #include <string.h>
 
 #include "dump.h"
+#include "bitstream.h"
+#include "controls.h"
+#include "field.h"
+#include "governor.h"
 #include "header.h"
+#include "index.h"
+#include "nal.h"
 #include "surface.h"
+#include "trace.h"
+#include "log.h"
+
+#include "autoconfig.h"
+
+#ifdef HAVE_V4L2_STATELESS
+#include <linux/v4l2-controls.h>
+#endif
 
 #define H265_REF_NUM_MAX			16
 #define H265_REF_INVALID			0xff
 
+/* Up to one entry point per tile, for 20 columns and 22 rows of tiles. */
+#define H265_ENTRY_POINT_OFFSETS_MAX		440
+
 #define H265_NAL_UNIT_TYPE_SHIFT		1
 #define H265_NAL_UNIT_TYPE_MASK			((1 << 6) - 1)
 #define H265_NUH_TEMPORAL_ID_PLUS1_SHIFT	0
 #define H265_NUH_TEMPORAL_ID_PLUS1_MASK		((1 << 3) - 1)
 
+#define H265_NAL_BLA_W_LP			16
+#define H265_NAL_IDR_W_RADL			19
+#define H265_NAL_IDR_N_LP			20
+#define H265_NAL_RSV_IRAP_23			23
+
+#define H265_SLICE_B				0
+#define H265_SLICE_P				1
+#define H265_SLICE_I				2
+
+enum h265_field_source {
+	H265_FIELD_PICTURE,
+	H265_FIELD_SLICE,
+};
+
+#define H265_FIELD_PICTURE_TYPE			VAPictureParameterBufferHEVC
+#define H265_FIELD_SLICE_TYPE			VASliceParameterBufferHEVC
+
+#define H265_SPS_FIELDS(X) \
+	X(BITS, chroma_format_idc, H265_FIELD_PICTURE, pic_fields.bits.chroma_format_idc) \
+	X(BITS, separate_colour_plane_flag, H265_FIELD_PICTURE, pic_fields.bits.separate_colour_plane_flag) \
+	X(VALUE, pic_width_in_luma_samples, H265_FIELD_PICTURE, pic_width_in_luma_samples) \
+	X(VALUE, pic_height_in_luma_samples, H265_FIELD_PICTURE, pic_height_in_luma_samples) \
+	X(VALUE, bit_depth_luma_minus8, H265_FIELD_PICTURE, bit_depth_luma_minus8) \
+	X(VALUE, bit_depth_chroma_minus8, H265_FIELD_PICTURE, bit_depth_chroma_minus8) \
+	X(VALUE, log2_max_pic_order_cnt_lsb_minus4, H265_FIELD_PICTURE, log2_max_pic_order_cnt_lsb_minus4) \
+	X(VALUE, sps_max_dec_pic_buffering_minus1, H265_FIELD_PICTURE, sps_max_dec_pic_buffering_minus1) \
+	X(CONSTANT, sps_max_num_reorder_pics, 0) \
+	X(CONSTANT, sps_max_latency_increase_plus1, 0) \
+	X(VALUE, log2_min_luma_coding_block_size_minus3, H265_FIELD_PICTURE, log2_min_luma_coding_block_size_minus3) \
+	X(VALUE, log2_diff_max_min_luma_coding_block_size, H265_FIELD_PICTURE, log2_diff_max_min_luma_coding_block_size) \
+	X(VALUE, log2_min_luma_transform_block_size_minus2, H265_FIELD_PICTURE, log2_min_transform_block_size_minus2) \
+	X(VALUE, log2_diff_max_min_luma_transform_block_size, H265_FIELD_PICTURE, log2_diff_max_min_transform_block_size) \
+	X(VALUE, max_transform_hierarchy_depth_inter, H265_FIELD_PICTURE, max_transform_hierarchy_depth_inter) \
+	X(VALUE, max_transform_hierarchy_depth_intra, H265_FIELD_PICTURE, max_transform_hierarchy_depth_intra) \
+	X(BITS, scaling_list_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.scaling_list_enabled_flag) \
+	X(BITS, amp_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.amp_enabled_flag) \
+	X(BITS, sample_adaptive_offset_enabled_flag, H265_FIELD_PICTURE, slice_parsing_fields.bits.sample_adaptive_offset_enabled_flag) \
+	X(BITS, pcm_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.pcm_enabled_flag) \
+	X(VALUE, pcm_sample_bit_depth_luma_minus1, H265_FIELD_PICTURE, pcm_sample_bit_depth_luma_minus1) \
+	X(VALUE, pcm_sample_bit_depth_chroma_minus1, H265_FIELD_PICTURE, pcm_sample_bit_depth_chroma_minus1) \
+	X(VALUE, log2_min_pcm_luma_coding_block_size_minus3, H265_FIELD_PICTURE, log2_min_pcm_luma_coding_block_size_minus3) \
+	X(VALUE, log2_diff_max_min_pcm_luma_coding_block_size, H265_FIELD_PICTURE, log2_diff_max_min_pcm_luma_coding_block_size) \
+	X(BITS, pcm_loop_filter_disabled_flag, H265_FIELD_PICTURE, pic_fields.bits.pcm_loop_filter_disabled_flag) \
+	X(VALUE, num_short_term_ref_pic_sets, H265_FIELD_PICTURE, num_short_term_ref_pic_sets) \
+	X(BITS, long_term_ref_pics_present_flag, H265_FIELD_PICTURE, slice_parsing_fields.bits.long_term_ref_pics_present_flag) \
+	X(VALUE, num_long_term_ref_pics_sps, H265_FIELD_PICTURE, num_long_term_ref_pic_sps) \
+	X(BITS, sps_temporal_mvp_enabled_flag, H265_FIELD_PICTURE, slice_parsing_fields.bits.sps_temporal_mvp_enabled_flag) \
+	X(BITS, strong_intra_smoothing_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.strong_intra_smoothing_enabled_flag)
+
+#define H265_PPS_FIELDS(X) \
+	X(BITS, dependent_slice_segment_flag, H265_FIELD_SLICE, LongSliceFlags.fields.dependent_slice_segment_flag) \
+	X(BITS, output_flag_present_flag, H265_FIELD_PICTURE, slice_parsing_fields.bits.output_flag_present_flag) \
+	X(VALUE, num_extra_slice_header_bits, H265_FIELD_PICTURE, num_extra_slice_header_bits) \
+	X(BITS, sign_data_hiding_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.sign_data_hiding_enabled_flag) \
+	X(BITS, cabac_init_present_flag, H265_FIELD_PICTURE, slice_parsing_fields.bits.cabac_init_present_flag) \
+	X(VALUE, init_qp_minus26, H265_FIELD_PICTURE, init_qp_minus26) \
+	X(BITS, constrained_intra_pred_flag, H265_FIELD_PICTURE, pic_fields.bits.constrained_intra_pred_flag) \
+	X(BITS, transform_skip_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.transform_skip_enabled_flag) \
+	X(BITS, cu_qp_delta_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.cu_qp_delta_enabled_flag) \
+	X(VALUE, diff_cu_qp_delta_depth, H265_FIELD_PICTURE, diff_cu_qp_delta_depth) \
+	X(VALUE, pps_cb_qp_offset, H265_FIELD_PICTURE, pps_cb_qp_offset) \
+	X(VALUE, pps_cr_qp_offset, H265_FIELD_PICTURE, pps_cr_qp_offset) \
+	X(BITS, pps_slice_chroma_qp_offsets_present_flag, H265_FIELD_PICTURE, slice_parsing_fields.bits.pps_slice_chroma_qp_offsets_present_flag) \
+	X(BITS, weighted_pred_flag, H265_FIELD_PICTURE, pic_fields.bits.weighted_pred_flag) \
+	X(BITS, weighted_bipred_flag, H265_FIELD_PICTURE, pic_fields.bits.weighted_bipred_flag) \
+	X(BITS, transquant_bypass_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.transquant_bypass_enabled_flag) \
+	X(BITS, tiles_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.tiles_enabled_flag) \
+	X(BITS, entropy_coding_sync_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.entropy_coding_sync_enabled_flag) \
+	X(VALUE, num_tile_columns_minus1, H265_FIELD_PICTURE, num_tile_columns_minus1) \
+	X(VALUE, num_tile_rows_minus1, H265_FIELD_PICTURE, num_tile_rows_minus1) \
+	X(ARRAY, column_width_minus1, H265_FIELD_PICTURE, column_width_minus1, 19) \
+	X(ARRAY, row_height_minus1, H265_FIELD_PICTURE, row_height_minus1, 21) \
+	X(BITS, loop_filter_across_tiles_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.loop_filter_across_tiles_enabled_flag) \
+	X(BITS, pps_loop_filter_across_slices_enabled_flag, H265_FIELD_PICTURE, pic_fields.bits.pps_loop_filter_across_slices_enabled_flag) \
+	X(BITS, deblocking_filter_override_enabled_flag, H265_FIELD_PICTURE, slice_parsing_fields.bits.deblocking_filter_override_enabled_flag) \
+	X(BITS, pps_disable_deblocking_filter_flag, H265_FIELD_PICTURE, slice_parsing_fields.bits.pps_disable_deblocking_filter_flag) \
+	X(VALUE, pps_beta_offset_div2, H265_FIELD_PICTURE, pps_beta_offset_div2) \
+	X(VALUE, pps_tc_offset_div2, H265_FIELD_PICTURE, pps_tc_offset_div2) \
+	X(BITS, lists_modification_present_flag, H265_FIELD_PICTURE, slice_parsing_fields.bits.lists_modification_present_flag) \
+	X(VALUE, log2_parallel_merge_level_minus2, H265_FIELD_PICTURE, log2_parallel_merge_level_minus2)
+
+#define H265_SLICE_FIELDS(X) \
+	X(BITS, colour_plane_id, H265_FIELD_SLICE, LongSliceFlags.fields.color_plane_id) \
+	X(VALUE, slice_pic_order_cnt, H265_FIELD_PICTURE, CurrPic.pic_order_cnt) \
+	X(BITS, slice_sao_luma_flag, H265_FIELD_SLICE, LongSliceFlags.fields.slice_sao_luma_flag) \
+	X(BITS, slice_sao_chroma_flag, H265_FIELD_SLICE, LongSliceFlags.fields.slice_sao_chroma_flag) \
+	X(BITS, slice_temporal_mvp_enabled_flag, H265_FIELD_SLICE, LongSliceFlags.fields.slice_temporal_mvp_enabled_flag) \
+	X(VALUE, num_ref_idx_l0_active_minus1, H265_FIELD_SLICE, num_ref_idx_l0_active_minus1) \
+	X(VALUE, num_ref_idx_l1_active_minus1, H265_FIELD_SLICE, num_ref_idx_l1_active_minus1) \
+	X(BITS, mvd_l1_zero_flag, H265_FIELD_SLICE, LongSliceFlags.fields.mvd_l1_zero_flag) \
+	X(BITS, cabac_init_flag, H265_FIELD_SLICE, LongSliceFlags.fields.cabac_init_flag) \
+	X(BITS, collocated_from_l0_flag, H265_FIELD_SLICE, LongSliceFlags.fields.collocated_from_l0_flag) \
+	X(VALUE, collocated_ref_idx, H265_FIELD_SLICE, collocated_ref_idx) \
+	X(VALUE, five_minus_max_num_merge_cand, H265_FIELD_SLICE, five_minus_max_num_merge_cand) \
+	X(CONSTANT, use_integer_mv_flag, 0) \
+	X(VALUE, slice_qp_delta, H265_FIELD_SLICE, slice_qp_delta) \
+	X(VALUE, slice_cb_qp_offset, H265_FIELD_SLICE, slice_cb_qp_offset) \
+	X(VALUE, slice_cr_qp_offset, H265_FIELD_SLICE, slice_cr_qp_offset) \
+	X(CONSTANT, slice_act_y_qp_offset, 0) \
+	X(CONSTANT, slice_act_cb_qp_offset, 0) \
+	X(CONSTANT, slice_act_cr_qp_offset, 0) \
+	X(BITS, slice_deblocking_filter_disabled_flag, H265_FIELD_SLICE, LongSliceFlags.fields.slice_deblocking_filter_disabled_flag) \
+	X(VALUE, slice_beta_offset_div2, H265_FIELD_SLICE, slice_beta_offset_div2) \
+	X(VALUE, slice_tc_offset_div2, H265_FIELD_SLICE, slice_tc_offset_div2) \
+	X(BITS, slice_loop_filter_across_slices_enabled_flag, H265_FIELD_SLICE, LongSliceFlags.fields.slice_loop_filter_across_slices_enabled_flag) \
+	X(VALUE, slice_segment_addr, H265_FIELD_SLICE, slice_segment_address)
+
+FIELD_TABLE(h265_sps_table, "frame.h265.sps", H265_SPS_FIELDS);
+FIELD_TABLE(h265_pps_table, "frame.h265.pps", H265_PPS_FIELDS);
+FIELD_TABLE(h265_slice_table, "slice.h265", H265_SLICE_FIELDS);
+
 static void h265_dump_sps(struct dump_driver_data *driver_data,
 			  unsigned int indent)
 {
-	VAPictureParameterBufferHEVC *picture_params =
-		&driver_data->params.h265.picture;
+	const void *sources[] = {
+		[H265_FIELD_PICTURE] = &driver_data->params.h265.picture,
+		[H265_FIELD_SLICE] = &driver_data->params.h265.slice,
+	};
 
 	print_indent(indent++, ".sps = {\n");
-	print_indent(indent, ".chroma_format_idc = %d,\n",
-		     picture_params->pic_fields.bits.chroma_format_idc);
-	print_indent(indent, ".separate_colour_plane_flag = %d,\n",
-		     picture_params->pic_fields.bits.separate_colour_plane_flag);
-	print_indent(indent, ".pic_width_in_luma_samples = %d,\n",
-		     picture_params->pic_width_in_luma_samples);
-	print_indent(indent, ".pic_height_in_luma_samples = %d,\n",
-		     picture_params->pic_height_in_luma_samples);
-	print_indent(indent, ".bit_depth_luma_minus8 = %d,\n",
-		     picture_params->bit_depth_luma_minus8);
-	print_indent(indent, ".bit_depth_chroma_minus8 = %d,\n",
-		     picture_params->bit_depth_chroma_minus8);
-	print_indent(indent, ".log2_max_pic_order_cnt_lsb_minus4 = %d,\n",
-		     picture_params->log2_max_pic_order_cnt_lsb_minus4);
-	print_indent(indent, ".sps_max_dec_pic_buffering_minus1 = %d,\n",
-		     picture_params->sps_max_dec_pic_buffering_minus1);
-	print_indent(indent, ".sps_max_num_reorder_pics = %d,\n", 0);
-	print_indent(indent, ".sps_max_latency_increase_plus1 = %d,\n", 0);
-	print_indent(indent, ".log2_min_luma_coding_block_size_minus3 = %d,\n",
-		     picture_params->log2_min_luma_coding_block_size_minus3);
-	print_indent(indent, ".log2_diff_max_min_luma_coding_block_size = %d,\n",
-		     picture_params->log2_diff_max_min_luma_coding_block_size);
-	print_indent(indent, ".log2_min_luma_transform_block_size_minus2 = %d,\n",
-		     picture_params->log2_min_transform_block_size_minus2);
-	print_indent(indent, ".log2_diff_max_min_luma_transform_block_size = %d,\n",
-		     picture_params->log2_diff_max_min_transform_block_size);
-	print_indent(indent, ".max_transform_hierarchy_depth_inter = %d,\n",
-		     picture_params->max_transform_hierarchy_depth_inter);
-	print_indent(indent, ".max_transform_hierarchy_depth_intra = %d,\n",
-		     picture_params->max_transform_hierarchy_depth_intra);
-	print_indent(indent, ".scaling_list_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.scaling_list_enabled_flag);
-	print_indent(indent, ".amp_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.amp_enabled_flag);
-	print_indent(indent, ".sample_adaptive_offset_enabled_flag = %d,\n",
-		     picture_params->slice_parsing_fields.bits.sample_adaptive_offset_enabled_flag);
-	print_indent(indent, ".pcm_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.pcm_enabled_flag);
-	print_indent(indent, ".pcm_sample_bit_depth_luma_minus1 = %d,\n",
-		     picture_params->pcm_sample_bit_depth_luma_minus1);
-	print_indent(indent, ".pcm_sample_bit_depth_chroma_minus1 = %d,\n",
-		     picture_params->pcm_sample_bit_depth_chroma_minus1);
-	print_indent(indent, ".log2_min_pcm_luma_coding_block_size_minus3 = %d,\n",
-		     picture_params->log2_min_pcm_luma_coding_block_size_minus3);
-	print_indent(indent, ".log2_diff_max_min_pcm_luma_coding_block_size = %d,\n",
-		     picture_params->log2_diff_max_min_pcm_luma_coding_block_size);
-	print_indent(indent, ".pcm_loop_filter_disabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.pcm_loop_filter_disabled_flag);
-	print_indent(indent, ".num_short_term_ref_pic_sets = %d,\n",
-		     picture_params->num_short_term_ref_pic_sets);
-	print_indent(indent, ".long_term_ref_pics_present_flag = %d,\n",
-		     picture_params->slice_parsing_fields.bits.long_term_ref_pics_present_flag);
-	print_indent(indent, ".num_long_term_ref_pics_sps = %d,\n",
-		     picture_params->num_long_term_ref_pic_sps);
-	print_indent(indent, ".sps_temporal_mvp_enabled_flag = %d,\n",
-		     picture_params->slice_parsing_fields.bits.sps_temporal_mvp_enabled_flag);
-	print_indent(indent, ".strong_intra_smoothing_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.strong_intra_smoothing_enabled_flag);
+	field_print(&h265_sps_table, sources, indent);
+	field_columnar(&h265_sps_table, sources, &driver_data->output.columnar);
 	print_indent(--indent, "},\n");
 }
 
 static void h265_dump_pps(struct dump_driver_data *driver_data,
 			  unsigned int indent)
+{
+	const void *sources[] = {
+		[H265_FIELD_PICTURE] = &driver_data->params.h265.picture,
+		[H265_FIELD_SLICE] = &driver_data->params.h265.slice,
+	};
+
+	print_indent(indent++, ".pps = {\n");
+	field_print(&h265_pps_table, sources, indent);
+	field_columnar(&h265_pps_table, sources, &driver_data->output.columnar);
+	print_indent(--indent, "},\n");
+}
+
+static void h265_parse_pred_weight_table(struct dump_driver_data *driver_data,
+					 struct bitstream *bitstream,
+					 unsigned int chroma_array_type,
+					 unsigned int slice_type,
+					 unsigned int num_ref_idx_l0,
+					 unsigned int num_ref_idx_l1)
 {
 	VAPictureParameterBufferHEVC *picture_params =
 		&driver_data->params.h265.picture;
 	VASliceParameterBufferHEVC *slice_params =
 		&driver_data->params.h265.slice;
+	bool luma_weight_flags[H265_REF_NUM_MAX];
+	bool chroma_weight_flags[H265_REF_NUM_MAX];
+	unsigned int count;
+	unsigned int index;
+	unsigned int i, j;
 
-	print_indent(indent++, ".pps = {\n");
-	print_indent(indent, ".dependent_slice_segment_flag = %d,\n",
-		     slice_params->LongSliceFlags.fields.dependent_slice_segment_flag);
-	print_indent(indent, ".output_flag_present_flag = %d,\n",
-		     picture_params->slice_parsing_fields.bits.output_flag_present_flag);
-	print_indent(indent, ".num_extra_slice_header_bits = %d,\n",
-		     picture_params->num_extra_slice_header_bits);
-	print_indent(indent, ".sign_data_hiding_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.sign_data_hiding_enabled_flag);
-	print_indent(indent, ".cabac_init_present_flag = %d,\n",
-		     picture_params->slice_parsing_fields.bits.cabac_init_present_flag);
-	print_indent(indent, ".init_qp_minus26 = %d,\n",
-		     picture_params->init_qp_minus26);
-	print_indent(indent, ".constrained_intra_pred_flag = %d,\n",
-		     picture_params->pic_fields.bits.constrained_intra_pred_flag);
-	print_indent(indent, ".transform_skip_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.transform_skip_enabled_flag);
-	print_indent(indent, ".cu_qp_delta_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.cu_qp_delta_enabled_flag);
-	print_indent(indent, ".diff_cu_qp_delta_depth = %d,\n",
-		     picture_params->diff_cu_qp_delta_depth);
-	print_indent(indent, ".pps_cb_qp_offset = %d,\n",
-		     picture_params->pps_cb_qp_offset);
-	print_indent(indent, ".pps_cr_qp_offset = %d,\n",
-		     picture_params->pps_cr_qp_offset);
-	print_indent(indent, ".pps_slice_chroma_qp_offsets_present_flag = %d,\n",
-		     picture_params->slice_parsing_fields.bits.pps_slice_chroma_qp_offsets_present_flag);
-	print_indent(indent, ".weighted_pred_flag = %d,\n",
-		     picture_params->pic_fields.bits.weighted_pred_flag);
-	print_indent(indent, ".weighted_bipred_flag = %d,\n",
-		     picture_params->pic_fields.bits.weighted_bipred_flag);
-	print_indent(indent, ".transquant_bypass_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.transquant_bypass_enabled_flag);
-	print_indent(indent, ".tiles_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.tiles_enabled_flag);
-	print_indent(indent, ".entropy_coding_sync_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.entropy_coding_sync_enabled_flag);
-	print_indent(indent, ".num_tile_columns_minus1 = %d,\n",
-		     picture_params->num_tile_columns_minus1);
-	print_indent(indent, ".num_tile_rows_minus1 = %d,\n",
-		     picture_params->num_tile_rows_minus1);
-
-	/* TODO: column_width_minus1, row_height_minus1 */
-
-	print_indent(indent, ".loop_filter_across_tiles_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.loop_filter_across_tiles_enabled_flag);
-	print_indent(indent, ".pps_loop_filter_across_slices_enabled_flag = %d,\n",
-		     picture_params->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag);
-	print_indent(indent, ".deblocking_filter_override_enabled_flag = %d,\n",
-		     picture_params->slice_parsing_fields.bits.deblocking_filter_override_enabled_flag);
-	print_indent(indent, ".pps_disable_deblocking_filter_flag = %d,\n",
-		     picture_params->slice_parsing_fields.bits.pps_disable_deblocking_filter_flag);
-	print_indent(indent, ".pps_beta_offset_div2 = %d,\n",
-		     picture_params->pps_beta_offset_div2);
-	print_indent(indent, ".pps_tc_offset_div2 = %d,\n",
-		     picture_params->pps_tc_offset_div2);
-	print_indent(indent, ".lists_modification_present_flag = %d,\n",
-		     picture_params->slice_parsing_fields.bits.lists_modification_present_flag);
-	print_indent(indent, ".log2_parallel_merge_level_minus2 = %d,\n",
-		     picture_params->log2_parallel_merge_level_minus2);
-	print_indent(--indent, "},\n");
+	bitstream_read_ue(bitstream);
+
+	if (chroma_array_type != 0)
+		bitstream_read_se(bitstream);
+
+	for (j = 0; j < 2; j++) {
+		count = j ? num_ref_idx_l1 : num_ref_idx_l0;
+		if (count > 15)
+			count = 15;
+
+		if (j == 1 && slice_type != H265_SLICE_B)
+			break;
+
+		/* Weights are only signaled for references with another POC. */
+		for (i = 0; i < count; i++) {
+			index = slice_params->RefPicList[j][i];
+			luma_weight_flags[i] = index >= 15 ||
+				picture_params->ReferenceFrames[index].pic_order_cnt !=
+				picture_params->CurrPic.pic_order_cnt;
+
+			if (luma_weight_flags[i])
+				luma_weight_flags[i] = bitstream_read_flag(bitstream);
+		}
+
+		for (i = 0; i < count; i++) {
+			index = slice_params->RefPicList[j][i];
+			chroma_weight_flags[i] = chroma_array_type != 0 &&
+				(index >= 15 ||
+				 picture_params->ReferenceFrames[index].pic_order_cnt !=
+				 picture_params->CurrPic.pic_order_cnt);
+
+			if (chroma_weight_flags[i])
+				chroma_weight_flags[i] = bitstream_read_flag(bitstream);
+		}
+
+		for (i = 0; i < count; i++) {
+			if (luma_weight_flags[i]) {
+				bitstream_read_se(bitstream);
+				bitstream_read_se(bitstream);
+			}
+
+			if (chroma_weight_flags[i]) {
+				bitstream_read_se(bitstream);
+				bitstream_read_se(bitstream);
+				bitstream_read_se(bitstream);
+				bitstream_read_se(bitstream);
+			}
+		}
+	}
+}
+
+/* Slice segment header values that VAAPI does not provide. */
+struct h265_slice_header {
+	unsigned int header_bit_size;
+	unsigned int data_byte_offset;
+	bool no_output_of_prior_pics;
+	bool dependent_slice_segment;
+	unsigned int short_term_ref_pic_set_size;
+	unsigned int long_term_ref_pic_set_size;
+	unsigned int num_entry_point_offsets;
+	uint32_t entry_point_offset_minus1[H265_ENTRY_POINT_OFFSETS_MAX];
+};
+
+/*
+ * Parse the slice segment header up to byte_alignment() to find its exact size
+ * in bits, counted from the start of the NAL unit in the slice data, either
+ * escaped or already stripped of its emulation prevention bytes in RBSP mode.
+ */
+static int h265_parse_slice_header(struct dump_driver_data *driver_data,
+				   uint8_t *data, unsigned int size, bool rbsp,
+				   struct h265_slice_header *header)
+{
+	VAPictureParameterBufferHEVC *picture_params =
+		&driver_data->params.h265.picture;
+	struct bitstream bitstream;
+	unsigned int nal_unit_type;
+	unsigned int chroma_array_type;
+	unsigned int log2_min_cb_size;
+	unsigned int log2_ctb_size;
+	unsigned int ctb_size;
+	unsigned int pic_size_in_ctbs;
+	unsigned int num_pic_total_curr;
+	unsigned int num_ref_idx_l0;
+	unsigned int num_ref_idx_l1;
+	unsigned int num_long_term;
+	unsigned int num_entry_point_offsets;
+	unsigned int offset_len;
+	unsigned int slice_type;
+	unsigned int position;
+	unsigned int value;
+	unsigned int count;
+	unsigned int i;
+	bool dependent_slice_segment_flag = false;
+	bool slice_temporal_mvp_enabled_flag = false;
+	bool slice_sao_luma_flag = false;
+	bool slice_sao_chroma_flag = false;
+	bool slice_deblocking_filter_disabled_flag;
+	bool collocated_from_l0_flag;
+
+	memset(header, 0, sizeof(*header));
+
+	if (size < 3)
+		return -1;
+
+	nal_unit_type = (data[0] >> H265_NAL_UNIT_TYPE_SHIFT) &
+			H265_NAL_UNIT_TYPE_MASK;
+
+	if (picture_params->pic_fields.bits.separate_colour_plane_flag)
+		chroma_array_type = 0;
+	else
+		chroma_array_type = picture_params->pic_fields.bits.chroma_format_idc;
+
+	log2_min_cb_size = picture_params->log2_min_luma_coding_block_size_minus3 + 3;
+	log2_ctb_size = log2_min_cb_size +
+			picture_params->log2_diff_max_min_luma_coding_block_size;
+	ctb_size = 1 << log2_ctb_size;
+	pic_size_in_ctbs =
+		((picture_params->pic_width_in_luma_samples + ctb_size - 1) >> log2_ctb_size) *
+		((picture_params->pic_height_in_luma_samples + ctb_size - 1) >> log2_ctb_size);
+
+	num_pic_total_curr = 0;
+
+	for (i = 0; i < 15; i++)
+		if (picture_params->ReferenceFrames[i].flags &
+		    (VA_PICTURE_HEVC_RPS_ST_CURR_BEFORE |
+		     VA_PICTURE_HEVC_RPS_ST_CURR_AFTER |
+		     VA_PICTURE_HEVC_RPS_LT_CURR))
+			num_pic_total_curr++;
+
+	if (rbsp)
+		bitstream_init_raw(&bitstream, data, size);
+	else
+		bitstream_init(&bitstream, data, size);
+	bitstream_skip(&bitstream, 16);
+
+	if (bitstream_read_flag(&bitstream)) {
+		if (nal_unit_type >= H265_NAL_BLA_W_LP &&
+		    nal_unit_type <= H265_NAL_RSV_IRAP_23)
+			header->no_output_of_prior_pics =
+				bitstream_read_flag(&bitstream);
+
+		bitstream_read_ue(&bitstream);
+	} else {
+		if (nal_unit_type >= H265_NAL_BLA_W_LP &&
+		    nal_unit_type <= H265_NAL_RSV_IRAP_23)
+			header->no_output_of_prior_pics =
+				bitstream_read_flag(&bitstream);
+
+		bitstream_read_ue(&bitstream);
+
+		if (picture_params->slice_parsing_fields.bits.dependent_slice_segments_enabled_flag)
+			dependent_slice_segment_flag = bitstream_read_flag(&bitstream);
+
+		bitstream_skip(&bitstream, bitstream_ceil_log2(pic_size_in_ctbs));
+	}
+
+	header->dependent_slice_segment = dependent_slice_segment_flag;
+
+	if (!dependent_slice_segment_flag) {
+		bitstream_skip(&bitstream,
+			       picture_params->num_extra_slice_header_bits);
+
+		slice_type = bitstream_read_ue(&bitstream);
+
+		if (picture_params->slice_parsing_fields.bits.output_flag_present_flag)
+			bitstream_skip(&bitstream, 1);
+
+		if (picture_params->pic_fields.bits.separate_colour_plane_flag)
+			bitstream_skip(&bitstream, 2);
+
+		if (nal_unit_type != H265_NAL_IDR_W_RADL &&
+		    nal_unit_type != H265_NAL_IDR_N_LP) {
+			bitstream_skip(&bitstream,
+				       picture_params->log2_max_pic_order_cnt_lsb_minus4 + 4);
+
+			/* The explicit RPS size is provided by VAAPI. */
+			if (!bitstream_read_flag(&bitstream)) {
+				bitstream_skip(&bitstream,
+					       picture_params->st_rps_bits);
+				header->short_term_ref_pic_set_size =
+					picture_params->st_rps_bits;
+			} else if (picture_params->num_short_term_ref_pic_sets > 1)
+				bitstream_skip(&bitstream,
+					       bitstream_ceil_log2(picture_params->num_short_term_ref_pic_sets));
+
+			position = bitstream_position(&bitstream);
+
+			if (picture_params->slice_parsing_fields.bits.long_term_ref_pics_present_flag) {
+				count = 0;
+
+				if (picture_params->num_long_term_ref_pic_sps > 0)
+					count = bitstream_read_ue(&bitstream);
+
+				num_long_term = count +
+						bitstream_read_ue(&bitstream);
+
+				for (i = 0; i < num_long_term; i++) {
+					if (i < count) {
+						if (picture_params->num_long_term_ref_pic_sps > 1)
+							bitstream_skip(&bitstream,
+								       bitstream_ceil_log2(picture_params->num_long_term_ref_pic_sps));
+					} else {
+						bitstream_skip(&bitstream,
+							       picture_params->log2_max_pic_order_cnt_lsb_minus4 + 4 + 1);
+					}
+
+					if (bitstream_read_flag(&bitstream))
+						bitstream_read_ue(&bitstream);
+
+					if (bitstream_error(&bitstream))
+						return -1;
+				}
+			}
+
+			header->long_term_ref_pic_set_size =
+				bitstream_position(&bitstream) - position;
+
+			if (picture_params->slice_parsing_fields.bits.sps_temporal_mvp_enabled_flag)
+				slice_temporal_mvp_enabled_flag =
+					bitstream_read_flag(&bitstream);
+		}
+
+		if (picture_params->slice_parsing_fields.bits.sample_adaptive_offset_enabled_flag) {
+			slice_sao_luma_flag = bitstream_read_flag(&bitstream);
+
+			if (chroma_array_type != 0)
+				slice_sao_chroma_flag =
+					bitstream_read_flag(&bitstream);
+		}
+
+		if (slice_type == H265_SLICE_P || slice_type == H265_SLICE_B) {
+			num_ref_idx_l0 = picture_params->num_ref_idx_l0_default_active_minus1 + 1;
+			num_ref_idx_l1 = picture_params->num_ref_idx_l1_default_active_minus1 + 1;
+
+			if (bitstream_read_flag(&bitstream)) {
+				num_ref_idx_l0 = bitstream_read_ue(&bitstream) + 1;
+
+				if (slice_type == H265_SLICE_B)
+					num_ref_idx_l1 = bitstream_read_ue(&bitstream) + 1;
+			}
+
+			if (slice_type != H265_SLICE_B)
+				num_ref_idx_l1 = 0;
+
+			if (picture_params->slice_parsing_fields.bits.lists_modification_present_flag &&
+			    num_pic_total_curr > 1) {
+				if (bitstream_read_flag(&bitstream))
+					bitstream_skip(&bitstream,
+						       num_ref_idx_l0 * bitstream_ceil_log2(num_pic_total_curr));
+
+				if (slice_type == H265_SLICE_B &&
+				    bitstream_read_flag(&bitstream))
+					bitstream_skip(&bitstream,
+						       num_ref_idx_l1 * bitstream_ceil_log2(num_pic_total_curr));
+			}
+
+			if (slice_type == H265_SLICE_B)
+				bitstream_skip(&bitstream, 1);
+
+			if (picture_params->slice_parsing_fields.bits.cabac_init_present_flag)
+				bitstream_skip(&bitstream, 1);
+
+			if (slice_temporal_mvp_enabled_flag) {
+				collocated_from_l0_flag = true;
+
+				if (slice_type == H265_SLICE_B)
+					collocated_from_l0_flag =
+						bitstream_read_flag(&bitstream);
+
+				if ((collocated_from_l0_flag && num_ref_idx_l0 > 1) ||
+				    (!collocated_from_l0_flag && num_ref_idx_l1 > 1))
+					bitstream_read_ue(&bitstream);
+			}
+
+			if ((picture_params->pic_fields.bits.weighted_pred_flag &&
+			     slice_type == H265_SLICE_P) ||
+			    (picture_params->pic_fields.bits.weighted_bipred_flag &&
+			     slice_type == H265_SLICE_B))
+				h265_parse_pred_weight_table(driver_data,
+							     &bitstream,
+							     chroma_array_type,
+							     slice_type,
+							     num_ref_idx_l0,
+							     num_ref_idx_l1);
+
+			bitstream_read_ue(&bitstream);
+		}
+
+		bitstream_read_se(&bitstream);
+
+		if (picture_params->slice_parsing_fields.bits.pps_slice_chroma_qp_offsets_present_flag) {
+			bitstream_read_se(&bitstream);
+			bitstream_read_se(&bitstream);
+		}
+
+		slice_deblocking_filter_disabled_flag =
+			picture_params->slice_parsing_fields.bits.pps_disable_deblocking_filter_flag;
+
+		if (picture_params->slice_parsing_fields.bits.deblocking_filter_override_enabled_flag &&
+		    bitstream_read_flag(&bitstream)) {
+			slice_deblocking_filter_disabled_flag =
+				bitstream_read_flag(&bitstream);
+
+			if (!slice_deblocking_filter_disabled_flag) {
+				bitstream_read_se(&bitstream);
+				bitstream_read_se(&bitstream);
+			}
+		}
+
+		if (picture_params->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag &&
+		    (slice_sao_luma_flag || slice_sao_chroma_flag ||
+		     !slice_deblocking_filter_disabled_flag))
+			bitstream_skip(&bitstream, 1);
+	}
+
+	if (picture_params->pic_fields.bits.tiles_enabled_flag ||
+	    picture_params->pic_fields.bits.entropy_coding_sync_enabled_flag) {
+		num_entry_point_offsets = bitstream_read_ue(&bitstream);
+		header->num_entry_point_offsets = num_entry_point_offsets;
+
+		if (num_entry_point_offsets > 0) {
+			offset_len = bitstream_read_ue(&bitstream) + 1;
+			if (offset_len > 32)
+				return -1;
+
+			for (i = 0; i < num_entry_point_offsets; i++) {
+				value = bitstream_read(&bitstream, offset_len);
+				if (i < H265_ENTRY_POINT_OFFSETS_MAX)
+					header->entry_point_offset_minus1[i] = value;
+
+				if (bitstream_error(&bitstream))
+					return -1;
+			}
+		}
+	}
+
+	if (picture_params->slice_parsing_fields.bits.slice_segment_header_extension_present_flag) {
+		count = bitstream_read_ue(&bitstream);
+		bitstream_skip(&bitstream, count * 8);
+	}
+
+	if (bitstream_error(&bitstream))
+		return -1;
+
+	header->header_bit_size = bitstream_raw_position(&bitstream);
+
+	/* Slice data starts after the one bit and the zero bits that align it. */
+	header->data_byte_offset = (header->header_bit_size + 8) / 8;
+
+	return 0;
+}
+
+/* Extract the NAL header information that VAAPI does not provide. */
+static void h265_nal_header(struct dump_driver_data *driver_data,
+			    struct object_surface *surface,
+			    VASliceParameterBufferHEVC *slice_params,
+			    unsigned int offset, uint8_t *nal_unit_type,
+			    uint8_t *nuh_temporal_id_plus1)
+{
+	struct nal_unit *unit;
+	uint8_t *b;
+
+	offset += slice_params->slice_data_offset;
+
+	b = (uint8_t *)surface->slice_data + offset;
+
+	unit = nal_index_lookup(&driver_data->nal_index, offset);
+	if (unit != NULL) {
+		*nal_unit_type = unit->type;
+		*nuh_temporal_id_plus1 = unit->temporal_id + 1;
+	} else {
+		*nal_unit_type = (b[0] >> H265_NAL_UNIT_TYPE_SHIFT) &
+				 H265_NAL_UNIT_TYPE_MASK;
+		*nuh_temporal_id_plus1 = (b[1] >> H265_NUH_TEMPORAL_ID_PLUS1_SHIFT) &
+					 H265_NUH_TEMPORAL_ID_PLUS1_MASK;
+	}
+}
+
+/*
+ * VAAPI only provides a byte-aligned value for the slice segment data offset,
+ * although the slice segment header is not always aligned. Parse the header to
+ * find the one bit that marks its end.
+ */
+static uint32_t h265_slice_bit_offset(struct dump_driver_data *driver_data,
+				      struct object_surface *surface,
+				      VASliceParameterBufferHEVC *slice_params,
+				      unsigned int offset,
+				      struct h265_slice_header *header,
+				      unsigned int *size)
+{
+	uint8_t *slice_data;
+	uint8_t *b;
+	unsigned int o;
+	int rc;
+
+	slice_data = (uint8_t *)surface->slice_data + offset;
+
+	b = slice_data + slice_params->slice_data_offset;
+
+	*size = slice_dump_size(driver_data,
+				offset + slice_params->slice_data_offset,
+				slice_params->slice_data_size);
+
+	rc = h265_parse_slice_header(driver_data, b, *size,
+				     driver_data->slices_rbsp, header);
+	if (rc == 0)
+		return slice_params->slice_data_offset * 8 +
+		       header->header_bit_size;
+
+	/* The VAAPI offset counts emulation prevention bytes. */
+	if (driver_data->slices_rbsp) {
+		log_warning("Unable to parse slice segment header, data offset unknown\n");
+		return 0;
+	}
+
+	/*
+	 * Search for the first one bit in the previous byte instead, which
+	 * breaks when the header ends with trailing zero bits.
+	 */
+
+	b = slice_data + (slice_params->slice_data_offset +
+			  slice_params->slice_data_byte_offset) - 1;
+
+	for (o = 0; o < 8; o++)
+		if (*b & (1 << o))
+			break;
+
+	/* Include the one bit. */
+	o++;
+
+	return (slice_params->slice_data_offset +
+		slice_params->slice_data_byte_offset) * 8 - o;
 }
 
 static void h265_dump_slice_params(struct dump_driver_data *driver_data,
-				   unsigned int indent, void *slice_data,
-				   unsigned int sice_size)
+				   unsigned int indent,
+				   struct object_surface *surface)
 {
 	VAPictureParameterBufferHEVC *picture_params =
 		&driver_data->params.h265.picture;
 	VASliceParameterBufferHEVC *slice_params =
 		&driver_data->params.h265.slice;
+	const void *sources[] = {
+		[H265_FIELD_PICTURE] = picture_params,
+		[H265_FIELD_SLICE] = slice_params,
+	};
 	VAPictureHEVC *picture;
 	struct object_surface *surface_object;
 	uint8_t nal_unit_type;
@@ -190,7 +662,6 @@ static void h265_dump_slice_params(struct dump_driver_data *driver_data,
 	uint8_t field_pic;
 	uint8_t slice_type;
 	char *slice_type_string;
-	uint8_t *b;
 	uint8_t uarray[H265_REF_NUM_MAX];
 	int8_t sarray[H265_REF_NUM_MAX];
 	int8_t smatrix[H265_REF_NUM_MAX][2];
@@ -198,41 +669,22 @@ static void h265_dump_slice_params(struct dump_driver_data *driver_data,
 	unsigned int num_rps_poc_st_curr_before;
 	unsigned int num_rps_poc_st_curr_after;
 	unsigned int num_rps_poc_lt_curr;
+	struct h265_slice_header header;
+	unsigned int size;
 	unsigned int count;
-	unsigned int o, i, j;
-
-	/* Extract the missing NAL header information. */
-
-	b = slice_data + slice_params->slice_data_offset;
-
-	nal_unit_type = (b[0] >> H265_NAL_UNIT_TYPE_SHIFT) &
-			H265_NAL_UNIT_TYPE_MASK;
-	nuh_temporal_id_plus1 = (b[1] >> H265_NUH_TEMPORAL_ID_PLUS1_SHIFT) &
-				H265_NUH_TEMPORAL_ID_PLUS1_MASK;
-
-	/*
-	 * VAAPI only provides a byte-aligned value for the slice segment data
-	 * offset, although it appears that the offset is not always aligned.
-	 * Search for the first one bit in the previous byte, that marks the
-	 * start of the slice segment to correct the value.
-	 */
+	unsigned int i, j;
 
-	b = slice_data + (slice_params->slice_data_offset +
-			  slice_params->slice_data_byte_offset) - 1;
-
-	for (o = 0; o < 8; o++)
-		if (*b & (1 << o))
-			break;
-
-	/* Include the one bit. */
-	o++;
+	h265_nal_header(driver_data, surface, slice_params,
+			surface->slice_offset, &nal_unit_type,
+			&nuh_temporal_id_plus1);
 
-	data_bit_offset = (slice_params->slice_data_offset +
-			   slice_params->slice_data_byte_offset) * 8 - o;
+	data_bit_offset = h265_slice_bit_offset(driver_data, surface,
+						slice_params,
+						surface->slice_offset,
+						&header, &size);
 
 	print_indent(indent++, ".slice_params = {\n");
-	print_indent(indent, ".bit_size = %d,\n",
-		     slice_params->slice_data_size * 8);
+	print_indent(indent, ".bit_size = %d,\n", size * 8);
 	print_indent(indent, ".data_bit_offset = %d,\n", data_bit_offset);
 
 	print_indent(indent, ".nal_unit_type = %d,\n", nal_unit_type);
@@ -257,48 +709,21 @@ static void h265_dump_slice_params(struct dump_driver_data *driver_data,
 	}
 
 	print_indent(indent, ".slice_type = %s,\n", slice_type_string);
-	print_indent(indent, ".colour_plane_id = %d,\n",
-		     slice_params->LongSliceFlags.fields.color_plane_id);
-	print_indent(indent, ".slice_pic_order_cnt = %d,\n",
-		     picture_params->CurrPic.pic_order_cnt);
-	print_indent(indent, ".slice_sao_luma_flag = %d,\n",
-		     slice_params->LongSliceFlags.fields.slice_sao_luma_flag);
-	print_indent(indent, ".slice_sao_chroma_flag = %d,\n",
-		     slice_params->LongSliceFlags.fields.slice_sao_chroma_flag);
-	print_indent(indent, ".slice_temporal_mvp_enabled_flag = %d,\n",
-		     slice_params->LongSliceFlags.fields.slice_temporal_mvp_enabled_flag);
-	print_indent(indent, ".num_ref_idx_l0_active_minus1 = %d,\n",
-		     slice_params->num_ref_idx_l0_active_minus1);
-	print_indent(indent, ".num_ref_idx_l1_active_minus1 = %d,\n",
-		     slice_params->num_ref_idx_l1_active_minus1);
-	print_indent(indent, ".mvd_l1_zero_flag = %d,\n",
-		     slice_params->LongSliceFlags.fields.mvd_l1_zero_flag);
-	print_indent(indent, ".cabac_init_flag = %d,\n",
-		     slice_params->LongSliceFlags.fields.cabac_init_flag);
-	print_indent(indent, ".collocated_from_l0_flag = %d,\n",
-		     slice_params->LongSliceFlags.fields.collocated_from_l0_flag);
-	print_indent(indent, ".collocated_ref_idx = %d,\n",
-		     slice_params->collocated_ref_idx);
-	print_indent(indent, ".five_minus_max_num_merge_cand = %d,\n",
-		     slice_params->five_minus_max_num_merge_cand);
-	print_indent(indent, ".use_integer_mv_flag = %d,\n", 0);
-	print_indent(indent, ".slice_qp_delta = %d,\n",
-		     slice_params->slice_qp_delta);
-	print_indent(indent, ".slice_cb_qp_offset = %d,\n",
-		     slice_params->slice_cb_qp_offset);
-	print_indent(indent, ".slice_cr_qp_offset = %d,\n",
-		     slice_params->slice_cr_qp_offset);
-	print_indent(indent, ".slice_act_y_qp_offset = %d,\n", 0);
-	print_indent(indent, ".slice_act_cb_qp_offset = %d,\n", 0);
-	print_indent(indent, ".slice_act_cr_qp_offset = %d,\n", 0);
-	print_indent(indent, ".slice_deblocking_filter_disabled_flag = %d,\n",
-		     slice_params->LongSliceFlags.fields.slice_deblocking_filter_disabled_flag);
-	print_indent(indent, ".slice_beta_offset_div2 = %d,\n",
-		     slice_params->slice_beta_offset_div2);
-	print_indent(indent, ".slice_tc_offset_div2 = %d,\n",
-		     slice_params->slice_tc_offset_div2);
-	print_indent(indent, ".slice_loop_filter_across_slices_enabled_flag = %d,\n",
-		     slice_params->LongSliceFlags.fields.slice_loop_filter_across_slices_enabled_flag);
+	field_print(&h265_slice_table, sources, indent);
+
+	print_indent(indent, ".num_entry_point_offsets = %u,\n",
+		     header.num_entry_point_offsets);
+
+	count = header.num_entry_point_offsets;
+	if (count > H265_ENTRY_POINT_OFFSETS_MAX)
+		count = H265_ENTRY_POINT_OFFSETS_MAX;
+
+	if (count > 0) {
+		print_indent(indent, ".entry_point_offset_minus1 = {");
+		for (i = 0; i < count; i++)
+			print_indent(0, " %u,", header.entry_point_offset_minus1[i]);
+		print_indent(0, " },\n");
+	}
 
 	if (picture_params->CurrPic.flags & VA_PICTURE_HEVC_FIELD_PIC) {
 		if (picture_params->CurrPic.flags &
@@ -511,13 +936,624 @@ static void h265_dump_slice_params(struct dump_driver_data *driver_data,
 	print_indent(--indent, "},\n");
 }
 
+/* Export the fields of every slice of the picture, with one row each. */
+static void h265_columnar_slices(struct dump_driver_data *driver_data,
+				 struct object_surface *surface)
+{
+	struct columnar *columnar = &driver_data->output.columnar_slices;
+	VASliceParameterBufferHEVC *slice_params;
+	const void *sources[] = {
+		[H265_FIELD_PICTURE] = &driver_data->params.h265.picture,
+		[H265_FIELD_SLICE] = NULL,
+	};
+	struct h265_slice_header header;
+	struct dump_slice *slice;
+	uint8_t nal_unit_type;
+	uint8_t nuh_temporal_id_plus1;
+	uint32_t data_bit_offset;
+	unsigned int size;
+	unsigned int i;
+
+	if (columnar->group_rows == 0)
+		return;
+
+	for (i = 0; i < driver_data->slices_count; i++) {
+		slice = &driver_data->slices[i];
+		slice_params = &slice->params.h265;
+		sources[H265_FIELD_SLICE] = slice_params;
+
+		h265_nal_header(driver_data, surface, slice_params,
+				slice->offset, &nal_unit_type,
+				&nuh_temporal_id_plus1);
+
+		data_bit_offset = h265_slice_bit_offset(driver_data, surface,
+							slice_params,
+							slice->offset, &header,
+							&size);
+
+		columnar_row_begin(columnar);
+		columnar_int(columnar, "index", driver_data->frame_index);
+		columnar_int(columnar, "slice", i);
+		columnar_int(columnar, "slice.h265.bit_size", size * 8);
+		columnar_int(columnar, "slice.h265.data_bit_offset",
+			     data_bit_offset);
+		columnar_int(columnar, "slice.h265.nal_unit_type",
+			     nal_unit_type);
+		columnar_int(columnar, "slice.h265.slice_type",
+			     slice_params->LongSliceFlags.fields.slice_type);
+		field_columnar(&h265_slice_table, sources, columnar);
+		columnar_row_end(columnar);
+	}
+}
+
+#ifdef HAVE_V4L2_STATELESS
+
+static void h265_controls_sps(struct dump_driver_data *driver_data,
+			      struct v4l2_ctrl_hevc_sps *sps)
+{
+	VAPictureParameterBufferHEVC *picture_params =
+		&driver_data->params.h265.picture;
+
+	sps->pic_width_in_luma_samples = picture_params->pic_width_in_luma_samples;
+	sps->pic_height_in_luma_samples = picture_params->pic_height_in_luma_samples;
+	sps->bit_depth_luma_minus8 = picture_params->bit_depth_luma_minus8;
+	sps->bit_depth_chroma_minus8 = picture_params->bit_depth_chroma_minus8;
+	sps->log2_max_pic_order_cnt_lsb_minus4 = picture_params->log2_max_pic_order_cnt_lsb_minus4;
+	sps->sps_max_dec_pic_buffering_minus1 = picture_params->sps_max_dec_pic_buffering_minus1;
+	sps->log2_min_luma_coding_block_size_minus3 = picture_params->log2_min_luma_coding_block_size_minus3;
+	sps->log2_diff_max_min_luma_coding_block_size = picture_params->log2_diff_max_min_luma_coding_block_size;
+	sps->log2_min_luma_transform_block_size_minus2 = picture_params->log2_min_transform_block_size_minus2;
+	sps->log2_diff_max_min_luma_transform_block_size = picture_params->log2_diff_max_min_transform_block_size;
+	sps->max_transform_hierarchy_depth_inter = picture_params->max_transform_hierarchy_depth_inter;
+	sps->max_transform_hierarchy_depth_intra = picture_params->max_transform_hierarchy_depth_intra;
+	sps->pcm_sample_bit_depth_luma_minus1 = picture_params->pcm_sample_bit_depth_luma_minus1;
+	sps->pcm_sample_bit_depth_chroma_minus1 = picture_params->pcm_sample_bit_depth_chroma_minus1;
+	sps->log2_min_pcm_luma_coding_block_size_minus3 = picture_params->log2_min_pcm_luma_coding_block_size_minus3;
+	sps->log2_diff_max_min_pcm_luma_coding_block_size = picture_params->log2_diff_max_min_pcm_luma_coding_block_size;
+	sps->num_short_term_ref_pic_sets = picture_params->num_short_term_ref_pic_sets;
+	sps->num_long_term_ref_pics_sps = picture_params->num_long_term_ref_pic_sps;
+	sps->chroma_format_idc = picture_params->pic_fields.bits.chroma_format_idc;
+
+	if (picture_params->pic_fields.bits.separate_colour_plane_flag)
+		sps->flags |= V4L2_HEVC_SPS_FLAG_SEPARATE_COLOUR_PLANE;
+	if (picture_params->pic_fields.bits.scaling_list_enabled_flag)
+		sps->flags |= V4L2_HEVC_SPS_FLAG_SCALING_LIST_ENABLED;
+	if (picture_params->pic_fields.bits.amp_enabled_flag)
+		sps->flags |= V4L2_HEVC_SPS_FLAG_AMP_ENABLED;
+	if (picture_params->slice_parsing_fields.bits.sample_adaptive_offset_enabled_flag)
+		sps->flags |= V4L2_HEVC_SPS_FLAG_SAMPLE_ADAPTIVE_OFFSET;
+	if (picture_params->pic_fields.bits.pcm_enabled_flag)
+		sps->flags |= V4L2_HEVC_SPS_FLAG_PCM_ENABLED;
+	if (picture_params->pic_fields.bits.pcm_loop_filter_disabled_flag)
+		sps->flags |= V4L2_HEVC_SPS_FLAG_PCM_LOOP_FILTER_DISABLED;
+	if (picture_params->slice_parsing_fields.bits.long_term_ref_pics_present_flag)
+		sps->flags |= V4L2_HEVC_SPS_FLAG_LONG_TERM_REF_PICS_PRESENT;
+	if (picture_params->slice_parsing_fields.bits.sps_temporal_mvp_enabled_flag)
+		sps->flags |= V4L2_HEVC_SPS_FLAG_SPS_TEMPORAL_MVP_ENABLED;
+	if (picture_params->pic_fields.bits.strong_intra_smoothing_enabled_flag)
+		sps->flags |= V4L2_HEVC_SPS_FLAG_STRONG_INTRA_SMOOTHING_ENABLED;
+}
+
+static void h265_controls_pps(struct dump_driver_data *driver_data,
+			      struct v4l2_ctrl_hevc_pps *pps)
+{
+	VAPictureParameterBufferHEVC *picture_params =
+		&driver_data->params.h265.picture;
+	unsigned int log2_ctb_size;
+	unsigned int ctb_size;
+	unsigned int remaining;
+	unsigned int count;
+	unsigned int i;
+
+	pps->num_extra_slice_header_bits = picture_params->num_extra_slice_header_bits;
+	pps->num_ref_idx_l0_default_active_minus1 = picture_params->num_ref_idx_l0_default_active_minus1;
+	pps->num_ref_idx_l1_default_active_minus1 = picture_params->num_ref_idx_l1_default_active_minus1;
+	pps->init_qp_minus26 = picture_params->init_qp_minus26;
+	pps->diff_cu_qp_delta_depth = picture_params->diff_cu_qp_delta_depth;
+	pps->pps_cb_qp_offset = picture_params->pps_cb_qp_offset;
+	pps->pps_cr_qp_offset = picture_params->pps_cr_qp_offset;
+	pps->pps_beta_offset_div2 = picture_params->pps_beta_offset_div2;
+	pps->pps_tc_offset_div2 = picture_params->pps_tc_offset_div2;
+	pps->log2_parallel_merge_level_minus2 = picture_params->log2_parallel_merge_level_minus2;
+
+	if (picture_params->pic_fields.bits.tiles_enabled_flag) {
+		log2_ctb_size = picture_params->log2_min_luma_coding_block_size_minus3 + 3 +
+				picture_params->log2_diff_max_min_luma_coding_block_size;
+		ctb_size = 1 << log2_ctb_size;
+
+		pps->num_tile_columns_minus1 = picture_params->num_tile_columns_minus1;
+		pps->num_tile_rows_minus1 = picture_params->num_tile_rows_minus1;
+
+		/* The size of the last tile is inferred rather than coded. */
+		count = pps->num_tile_columns_minus1;
+		if (count > 19)
+			count = 19;
+
+		remaining = (picture_params->pic_width_in_luma_samples + ctb_size - 1) >> log2_ctb_size;
+
+		for (i = 0; i < count; i++) {
+			pps->column_width_minus1[i] = picture_params->column_width_minus1[i];
+			remaining -= picture_params->column_width_minus1[i] + 1;
+		}
+
+		pps->column_width_minus1[i] = remaining - 1;
+
+		count = pps->num_tile_rows_minus1;
+		if (count > 21)
+			count = 21;
+
+		remaining = (picture_params->pic_height_in_luma_samples + ctb_size - 1) >> log2_ctb_size;
+
+		for (i = 0; i < count; i++) {
+			pps->row_height_minus1[i] = picture_params->row_height_minus1[i];
+			remaining -= picture_params->row_height_minus1[i] + 1;
+		}
+
+		pps->row_height_minus1[i] = remaining - 1;
+	}
+
+	if (picture_params->slice_parsing_fields.bits.dependent_slice_segments_enabled_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_DEPENDENT_SLICE_SEGMENT_ENABLED;
+	if (picture_params->slice_parsing_fields.bits.output_flag_present_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_OUTPUT_FLAG_PRESENT;
+	if (picture_params->pic_fields.bits.sign_data_hiding_enabled_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_SIGN_DATA_HIDING_ENABLED;
+	if (picture_params->slice_parsing_fields.bits.cabac_init_present_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_CABAC_INIT_PRESENT;
+	if (picture_params->pic_fields.bits.constrained_intra_pred_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_CONSTRAINED_INTRA_PRED;
+	if (picture_params->pic_fields.bits.transform_skip_enabled_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_TRANSFORM_SKIP_ENABLED;
+	if (picture_params->pic_fields.bits.cu_qp_delta_enabled_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_CU_QP_DELTA_ENABLED;
+	if (picture_params->slice_parsing_fields.bits.pps_slice_chroma_qp_offsets_present_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_PPS_SLICE_CHROMA_QP_OFFSETS_PRESENT;
+	if (picture_params->pic_fields.bits.weighted_pred_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_WEIGHTED_PRED;
+	if (picture_params->pic_fields.bits.weighted_bipred_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_WEIGHTED_BIPRED;
+	if (picture_params->pic_fields.bits.transquant_bypass_enabled_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_TRANSQUANT_BYPASS_ENABLED;
+	if (picture_params->pic_fields.bits.tiles_enabled_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_TILES_ENABLED;
+	if (picture_params->pic_fields.bits.entropy_coding_sync_enabled_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_ENTROPY_CODING_SYNC_ENABLED;
+	if (picture_params->pic_fields.bits.loop_filter_across_tiles_enabled_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_LOOP_FILTER_ACROSS_TILES_ENABLED;
+	if (picture_params->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_PPS_LOOP_FILTER_ACROSS_SLICES_ENABLED;
+	if (picture_params->slice_parsing_fields.bits.deblocking_filter_override_enabled_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_DEBLOCKING_FILTER_OVERRIDE_ENABLED;
+	if (picture_params->slice_parsing_fields.bits.pps_disable_deblocking_filter_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_PPS_DISABLE_DEBLOCKING_FILTER;
+	if (picture_params->slice_parsing_fields.bits.lists_modification_present_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_LISTS_MODIFICATION_PRESENT;
+	if (picture_params->slice_parsing_fields.bits.slice_segment_header_extension_present_flag)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_SLICE_SEGMENT_HEADER_EXTENSION_PRESENT;
+
+	/* The presence flag itself is not provided, infer it from its syntax. */
+	if (picture_params->slice_parsing_fields.bits.deblocking_filter_override_enabled_flag ||
+	    picture_params->slice_parsing_fields.bits.pps_disable_deblocking_filter_flag ||
+	    picture_params->pps_beta_offset_div2 != 0 ||
+	    picture_params->pps_tc_offset_div2 != 0)
+		pps->flags |= V4L2_HEVC_PPS_FLAG_DEBLOCKING_FILTER_CONTROL_PRESENT;
+}
+
+/*
+ * Fallback to the values provided by VAAPI if parsing fails, except in RBSP
+ * mode where they count emulation prevention bytes and are left unknown (zero).
+ */
+static unsigned int h265_slice_header(struct dump_driver_data *driver_data,
+				      struct object_surface *surface,
+				      VASliceParameterBufferHEVC *slice_params,
+				      unsigned int offset,
+				      struct h265_slice_header *header)
+{
+	unsigned int size;
+	uint8_t *data;
+	int rc;
+
+	offset += slice_params->slice_data_offset;
+
+	data = (uint8_t *)surface->slice_data + offset;
+	size = slice_dump_size(driver_data, offset,
+			       slice_params->slice_data_size);
+
+	rc = h265_parse_slice_header(driver_data, data, size,
+				     driver_data->slices_rbsp, header);
+	if (rc < 0 && !driver_data->slices_rbsp)
+		header->data_byte_offset = slice_params->slice_data_byte_offset;
+
+	return size;
+}
+
+static void h265_controls_slice_params(struct dump_driver_data *driver_data,
+				       struct object_surface *surface,
+				       VASliceParameterBufferHEVC *slice_params,
+				       unsigned int offset,
+				       struct h265_slice_header *header,
+				       unsigned int size,
+				       struct v4l2_ctrl_hevc_slice_params *slice)
+{
+	VAPictureParameterBufferHEVC *picture_params =
+		&driver_data->params.h265.picture;
+	struct v4l2_hevc_pred_weight_table *weights = &slice->pred_weight_table;
+	unsigned int i, j;
+
+	slice->bit_size = size * 8;
+	slice->data_byte_offset = header->data_byte_offset;
+	slice->num_entry_point_offsets = header->num_entry_point_offsets;
+
+	h265_nal_header(driver_data, surface, slice_params, offset,
+			&slice->nal_unit_type, &slice->nuh_temporal_id_plus1);
+
+	slice->slice_type = slice_params->LongSliceFlags.fields.slice_type;
+	slice->colour_plane_id = slice_params->LongSliceFlags.fields.color_plane_id;
+	slice->slice_pic_order_cnt = picture_params->CurrPic.pic_order_cnt;
+	slice->num_ref_idx_l0_active_minus1 = slice_params->num_ref_idx_l0_active_minus1;
+	slice->num_ref_idx_l1_active_minus1 = slice_params->num_ref_idx_l1_active_minus1;
+	slice->collocated_ref_idx = slice_params->collocated_ref_idx;
+	slice->five_minus_max_num_merge_cand = slice_params->five_minus_max_num_merge_cand;
+	slice->slice_qp_delta = slice_params->slice_qp_delta;
+	slice->slice_cb_qp_offset = slice_params->slice_cb_qp_offset;
+	slice->slice_cr_qp_offset = slice_params->slice_cr_qp_offset;
+	slice->slice_beta_offset_div2 = slice_params->slice_beta_offset_div2;
+	slice->slice_tc_offset_div2 = slice_params->slice_tc_offset_div2;
+	slice->slice_segment_addr = slice_params->slice_segment_address;
+	slice->short_term_ref_pic_set_size = header->short_term_ref_pic_set_size;
+	slice->long_term_ref_pic_set_size = header->long_term_ref_pic_set_size;
+
+	if (picture_params->CurrPic.flags & VA_PICTURE_HEVC_FIELD_PIC)
+		slice->pic_struct = picture_params->CurrPic.flags &
+				    VA_PICTURE_HEVC_BOTTOM_FIELD ?
+				    V4L2_HEVC_SEI_PIC_STRUCT_BOTTOM_FIELD :
+				    V4L2_HEVC_SEI_PIC_STRUCT_TOP_FIELD;
+
+	for (i = 0; i < V4L2_HEVC_DPB_ENTRIES_NUM_MAX; i++) {
+		slice->ref_idx_l0[i] = H265_REF_INVALID;
+		slice->ref_idx_l1[i] = H265_REF_INVALID;
+	}
+
+	if (slice->slice_type != H265_SLICE_I)
+		for (i = 0; i <= slice_params->num_ref_idx_l0_active_minus1 && i < 15; i++)
+			slice->ref_idx_l0[i] = slice_params->RefPicList[0][i];
+
+	if (slice->slice_type == H265_SLICE_B)
+		for (i = 0; i <= slice_params->num_ref_idx_l1_active_minus1 && i < 15; i++)
+			slice->ref_idx_l1[i] = slice_params->RefPicList[1][i];
+
+	weights->luma_log2_weight_denom = slice_params->luma_log2_weight_denom;
+	weights->delta_chroma_log2_weight_denom = slice_params->delta_chroma_log2_weight_denom;
+
+	for (i = 0; i < 15; i++) {
+		weights->delta_luma_weight_l0[i] = slice_params->delta_luma_weight_l0[i];
+		weights->luma_offset_l0[i] = slice_params->luma_offset_l0[i];
+		weights->delta_luma_weight_l1[i] = slice_params->delta_luma_weight_l1[i];
+		weights->luma_offset_l1[i] = slice_params->luma_offset_l1[i];
+
+		for (j = 0; j < 2; j++) {
+			weights->delta_chroma_weight_l0[i][j] = slice_params->delta_chroma_weight_l0[i][j];
+			weights->chroma_offset_l0[i][j] = slice_params->ChromaOffsetL0[i][j];
+			weights->delta_chroma_weight_l1[i][j] = slice_params->delta_chroma_weight_l1[i][j];
+			weights->chroma_offset_l1[i][j] = slice_params->ChromaOffsetL1[i][j];
+		}
+	}
+
+	if (slice_params->LongSliceFlags.fields.slice_sao_luma_flag)
+		slice->flags |= V4L2_HEVC_SLICE_PARAMS_FLAG_SLICE_SAO_LUMA;
+	if (slice_params->LongSliceFlags.fields.slice_sao_chroma_flag)
+		slice->flags |= V4L2_HEVC_SLICE_PARAMS_FLAG_SLICE_SAO_CHROMA;
+	if (slice_params->LongSliceFlags.fields.slice_temporal_mvp_enabled_flag)
+		slice->flags |= V4L2_HEVC_SLICE_PARAMS_FLAG_SLICE_TEMPORAL_MVP_ENABLED;
+	if (slice_params->LongSliceFlags.fields.mvd_l1_zero_flag)
+		slice->flags |= V4L2_HEVC_SLICE_PARAMS_FLAG_MVD_L1_ZERO;
+	if (slice_params->LongSliceFlags.fields.cabac_init_flag)
+		slice->flags |= V4L2_HEVC_SLICE_PARAMS_FLAG_CABAC_INIT;
+	if (slice_params->LongSliceFlags.fields.collocated_from_l0_flag)
+		slice->flags |= V4L2_HEVC_SLICE_PARAMS_FLAG_COLLOCATED_FROM_L0;
+	if (slice_params->LongSliceFlags.fields.slice_deblocking_filter_disabled_flag)
+		slice->flags |= V4L2_HEVC_SLICE_PARAMS_FLAG_SLICE_DEBLOCKING_FILTER_DISABLED;
+	if (slice_params->LongSliceFlags.fields.slice_loop_filter_across_slices_enabled_flag)
+		slice->flags |= V4L2_HEVC_SLICE_PARAMS_FLAG_SLICE_LOOP_FILTER_ACROSS_SLICES_ENABLED;
+	if (slice_params->LongSliceFlags.fields.dependent_slice_segment_flag)
+		slice->flags |= V4L2_HEVC_SLICE_PARAMS_FLAG_DEPENDENT_SLICE_SEGMENT;
+}
+
+/* Insert a DPB index in a list sorted by distance to the current POC. */
+static void h265_controls_poc_insert(uint8_t *list, uint8_t *count,
+				     struct v4l2_hevc_dpb_entry *dpb,
+				     int poc, uint8_t index)
+{
+	unsigned int i;
+	int distance;
+
+	distance = abs(dpb[index].pic_order_cnt_val - poc);
+
+	for (i = *count; i > 0; i--) {
+		if (abs(dpb[list[i - 1]].pic_order_cnt_val - poc) <= distance)
+			break;
+
+		list[i] = list[i - 1];
+	}
+
+	list[i] = index;
+	(*count)++;
+}
+
+static void h265_controls_decode_params(struct dump_driver_data *driver_data,
+					struct object_surface *surface,
+					VASliceParameterBufferHEVC *slice_params,
+					unsigned int offset,
+					struct h265_slice_header *header,
+					struct v4l2_ctrl_hevc_decode_params *decode)
+{
+	VAPictureParameterBufferHEVC *picture_params =
+		&driver_data->params.h265.picture;
+	struct object_surface *surface_object;
+	VAPictureHEVC *picture;
+	int poc = picture_params->CurrPic.pic_order_cnt;
+	uint8_t nal_unit_type;
+	uint8_t nuh_temporal_id_plus1;
+	unsigned int i;
+
+	h265_nal_header(driver_data, surface, slice_params, offset,
+			&nal_unit_type, &nuh_temporal_id_plus1);
+
+	decode->pic_order_cnt_val = poc;
+	decode->short_term_ref_pic_set_size = header->short_term_ref_pic_set_size;
+	decode->long_term_ref_pic_set_size = header->long_term_ref_pic_set_size;
+
+	for (i = 0; i < 15; i++) {
+		picture = &picture_params->ReferenceFrames[i];
+
+		if (picture->picture_id == VA_INVALID_SURFACE ||
+		    (picture->flags & VA_PICTURE_HEVC_INVALID) != 0)
+			break;
+
+		surface_object = (struct object_surface *)
+			object_heap_lookup(&driver_data->surface_heap,
+					   picture->picture_id);
+		if (surface_object == NULL)
+			break;
+
+		decode->dpb[i].timestamp = CONTROLS_TIMESTAMP(surface_object->index);
+		decode->dpb[i].field_pic = !!(picture->flags & VA_PICTURE_HEVC_FIELD_PIC);
+		decode->dpb[i].pic_order_cnt_val = picture->pic_order_cnt;
+
+		if (picture->flags & VA_PICTURE_HEVC_LONG_TERM_REFERENCE)
+			decode->dpb[i].flags = V4L2_HEVC_DPB_ENTRY_LONG_TERM_REFERENCE;
+
+		if (picture->flags & VA_PICTURE_HEVC_RPS_ST_CURR_BEFORE)
+			h265_controls_poc_insert(decode->poc_st_curr_before,
+						 &decode->num_poc_st_curr_before,
+						 decode->dpb, poc, i);
+		else if (picture->flags & VA_PICTURE_HEVC_RPS_ST_CURR_AFTER)
+			h265_controls_poc_insert(decode->poc_st_curr_after,
+						 &decode->num_poc_st_curr_after,
+						 decode->dpb, poc, i);
+		else if (picture->flags & VA_PICTURE_HEVC_RPS_LT_CURR)
+			decode->poc_lt_curr[decode->num_poc_lt_curr++] = i;
+	}
+
+	decode->num_active_dpb_entries = i;
+
+	if (nal_unit_type >= H265_NAL_BLA_W_LP &&
+	    nal_unit_type <= H265_NAL_RSV_IRAP_23)
+		decode->flags |= V4L2_HEVC_DECODE_PARAM_FLAG_IRAP_PIC;
+	if (nal_unit_type == H265_NAL_IDR_W_RADL ||
+	    nal_unit_type == H265_NAL_IDR_N_LP)
+		decode->flags |= V4L2_HEVC_DECODE_PARAM_FLAG_IDR_PIC;
+	if (header->no_output_of_prior_pics)
+		decode->flags |= V4L2_HEVC_DECODE_PARAM_FLAG_NO_OUTPUT_OF_PRIOR;
+}
+
+/* Get the parameters and data offset of a slice of the frame. */
+static VASliceParameterBufferHEVC *h265_controls_slice(struct dump_driver_data *driver_data,
+						       struct object_surface *surface,
+						       unsigned int index,
+						       unsigned int *offset)
+{
+	if (driver_data->slices_count == 0) {
+		*offset = surface->slice_offset;
+		return &driver_data->params.h265.slice;
+	}
+
+	*offset = driver_data->slices[index].offset;
+	return &driver_data->slices[index].params.h265;
+}
+
+/*
+ * Fill the payloads of the mainline stateless H.265 controls. The slice
+ * parameters and entry point offsets are dynamic arrays covering all the
+ * slices of the frame, as expected for frame-based decoding.
+ */
+static void h265_emit_controls(struct dump_driver_data *driver_data,
+			       struct object_surface *surface)
+{
+	struct controls *controls = &driver_data->output.controls;
+	VAPictureParameterBufferHEVC *picture_params =
+		&driver_data->params.h265.picture;
+	VAIQMatrixBufferHEVC *quantization_params =
+		&driver_data->params.h265.quantization;
+	VASliceParameterBufferHEVC *slice_params;
+	struct v4l2_ctrl_hevc_sps *sps;
+	struct v4l2_ctrl_hevc_pps *pps;
+	struct v4l2_ctrl_hevc_slice_params *slices;
+	struct v4l2_ctrl_hevc_scaling_matrix *scaling_matrix;
+	struct v4l2_ctrl_hevc_decode_params *decode;
+	struct h265_slice_header header;
+	uint32_t *entry_point_offsets;
+	unsigned int slices_count;
+	unsigned int offset;
+	unsigned int count;
+	unsigned int total;
+	unsigned int size;
+	unsigned int i;
+
+	slices_count = driver_data->slices_count > 0 ?
+		       driver_data->slices_count : 1;
+
+	controls_begin(controls, driver_data->frame_index, INDEX_CODEC_H265);
+
+	sps = controls_add(controls, V4L2_CID_STATELESS_HEVC_SPS, sizeof(*sps));
+	if (sps != NULL)
+		h265_controls_sps(driver_data, sps);
+
+	pps = controls_add(controls, V4L2_CID_STATELESS_HEVC_PPS, sizeof(*pps));
+	if (pps != NULL)
+		h265_controls_pps(driver_data, pps);
+
+	slices = controls_add(controls, V4L2_CID_STATELESS_HEVC_SLICE_PARAMS,
+			      slices_count * sizeof(*slices));
+	total = 0;
+
+	for (i = 0; i < slices_count; i++) {
+		slice_params = h265_controls_slice(driver_data, surface, i,
+						   &offset);
+		size = h265_slice_header(driver_data, surface, slice_params,
+					 offset, &header);
+
+		if (slices != NULL)
+			h265_controls_slice_params(driver_data, surface,
+						   slice_params, offset,
+						   &header, size, &slices[i]);
+
+		count = header.num_entry_point_offsets;
+		if (count > H265_ENTRY_POINT_OFFSETS_MAX)
+			count = H265_ENTRY_POINT_OFFSETS_MAX;
+
+		total += count;
+	}
+
+	/* The offsets of all the slices are concatenated in slice order. */
+	entry_point_offsets = NULL;
+	if (total > 0)
+		entry_point_offsets = controls_add(controls,
+						   V4L2_CID_STATELESS_HEVC_ENTRY_POINT_OFFSETS,
+						   total * sizeof(*entry_point_offsets));
+
+	for (i = 0; entry_point_offsets != NULL && i < slices_count; i++) {
+		slice_params = h265_controls_slice(driver_data, surface, i,
+						   &offset);
+		h265_slice_header(driver_data, surface, slice_params, offset,
+				  &header);
+
+		count = header.num_entry_point_offsets;
+		if (count > H265_ENTRY_POINT_OFFSETS_MAX)
+			count = H265_ENTRY_POINT_OFFSETS_MAX;
+
+		memcpy(entry_point_offsets, header.entry_point_offset_minus1,
+		       count * sizeof(*entry_point_offsets));
+		entry_point_offsets += count;
+	}
+
+	if (picture_params->pic_fields.bits.scaling_list_enabled_flag) {
+		scaling_matrix = controls_add(controls,
+					      V4L2_CID_STATELESS_HEVC_SCALING_MATRIX,
+					      sizeof(*scaling_matrix));
+		if (scaling_matrix != NULL) {
+			memcpy(scaling_matrix->scaling_list_4x4,
+			       quantization_params->ScalingList4x4,
+			       sizeof(scaling_matrix->scaling_list_4x4));
+			memcpy(scaling_matrix->scaling_list_8x8,
+			       quantization_params->ScalingList8x8,
+			       sizeof(scaling_matrix->scaling_list_8x8));
+			memcpy(scaling_matrix->scaling_list_16x16,
+			       quantization_params->ScalingList16x16,
+			       sizeof(scaling_matrix->scaling_list_16x16));
+			memcpy(scaling_matrix->scaling_list_32x32,
+			       quantization_params->ScalingList32x32,
+			       sizeof(scaling_matrix->scaling_list_32x32));
+			memcpy(scaling_matrix->scaling_list_dc_coef_16x16,
+			       quantization_params->ScalingListDC16x16,
+			       sizeof(scaling_matrix->scaling_list_dc_coef_16x16));
+			memcpy(scaling_matrix->scaling_list_dc_coef_32x32,
+			       quantization_params->ScalingListDC32x32,
+			       sizeof(scaling_matrix->scaling_list_dc_coef_32x32));
+		}
+	}
+
+	/* The decode parameters are taken from the first slice. */
+	slice_params = h265_controls_slice(driver_data, surface, 0, &offset);
+	h265_slice_header(driver_data, surface, slice_params, offset, &header);
+
+	decode = controls_add(controls, V4L2_CID_STATELESS_HEVC_DECODE_PARAMS,
+			      sizeof(*decode));
+	if (decode != NULL)
+		h265_controls_decode_params(driver_data, surface, slice_params,
+					    offset, &header, decode);
+
+	controls_end(controls);
+}
+
+#endif
+
 void h265_dump_prepare(struct dump_driver_data *driver_data)
 {
 }
 
-void h265_dump_header(struct dump_driver_data *driver_data, void *slice_data,
-		      unsigned int slice_size)
+/*
+ * Describe the substreams of a slice to the index before it is written, from
+ * its entry points, that count bytes in the escaped slice data.
+ */
+void h265_dump_slice_layout(struct dump_driver_data *driver_data,
+			    void *data, unsigned int size)
+{
+	VASliceParameterBufferHEVC *slice_params =
+		&driver_data->params.h265.slice;
+	struct h265_slice_header header;
+	unsigned int header_size;
+	unsigned int remaining;
+	unsigned int substream;
+	unsigned int largest = 0;
+	unsigned int count;
+	unsigned int i;
+	int rc;
+
+	if (slice_params->slice_data_offset >= size)
+		return;
+
+	data = (uint8_t *)data + slice_params->slice_data_offset;
+	size -= slice_params->slice_data_offset;
+	if (size > slice_params->slice_data_size)
+		size = slice_params->slice_data_size;
+
+	/* Slices are laid out as given by VAAPI, before any unescaping. */
+	rc = h265_parse_slice_header(driver_data, data, size, false, &header);
+	if (rc < 0)
+		return;
+
+	header_size = header.data_byte_offset;
+	remaining = size > header_size ? size - header_size : 0;
+
+	/* Unrecorded entry points are left in the last substream. */
+	count = header.num_entry_point_offsets;
+	if (count > H265_ENTRY_POINT_OFFSETS_MAX)
+		count = H265_ENTRY_POINT_OFFSETS_MAX;
+
+	for (i = 0; i < count; i++) {
+		substream = header.entry_point_offset_minus1[i] + 1;
+		if (substream > remaining)
+			substream = remaining;
+
+		if (substream > largest)
+			largest = substream;
+
+		remaining -= substream;
+	}
+
+	if (remaining > largest)
+		largest = remaining;
+
+	output_slice_layout(driver_data, header_size,
+			    header.num_entry_point_offsets + 1, largest);
+}
+
+void h265_dump_header(struct dump_driver_data *driver_data,
+		      struct object_surface *surface)
 {
+	TRACE_FUNCTION();
+
 	unsigned int index = driver_data->frame_index;
 	unsigned int indent = 1;
 
@@ -527,8 +1563,16 @@ void h265_dump_header(struct dump_driver_data *driver_data, void *slice_data,
 
 	h265_dump_sps(driver_data, indent);
 	h265_dump_pps(driver_data, indent);
-	h265_dump_slice_params(driver_data, indent, slice_data, slice_size);
+	h265_dump_slice_params(driver_data, indent, surface);
+	h265_columnar_slices(driver_data, surface);
 
 	print_indent(--indent, "},\n");
+	print_nal_units(indent, &driver_data->nal_index);
+	governor_print(driver_data, indent);
 	print_indent(--indent, "},\n");
+
+#ifdef HAVE_V4L2_STATELESS
+	if (driver_data->output.controls.file != NULL)
+		h265_emit_controls(driver_data, surface);
+#endif
 }
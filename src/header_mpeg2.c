@@ -23,8 +23,64 @@
 #include <string.h>
 
 #include "dump.h"
+#include "controls.h"
+#include "field.h"
+#include "governor.h"
 #include "header.h"
+#include "index.h"
 #include "surface.h"
+#include "trace.h"
+
+#include "autoconfig.h"
+
+#ifdef HAVE_V4L2_STATELESS
+#include <linux/v4l2-controls.h>
+#endif
+
+enum mpeg2_field_source {
+	MPEG2_FIELD_PICTURE,
+	MPEG2_FIELD_QUANTIZATION,
+};
+
+#define MPEG2_FIELD_PICTURE_TYPE		VAPictureParameterBufferMPEG2
+#define MPEG2_FIELD_QUANTIZATION_TYPE		VAIQMatrixBufferMPEG2
+
+#define MPEG2_SEQUENCE_FIELDS(X) \
+	X(VALUE, horizontal_size, MPEG2_FIELD_PICTURE, horizontal_size) \
+	X(VALUE, vertical_size, MPEG2_FIELD_PICTURE, vertical_size) \
+	X(CONSTANT, vbv_buffer_size, 1024 * 1024) \
+	X(CONSTANT, profile_and_level_indication, 0) \
+	X(CONSTANT, progressive_sequence, 0) \
+	X(CONSTANT, chroma_format, 1) /* 4:2:0 */
+
+#define MPEG2_PICTURE_FIELDS(X) \
+	X(BITS, intra_dc_precision, MPEG2_FIELD_PICTURE, picture_coding_extension.bits.intra_dc_precision) \
+	X(BITS, picture_structure, MPEG2_FIELD_PICTURE, picture_coding_extension.bits.picture_structure) \
+	X(BITS, top_field_first, MPEG2_FIELD_PICTURE, picture_coding_extension.bits.top_field_first) \
+	X(BITS, frame_pred_frame_dct, MPEG2_FIELD_PICTURE, picture_coding_extension.bits.frame_pred_frame_dct) \
+	X(BITS, concealment_motion_vectors, MPEG2_FIELD_PICTURE, picture_coding_extension.bits.concealment_motion_vectors) \
+	X(BITS, q_scale_type, MPEG2_FIELD_PICTURE, picture_coding_extension.bits.q_scale_type) \
+	X(BITS, intra_vlc_format, MPEG2_FIELD_PICTURE, picture_coding_extension.bits.intra_vlc_format) \
+	X(BITS, alternate_scan, MPEG2_FIELD_PICTURE, picture_coding_extension.bits.alternate_scan) \
+	X(BITS, repeat_first_field, MPEG2_FIELD_PICTURE, picture_coding_extension.bits.repeat_first_field) \
+	X(BITS, progressive_frame, MPEG2_FIELD_PICTURE, picture_coding_extension.bits.progressive_frame)
+
+#define MPEG2_QUANTIZATION_FIELDS(X) \
+	X(VALUE, load_intra_quantiser_matrix, MPEG2_FIELD_QUANTIZATION, load_intra_quantiser_matrix) \
+	X(VALUE, load_non_intra_quantiser_matrix, MPEG2_FIELD_QUANTIZATION, load_non_intra_quantiser_matrix) \
+	X(VALUE, load_chroma_intra_quantiser_matrix, MPEG2_FIELD_QUANTIZATION, load_chroma_intra_quantiser_matrix) \
+	X(VALUE, load_chroma_non_intra_quantiser_matrix, MPEG2_FIELD_QUANTIZATION, load_chroma_non_intra_quantiser_matrix) \
+	X(ARRAY, intra_quantiser_matrix, MPEG2_FIELD_QUANTIZATION, intra_quantiser_matrix, 64) \
+	X(ARRAY, non_intra_quantiser_matrix, MPEG2_FIELD_QUANTIZATION, non_intra_quantiser_matrix, 64) \
+	X(ARRAY, chroma_intra_quantiser_matrix, MPEG2_FIELD_QUANTIZATION, chroma_intra_quantiser_matrix, 64) \
+	X(ARRAY, chroma_non_intra_quantiser_matrix, MPEG2_FIELD_QUANTIZATION, chroma_non_intra_quantiser_matrix, 64)
+
+FIELD_TABLE(mpeg2_sequence_table, "frame.mpeg2.slice_params.sequence",
+	    MPEG2_SEQUENCE_FIELDS);
+FIELD_TABLE(mpeg2_picture_table, "frame.mpeg2.slice_params.picture",
+	    MPEG2_PICTURE_FIELDS);
+FIELD_TABLE(mpeg2_quantization_table, "frame.mpeg2.quantization",
+	    MPEG2_QUANTIZATION_FIELDS);
 
 static void mpeg2_dump_slice_params(struct dump_driver_data *driver_data,
 				    unsigned int indent,
@@ -34,11 +90,15 @@ static void mpeg2_dump_slice_params(struct dump_driver_data *driver_data,
 		&driver_data->params.mpeg2.picture;
 	VASliceParameterBufferMPEG2 *slice_params =
 		&driver_data->params.mpeg2.slice;
+	struct columnar *columnar = &driver_data->output.columnar;
 	struct object_surface *surface_object;
 	char *picture_coding_type;
 	unsigned int forward_reference_index;
 	unsigned int backward_reference_index;
 	unsigned int index = driver_data->frame_index;
+	const void *sources[] = {
+		[MPEG2_FIELD_PICTURE] = picture_params,
+	};
 
 	print_indent(indent++, ".frame.mpeg2.slice_params = {\n");
 
@@ -46,17 +106,8 @@ static void mpeg2_dump_slice_params(struct dump_driver_data *driver_data,
 	print_indent(indent, ".data_bit_offset = %d,\n", 0);
 
 	print_indent(indent++, ".sequence = {\n");
-
-	print_indent(indent, ".horizontal_size = %d,\n",
-		     picture_params->horizontal_size);
-	print_indent(indent, ".vertical_size = %d,\n",
-		     picture_params->vertical_size);
-	print_indent(indent, ".vbv_buffer_size = %d,\n", 1024 * 1024);
-
-	print_indent(indent, ".profile_and_level_indication = %d,\n", 0);
-	print_indent(indent, ".progressive_sequence = %d,\n", 0);
-	print_indent(indent, ".chroma_format = %d,\n", 1); // 4:2:0
-
+	field_print(&mpeg2_sequence_table, sources, indent);
+	field_columnar(&mpeg2_sequence_table, sources, columnar);
 	print_indent(--indent, "},\n");
 
 	if (picture_params->picture_coding_type == 1)
@@ -76,32 +127,19 @@ static void mpeg2_dump_slice_params(struct dump_driver_data *driver_data,
 		     (picture_params->f_code >> 8) & 0xf,
 		     (picture_params->f_code >> 4) & 0xf,
 		     (picture_params->f_code >> 0) & 0xf);
-	print_indent(indent, ".intra_dc_precision = %d,\n",
-		     picture_params->picture_coding_extension.bits.intra_dc_precision);
-	print_indent(indent, ".picture_structure = %d,\n",
-		     picture_params->picture_coding_extension.bits.picture_structure);
-	print_indent(indent, ".top_field_first = %d,\n",
-		     picture_params->picture_coding_extension.bits.top_field_first);
-	print_indent(indent, ".frame_pred_frame_dct = %d,\n",
-		     picture_params->picture_coding_extension.bits.frame_pred_frame_dct);
-	print_indent(indent, ".concealment_motion_vectors = %d,\n",
-		     picture_params->picture_coding_extension.bits.concealment_motion_vectors);
-	print_indent(indent, ".q_scale_type = %d,\n",
-		     picture_params->picture_coding_extension.bits.q_scale_type);
-	print_indent(indent, ".intra_vlc_format = %d,\n",
-		     picture_params->picture_coding_extension.bits.intra_vlc_format);
-	print_indent(indent, ".alternate_scan = %d,\n",
-		     picture_params->picture_coding_extension.bits.alternate_scan);
-	print_indent(indent, ".repeat_first_field = %d,\n",
-		     picture_params->picture_coding_extension.bits.repeat_first_field);
-	print_indent(indent, ".progressive_frame = %d,\n",
-		     picture_params->picture_coding_extension.bits.progressive_frame);
+	field_print(&mpeg2_picture_table, sources, indent);
+	field_columnar(&mpeg2_picture_table, sources, columnar);
 
 	print_indent(--indent, "},\n");
 
 	print_indent(indent, ".quantiser_scale_code = %d,\n",
 		     slice_params->quantiser_scale_code);
 
+	columnar_int(columnar, "frame.mpeg2.slice_params.bit_size",
+		     slice_size * 8);
+	columnar_int(columnar, "frame.mpeg2.slice_params.picture.picture_coding_type",
+		     picture_params->picture_coding_type);
+
 	surface_object = (struct object_surface *)
 		object_heap_lookup(&driver_data->surface_heap,
 				   picture_params->forward_reference_picture);
@@ -128,43 +166,156 @@ static void mpeg2_dump_slice_params(struct dump_driver_data *driver_data,
 static void mpeg2_dump_quantization(struct dump_driver_data *driver_data,
 				    unsigned int indent)
 {
-	VAIQMatrixBufferMPEG2 *quantization_params =
-		&driver_data->params.mpeg2.quantization;
+	const void *sources[] = {
+		[MPEG2_FIELD_QUANTIZATION] = &driver_data->params.mpeg2.quantization,
+	};
 
 	print_indent(indent++, ".frame.mpeg2.quantization = {\n");
 
-	print_indent(indent, ".load_intra_quantiser_matrix = %d,\n",
-		     quantization_params->load_intra_quantiser_matrix);
-	print_indent(indent, ".load_non_intra_quantiser_matrix = %d,\n",
-		     quantization_params->load_non_intra_quantiser_matrix);
-	print_indent(indent, ".load_chroma_intra_quantiser_matrix = %d,\n",
-		     quantization_params->load_chroma_intra_quantiser_matrix);
-	print_indent(indent, ".load_chroma_non_intra_quantiser_matrix = %d,\n",
-		     quantization_params->load_chroma_non_intra_quantiser_matrix);
-
-	print_u8_matrix(indent, "intra_quantiser_matrix",
-			(uint8_t *)&quantization_params->intra_quantiser_matrix,
-			1, 64);
-	print_u8_matrix(indent, "non_intra_quantiser_matrix",
-			(uint8_t *)&quantization_params->non_intra_quantiser_matrix,
-			1, 64);
-	print_u8_matrix(indent, "chroma_intra_quantiser_matrix",
-			(uint8_t *)&quantization_params->chroma_intra_quantiser_matrix,
-			1, 64);
-	print_u8_matrix(indent, "chroma_non_intra_quantiser_matrix",
-			(uint8_t *)&quantization_params->chroma_non_intra_quantiser_matrix,
-			1, 64);
+	field_print(&mpeg2_quantization_table, sources, indent);
+	field_columnar(&mpeg2_quantization_table, sources,
+		       &driver_data->output.columnar);
 
 	print_indent(--indent, "},\n");
 }
 
+#ifdef HAVE_V4L2_STATELESS
+
+static uint64_t mpeg2_controls_reference_ts(struct dump_driver_data *driver_data,
+					    VASurfaceID surface_id)
+{
+	struct object_surface *surface_object;
+
+	surface_object = (struct object_surface *)
+		object_heap_lookup(&driver_data->surface_heap, surface_id);
+	if (surface_object == NULL)
+		return CONTROLS_TIMESTAMP(driver_data->frame_index);
+
+	return CONTROLS_TIMESTAMP(surface_object->index);
+}
+
+/* Fill the payloads of the mainline stateless MPEG-2 controls. */
+static void mpeg2_emit_controls(struct dump_driver_data *driver_data,
+				VAProfile profile)
+{
+	struct controls *controls = &driver_data->output.controls;
+	VAPictureParameterBufferMPEG2 *picture_params =
+		&driver_data->params.mpeg2.picture;
+	VAIQMatrixBufferMPEG2 *quantization_params =
+		&driver_data->params.mpeg2.quantization;
+	struct v4l2_ctrl_mpeg2_sequence *sequence;
+	struct v4l2_ctrl_mpeg2_picture *picture;
+	struct v4l2_ctrl_mpeg2_quantisation *quantisation;
+
+	controls_begin(controls, driver_data->frame_index, INDEX_CODEC_MPEG2);
+
+	sequence = controls_add(controls, V4L2_CID_STATELESS_MPEG2_SEQUENCE,
+				sizeof(*sequence));
+	if (sequence != NULL) {
+		sequence->horizontal_size = picture_params->horizontal_size;
+		sequence->vertical_size = picture_params->vertical_size;
+		sequence->vbv_buffer_size = 1024 * 1024;
+		sequence->profile_and_level_indication =
+			profile == VAProfileMPEG2Simple ? 0x58 : 0x48;
+		sequence->chroma_format = 1; /* 4:2:0 */
+	}
+
+	picture = controls_add(controls, V4L2_CID_STATELESS_MPEG2_PICTURE,
+			       sizeof(*picture));
+	if (picture != NULL) {
+		picture->backward_ref_ts =
+			mpeg2_controls_reference_ts(driver_data,
+						    picture_params->backward_reference_picture);
+		picture->forward_ref_ts =
+			mpeg2_controls_reference_ts(driver_data,
+						    picture_params->forward_reference_picture);
+
+		picture->f_code[0][0] = (picture_params->f_code >> 12) & 0xf;
+		picture->f_code[0][1] = (picture_params->f_code >> 8) & 0xf;
+		picture->f_code[1][0] = (picture_params->f_code >> 4) & 0xf;
+		picture->f_code[1][1] = (picture_params->f_code >> 0) & 0xf;
+		picture->picture_coding_type = picture_params->picture_coding_type;
+		picture->picture_structure = picture_params->picture_coding_extension.bits.picture_structure;
+		picture->intra_dc_precision = picture_params->picture_coding_extension.bits.intra_dc_precision;
+
+		if (picture_params->picture_coding_extension.bits.top_field_first)
+			picture->flags |= V4L2_MPEG2_PIC_FLAG_TOP_FIELD_FIRST;
+		if (picture_params->picture_coding_extension.bits.frame_pred_frame_dct)
+			picture->flags |= V4L2_MPEG2_PIC_FLAG_FRAME_PRED_DCT;
+		if (picture_params->picture_coding_extension.bits.concealment_motion_vectors)
+			picture->flags |= V4L2_MPEG2_PIC_FLAG_CONCEALMENT_MV;
+		if (picture_params->picture_coding_extension.bits.q_scale_type)
+			picture->flags |= V4L2_MPEG2_PIC_FLAG_Q_SCALE_TYPE;
+		if (picture_params->picture_coding_extension.bits.intra_vlc_format)
+			picture->flags |= V4L2_MPEG2_PIC_FLAG_INTRA_VLC;
+		if (picture_params->picture_coding_extension.bits.alternate_scan)
+			picture->flags |= V4L2_MPEG2_PIC_FLAG_ALT_SCAN;
+		if (picture_params->picture_coding_extension.bits.repeat_first_field)
+			picture->flags |= V4L2_MPEG2_PIC_FLAG_REPEAT_FIRST;
+		if (picture_params->picture_coding_extension.bits.progressive_frame)
+			picture->flags |= V4L2_MPEG2_PIC_FLAG_PROGRESSIVE;
+	}
+
+	quantisation = controls_add(controls,
+				    V4L2_CID_STATELESS_MPEG2_QUANTISATION,
+				    sizeof(*quantisation));
+	if (quantisation != NULL) {
+		memcpy(quantisation->intra_quantiser_matrix,
+		       quantization_params->intra_quantiser_matrix,
+		       sizeof(quantisation->intra_quantiser_matrix));
+		memcpy(quantisation->non_intra_quantiser_matrix,
+		       quantization_params->non_intra_quantiser_matrix,
+		       sizeof(quantisation->non_intra_quantiser_matrix));
+		memcpy(quantisation->chroma_intra_quantiser_matrix,
+		       quantization_params->chroma_intra_quantiser_matrix,
+		       sizeof(quantisation->chroma_intra_quantiser_matrix));
+		memcpy(quantisation->chroma_non_intra_quantiser_matrix,
+		       quantization_params->chroma_non_intra_quantiser_matrix,
+		       sizeof(quantisation->chroma_non_intra_quantiser_matrix));
+	}
+
+	controls_end(controls);
+}
+
+#endif
+
+/* Export the fields of every slice of the picture, with one row each. */
+static void mpeg2_columnar_slices(struct dump_driver_data *driver_data)
+{
+	struct columnar *columnar = &driver_data->output.columnar_slices;
+	VASliceParameterBufferMPEG2 *slice_params;
+	unsigned int i;
+
+	if (columnar->group_rows == 0)
+		return;
+
+	for (i = 0; i < driver_data->slices_count; i++) {
+		slice_params = &driver_data->slices[i].params.mpeg2;
+
+		columnar_row_begin(columnar);
+		columnar_int(columnar, "index", driver_data->frame_index);
+		columnar_int(columnar, "slice", i);
+		columnar_int(columnar, "slice.mpeg2.bit_size",
+			     slice_params->slice_data_size * 8);
+		columnar_int(columnar, "slice.mpeg2.slice_horizontal_position",
+			     slice_params->slice_horizontal_position);
+		columnar_int(columnar, "slice.mpeg2.slice_vertical_position",
+			     slice_params->slice_vertical_position);
+		columnar_int(columnar, "slice.mpeg2.quantiser_scale_code",
+			     slice_params->quantiser_scale_code);
+		columnar_row_end(columnar);
+	}
+}
+
 void mpeg2_dump_prepare(struct dump_driver_data *driver_data)
 {
 }
 
-void mpeg2_dump_header(struct dump_driver_data *driver_data, void *slice_data,
-		       unsigned int slice_size)
+void mpeg2_dump_header(struct dump_driver_data *driver_data, VAProfile profile,
+		       void *slice_data, unsigned int slice_size)
 {
+	TRACE_FUNCTION();
+
 	unsigned int index = driver_data->frame_index;
 	unsigned int indent = 1;
 
@@ -172,7 +323,15 @@ void mpeg2_dump_header(struct dump_driver_data *driver_data, void *slice_data,
 	print_indent(indent, ".index = %d,\n", index);
 
 	mpeg2_dump_slice_params(driver_data, indent, slice_size);
+	mpeg2_columnar_slices(driver_data);
 	mpeg2_dump_quantization(driver_data, indent);
+	print_nal_units(indent, &driver_data->nal_index);
+	governor_print(driver_data, indent);
 
 	print_indent(--indent, "},\n");
+
+#ifdef HAVE_V4L2_STATELESS
+	if (driver_data->output.controls.file != NULL)
+		mpeg2_emit_controls(driver_data, profile);
+#endif
 }
@@ -22,10 +22,14 @@
 #include "image.h"
 #include "surface.h"
 #include "buffer.h"
+#include "timing.h"
+#include "trace.h"
 
 VAStatus DumpCreateImage(VADriverContextP context, VAImageFormat *format,
 	int width, int height, VAImage *image)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_image *image_object;
 	unsigned int size;
@@ -67,6 +71,8 @@ VAStatus DumpCreateImage(VADriverContextP context, VAImageFormat *format,
 
 VAStatus DumpDestroyImage(VADriverContextP context, VAImageID image_id)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_image *image_object;
 	VAStatus status;
@@ -87,6 +93,8 @@ VAStatus DumpDestroyImage(VADriverContextP context, VAImageID image_id)
 VAStatus DumpDeriveImage(VADriverContextP context, VASurfaceID surface_id,
 	VAImage *image)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_surface *surface_object;
 	VAImageFormat format;
@@ -102,6 +110,11 @@ VAStatus DumpDeriveImage(VADriverContextP context, VASurfaceID surface_id,
 	if (status != VA_STATUS_SUCCESS)
 		return status;
 
+	/* Deriving an image synchronizes the surface like DumpSyncSurface. */
+	if (surface_object->status == VASurfaceRendering &&
+	    surface_object->deadline != 0)
+		timing_wait(surface_object->deadline);
+
 	surface_object->status = VASurfaceReady;
 
 	return VA_STATUS_SUCCESS;
@@ -110,6 +123,8 @@ VAStatus DumpDeriveImage(VADriverContextP context, VASurfaceID surface_id,
 VAStatus DumpQueryImageFormats(VADriverContextP context, VAImageFormat *formats,
 	int *formats_count)
 {
+	TRACE_FUNCTION();
+
 	formats[0].fourcc = VA_FOURCC_NV12;
 	*formats_count = 1;
 
@@ -119,12 +134,16 @@ VAStatus DumpQueryImageFormats(VADriverContextP context, VAImageFormat *formats,
 VAStatus DumpSetImagePalette(VADriverContextP context, VAImageID image_id,
 	unsigned char *palette)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
 
 VAStatus DumpGetImage(VADriverContextP context, VASurfaceID surface_id, int x,
 	int y, unsigned int width, unsigned int height, VAImageID image_id)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
 
@@ -133,5 +152,7 @@ VAStatus DumpPutImage(VADriverContextP context, VASurfaceID surface_id,
 	unsigned int src_height, int dst_x, int dst_y, unsigned int dst_width,
 	unsigned int dst_height)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
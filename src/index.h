@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _INDEX_H_
+#define _INDEX_H_
+
+#include <stdint.h>
+
+/*
+ * Values
+ */
+
+#define INDEX_FRAMES_FILENAME			"index.frames"
+#define INDEX_SLICES_FILENAME			"index.slices"
+
+#define INDEX_MAGIC				0x58444e49
+#define INDEX_VERSION				2
+
+#define INDEX_REFERENCES_MAX			16
+#define INDEX_NONE				0xffffffff
+#define INDEX_OFFSET_NONE			0xffffffffffffffffULL
+
+/* Records are only missing for frames that could not be dumped. */
+#define INDEX_FLAG_VALID			(1 << 0)
+#define INDEX_FLAG_KEYFRAME			(1 << 1)
+#define INDEX_FLAG_RBSP				(1 << 2)
+#define INDEX_FLAG_WPP				(1 << 3)
+
+enum index_codec {
+	INDEX_CODEC_MPEG2,
+	INDEX_CODEC_H264,
+	INDEX_CODEC_H265,
+};
+
+enum index_kind {
+	INDEX_KIND_FRAMES,
+	INDEX_KIND_SLICES,
+};
+
+/*
+ * Structures
+ */
+
+/*
+ * Both index files start with this header, followed by fixed-size records in
+ * host byte order: frame N is the N-th record of the frames file and its
+ * slices are consecutive records of the slices file.
+ */
+struct index_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t kind;
+	uint32_t record_size;
+	uint32_t mode;
+	uint32_t reserved[3];
+};
+
+/*
+ * Slice offsets are given in the slices output of the frame: its own file in
+ * files mode (in the shard directory when sharded) or the shared file in
+ * direct and elementary stream modes. Metadata offsets are given in the standard output, when it is
+ * a regular file.
+ */
+struct index_frame {
+	uint32_t frame;
+	uint32_t flags;
+	uint32_t codec;
+	uint32_t context_id;
+	uint32_t shard;
+	uint32_t slices_count;
+	uint64_t slice_first;
+	uint64_t slice_offset;
+	uint64_t slice_size;
+	uint64_t metadata_offset;
+	uint64_t metadata_size;
+
+	/* Display order is given by the sequence, then the order. */
+	uint32_t sequence;
+	int32_t order;
+
+	uint32_t references_count;
+	uint32_t references[INDEX_REFERENCES_MAX];
+
+	/* H.265 tiles, one column and row otherwise. */
+	uint16_t tile_columns;
+	uint16_t tile_rows;
+};
+
+/*
+ * Slice offsets are relative to the slice data of the frame. H.265 slices
+ * with tiles or wavefront parallel processing are split in substreams that
+ * can be decoded in parallel, starting header_size bytes into the slice. As
+ * the entry points they come from, substream sizes count the emulation
+ * prevention bytes. Other slices are a single substream with no header size.
+ */
+struct index_slice {
+	uint64_t offset;
+	uint32_t size;
+	uint32_t header_size;
+	uint32_t substreams;
+	uint32_t substream_max;
+};
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+
+struct log_entry {
+	unsigned long sequence;
+	char message[LOG_MESSAGE_SIZE];
+};
+
+int log_threshold = LOG_LEVEL_INFO;
+
+static const char *log_level_names[] = {
+	[LOG_LEVEL_ERROR] = "error",
+	[LOG_LEVEL_WARNING] = "warning",
+	[LOG_LEVEL_INFO] = "info",
+	[LOG_LEVEL_DEBUG] = "debug",
+};
+
+static struct log_entry log_ring[LOG_RING_ENTRIES];
+static unsigned long log_head;
+static unsigned long log_tail;
+static unsigned long log_dropped;
+
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int log_users;
+static pthread_t log_thread;
+static bool log_running;
+
+static uint64_t log_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Let at most LOG_RATE_BURST messages through for each call site per interval,
+ * returning the number of messages suppressed in the previous interval.
+ */
+static bool log_rate_check(struct log_site *site, unsigned int *suppressed)
+{
+	uint64_t now = log_time();
+	uint64_t start;
+
+	*suppressed = 0;
+
+	start = __atomic_load_n(&site->window_start, __ATOMIC_RELAXED);
+	if (now - start >= LOG_RATE_INTERVAL &&
+	    __atomic_compare_exchange_n(&site->window_start, &start, now, false,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+		*suppressed = __atomic_exchange_n(&site->suppressed, 0,
+						  __ATOMIC_RELAXED);
+	}
+
+	if (__atomic_fetch_add(&site->count, 1, __ATOMIC_RELAXED) >= LOG_RATE_BURST) {
+		__atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	return true;
+}
+
+/* Claim an entry of the ring, any number of threads may log at once. */
+static struct log_entry *log_claim(unsigned long *position)
+{
+	struct log_entry *entry;
+	unsigned long sequence;
+	unsigned long head;
+	long difference;
+
+	head = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+
+	while (1) {
+		entry = &log_ring[head % LOG_RING_ENTRIES];
+		sequence = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE);
+		difference = (long) (sequence - head);
+
+		if (difference == 0) {
+			if (__atomic_compare_exchange_n(&log_head, &head, head + 1,
+							true, __ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (difference < 0) {
+			__atomic_fetch_add(&log_dropped, 1, __ATOMIC_RELAXED);
+			return NULL;
+		} else {
+			head = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+		}
+	}
+
+	*position = head;
+
+	return entry;
+}
+
+static void log_push(const char *format, va_list args)
+{
+	struct log_entry *entry;
+	unsigned long position;
+
+	if (!__atomic_load_n(&log_running, __ATOMIC_ACQUIRE)) {
+		vfprintf(stderr, format, args);
+		return;
+	}
+
+	entry = log_claim(&position);
+	if (entry == NULL)
+		return;
+
+	vsnprintf(entry->message, sizeof(entry->message), format, args);
+
+	__atomic_store_n(&entry->sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+static void log_push_format(const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	log_push(format, args);
+	va_end(args);
+}
+
+void log_print(struct log_site *site, enum log_level level,
+	       const char *format, ...)
+{
+	unsigned int suppressed;
+	va_list args;
+
+	if (!log_rate_check(site, &suppressed))
+		return;
+
+	if (suppressed > 0)
+		log_push_format("Suppressed %u similar messages\n", suppressed);
+
+	va_start(args, format);
+	log_push(format, args);
+	va_end(args);
+}
+
+static void log_write(const char *buffer, size_t length)
+{
+	ssize_t written;
+
+	while (length > 0) {
+		written = write(STDERR_FILENO, buffer, length);
+		if (written <= 0)
+			return;
+
+		buffer += written;
+		length -= written;
+	}
+}
+
+/* Write out all the complete entries of the ring with as few writes as possible. */
+static void log_flush(void)
+{
+	static unsigned long dropped_reported;
+	struct log_entry *entry;
+	char buffer[16 * 1024];
+	unsigned long dropped;
+	size_t length = 0;
+	size_t size;
+
+	while (1) {
+		entry = &log_ring[log_tail % LOG_RING_ENTRIES];
+		if (__atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE) != log_tail + 1)
+			break;
+
+		size = strnlen(entry->message, sizeof(entry->message));
+		if (length + size > sizeof(buffer)) {
+			log_write(buffer, length);
+			length = 0;
+		}
+
+		memcpy(buffer + length, entry->message, size);
+		length += size;
+
+		__atomic_store_n(&entry->sequence, log_tail + LOG_RING_ENTRIES,
+				 __ATOMIC_RELEASE);
+		log_tail++;
+	}
+
+	dropped = __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+	if (dropped != dropped_reported && length + 64 <= sizeof(buffer)) {
+		length += snprintf(buffer + length, 64,
+				   "Dropped %lu log messages\n",
+				   dropped - dropped_reported);
+		dropped_reported = dropped;
+	}
+
+	if (length > 0)
+		log_write(buffer, length);
+}
+
+static void *log_thread_run(void *data)
+{
+	struct timespec interval = {
+		.tv_sec = 0,
+		.tv_nsec = LOG_FLUSH_INTERVAL * 1000000L,
+	};
+
+	while (__atomic_load_n(&log_running, __ATOMIC_ACQUIRE)) {
+		log_flush();
+		nanosleep(&interval, NULL);
+	}
+
+	log_flush();
+
+	return NULL;
+}
+
+static int log_level_parse(const char *level)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(log_level_names) / sizeof(log_level_names[0]); i++)
+		if (strcmp(level, log_level_names[i]) == 0)
+			return i;
+
+	return atoi(level);
+}
+
+/*
+ * Messages are formatted in the calling thread and written to stderr from a
+ * background thread, every LOG_FLUSH_INTERVAL milliseconds. Without it, they
+ * are printed right away.
+ */
+void log_init(const char *level)
+{
+	unsigned int i;
+	int rc;
+
+	pthread_mutex_lock(&log_mutex);
+
+	if (level != NULL)
+		log_threshold = log_level_parse(level);
+
+	if (log_users++ > 0)
+		goto complete;
+
+	for (i = 0; i < LOG_RING_ENTRIES; i++)
+		log_ring[i].sequence = log_tail + i;
+
+	log_head = log_tail;
+
+	__atomic_store_n(&log_running, true, __ATOMIC_RELEASE);
+
+	rc = pthread_create(&log_thread, NULL, log_thread_run, NULL);
+	if (rc != 0)
+		__atomic_store_n(&log_running, false, __ATOMIC_RELEASE);
+
+complete:
+	pthread_mutex_unlock(&log_mutex);
+}
+
+void log_destroy(void)
+{
+	pthread_mutex_lock(&log_mutex);
+
+	if (log_users == 0 || --log_users > 0)
+		goto complete;
+
+	if (__atomic_load_n(&log_running, __ATOMIC_ACQUIRE)) {
+		__atomic_store_n(&log_running, false, __ATOMIC_RELEASE);
+		pthread_join(log_thread, NULL);
+	}
+
+complete:
+	pthread_mutex_unlock(&log_mutex);
+}
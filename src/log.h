@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <stdint.h>
+
+/*
+ * Values
+ */
+
+enum log_level {
+	LOG_LEVEL_ERROR = 0,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_DEBUG,
+};
+
+#define LOG_RING_ENTRIES			256
+#define LOG_MESSAGE_SIZE			248
+/* Messages allowed from a single call site per interval. */
+#define LOG_RATE_BURST				10
+#define LOG_RATE_INTERVAL			1000000000ULL
+#define LOG_FLUSH_INTERVAL			100
+
+/*
+ * Structures
+ */
+
+struct log_site {
+	uint64_t window_start;
+	unsigned int count;
+	unsigned int suppressed;
+};
+
+extern int log_threshold;
+
+/*
+ * Functions
+ */
+
+void log_init(const char *level);
+void log_destroy(void);
+void log_print(struct log_site *site, enum log_level level,
+	       const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#define log_message(level, ...) \
+	do { \
+		static struct log_site log_site; \
+		if ((int) (level) <= log_threshold) \
+			log_print(&log_site, (level), __VA_ARGS__); \
+	} while (0)
+
+#define log_error(...)		log_message(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define log_warning(...)	log_message(LOG_LEVEL_WARNING, __VA_ARGS__)
+#define log_info(...)		log_message(LOG_LEVEL_INFO, __VA_ARGS__)
+
+/* Debug messages are only built with --enable-debug-log. */
+#ifdef LOG_DEBUG_ENABLED
+#define log_debug(...)		log_message(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define log_debug(...) \
+	do { \
+		if (0) \
+			log_print(NULL, LOG_LEVEL_DEBUG, __VA_ARGS__); \
+	} while (0)
+#endif
+
+#endif
@@ -0,0 +1,432 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "nal.h"
+
+#define NAL_START_CODE_SIZE			3
+#define NAL_EPB					0x03
+
+#define H264_NAL_UNIT_TYPE_MASK			((1 << 5) - 1)
+#define H264_NAL_PREFIX				14
+#define H264_NAL_SLICE_EXT			20
+#define H264_NAL_SVC_EXTENSION_FLAG		(1 << 7)
+
+#define H265_NAL_UNIT_TYPE_SHIFT		1
+#define H265_NAL_UNIT_TYPE_MASK			((1 << 6) - 1)
+#define H265_NUH_TEMPORAL_ID_PLUS1_MASK		((1 << 3) - 1)
+
+#define MPEG2_SLICE_START_CODE_MIN		0x01
+
+/*
+ * The scan kernels look for 00 00 01 start code sequences and count 00 00 03
+ * emulation prevention sequences before the start code that is found. They
+ * stop at the first emulation prevention sequence instead when requested.
+ */
+
+static unsigned int nal_scan_scalar(const uint8_t *data, unsigned int size,
+				    unsigned int offset,
+				    unsigned int *epb_count, bool epb_stop)
+{
+	unsigned int i;
+
+	for (i = offset; i + 2 < size; i++) {
+		/* No sequence can start at any of the next three bytes. */
+		if (data[i + 2] > 3) {
+			i += 2;
+			continue;
+		}
+
+		if (data[i] != 0 || data[i + 1] != 0)
+			continue;
+
+		if (data[i + 2] == 1)
+			return i;
+		else if (data[i + 2] == 3 && epb_stop)
+			return i;
+		else if (data[i + 2] == 3)
+			(*epb_count)++;
+	}
+
+	return size;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#ifdef __SSE2__
+static unsigned int nal_scan_sse2(const uint8_t *data, unsigned int size,
+				  unsigned int *epb_count, bool epb_stop)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i one = _mm_set1_epi8(1);
+	__m128i three = _mm_set1_epi8(3);
+	__m128i v0, v1, v2, z;
+	unsigned int mask_start, mask_epb;
+	unsigned int i = 0;
+
+	for (i = 0; i + 16 + 2 <= size; i += 16) {
+		v0 = _mm_loadu_si128((const __m128i *)(data + i));
+		v1 = _mm_loadu_si128((const __m128i *)(data + i + 1));
+		v2 = _mm_loadu_si128((const __m128i *)(data + i + 2));
+
+		z = _mm_and_si128(_mm_cmpeq_epi8(v0, zero),
+				  _mm_cmpeq_epi8(v1, zero));
+		mask_start = _mm_movemask_epi8(_mm_and_si128(z, _mm_cmpeq_epi8(v2, one)));
+		mask_epb = _mm_movemask_epi8(_mm_and_si128(z, _mm_cmpeq_epi8(v2, three)));
+
+		if (epb_stop)
+			mask_start |= mask_epb;
+
+		if (mask_start) {
+			mask_start = __builtin_ctz(mask_start);
+			*epb_count += __builtin_popcount(mask_epb & ((1U << mask_start) - 1));
+			return i + mask_start;
+		}
+
+		*epb_count += __builtin_popcount(mask_epb);
+	}
+
+	return nal_scan_scalar(data, size, i, epb_count, epb_stop);
+}
+#endif
+
+__attribute__((target("avx2")))
+static unsigned int nal_scan_avx2(const uint8_t *data, unsigned int size,
+				  unsigned int *epb_count, bool epb_stop)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i one = _mm256_set1_epi8(1);
+	__m256i three = _mm256_set1_epi8(3);
+	__m256i v0, v1, v2, z;
+	unsigned int mask_start, mask_epb;
+	unsigned int i = 0;
+
+	for (i = 0; i + 32 + 2 <= size; i += 32) {
+		v0 = _mm256_loadu_si256((const __m256i *)(data + i));
+		v1 = _mm256_loadu_si256((const __m256i *)(data + i + 1));
+		v2 = _mm256_loadu_si256((const __m256i *)(data + i + 2));
+
+		z = _mm256_and_si256(_mm256_cmpeq_epi8(v0, zero),
+				     _mm256_cmpeq_epi8(v1, zero));
+		mask_start = _mm256_movemask_epi8(_mm256_and_si256(z, _mm256_cmpeq_epi8(v2, one)));
+		mask_epb = _mm256_movemask_epi8(_mm256_and_si256(z, _mm256_cmpeq_epi8(v2, three)));
+
+		if (epb_stop)
+			mask_start |= mask_epb;
+
+		if (mask_start) {
+			mask_start = __builtin_ctz(mask_start);
+			*epb_count += __builtin_popcount(mask_epb & ((1U << mask_start) - 1));
+			return i + mask_start;
+		}
+
+		*epb_count += __builtin_popcount(mask_epb);
+	}
+
+	return nal_scan_scalar(data, size, i, epb_count, epb_stop);
+}
+
+#elif defined(__aarch64__)
+
+static unsigned int nal_scan_neon(const uint8_t *data, unsigned int size,
+				  unsigned int *epb_count, bool epb_stop)
+{
+	uint8x16_t v0, v1, v2, z, start, epb;
+	unsigned int i = 0;
+	unsigned int count;
+
+	for (i = 0; i + 16 + 2 <= size; i += 16) {
+		v0 = vld1q_u8(data + i);
+		v1 = vld1q_u8(data + i + 1);
+		v2 = vld1q_u8(data + i + 2);
+
+		z = vandq_u8(vceqzq_u8(v0), vceqzq_u8(v1));
+		start = vandq_u8(z, vceqq_u8(v2, vdupq_n_u8(1)));
+		epb = vandq_u8(z, vceqq_u8(v2, vdupq_n_u8(3)));
+
+		if (epb_stop)
+			start = vorrq_u8(start, epb);
+
+		/* Let the scalar code locate the sequence in this block. */
+		if (vmaxvq_u8(start)) {
+			count = 0;
+			i = nal_scan_scalar(data, i + 16 + 2, i, &count,
+					    epb_stop);
+			*epb_count += count;
+			return i;
+		}
+
+		*epb_count += vaddvq_u8(vshrq_n_u8(epb, 7));
+	}
+
+	return nal_scan_scalar(data, size, i, epb_count, epb_stop);
+}
+
+#endif
+
+static unsigned int (*nal_scan_impl)(const uint8_t *data, unsigned int size,
+				     unsigned int *epb_count, bool epb_stop);
+
+static struct nal_scanner nal_scanners_list[NAL_SCANNERS_MAX];
+static unsigned int nal_scanners_count;
+static pthread_once_t nal_scan_once = PTHREAD_ONCE_INIT;
+
+static unsigned int nal_scan_default(const uint8_t *data, unsigned int size,
+				     unsigned int *epb_count, bool epb_stop)
+{
+	return nal_scan_scalar(data, size, 0, epb_count, epb_stop);
+}
+
+static void nal_scanner_add(const char *name,
+			    unsigned int (*scan)(const uint8_t *data,
+						 unsigned int size,
+						 unsigned int *epb_count,
+						 bool epb_stop))
+{
+	nal_scanners_list[nal_scanners_count].name = name;
+	nal_scanners_list[nal_scanners_count].scan = scan;
+	nal_scanners_count++;
+}
+
+/* List the kernels the CPU supports and use the last, fastest one. */
+static void nal_scan_select(void)
+{
+	nal_scanner_add("scalar", nal_scan_default);
+
+#if defined(__x86_64__) || defined(__i386__)
+#ifdef __SSE2__
+	nal_scanner_add("sse2", nal_scan_sse2);
+#endif
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		nal_scanner_add("avx2", nal_scan_avx2);
+#elif defined(__aarch64__)
+	nal_scanner_add("neon", nal_scan_neon);
+#endif
+
+	nal_scan_impl = nal_scanners_list[nal_scanners_count - 1].scan;
+}
+
+/* Return the scan kernels supported by the CPU, the scalar one first. */
+unsigned int nal_scanners(const struct nal_scanner **scanners)
+{
+	pthread_once(&nal_scan_once, nal_scan_select);
+
+	*scanners = nal_scanners_list;
+
+	return nal_scanners_count;
+}
+
+/*
+ * Return the offset of the next 00 00 01 start code or the size of the data
+ * if there is none, and add the number of emulation prevention bytes found
+ * before it to epb_count.
+ */
+unsigned int nal_find_start_code(const uint8_t *data, unsigned int size,
+				 unsigned int *epb_count)
+{
+	pthread_once(&nal_scan_once, nal_scan_select);
+
+	return nal_scan_impl(data, size, epb_count, false);
+}
+
+/*
+ * Copy escaped data to its RBSP form, without the emulation prevention bytes.
+ * Start codes are kept as-is. Return the size of the converted data.
+ */
+unsigned int nal_unescape(uint8_t *destination, const uint8_t *source,
+			  unsigned int size)
+{
+	unsigned int epb_count = 0;
+	unsigned int offset = 0;
+	unsigned int next;
+	unsigned int i = 0;
+
+	pthread_once(&nal_scan_once, nal_scan_select);
+
+	while (i < size) {
+		next = i + nal_scan_impl(source + i, size - i, &epb_count,
+					 true);
+		if (next == size) {
+			memcpy(destination + offset, source + i, size - i);
+			offset += size - i;
+			break;
+		}
+
+		/* Copy up to the two zero bytes of the sequence. */
+		memcpy(destination + offset, source + i, next + 2 - i);
+		offset += next + 2 - i;
+
+		if (source[next + 2] == NAL_EPB)
+			i = next + 3;
+		else
+			i = next + 2;
+	}
+
+	return offset;
+}
+
+static int nal_index_append(struct nal_index *index, enum nal_codec codec,
+			    const uint8_t *data, unsigned int start,
+			    unsigned int end, bool start_code,
+			    unsigned int epb_count, unsigned int base,
+			    bool rbsp)
+{
+	struct nal_unit *units;
+	struct nal_unit *unit;
+	unsigned int allocated;
+	unsigned int type = 0;
+	unsigned int temporal_id = 0;
+
+	/* Trailing zero bytes belong to the next start code. */
+	while (end > start && data[end - 1] == 0)
+		end--;
+
+	if (end == start)
+		return 0;
+
+	if (index->count == index->allocated) {
+		allocated = index->allocated ? index->allocated * 2 : 16;
+
+		units = realloc(index->units, allocated * sizeof(*units));
+		if (units == NULL)
+			return -1;
+
+		index->units = units;
+		index->allocated = allocated;
+	}
+
+	switch (codec) {
+	case NAL_CODEC_MPEG2:
+		/* Buffers without a start code only carry slice data. */
+		type = start_code ? data[start] : MPEG2_SLICE_START_CODE_MIN;
+		epb_count = 0;
+		break;
+
+	case NAL_CODEC_H264:
+		type = data[start] & H264_NAL_UNIT_TYPE_MASK;
+
+		if ((type == H264_NAL_PREFIX || type == H264_NAL_SLICE_EXT) &&
+		    end - start >= 4) {
+			if (data[start + 1] & H264_NAL_SVC_EXTENSION_FLAG)
+				temporal_id = data[start + 3] >> 5;
+			else
+				temporal_id = (data[start + 3] >> 3) & 0x7;
+		}
+		break;
+
+	case NAL_CODEC_H265:
+		type = (data[start] >> H265_NAL_UNIT_TYPE_SHIFT) &
+		       H265_NAL_UNIT_TYPE_MASK;
+
+		if (end - start >= 2 &&
+		    (data[start + 1] & H265_NUH_TEMPORAL_ID_PLUS1_MASK) > 0)
+			temporal_id = (data[start + 1] &
+				       H265_NUH_TEMPORAL_ID_PLUS1_MASK) - 1;
+		break;
+	}
+
+	unit = &index->units[index->count++];
+	unit->type = type;
+	unit->temporal_id = temporal_id;
+	unit->offset = base + start;
+	unit->size = end - start;
+	unit->epb_count = epb_count;
+
+	if (rbsp)
+		unit->size -= epb_count;
+
+	return 0;
+}
+
+/*
+ * Append the units found in a slice buffer located at the base offset of the
+ * frame data. Buffers usually hold a single unit without a start code.
+ * Offsets and sizes describe the RBSP form of the data when requested.
+ */
+int nal_index_scan(struct nal_index *index, enum nal_codec codec,
+		   const uint8_t *data, unsigned int size, unsigned int base,
+		   bool rbsp)
+{
+	unsigned int epb_count;
+	unsigned int removed = 0;
+	unsigned int start = 0;
+	unsigned int next;
+	bool start_code = false;
+	int rc;
+
+	while (start < size) {
+		epb_count = 0;
+		next = start + nal_find_start_code(data + start, size - start,
+						   &epb_count);
+
+		rc = nal_index_append(index, codec, data, start, next,
+				      start_code, epb_count, base - removed,
+				      rbsp);
+		if (rc < 0)
+			return rc;
+
+		if (rbsp && codec != NAL_CODEC_MPEG2)
+			removed += epb_count;
+
+		start = next + NAL_START_CODE_SIZE;
+		start_code = true;
+	}
+
+	return 0;
+}
+
+struct nal_unit *nal_index_lookup(struct nal_index *index,
+				  unsigned int offset)
+{
+	struct nal_unit *unit;
+	unsigned int i;
+
+	for (i = index->count; i > 0; i--) {
+		unit = &index->units[i - 1];
+
+		if (offset >= unit->offset && offset < unit->offset + unit->size)
+			return unit;
+	}
+
+	return NULL;
+}
+
+void nal_index_reset(struct nal_index *index)
+{
+	index->count = 0;
+}
+
+void nal_index_destroy(struct nal_index *index)
+{
+	free(index->units);
+
+	index->units = NULL;
+	index->count = 0;
+	index->allocated = 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _NAL_H_
+#define _NAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Values
+ */
+
+#define NAL_SCANNERS_MAX			4
+
+enum nal_codec {
+	NAL_CODEC_MPEG2,
+	NAL_CODEC_H264,
+	NAL_CODEC_H265,
+};
+
+/*
+ * Structures
+ */
+
+struct nal_unit {
+	unsigned int type;
+	unsigned int temporal_id;
+	unsigned int offset;
+	unsigned int size;
+	unsigned int epb_count;
+};
+
+/*
+ * Start code scan kernel: return the offset of the next start code, or of the
+ * next emulation prevention sequence with epb_stop, and count the emulation
+ * prevention sequences before it.
+ */
+struct nal_scanner {
+	const char *name;
+	unsigned int (*scan)(const uint8_t *data, unsigned int size,
+			     unsigned int *epb_count, bool epb_stop);
+};
+
+struct nal_index {
+	struct nal_unit *units;
+	unsigned int count;
+	unsigned int allocated;
+};
+
+/*
+ * Functions
+ */
+
+unsigned int nal_scanners(const struct nal_scanner **scanners);
+unsigned int nal_find_start_code(const uint8_t *data, unsigned int size,
+				 unsigned int *epb_count);
+unsigned int nal_unescape(uint8_t *destination, const uint8_t *source,
+			  unsigned int size);
+int nal_index_scan(struct nal_index *index, enum nal_codec codec,
+		   const uint8_t *data, unsigned int size, unsigned int base,
+		   bool rbsp);
+struct nal_unit *nal_index_lookup(struct nal_index *index,
+				  unsigned int offset);
+void nal_index_reset(struct nal_index *index);
+void nal_index_destroy(struct nal_index *index);
+
+#endif
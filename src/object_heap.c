@@ -26,109 +26,330 @@
 
 #include "object_heap.h"
 
+/*
+ * Bucket n holds heap_increment << n objects, so that the heap grows
+ * geometrically while object indexes stay stable.
+ */
+static int object_heap_bucket_index(struct object_heap *heap, int index,
+	int *object_index)
+{
+	int bucket_index = 31 - __builtin_clz(index / heap->heap_increment + 1);
+
+	*object_index = index - heap->heap_increment * ((1 << bucket_index) - 1);
+
+	return bucket_index;
+}
+
+static struct object_base *object_heap_object(struct object_heap *heap,
+	int index)
+{
+	int bucket_index, object_index;
+
+	bucket_index = object_heap_bucket_index(heap, index, &object_index);
+
+	return (struct object_base *)(heap->bucket[bucket_index] + object_index * heap->object_size);
+}
+
+static int object_heap_bucket_start(struct object_heap *heap, int bucket_index)
+{
+	return heap->heap_increment * ((1 << bucket_index) - 1);
+}
+
+/*
+ * Populate the lowest bucket that was reclaimed, or add a new one. Objects keep
+ * the ID matching their position either way.
+ */
 static int object_heap_expand(struct object_heap *heap)
 {
 	struct object_base *object;
 	void *new_heap_index;
-	int new_heap_size = heap->heap_size + heap->heap_increment;
-	int bucket_index = new_heap_size / heap->heap_increment - 1;
+	int bucket_index;
+	int bucket_size;
+	int bucket_start;
 	int next_free;
+	int rc;
 	int i;
 
-	if (bucket_index >= heap->num_buckets) {
-		int new_num_buckets = heap->num_buckets + 8;
-		void **new_bucket;
+	for (bucket_index = 0; bucket_index < heap->num_buckets; bucket_index++)
+		if (heap->bucket[bucket_index] == NULL)
+			break;
 
-		new_bucket = realloc(heap->bucket, new_num_buckets * sizeof(void *));
-		if (new_bucket == NULL)
-			return -1;
+	bucket_size = heap->heap_increment << bucket_index;
+	bucket_start = object_heap_bucket_start(heap, bucket_index);
 
-		heap->num_buckets = new_num_buckets;
-		heap->bucket = new_bucket;
-	}
+	if (bucket_index >= OBJECT_HEAP_BUCKETS_MAX ||
+	    bucket_start + bucket_size > OBJECT_HEAP_ID_MASK)
+		return -1;
 
-	new_heap_index = malloc(heap->heap_increment * heap->object_size);
-	if (new_heap_index == NULL)
+	rc = posix_memalign(&new_heap_index, OBJECT_HEAP_ALIGNMENT,
+			    bucket_size * heap->object_size);
+	if (rc != 0)
 		return -1;
 
-	heap->bucket[bucket_index] = new_heap_index;
-	next_free = heap->next_free;
+	next_free = OBJECT_HEAP_LAST;
 
-	for (i = new_heap_size; i-- > heap->heap_size;) {
-		object = (struct object_base *)(new_heap_index + (i - heap->heap_size) * heap->object_size);
+	for (i = bucket_start + bucket_size; i-- > bucket_start;) {
+		object = (struct object_base *)(new_heap_index + (i - bucket_start) * heap->object_size);
 		object->id = i + heap->id_offset;
 		object->next_free = next_free;
 		next_free = i;
 	}
 
-	heap->next_free = next_free;
-	heap->heap_size = new_heap_size;
+	heap->bucket[bucket_index] = new_heap_index;
+	heap->bucket_free[bucket_index] = next_free;
+	heap->bucket_used[bucket_index] = 0;
+	heap->free_mask |= 1U << bucket_index;
+
+	if (bucket_index == heap->num_buckets) {
+		heap->num_buckets++;
+		heap->heap_size = bucket_start + bucket_size;
+	}
 
 	return 0;
 }
 
-static int object_heap_allocate_unlocked(struct object_heap *heap)
+/*
+ * Give fully free buckets back once the objects in use fit in half of the
+ * buckets below them, so that a pool that is destroyed and created again at a
+ * similar size does not reallocate. The first bucket is always kept.
+ */
+static void object_heap_reclaim(struct object_heap *heap)
+{
+	int bucket_index;
+
+	for (bucket_index = heap->num_buckets - 1; bucket_index > 0; bucket_index--) {
+		if (heap->bucket[bucket_index] == NULL ||
+		    heap->bucket_used[bucket_index] > 0)
+			continue;
+
+		if (heap->used_count > object_heap_bucket_start(heap, bucket_index) / 2)
+			break;
+
+		free(heap->bucket[bucket_index]);
+		heap->bucket[bucket_index] = NULL;
+		heap->bucket_free[bucket_index] = OBJECT_HEAP_LAST;
+		heap->free_mask &= ~(1U << bucket_index);
+	}
+}
+
+/* Objects are taken from the lowest bucket, leaving higher ones to empty out. */
+static struct object_base *object_heap_allocate_unlocked(struct object_heap *heap)
 {
 	struct object_base *object;
-	int bucket_index, object_index;
+	int bucket_index;
 
-	if (heap->next_free == OBJECT_HEAP_LAST)
+	if (heap->free_mask == 0)
 		if (object_heap_expand(heap) == -1)
-			return -1;
+			return NULL;
 
-	if (heap->next_free < 0)
-		return -1;
+	bucket_index = __builtin_ctz(heap->free_mask);
 
-	bucket_index = heap->next_free / heap->heap_increment;
-	object_index = heap->next_free % heap->heap_increment;
-
-	object = (struct object_base *) (heap->bucket[bucket_index] + object_index * heap->object_size);
-	heap->next_free = object->next_free;
+	object = object_heap_object(heap, heap->bucket_free[bucket_index]);
+	heap->bucket_free[bucket_index] = object->next_free;
 	object->next_free = OBJECT_HEAP_ALLOCATED;
 
-	return object->id;
+	if (heap->bucket_free[bucket_index] == OBJECT_HEAP_LAST)
+		heap->free_mask &= ~(1U << bucket_index);
+
+	heap->bucket_used[bucket_index]++;
+	heap->used_count++;
+
+	return object;
+}
+
+static void object_heap_free_unlocked(struct object_heap *heap,
+	struct object_base *object)
+{
+	int index = object->id & OBJECT_HEAP_ID_MASK;
+	int bucket_index, object_index;
+
+	/* Freeing an object twice would loop the free list. */
+	if (object->next_free != OBJECT_HEAP_ALLOCATED)
+		return;
+
+	bucket_index = object_heap_bucket_index(heap, index, &object_index);
+
+	object->next_free = heap->bucket_free[bucket_index];
+	heap->bucket_free[bucket_index] = index;
+	heap->free_mask |= 1U << bucket_index;
+
+	heap->bucket_used[bucket_index]--;
+	heap->used_count--;
 }
 
 int object_heap_init(struct object_heap *heap, int object_size, int id_offset)
 {
 	pthread_mutex_init(&heap->mutex, NULL);
 
-	heap->object_size = object_size;
+	/* Keep objects on their own cache lines. */
+	heap->object_size = (object_size + OBJECT_HEAP_ALIGNMENT - 1) &
+			    ~(OBJECT_HEAP_ALIGNMENT - 1);
 	heap->id_offset = id_offset & OBJECT_HEAP_OFFSET_MASK;
 	heap->heap_size = 0;
-	heap->heap_increment = 16;
-	heap->next_free = OBJECT_HEAP_LAST;
+	heap->heap_increment = OBJECT_HEAP_INCREMENT;
 	heap->num_buckets = 0;
-	heap->bucket = NULL;
+	heap->free_mask = 0;
+	heap->used_count = 0;
+	heap->aliases = NULL;
+	heap->aliases_size = 0;
+	heap->aliases_used = 0;
+	heap->aliases_count = 0;
 
 	return object_heap_expand(heap);
 }
 
 int object_heap_allocate(struct object_heap *heap)
 {
-	int rc;
+	struct object_base *object;
 
 	pthread_mutex_lock(&heap->mutex);
-	rc = object_heap_allocate_unlocked(heap);
+	object = object_heap_allocate_unlocked(heap);
 	pthread_mutex_unlock(&heap->mutex);
 
-	return rc;
+	if (object == NULL)
+		return -1;
+
+	return object->id;
+}
+
+/*
+ * Allocate count objects at once, returning their IDs and optionally the
+ * objects themselves. Either all of them are allocated or none is.
+ */
+int object_heap_allocate_bulk(struct object_heap *heap, int count, int *ids,
+	struct object_base **objects)
+{
+	struct object_base *object;
+	int i;
+
+	pthread_mutex_lock(&heap->mutex);
+
+	for (i = 0; i < count; i++) {
+		object = object_heap_allocate_unlocked(heap);
+		if (object == NULL)
+			break;
+
+		ids[i] = object->id;
+
+		if (objects != NULL)
+			objects[i] = object;
+	}
+
+	if (i < count) {
+		while (i-- > 0)
+			object_heap_free_unlocked(heap, object_heap_object(heap, ids[i] & OBJECT_HEAP_ID_MASK));
+
+		object_heap_reclaim(heap);
+		pthread_mutex_unlock(&heap->mutex);
+		return -1;
+	}
+
+	pthread_mutex_unlock(&heap->mutex);
+
+	return 0;
+}
+
+/* Aliases are kept in an open addressing table with linear probing. */
+static struct object_heap_alias *object_heap_alias_find(struct object_heap *heap,
+	int id)
+{
+	struct object_heap_alias *alias;
+	unsigned int mask = heap->aliases_size - 1;
+	unsigned int slot = ((unsigned int) id * 2654435761U) & mask;
+
+	while (1) {
+		alias = &heap->aliases[slot];
+		if (alias->index == OBJECT_HEAP_ALIAS_EMPTY)
+			return NULL;
+
+		if (alias->index != OBJECT_HEAP_ALIAS_REMOVED && alias->id == id)
+			return alias;
+
+		slot = (slot + 1) & mask;
+	}
+}
+
+static void object_heap_alias_insert(struct object_heap *heap, int id,
+	int index)
+{
+	struct object_heap_alias *alias;
+	unsigned int mask = heap->aliases_size - 1;
+	unsigned int slot = ((unsigned int) id * 2654435761U) & mask;
+
+	while (1) {
+		alias = &heap->aliases[slot];
+		if (alias->index < 0)
+			break;
+
+		slot = (slot + 1) & mask;
+	}
+
+	if (alias->index == OBJECT_HEAP_ALIAS_EMPTY)
+		heap->aliases_used++;
+
+	heap->aliases_count++;
+
+	alias->id = id;
+	alias->index = index;
+}
+
+/* Rebuild the table without removed entries. */
+static int object_heap_alias_resize(struct object_heap *heap, int size)
+{
+	struct object_heap_alias *aliases = heap->aliases;
+	int aliases_size = heap->aliases_size;
+	int i;
+
+	heap->aliases = malloc(size * sizeof(*heap->aliases));
+	if (heap->aliases == NULL) {
+		heap->aliases = aliases;
+		return -1;
+	}
+
+	for (i = 0; i < size; i++)
+		heap->aliases[i].index = OBJECT_HEAP_ALIAS_EMPTY;
+
+	heap->aliases_size = size;
+	heap->aliases_used = 0;
+	heap->aliases_count = 0;
+
+	for (i = 0; i < aliases_size; i++)
+		if (aliases[i].index >= 0)
+			object_heap_alias_insert(heap, aliases[i].id,
+						 aliases[i].index);
+
+	free(aliases);
+
+	return 0;
 }
 
 static struct object_base *object_heap_lookup_unlocked(struct object_heap *heap,
 	int id)
 {
+	struct object_heap_alias *alias;
 	struct object_base *object;
 	int bucket_index, object_index;
 
-	if ((id < heap->id_offset) || (id > (heap->heap_size + heap->id_offset)))
+	if (heap->aliases != NULL) {
+		alias = object_heap_alias_find(heap, id);
+		if (alias == NULL)
+			return NULL;
+
+		id = alias->index + heap->id_offset;
+	}
+
+	if ((id & OBJECT_HEAP_OFFSET_MASK) != heap->id_offset)
 		return NULL;
 
 	id &= OBJECT_HEAP_ID_MASK;
-	bucket_index = id / heap->heap_increment;
-	object_index = id % heap->heap_increment;
+	if (id >= heap->heap_size)
+		return NULL;
 
-	object = (struct object_base *)(heap->bucket[bucket_index] + object_index * heap->object_size);
+	bucket_index = object_heap_bucket_index(heap, id, &object_index);
+	if (heap->bucket[bucket_index] == NULL)
+		return NULL;
+
+	object = object_heap_object(heap, id);
 
 	if (object->next_free != OBJECT_HEAP_ALLOCATED)
 		return NULL;
@@ -162,10 +383,13 @@ static struct object_base *object_heap_next_unlocked(struct object_heap *heap,
 	int i = *iterator + 1;
 
 	while (i < heap->heap_size) {
-		bucket_index = i / heap->heap_increment;
-		object_index = i % heap->heap_increment;
+		bucket_index = object_heap_bucket_index(heap, i, &object_index);
+		if (heap->bucket[bucket_index] == NULL) {
+			i = object_heap_bucket_start(heap, bucket_index + 1);
+			continue;
+		}
 
-		object = (struct object_base *)(heap->bucket[bucket_index] + object_index * heap->object_size);
+		object = object_heap_object(heap, i);
 		if (object->next_free == OBJECT_HEAP_ALLOCATED) {
 			*iterator = i;
 			return object;
@@ -190,13 +414,6 @@ struct object_base *object_heap_next(struct object_heap *heap, int *iterator)
 	return object;
 }
 
-static void object_heap_free_unlocked(struct object_heap *heap,
-	struct object_base *object)
-{
-	object->next_free = heap->next_free;
-	heap->next_free = object->id & OBJECT_HEAP_ID_MASK;
-}
-
 void object_heap_free(struct object_heap *heap, struct object_base *object)
 {
 	if (!object)
@@ -204,6 +421,23 @@ void object_heap_free(struct object_heap *heap, struct object_base *object)
 
 	pthread_mutex_lock(&heap->mutex);
 	object_heap_free_unlocked(heap, object);
+	object_heap_reclaim(heap);
+	pthread_mutex_unlock(&heap->mutex);
+}
+
+void object_heap_free_bulk(struct object_heap *heap,
+	struct object_base **objects, int count)
+{
+	int i;
+
+	pthread_mutex_lock(&heap->mutex);
+
+	for (i = 0; i < count; i++)
+		if (objects[i] != NULL)
+			object_heap_free_unlocked(heap, objects[i]);
+
+	object_heap_reclaim(heap);
+
 	pthread_mutex_unlock(&heap->mutex);
 }
 
@@ -211,13 +445,90 @@ void object_heap_destroy(struct object_heap *heap)
 {
 	int i;
 
-	for (i = 0; i < heap->heap_size / heap->heap_increment; i++)
+	for (i = 0; i < heap->num_buckets; i++) {
 		free(heap->bucket[i]);
+		heap->bucket[i] = NULL;
+	}
+
+	free(heap->aliases);
+	heap->aliases = NULL;
+	heap->aliases_size = 0;
+	heap->aliases_used = 0;
+	heap->aliases_count = 0;
 
 	pthread_mutex_destroy(&heap->mutex);
 
-	free(heap->bucket);
-	heap->bucket = NULL;
+	heap->num_buckets = 0;
 	heap->heap_size = 0;
-	heap->next_free = OBJECT_HEAP_LAST;
+	heap->free_mask = 0;
+	heap->used_count = 0;
+}
+
+int object_heap_alias_enable(struct object_heap *heap)
+{
+	int rc;
+
+	pthread_mutex_lock(&heap->mutex);
+	rc = object_heap_alias_resize(heap, OBJECT_HEAP_ALIASES_MIN);
+	pthread_mutex_unlock(&heap->mutex);
+
+	return rc;
+}
+
+/* Make objects reachable by their own IDs again, dropping all the aliases. */
+void object_heap_alias_disable(struct object_heap *heap)
+{
+	pthread_mutex_lock(&heap->mutex);
+
+	free(heap->aliases);
+	heap->aliases = NULL;
+	heap->aliases_size = 0;
+	heap->aliases_used = 0;
+	heap->aliases_count = 0;
+
+	pthread_mutex_unlock(&heap->mutex);
+}
+
+/* Make an object reachable by the ID given by another driver, only. */
+int object_heap_alias(struct object_heap *heap, struct object_base *object,
+	int id)
+{
+	struct object_heap_alias *alias;
+	int rc = 0;
+
+	pthread_mutex_lock(&heap->mutex);
+
+	/* Grow the table when live aliases fill a quarter of it once rebuilt. */
+	if ((heap->aliases_used + 1) * 2 > heap->aliases_size)
+		rc = object_heap_alias_resize(heap,
+			(heap->aliases_count + 1) * 4 > heap->aliases_size ?
+			heap->aliases_size * 2 : heap->aliases_size);
+
+	if (rc == 0) {
+		alias = object_heap_alias_find(heap, id);
+		if (alias != NULL)
+			alias->index = object->id & OBJECT_HEAP_ID_MASK;
+		else
+			object_heap_alias_insert(heap, id,
+						 object->id & OBJECT_HEAP_ID_MASK);
+	}
+
+	pthread_mutex_unlock(&heap->mutex);
+
+	return rc;
+}
+
+void object_heap_unalias(struct object_heap *heap, int id)
+{
+	struct object_heap_alias *alias;
+
+	pthread_mutex_lock(&heap->mutex);
+
+	alias = object_heap_alias_find(heap, id);
+	if (alias != NULL) {
+		alias->index = OBJECT_HEAP_ALIAS_REMOVED;
+		heap->aliases_count--;
+	}
+
+	pthread_mutex_unlock(&heap->mutex);
 }
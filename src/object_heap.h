@@ -37,6 +37,14 @@
 #define OBJECT_HEAP_LAST					-1
 #define OBJECT_HEAP_ALLOCATED					-2
 
+#define OBJECT_HEAP_INCREMENT					16
+#define OBJECT_HEAP_BUCKETS_MAX					20
+#define OBJECT_HEAP_ALIGNMENT					64
+
+#define OBJECT_HEAP_ALIASES_MIN					64
+#define OBJECT_HEAP_ALIAS_EMPTY					-1
+#define OBJECT_HEAP_ALIAS_REMOVED				-2
+
 /*
  * Structures
  */
@@ -47,15 +55,31 @@ struct object_base {
 	int next_free;
 };
 
+/*
+ * Heaps with aliases hold objects created by another driver, that are only
+ * looked up by the IDs it gave them.
+ */
+struct object_heap_alias {
+	int id;
+	int index;
+};
+
 struct object_heap {
 	pthread_mutex_t mutex;
 	int object_size;
 	int id_offset;
-	int next_free;
 	int heap_size;
 	int heap_increment;
-	void **bucket;
+	void *bucket[OBJECT_HEAP_BUCKETS_MAX];
+	int bucket_free[OBJECT_HEAP_BUCKETS_MAX];
+	int bucket_used[OBJECT_HEAP_BUCKETS_MAX];
+	unsigned int free_mask;
 	int num_buckets;
+	int used_count;
+	struct object_heap_alias *aliases;
+	int aliases_size;
+	int aliases_used;
+	int aliases_count;
 };
 
 /*
@@ -64,10 +88,19 @@ struct object_heap {
 
 int object_heap_init(struct object_heap *heap, int object_size, int id_offset);
 int object_heap_allocate(struct object_heap *heap);
+int object_heap_allocate_bulk(struct object_heap *heap, int count, int *ids,
+	struct object_base **objects);
 struct object_base *object_heap_lookup(struct object_heap *heap, int id);
 struct object_base *object_heap_first(struct object_heap *heap, int *iterator);
 struct object_base *object_heap_next(struct object_heap *heap, int *iterator);
 void object_heap_free(struct object_heap *heap, struct object_base *object);
+void object_heap_free_bulk(struct object_heap *heap,
+	struct object_base **objects, int count);
 void object_heap_destroy(struct object_heap *heap);
+int object_heap_alias_enable(struct object_heap *heap);
+void object_heap_alias_disable(struct object_heap *heap);
+int object_heap_alias(struct object_heap *heap, struct object_base *object,
+	int id);
+void object_heap_unalias(struct object_heap *heap, int id);
 
 #endif
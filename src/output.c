@@ -0,0 +1,1269 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "dump.h"
+#include "columnar.h"
+#include "config.h"
+#include "context.h"
+#include "hash.h"
+#include "header.h"
+#include "output.h"
+#include "direct.h"
+#include "es.h"
+#include "golden.h"
+#include "governor.h"
+#include "index.h"
+#include "picture.h"
+#include "probe.h"
+#include "ring.h"
+#include "stats.h"
+#include "stream.h"
+#include "surface.h"
+#include "trace.h"
+#include "log.h"
+
+/*
+ * Expand a path template:
+ * - %p: process id
+ * - %c: context id
+ * - %D: current date and time
+ * - %s: shard number
+ * - %f: first frame of the shard
+ * - %l: last frame of the shard
+ */
+static void output_expand(char *buffer, unsigned int size, const char *format,
+			  unsigned int context_id, unsigned int shard_index,
+			  unsigned int first, unsigned int last)
+{
+	unsigned int length = 0;
+	struct tm date;
+	time_t now;
+	int rc;
+
+	buffer[0] = '\0';
+
+	while (*format != '\0' && length < size - 1) {
+		if (format[0] != '%' || format[1] == '\0') {
+			buffer[length++] = *format++;
+			buffer[length] = '\0';
+			continue;
+		}
+
+		switch (format[1]) {
+		case 'p':
+			rc = snprintf(buffer + length, size - length, "%d",
+				      (int)getpid());
+			break;
+		case 'c':
+			rc = snprintf(buffer + length, size - length, "%x",
+				      context_id);
+			break;
+		case 'D':
+			now = time(NULL);
+			localtime_r(&now, &date);
+			rc = strftime(buffer + length, size - length,
+				      "%Y%m%d-%H%M%S", &date);
+			break;
+		case 's':
+			rc = snprintf(buffer + length, size - length, "%06u",
+				      shard_index);
+			break;
+		case 'f':
+			rc = snprintf(buffer + length, size - length, "%06u",
+				      first);
+			break;
+		case 'l':
+			rc = snprintf(buffer + length, size - length, "%06u",
+				      last);
+			break;
+		default:
+			rc = snprintf(buffer + length, size - length, "%c",
+				      format[1]);
+			break;
+		}
+
+		if (rc < 0 || length + rc >= size)
+			break;
+
+		length += rc;
+		format += 2;
+	}
+}
+
+/*
+ * The dump directory is created before any context or shard exists, so its
+ * template can only hold the sequences that are known at that point.
+ */
+static int output_path_check(const char *format)
+{
+	while ((format = strchr(format, '%')) != NULL && format[1] != '\0') {
+		if (strchr("csfl", format[1]) != NULL) {
+			log_error("Unable to expand %%%c in the dump path, which only supports %%p and %%D\n",
+				  format[1]);
+			return -1;
+		}
+
+		format += 2;
+	}
+
+	return 0;
+}
+
+static int output_mkdir(const char *path)
+{
+	char buffer[PATH_MAX];
+	char *p;
+	int rc;
+
+	if (strlen(path) >= sizeof(buffer))
+		return -1;
+
+	strcpy(buffer, path);
+
+	for (p = buffer + 1; ; p++) {
+		if (*p != '/' && *p != '\0')
+			continue;
+
+		if (*p == '/')
+			*p = '\0';
+		else
+			p = NULL;
+
+		rc = mkdir(buffer, 0755);
+		if (rc < 0 && errno != EEXIST) {
+			log_error("Unable to create dump directory %s: %s\n",
+				buffer, strerror(errno));
+			return -1;
+		}
+
+		if (p == NULL)
+			break;
+
+		*p = '/';
+	}
+
+	return 0;
+}
+
+/* Hash and golden modes already reduce every frame to its checksums. */
+static bool output_hashed(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+
+	return driver_data->governor.level == GOVERNOR_HASH &&
+	       output->mode != OUTPUT_MODE_HASH &&
+	       output->mode != OUTPUT_MODE_GOLDEN;
+}
+
+static bool output_sharded(struct output *output)
+{
+	return output->shard_frames > 0 || output->shard_bytes > 0;
+}
+
+static int output_shard_open(struct dump_driver_data *driver_data,
+			     unsigned int context_id, unsigned int index)
+{
+	struct output *output = &driver_data->output;
+	char name[PATH_MAX];
+	unsigned int last;
+	int rc;
+
+	/* The last frame is only known ahead of time with frame rotation. */
+	if (output->shard_frames > 0)
+		last = index + output->shard_frames - 1;
+	else
+		last = driver_data->dump_count - 1;
+
+	if (last >= driver_data->dump_count)
+		last = driver_data->dump_count - 1;
+
+	output_expand(name, sizeof(name), output->shard_format, context_id,
+		      output->shard_index, index, last);
+
+	rc = asprintf(&output->shard_path, "%s/%s", output->path, name);
+	if (rc < 0) {
+		output->shard_path = NULL;
+		return -1;
+	}
+
+	rc = output_mkdir(output->shard_path);
+	if (rc < 0) {
+		free(output->shard_path);
+		output->shard_path = NULL;
+		return -1;
+	}
+
+	output->shard_open = true;
+	output->shard_first = index;
+	output->shard_last = index;
+	output->shard_count = 0;
+	output->shard_size = 0;
+
+	return 0;
+}
+
+static void output_shard_close(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+
+	if (!output->shard_open)
+		return;
+
+	if (output->manifest != NULL) {
+		fprintf(output->manifest, "%s %u %u %u %llu\n",
+			output->shard_path + strlen(output->path) + 1,
+			output->shard_first, output->shard_last,
+			output->shard_count, output->shard_size);
+		fflush(output->manifest);
+	}
+
+	free(output->shard_path);
+	output->shard_path = NULL;
+	output->shard_open = false;
+	output->shard_index++;
+}
+
+/*
+ * All the slices are written to a single file in direct mode, with an index of
+ * the frame offsets in a separate file.
+ */
+static int output_direct_init(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+	char *direct_path;
+	char *index_path;
+	int rc;
+
+	rc = asprintf(&direct_path, "%s/%s", output->path,
+		      OUTPUT_DIRECT_FILENAME);
+	if (rc < 0)
+		return -1;
+
+	rc = direct_open(&output->direct, direct_path,
+			 output->direct_buffer_size,
+			 output->direct_buffer_count);
+	free(direct_path);
+	if (rc < 0)
+		return -1;
+
+	rc = asprintf(&index_path, "%s/%s", output->path,
+		      OUTPUT_DIRECT_INDEX_FILENAME);
+	if (rc < 0)
+		goto error;
+
+	output->direct_index = fopen(index_path, "w");
+	if (output->direct_index == NULL) {
+		log_error("Unable to open direct dump index %s: %s\n",
+			index_path, strerror(errno));
+		free(index_path);
+		goto error;
+	}
+
+	free(index_path);
+
+	fprintf(output->direct_index, "# frame offset size\n");
+
+	return 0;
+
+error:
+	direct_close(&output->direct);
+
+	return -1;
+}
+
+/* Only checksums of the slices and parameters are kept in hash mode. */
+static int output_hash_init(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+	char *manifest_path;
+	int rc;
+
+	rc = asprintf(&manifest_path, "%s/%s", output->path,
+		      OUTPUT_HASH_FILENAME);
+	if (rc < 0)
+		return -1;
+
+	output->hash_manifest = fopen(manifest_path, "w");
+	if (output->hash_manifest == NULL) {
+		log_error("Unable to open hash manifest %s: %s\n",
+			manifest_path, strerror(errno));
+		free(manifest_path);
+		return -1;
+	}
+
+	free(manifest_path);
+
+	fprintf(output->hash_manifest,
+		"# frame crc32c parameters_crc32c size slices crc32c:size...\n");
+
+	return 0;
+}
+
+/*
+ * Frames are hashed as in hash mode and compared against a golden manifest,
+ * only the divergent ones are saved.
+ */
+static int output_golden_init(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+	char *report_path;
+	int rc;
+
+	rc = golden_load(&output->golden, output->golden_path);
+	if (rc < 0)
+		return -1;
+
+	rc = output_hash_init(driver_data);
+	if (rc < 0)
+		return -1;
+
+	rc = asprintf(&report_path, "%s/%s", output->path,
+		      GOLDEN_REPORT_FILENAME);
+	if (rc < 0)
+		return -1;
+
+	output->golden.report = fopen(report_path, "w");
+	if (output->golden.report == NULL) {
+		log_error("Unable to open golden report %s: %s\n",
+			report_path, strerror(errno));
+		free(report_path);
+		return -1;
+	}
+
+	free(report_path);
+
+	fprintf(output->golden.report, "# frame reason\n");
+
+	return 0;
+}
+
+static void output_hash_slice(struct dump_driver_data *driver_data,
+			      const void *data, unsigned int size)
+{
+	struct output *output = &driver_data->output;
+	struct output_hash *hashes;
+	unsigned int allocated;
+
+	if (output->slice_hashes_count == output->slice_hashes_allocated) {
+		allocated = output->slice_hashes_allocated * 2 + 16;
+
+		hashes = realloc(output->slice_hashes,
+				 allocated * sizeof(*hashes));
+		if (hashes == NULL)
+			return;
+
+		output->slice_hashes = hashes;
+		output->slice_hashes_allocated = allocated;
+	}
+
+	hashes = &output->slice_hashes[output->slice_hashes_count++];
+	hashes->crc = hash_crc32c(0, data, size);
+	hashes->size = size;
+
+	output->frame_crc = hash_crc32c(output->frame_crc, data, size);
+	output->frame_size += size;
+}
+
+static void output_hash_frame(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+	unsigned int i;
+
+	fprintf(output->hash_manifest, "%u %08x %08x %llu %u",
+		output->frame_index, output->frame_crc,
+		output->parameters_crc, output->frame_size,
+		output->slice_hashes_count);
+
+	for (i = 0; i < output->slice_hashes_count; i++)
+		fprintf(output->hash_manifest, " %08x:%u",
+			output->slice_hashes[i].crc,
+			output->slice_hashes[i].size);
+
+	fprintf(output->hash_manifest, "\n");
+	fflush(output->hash_manifest);
+}
+
+static FILE *output_index_open(struct dump_driver_data *driver_data,
+			       const char *filename, enum index_kind kind,
+			       unsigned int record_size)
+{
+	struct output *output = &driver_data->output;
+	struct index_header header;
+	char *index_path;
+	FILE *file;
+	int rc;
+
+	rc = asprintf(&index_path, "%s/%s", output->path, filename);
+	if (rc < 0)
+		return NULL;
+
+	file = fopen(index_path, "w");
+	if (file == NULL) {
+		log_error("Unable to open frame index %s: %s\n", index_path,
+			strerror(errno));
+		free(index_path);
+		return NULL;
+	}
+
+	free(index_path);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.kind = kind;
+	header.record_size = record_size;
+	header.mode = output->mode;
+
+	fwrite(&header, sizeof(header), 1, file);
+
+	return file;
+}
+
+/*
+ * A frame index is written along with any output that has a directory, so that
+ * frames and their slices can be found without scanning the whole capture.
+ */
+static int output_index_init(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+
+	output->index_frames = output_index_open(driver_data,
+						 INDEX_FRAMES_FILENAME,
+						 INDEX_KIND_FRAMES,
+						 sizeof(struct index_frame));
+	if (output->index_frames == NULL)
+		return -1;
+
+	output->index_slices = output_index_open(driver_data,
+						 INDEX_SLICES_FILENAME,
+						 INDEX_KIND_SLICES,
+						 sizeof(struct index_slice));
+	if (output->index_slices == NULL) {
+		fclose(output->index_frames);
+		output->index_frames = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void output_index_begin(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+	struct index_frame *frame = &output->index_frame;
+	off_t offset = -1;
+
+	if (output->index_frames == NULL)
+		return;
+
+	memset(frame, 0, sizeof(*frame));
+	frame->frame = output->frame_index;
+	frame->context_id = output->frame_context_id;
+	frame->shard = INDEX_NONE;
+	frame->slice_first = output->index_slices_count;
+
+	if (output->mode == OUTPUT_MODE_DIRECT ||
+	    output->mode == OUTPUT_MODE_ES)
+		frame->slice_offset = output->frame_offset;
+
+	/* Metadata of the frame is only printed right away outside golden mode. */
+	if (output->mode != OUTPUT_MODE_GOLDEN)
+		offset = ftello(stdout);
+
+	frame->metadata_offset = offset >= 0 ? (uint64_t) offset :
+				 INDEX_OFFSET_NONE;
+}
+
+static void output_index_slice(struct dump_driver_data *driver_data,
+			       unsigned long long offset, unsigned int size)
+{
+	struct output *output = &driver_data->output;
+	struct index_frame *frame = &output->index_frame;
+	struct index_slice *slice = &output->index_slice;
+
+	if (output->index_slices == NULL || !output->frame_open) {
+		memset(slice, 0, sizeof(*slice));
+		return;
+	}
+
+	slice->offset = offset;
+	slice->size = size;
+
+	if (slice->substreams == 0) {
+		slice->substreams = 1;
+		slice->substream_max = size;
+	}
+
+	fwrite(slice, sizeof(*slice), 1, output->index_slices);
+	memset(slice, 0, sizeof(*slice));
+
+	frame->slices_count++;
+	frame->slice_size += size;
+	output->index_slices_count++;
+}
+
+/*
+ * Sort key for display order: picture order counts restart at each IDR picture
+ * for H.264 and H.265 while MPEG-2 B pictures are displayed right before the
+ * anchor picture that precedes them in decode order.
+ */
+static void output_index_order(struct dump_driver_data *driver_data,
+			       VAProfile profile, struct index_frame *frame)
+{
+	VAPictureParameterBufferMPEG2 *mpeg2 = &driver_data->params.mpeg2.picture;
+	VAPictureParameterBufferH264 *h264 = &driver_data->params.h264.picture;
+	VAPictureParameterBufferHEVC *h265 = &driver_data->params.h265.picture;
+	struct nal_index *nal_index = &driver_data->nal_index;
+	struct output *output = &driver_data->output;
+	unsigned int type;
+	bool reset = false;
+	unsigned int i;
+
+	frame->tile_columns = 1;
+	frame->tile_rows = 1;
+
+	switch (picture_nal_codec(profile)) {
+		case NAL_CODEC_MPEG2:
+			frame->codec = INDEX_CODEC_MPEG2;
+
+			if (mpeg2->picture_coding_type == 1)
+				frame->flags |= INDEX_FLAG_KEYFRAME;
+
+			if (mpeg2->picture_coding_type != 3)
+				output->index_anchors++;
+
+			frame->order = output->index_anchors * 2 -
+				       (mpeg2->picture_coding_type == 3 ? 1 : 0);
+			break;
+
+		case NAL_CODEC_H264:
+			frame->codec = INDEX_CODEC_H264;
+
+			for (i = 0; i < nal_index->count; i++)
+				if (nal_index->units[i].type == 5)
+					reset = true;
+
+			if (reset)
+				frame->flags |= INDEX_FLAG_KEYFRAME;
+
+			if ((h264->CurrPic.flags & VA_PICTURE_H264_BOTTOM_FIELD) &&
+			    !(h264->CurrPic.flags & VA_PICTURE_H264_TOP_FIELD))
+				frame->order = h264->CurrPic.BottomFieldOrderCnt;
+			else if ((h264->CurrPic.flags & VA_PICTURE_H264_TOP_FIELD) &&
+				 !(h264->CurrPic.flags & VA_PICTURE_H264_BOTTOM_FIELD))
+				frame->order = h264->CurrPic.TopFieldOrderCnt;
+			else if (h264->CurrPic.TopFieldOrderCnt <
+				 h264->CurrPic.BottomFieldOrderCnt)
+				frame->order = h264->CurrPic.TopFieldOrderCnt;
+			else
+				frame->order = h264->CurrPic.BottomFieldOrderCnt;
+			break;
+
+		case NAL_CODEC_H265:
+			frame->codec = INDEX_CODEC_H265;
+
+			/* IRAP pictures are keyframes, only IDR and BLA reset the count. */
+			for (i = 0; i < nal_index->count; i++) {
+				type = nal_index->units[i].type;
+
+				if (type >= 16 && type <= 23)
+					frame->flags |= INDEX_FLAG_KEYFRAME;
+
+				if (type >= 16 && type <= 20)
+					reset = true;
+			}
+
+			frame->order = h265->CurrPic.pic_order_cnt;
+
+			if (h265->pic_fields.bits.tiles_enabled_flag) {
+				frame->tile_columns = h265->num_tile_columns_minus1 + 1;
+				frame->tile_rows = h265->num_tile_rows_minus1 + 1;
+			}
+
+			if (h265->pic_fields.bits.entropy_coding_sync_enabled_flag)
+				frame->flags |= INDEX_FLAG_WPP;
+			break;
+	}
+
+	if (reset)
+		output->index_sequence++;
+
+	frame->sequence = output->index_sequence;
+}
+
+/* Write the index record of the current frame, once its metadata is printed. */
+void output_index_frame(struct dump_driver_data *driver_data,
+			VAProfile profile, struct object_surface *surface)
+{
+	TRACE_FUNCTION();
+
+	struct output *output = &driver_data->output;
+	struct index_frame *frame = &output->index_frame;
+	struct object_surface *reference;
+	struct index_frame empty;
+	VASurfaceID surfaces[INDEX_REFERENCES_MAX];
+	unsigned int count;
+	unsigned int i;
+	off_t offset;
+
+	/* Hashed frames are described in the metadata only. */
+	if (output->index_frames == NULL || !output->frame_open ||
+	    output_hashed(driver_data))
+		return;
+
+	frame->flags |= INDEX_FLAG_VALID;
+	if (driver_data->slices_rbsp && profile != VAProfileMPEG2Simple &&
+	    profile != VAProfileMPEG2Main)
+		frame->flags |= INDEX_FLAG_RBSP;
+
+	output_index_order(driver_data, profile, frame);
+
+	count = picture_references(driver_data, profile, surfaces);
+
+	for (i = 0; i < count; i++) {
+		reference = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, surfaces[i]);
+		if (reference == NULL || reference == surface)
+			continue;
+
+		frame->references[frame->references_count++] = reference->index;
+	}
+
+	if (frame->metadata_offset != INDEX_OFFSET_NONE) {
+		offset = ftello(stdout);
+		if (offset >= 0)
+			frame->metadata_size = offset - frame->metadata_offset;
+	}
+
+	/* Keep frame N at record N for frames that were not dumped. */
+	memset(&empty, 0, sizeof(empty));
+
+	while (output->index_frames_count < frame->frame) {
+		empty.frame = output->index_frames_count++;
+		fwrite(&empty, sizeof(empty), 1, output->index_frames);
+	}
+
+	fwrite(frame, sizeof(*frame), 1, output->index_frames);
+	output->index_frames_count++;
+}
+
+int output_init(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+	char path[PATH_MAX];
+	char *columnar_path;
+	char *manifest_path;
+	int rc;
+
+	/*
+	 * Parameters are exported along with any output mode, with one row per
+	 * frame and one row per slice in a separate file.
+	 */
+	if (output->columnar_path != NULL) {
+		columnar_open(&output->columnar, output->columnar_path,
+			      output->columnar_rows);
+
+		rc = asprintf(&columnar_path, "%s.slices",
+			      output->columnar_path);
+		if (rc >= 0) {
+			columnar_open(&output->columnar_slices, columnar_path,
+				      output->columnar_rows);
+			free(columnar_path);
+		}
+	}
+
+	/* Slices are sent along with the metadata in stream and ring modes. */
+	if (output->mode == OUTPUT_MODE_STREAM)
+		return stream_open(&output->stream, output->stream_path,
+				   output->stream_queue_size,
+				   output->stream_policy);
+
+	if (output->mode == OUTPUT_MODE_RING)
+		return ring_create(&output->ring, output->ring_name,
+				   output->ring_size, output->ring_slots);
+
+	rc = output_path_check(driver_data->slices_path);
+	if (rc < 0)
+		return -1;
+
+	output_expand(path, sizeof(path), driver_data->slices_path, 0, 0, 0, 0);
+
+	output->path = strdup(path);
+	if (output->path == NULL)
+		return -1;
+
+	rc = output_mkdir(output->path);
+	if (rc < 0)
+		return -1;
+
+	rc = output_index_init(driver_data);
+	if (rc < 0)
+		return -1;
+
+	/* Controls are optional, the dump goes on without them. */
+	if (output->controls_enabled)
+		controls_open(&output->controls, output->path);
+
+	if (output->mode == OUTPUT_MODE_DIRECT)
+		return output_direct_init(driver_data);
+
+	if (output->mode == OUTPUT_MODE_HASH)
+		return output_hash_init(driver_data);
+
+	if (output->mode == OUTPUT_MODE_GOLDEN)
+		return output_golden_init(driver_data);
+
+	if (output->mode == OUTPUT_MODE_ES)
+		return es_open(&output->es, output->path,
+			       output->es_buffer_size);
+
+	if (!output_sharded(output))
+		return 0;
+
+	rc = asprintf(&manifest_path, "%s/%s", output->path,
+		      OUTPUT_MANIFEST_FILENAME);
+	if (rc < 0)
+		return -1;
+
+	output->manifest = fopen(manifest_path, "w");
+	if (output->manifest == NULL) {
+		log_error("Unable to open dump manifest %s: %s\n",
+			manifest_path, strerror(errno));
+		free(manifest_path);
+		return -1;
+	}
+
+	free(manifest_path);
+
+	fprintf(output->manifest, "# shard first_frame last_frame frames bytes\n");
+	fflush(output->manifest);
+
+	return 0;
+}
+
+static int output_file_open(struct dump_driver_data *driver_data,
+			    const char *directory, unsigned int index)
+{
+	char *slice_filename;
+	char *slice_path;
+	int fd;
+	int rc;
+
+	rc = asprintf(&slice_filename, driver_data->slices_filename_format,
+		      index);
+	if (rc < 0)
+		return -1;
+
+	rc = asprintf(&slice_path, "%s/%s", directory, slice_filename);
+	free(slice_filename);
+	if (rc < 0)
+		return -1;
+
+	fd = open(slice_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		log_error("Unable to open slice dump path %s: %s\n",
+			slice_path, strerror(errno));
+
+	free(slice_path);
+
+	return fd;
+}
+
+static int output_file_write(int fd, const void *data, unsigned int size)
+{
+	unsigned int written = 0;
+	ssize_t rc;
+
+	while (written < size) {
+		rc = write(fd, data + written, size - written);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc < 0)
+			return -1;
+
+		written += rc;
+	}
+
+	return 0;
+}
+
+/* Save the slices of a frame to their own file, outside of any shard. */
+int output_save(struct dump_driver_data *driver_data, unsigned int index,
+		const void *data, unsigned int size)
+{
+	int fd;
+	int rc;
+
+	if (driver_data->output.path == NULL)
+		return -1;
+
+	fd = output_file_open(driver_data, driver_data->output.path, index);
+	if (fd < 0)
+		return -1;
+
+	rc = output_file_write(fd, data, size);
+	close(fd);
+
+	return rc;
+}
+
+static int output_frame_file_open(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+	unsigned int index = output->frame_index;
+	char *directory = output->path;
+	int fd;
+	int rc;
+
+	if (output->path == NULL)
+		return -1;
+
+	if (output_sharded(output)) {
+		if (output->shard_open &&
+		    ((output->shard_frames > 0 &&
+		      output->shard_count >= output->shard_frames) ||
+		     (output->shard_bytes > 0 &&
+		      output->shard_size >= output->shard_bytes)))
+			output_shard_close(driver_data);
+
+		if (!output->shard_open) {
+			rc = output_shard_open(driver_data,
+					       output->frame_context_id, index);
+			if (rc < 0)
+				return -1;
+		}
+
+		directory = output->shard_path;
+	}
+
+	fd = output_file_open(driver_data, directory, index);
+	if (fd < 0)
+		return -1;
+
+	if (output_sharded(output)) {
+		output->shard_last = index;
+		output->shard_count++;
+		output->index_frame.shard = output->shard_index;
+	}
+
+	driver_data->dump_fd = fd;
+
+	return 0;
+}
+
+int output_frame_open(struct dump_driver_data *driver_data,
+		      unsigned int context_id, unsigned int index)
+{
+	struct output *output = &driver_data->output;
+	struct object_context *context_object;
+	struct object_config *config_object;
+	int rc;
+
+	/* Sampled frames may be reduced to the checksum of their slices. */
+	output->frame_crc = 0;
+	output->frame_size = 0;
+
+	switch (output->mode) {
+	case OUTPUT_MODE_STREAM:
+		if (output->stream.fd < 0)
+			return -1;
+		break;
+	case OUTPUT_MODE_RING:
+		if (output->ring.control == NULL)
+			return -1;
+
+		ring_begin(&output->ring);
+		break;
+	case OUTPUT_MODE_DIRECT:
+		if (output->direct_index == NULL)
+			return -1;
+
+		output->frame_offset = direct_position(&output->direct);
+		break;
+	case OUTPUT_MODE_HASH:
+	case OUTPUT_MODE_GOLDEN:
+		if (output->hash_manifest == NULL)
+			return -1;
+
+		output->parameters_crc = 0;
+		output->slice_hashes_count = 0;
+		break;
+	case OUTPUT_MODE_ES:
+		context_object = (struct object_context *) object_heap_lookup(&driver_data->context_heap, context_id);
+		if (context_object == NULL)
+			return -1;
+
+		config_object = (struct object_config *) object_heap_lookup(&driver_data->config_heap, context_object->config_id);
+		if (config_object == NULL)
+			return -1;
+
+		rc = es_frame_begin(&output->es, config_object->profile);
+		if (rc < 0)
+			return -1;
+
+		output->frame_offset = output->es.position;
+		break;
+	default:
+		break;
+	}
+
+	output->frame_index = index;
+	output->frame_context_id = context_id;
+
+	output_index_begin(driver_data);
+
+	/* Files of sampled frames are only created once their slices are kept. */
+	if (output->mode == OUTPUT_MODE_FILES &&
+	    driver_data->governor.level == GOVERNOR_FULL) {
+		rc = output_frame_file_open(driver_data);
+		if (rc < 0)
+			return -1;
+	}
+
+	output->frame_open = true;
+
+	return 0;
+}
+
+/* Describe the substreams of the next slice to write, for the index. */
+void output_slice_layout(struct dump_driver_data *driver_data,
+			 unsigned int header_size, unsigned int substreams,
+			 unsigned int substream_max)
+{
+	struct index_slice *slice = &driver_data->output.index_slice;
+
+	slice->header_size = header_size;
+	slice->substreams = substreams;
+	slice->substream_max = substream_max;
+}
+
+/*
+ * Ring records take the slices in place: return the area of the ring where the
+ * next slice of at most size bytes is to be copied, or NULL when it has to go
+ * through the staging and output_write instead.
+ */
+void *output_slice_reserve(struct dump_driver_data *driver_data,
+			   unsigned int size)
+{
+	struct output *output = &driver_data->output;
+
+	if (output->mode != OUTPUT_MODE_RING || !output->frame_open ||
+	    output_hashed(driver_data))
+		return NULL;
+
+	if (driver_data->stats != NULL)
+		clock_gettime(CLOCK_MONOTONIC, &output->ring_start);
+
+	return ring_reserve(&output->ring, size);
+}
+
+/* Account for a slice copied to the area returned by output_slice_reserve. */
+void output_slice_commit(struct dump_driver_data *driver_data,
+			 unsigned int size)
+{
+	struct output *output = &driver_data->output;
+
+	PROBE3(slice_write, output->frame_context_id, output->frame_index,
+	       size);
+
+	output_index_slice(driver_data, output->index_frame.slice_size, size);
+	ring_commit(&output->ring, size);
+	stats_write(driver_data->stats, size, &output->ring_start);
+}
+
+int output_write(struct dump_driver_data *driver_data, const void *data,
+		 unsigned int size)
+{
+	TRACE_FUNCTION();
+
+	struct output *output = &driver_data->output;
+	unsigned long long offset;
+	struct timespec start;
+	int rc;
+
+	PROBE3(slice_write, output->frame_context_id, output->frame_index,
+	       size);
+
+	if (output_hashed(driver_data)) {
+		output->frame_crc = hash_crc32c(output->frame_crc, data, size);
+		output->frame_size += size;
+		return 0;
+	}
+
+	if (driver_data->stats != NULL)
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+	/* Headers of the frame come along with the first slice of the stream. */
+	if (output->mode == OUTPUT_MODE_ES) {
+		rc = es_write(driver_data, data, size, &offset);
+		if (rc < 0)
+			return -1;
+
+		output_index_slice(driver_data, offset - output->frame_offset,
+				   rc);
+		stats_write(driver_data->stats, rc, &start);
+		return 0;
+	}
+
+	output_index_slice(driver_data, output->index_frame.slice_size, size);
+
+	/* Ring records are written in place, stream records at frame end. */
+	if (driver_data->output.mode == OUTPUT_MODE_RING) {
+		ring_write(&driver_data->output.ring, data, size);
+		stats_write(driver_data->stats, size, &start);
+		return 0;
+	}
+
+	if (driver_data->output.mode == OUTPUT_MODE_STREAM)
+		return 0;
+
+	if (driver_data->output.mode == OUTPUT_MODE_HASH ||
+	    driver_data->output.mode == OUTPUT_MODE_GOLDEN) {
+		output_hash_slice(driver_data, data, size);
+		return 0;
+	}
+
+	if (driver_data->output.mode == OUTPUT_MODE_DIRECT) {
+		rc = direct_write(&driver_data->output.direct, data, size);
+		stats_write(driver_data->stats, size, &start);
+		return rc;
+	}
+
+	if (driver_data->dump_fd < 0) {
+		rc = output_frame_file_open(driver_data);
+		if (rc < 0)
+			return -1;
+	}
+
+	rc = output_file_write(driver_data->dump_fd, data, size);
+	if (rc < 0)
+		return -1;
+
+	driver_data->output.shard_size += size;
+
+	stats_write(driver_data->stats, size, &start);
+
+	return 0;
+}
+
+void output_parameters(struct dump_driver_data *driver_data,
+		       const void *data, unsigned int size)
+{
+	struct output *output = &driver_data->output;
+
+	if (output->mode == OUTPUT_MODE_HASH ||
+	    output->mode == OUTPUT_MODE_GOLDEN)
+		output->parameters_crc = hash_crc32c(output->parameters_crc,
+						     data, size);
+}
+
+/* Capture the metadata printed for the frame to send it with the slices. */
+void output_metadata_begin(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+
+	if (!output->frame_open)
+		return;
+
+	/* The header emitters fill the columns of the row as they print. */
+	columnar_row_begin(&output->columnar);
+	columnar_int(&output->columnar, "index", driver_data->frame_index);
+
+	if (output->mode == OUTPUT_MODE_FILES)
+		return;
+
+	output->metadata = open_memstream(&output->metadata_buffer,
+					  &output->metadata_size);
+	if (output->metadata == NULL)
+		return;
+
+	print_set_output(output->metadata);
+}
+
+void output_metadata_end(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+
+	columnar_row_end(&output->columnar);
+
+	if (output->metadata == NULL)
+		return;
+
+	print_set_output(NULL);
+
+	fclose(output->metadata);
+	output->metadata = NULL;
+
+	/* Only the metadata of divergent frames is printed in golden mode. */
+	if (output->mode != OUTPUT_MODE_GOLDEN)
+		fwrite(output->metadata_buffer, 1, output->metadata_size,
+		       stdout);
+}
+
+static void output_frame_reset(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+
+	if (output->metadata != NULL) {
+		print_set_output(NULL);
+		fclose(output->metadata);
+		output->metadata = NULL;
+	}
+
+	free(output->metadata_buffer);
+	output->metadata_buffer = NULL;
+	output->metadata_size = 0;
+
+	if (driver_data->dump_fd >= 0) {
+		close(driver_data->dump_fd);
+		driver_data->dump_fd = -1;
+	}
+
+	output->frame_open = false;
+}
+
+void output_frame_close(struct dump_driver_data *driver_data,
+			const void *slice_data, unsigned int slice_size)
+{
+	TRACE_FUNCTION();
+
+	struct output *output = &driver_data->output;
+	struct stream_record record;
+	struct ring_slot slot;
+	struct timespec start;
+
+	if (output->frame_open)
+		output_metadata_end(driver_data);
+
+	if (output_hashed(driver_data))
+		slice_size = 0;
+
+	if (output->mode == OUTPUT_MODE_STREAM && output->frame_open) {
+		memset(&record, 0, sizeof(record));
+		record.flags = driver_data->slices_rbsp ? STREAM_FLAG_RBSP : 0;
+		record.frame_index = output->frame_index;
+		record.context_id = output->frame_context_id;
+		record.metadata_size = output->metadata_size;
+		record.slice_size = slice_size;
+
+		if (driver_data->stats != NULL)
+			clock_gettime(CLOCK_MONOTONIC, &start);
+
+		stream_send(&output->stream, &record, output->metadata_buffer,
+			    slice_data);
+
+		stats_write(driver_data->stats,
+			    sizeof(record) + record.metadata_size + slice_size,
+			    &start);
+
+		STATS_SET(driver_data->stats, queue_depth, output->stream.count);
+		STATS_SET(driver_data->stats, queue_dropped,
+			  output->stream.dropped_total);
+	} else if (output->mode == OUTPUT_MODE_RING && output->frame_open) {
+		ring_write(&output->ring, output->metadata_buffer,
+			   output->metadata_size);
+
+		memset(&slot, 0, sizeof(slot));
+		slot.flags = driver_data->slices_rbsp ? RING_FLAG_RBSP : 0;
+		slot.frame_index = output->frame_index;
+		slot.context_id = output->frame_context_id;
+		slot.slice_size = slice_size;
+		slot.metadata_size = output->metadata_size;
+
+		ring_publish(&output->ring, &slot);
+
+		if (output->ring.control != NULL)
+			STATS_SET(driver_data->stats, queue_dropped,
+				  output->ring.control->dropped);
+	} else if ((output->mode == OUTPUT_MODE_HASH ||
+		    output->mode == OUTPUT_MODE_GOLDEN) && output->frame_open) {
+		output_hash_frame(driver_data);
+	} else if (output->mode == OUTPUT_MODE_DIRECT && output->frame_open) {
+		fprintf(output->direct_index, "%u %llu %llu\n",
+			output->frame_index, output->frame_offset,
+			(unsigned long long) direct_position(&output->direct) -
+			output->frame_offset);
+	} else if (output->mode == OUTPUT_MODE_ES && output->frame_open) {
+		fflush(output->es.file);
+	}
+
+	output_frame_reset(driver_data);
+}
+
+void output_terminate(struct dump_driver_data *driver_data)
+{
+	struct output *output = &driver_data->output;
+
+	output_frame_reset(driver_data);
+	output_shard_close(driver_data);
+
+	columnar_close(&output->columnar);
+	columnar_close(&output->columnar_slices);
+
+	if (output->mode == OUTPUT_MODE_STREAM)
+		stream_close(&output->stream);
+	else if (output->mode == OUTPUT_MODE_RING)
+		ring_destroy(&output->ring);
+
+	if (output->hash_manifest != NULL) {
+		fclose(output->hash_manifest);
+		output->hash_manifest = NULL;
+	}
+
+	free(output->slice_hashes);
+	output->slice_hashes = NULL;
+
+	golden_destroy(&output->golden);
+
+	if (output->index_frames != NULL) {
+		fclose(output->index_frames);
+		output->index_frames = NULL;
+	}
+
+	if (output->index_slices != NULL) {
+		fclose(output->index_slices);
+		output->index_slices = NULL;
+	}
+
+	es_close(&output->es);
+	controls_close(&output->controls);
+
+	if (output->direct_index != NULL) {
+		direct_close(&output->direct);
+		fclose(output->direct_index);
+		output->direct_index = NULL;
+	}
+
+	if (output->manifest != NULL) {
+		fclose(output->manifest);
+		output->manifest = NULL;
+	}
+
+	free(output->path);
+	output->path = NULL;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <va/va_backend.h>
+
+#include "columnar.h"
+#include "controls.h"
+#include "direct.h"
+#include "es.h"
+#include "golden.h"
+#include "index.h"
+#include "ring.h"
+#include "stream.h"
+
+struct dump_driver_data;
+struct object_surface;
+
+/*
+ * Values
+ */
+
+#define OUTPUT_MANIFEST_FILENAME		"manifest.txt"
+#define OUTPUT_DIRECT_FILENAME			"slices.dump"
+#define OUTPUT_DIRECT_INDEX_FILENAME		"slices.index"
+#define OUTPUT_HASH_FILENAME			"hashes.txt"
+
+enum output_mode {
+	OUTPUT_MODE_FILES,
+	OUTPUT_MODE_STREAM,
+	OUTPUT_MODE_RING,
+	OUTPUT_MODE_DIRECT,
+	OUTPUT_MODE_HASH,
+	OUTPUT_MODE_GOLDEN,
+	OUTPUT_MODE_ES,
+};
+
+/*
+ * Structures
+ */
+
+struct output_hash {
+	uint32_t crc;
+	unsigned int size;
+};
+
+struct output {
+	enum output_mode mode;
+
+	char *path;
+	FILE *manifest;
+
+	char *shard_format;
+	unsigned int shard_frames;
+	unsigned long long shard_bytes;
+
+	bool shard_open;
+	char *shard_path;
+	unsigned int shard_index;
+	unsigned int shard_first;
+	unsigned int shard_last;
+	unsigned int shard_count;
+	unsigned long long shard_size;
+
+	char *stream_path;
+	unsigned int stream_queue_size;
+	enum stream_policy stream_policy;
+	struct stream stream;
+
+	char *ring_name;
+	unsigned long long ring_size;
+	unsigned int ring_slots;
+	struct ring ring;
+	struct timespec ring_start;
+
+	unsigned int direct_buffer_size;
+	unsigned int direct_buffer_count;
+	struct direct direct;
+	FILE *direct_index;
+	unsigned long long frame_offset;
+
+	FILE *hash_manifest;
+	uint32_t frame_crc;
+	uint32_t parameters_crc;
+	unsigned long long frame_size;
+	struct output_hash *slice_hashes;
+	unsigned int slice_hashes_count;
+	unsigned int slice_hashes_allocated;
+
+	char *golden_path;
+	struct golden golden;
+
+	unsigned int es_buffer_size;
+	struct es es;
+
+	char *columnar_path;
+	unsigned int columnar_rows;
+	struct columnar columnar;
+	struct columnar columnar_slices;
+
+	FILE *index_frames;
+	FILE *index_slices;
+	unsigned int index_frames_count;
+	unsigned long long index_slices_count;
+	struct index_frame index_frame;
+	struct index_slice index_slice;
+	unsigned int index_sequence;
+	unsigned int index_anchors;
+
+	bool controls_enabled;
+	struct controls controls;
+
+	bool frame_open;
+	unsigned int frame_index;
+	unsigned int frame_context_id;
+
+	FILE *metadata;
+	char *metadata_buffer;
+	size_t metadata_size;
+};
+
+/*
+ * Functions
+ */
+
+int output_init(struct dump_driver_data *driver_data);
+int output_frame_open(struct dump_driver_data *driver_data,
+		      unsigned int context_id, unsigned int index);
+int output_save(struct dump_driver_data *driver_data, unsigned int index,
+		const void *data, unsigned int size);
+void output_slice_layout(struct dump_driver_data *driver_data,
+			 unsigned int header_size, unsigned int substreams,
+			 unsigned int substream_max);
+void *output_slice_reserve(struct dump_driver_data *driver_data,
+			   unsigned int size);
+void output_slice_commit(struct dump_driver_data *driver_data,
+			 unsigned int size);
+int output_write(struct dump_driver_data *driver_data, const void *data,
+		 unsigned int size);
+void output_parameters(struct dump_driver_data *driver_data,
+		       const void *data, unsigned int size);
+void output_metadata_begin(struct dump_driver_data *driver_data);
+void output_metadata_end(struct dump_driver_data *driver_data);
+void output_index_frame(struct dump_driver_data *driver_data,
+			VAProfile profile, struct object_surface *surface);
+void output_frame_close(struct dump_driver_data *driver_data,
+			const void *slice_data, unsigned int slice_size);
+void output_terminate(struct dump_driver_data *driver_data);
+
+#endif
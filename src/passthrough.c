@@ -0,0 +1,762 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <va/va_backend.h>
+
+#include "dump.h"
+#include "buffer.h"
+#include "config.h"
+#include "context.h"
+#include "governor.h"
+#include "passthrough.h"
+#include "picture.h"
+#include "probe.h"
+#include "surface.h"
+#include "trace.h"
+#include "log.h"
+
+/* The context points to the wrappers table, within the driver data. */
+static struct dump_driver_data *passthrough_driver_data(VADriverContextP context)
+{
+	struct passthrough *passthrough = (struct passthrough *)
+		((char *) context->vtable - offsetof(struct passthrough, wrappers));
+
+	return (struct dump_driver_data *)
+		((char *) passthrough - offsetof(struct dump_driver_data, passthrough));
+}
+
+static void passthrough_job_free(struct passthrough_job *job)
+{
+	unsigned int i;
+
+	for (i = 0; i < job->buffers_count; i++)
+		free(job->buffers[i].data);
+
+	free(job->buffers);
+	free(job);
+}
+
+static void passthrough_job_render(struct dump_driver_data *driver_data,
+				   struct passthrough_job *job)
+{
+	struct object_context *context_object;
+	struct object_config *config_object;
+	struct object_surface *surface_object;
+	struct timespec start;
+	unsigned int i;
+
+	context_object = (struct object_context *) object_heap_lookup(&driver_data->context_heap, job->context_id);
+	if (context_object == NULL)
+		return;
+
+	config_object = (struct object_config *) object_heap_lookup(&driver_data->config_heap, context_object->config_id);
+	surface_object = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, context_object->render_surface_id);
+	if (config_object == NULL || surface_object == NULL ||
+	    !driver_data->output.frame_open)
+		return;
+
+	governor_clock(&driver_data->governor, &start);
+
+	for (i = 0; i < job->buffers_count; i++)
+		picture_render_buffer(driver_data, config_object, surface_object,
+				      &job->buffers[i]);
+
+	governor_charge(&driver_data->governor, 0, &start);
+}
+
+static void *passthrough_thread(void *data)
+{
+	struct dump_driver_data *driver_data = data;
+	struct passthrough *passthrough = &driver_data->passthrough;
+	struct passthrough_job *job;
+
+	pthread_mutex_lock(&passthrough->lock);
+
+	while (1) {
+		while (passthrough->jobs == NULL && !passthrough->stop)
+			pthread_cond_wait(&passthrough->cond, &passthrough->lock);
+
+		job = passthrough->jobs;
+		if (job == NULL)
+			break;
+
+		passthrough->jobs = job->next;
+		if (passthrough->jobs == NULL)
+			passthrough->jobs_tail = &passthrough->jobs;
+
+		passthrough->busy = true;
+		pthread_mutex_unlock(&passthrough->lock);
+
+		TRACE_BEGIN("pass-through capture");
+
+		switch (job->type) {
+			case PASSTHROUGH_JOB_BEGIN:
+				picture_begin(driver_data, job->context_id,
+					      job->surface_id);
+				break;
+
+			case PASSTHROUGH_JOB_RENDER:
+				passthrough_job_render(driver_data, job);
+				break;
+
+			case PASSTHROUGH_JOB_END:
+				picture_end(driver_data, job->context_id);
+				break;
+		}
+
+		TRACE_END("pass-through capture");
+
+		pthread_mutex_lock(&passthrough->lock);
+		passthrough->jobs_size -= job->size;
+		passthrough->busy = false;
+		pthread_cond_broadcast(&passthrough->cond);
+
+		passthrough_job_free(job);
+	}
+
+	pthread_mutex_unlock(&passthrough->lock);
+
+	return NULL;
+}
+
+/* Rendering waits when too much copied data is queued, the job is freed otherwise. */
+static void passthrough_queue(struct passthrough *passthrough,
+			      struct passthrough_job *job)
+{
+	pthread_mutex_lock(&passthrough->lock);
+
+	while (passthrough->jobs_size > 0 &&
+	       passthrough->jobs_size + job->size > PASSTHROUGH_QUEUE_SIZE &&
+	       !passthrough->stop)
+		pthread_cond_wait(&passthrough->cond, &passthrough->lock);
+
+	if (passthrough->stop) {
+		pthread_mutex_unlock(&passthrough->lock);
+		passthrough_job_free(job);
+		return;
+	}
+
+	job->next = NULL;
+	*passthrough->jobs_tail = job;
+	passthrough->jobs_tail = &job->next;
+	passthrough->jobs_size += job->size;
+
+	pthread_cond_broadcast(&passthrough->cond);
+	pthread_mutex_unlock(&passthrough->lock);
+}
+
+static void passthrough_queue_picture(struct passthrough *passthrough,
+				      enum passthrough_job_type type,
+				      VAContextID context_id,
+				      VASurfaceID surface_id)
+{
+	struct passthrough_job *job;
+
+	job = calloc(1, sizeof(*job));
+	if (job == NULL) {
+		log_error("Unable to queue picture capture\n");
+		return;
+	}
+
+	job->type = type;
+	job->context_id = context_id;
+	job->surface_id = surface_id;
+
+	passthrough_queue(passthrough, job);
+}
+
+/* Shadow objects are only released once no queued job refers to them. */
+static void passthrough_drain(struct passthrough *passthrough)
+{
+	pthread_mutex_lock(&passthrough->lock);
+
+	while (passthrough->jobs != NULL || passthrough->busy)
+		pthread_cond_wait(&passthrough->cond, &passthrough->lock);
+
+	pthread_mutex_unlock(&passthrough->lock);
+}
+
+static void passthrough_stop(struct passthrough *passthrough)
+{
+	passthrough_drain(passthrough);
+
+	pthread_mutex_lock(&passthrough->lock);
+	passthrough->stop = true;
+	pthread_cond_broadcast(&passthrough->cond);
+	pthread_mutex_unlock(&passthrough->lock);
+
+	pthread_join(passthrough->thread, NULL);
+
+	pthread_cond_destroy(&passthrough->cond);
+	pthread_mutex_destroy(&passthrough->lock);
+}
+
+/*
+ * Objects of the other driver are shadowed in the heaps with the fields the
+ * capture needs, under the IDs the other driver gave them.
+ */
+static struct object_config *passthrough_config(struct dump_driver_data *driver_data,
+	VADriverContextP context, VAConfigID config_id)
+{
+	struct object_config *config_object;
+	struct object_base *object;
+	VAConfigAttrib *attributes;
+	VAProfile profile;
+	VAEntrypoint entrypoint;
+	int attributes_count = 0;
+	VAStatus status;
+	int id;
+	int rc;
+
+	config_object = (struct object_config *) object_heap_lookup(&driver_data->config_heap, config_id);
+	if (config_object != NULL)
+		return config_object;
+
+	attributes = calloc(context->max_attributes > 0 ? context->max_attributes : 1,
+			    sizeof(*attributes));
+	if (attributes == NULL)
+		return NULL;
+
+	status = driver_data->passthrough.vtable.vaQueryConfigAttributes(context,
+		config_id, &profile, &entrypoint, attributes, &attributes_count);
+	if (status != VA_STATUS_SUCCESS) {
+		free(attributes);
+		return NULL;
+	}
+
+	rc = object_heap_allocate_bulk(&driver_data->config_heap, 1, &id, &object);
+	if (rc < 0) {
+		free(attributes);
+		return NULL;
+	}
+
+	config_object = (struct object_config *) object;
+	config_object->profile = profile;
+	config_object->entrypoint = entrypoint;
+
+	if (attributes_count > DUMP_MAX_CONFIG_ATTRIBUTES)
+		attributes_count = DUMP_MAX_CONFIG_ATTRIBUTES;
+
+	memcpy(config_object->attributes, attributes,
+	       attributes_count * sizeof(*attributes));
+	config_object->attributes_count = attributes_count;
+
+	free(attributes);
+
+	rc = object_heap_alias(&driver_data->config_heap, object, config_id);
+	if (rc < 0) {
+		object_heap_free(&driver_data->config_heap, object);
+		return NULL;
+	}
+
+	return config_object;
+}
+
+static struct object_surface *passthrough_surface(struct dump_driver_data *driver_data,
+	VASurfaceID surface_id, unsigned int width, unsigned int height)
+{
+	struct object_surface *surface_object;
+	struct object_base *object;
+	int id;
+	int rc;
+
+	surface_object = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, surface_id);
+	if (surface_object != NULL)
+		return surface_object;
+
+	rc = object_heap_allocate_bulk(&driver_data->surface_heap, 1, &id, &object);
+	if (rc < 0)
+		return NULL;
+
+	surface_object = (struct object_surface *) object;
+
+	surface_object->status = VASurfaceReady;
+	surface_object->deadline = 0;
+	surface_object->width = width;
+	surface_object->height = height;
+	surface_object->index = 0;
+
+	surface_object->slice_data = NULL;
+	surface_object->slice_staging = NULL;
+	surface_object->slice_data_size = 0;
+	surface_object->slice_size = 0;
+	surface_object->slice_offset = 0;
+
+	surface_object->dump_size = 0;
+	surface_object->metadata = NULL;
+	surface_object->metadata_size = 0;
+	surface_object->passthrough_index = 0;
+
+	rc = object_heap_alias(&driver_data->surface_heap, object, surface_id);
+	if (rc < 0) {
+		object_heap_free(&driver_data->surface_heap, object);
+		return NULL;
+	}
+
+	return surface_object;
+}
+
+static VAStatus PassthroughTerminate(VADriverContextP context)
+{
+	struct dump_driver_data *driver_data = passthrough_driver_data(context);
+	void *handle;
+	VAStatus status;
+
+	passthrough_stop(&driver_data->passthrough);
+
+	/* The table is freed by libva once terminated. */
+	context->vtable = driver_data->passthrough.context_vtable;
+
+	status = driver_data->passthrough.vtable.vaTerminate(context);
+
+	/* Shadow objects are destroyed by their own IDs along with the rest. */
+	object_heap_alias_disable(&driver_data->config_heap);
+	object_heap_alias_disable(&driver_data->context_heap);
+	object_heap_alias_disable(&driver_data->surface_heap);
+
+	handle = driver_data->passthrough.handle;
+
+	context->pDriverData = driver_data;
+	DumpTerminate(context);
+
+	dlclose(handle);
+
+	return status;
+}
+
+static VAStatus PassthroughDestroyConfig(VADriverContextP context,
+	VAConfigID config_id)
+{
+	TRACE_FUNCTION();
+
+	struct dump_driver_data *driver_data = passthrough_driver_data(context);
+	struct object_base *object;
+	VAStatus status;
+
+	status = driver_data->passthrough.vtable.vaDestroyConfig(context, config_id);
+	if (status != VA_STATUS_SUCCESS)
+		return status;
+
+	passthrough_drain(&driver_data->passthrough);
+
+	object = object_heap_lookup(&driver_data->config_heap, config_id);
+	if (object != NULL) {
+		object_heap_unalias(&driver_data->config_heap, config_id);
+		object_heap_free(&driver_data->config_heap, object);
+	}
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus PassthroughDestroySurfaces(VADriverContextP context,
+	VASurfaceID *surfaces_ids, int surfaces_count)
+{
+	TRACE_FUNCTION();
+
+	struct dump_driver_data *driver_data = passthrough_driver_data(context);
+	struct object_surface *surface_object;
+	VAStatus status;
+	int i;
+
+	status = driver_data->passthrough.vtable.vaDestroySurfaces(context,
+		surfaces_ids, surfaces_count);
+	if (status != VA_STATUS_SUCCESS)
+		return status;
+
+	passthrough_drain(&driver_data->passthrough);
+
+	for (i = 0; i < surfaces_count; i++) {
+		surface_object = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, surfaces_ids[i]);
+		if (surface_object == NULL)
+			continue;
+
+		surface_staging_release(surface_object);
+		free(surface_object->metadata);
+
+		object_heap_unalias(&driver_data->surface_heap, surfaces_ids[i]);
+		object_heap_free(&driver_data->surface_heap, (struct object_base *) surface_object);
+	}
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus PassthroughCreateContext(VADriverContextP context,
+	VAConfigID config_id, int picture_width, int picture_height, int flag,
+	VASurfaceID *surfaces_ids, int surfaces_count, VAContextID *context_id)
+{
+	TRACE_FUNCTION();
+
+	struct dump_driver_data *driver_data = passthrough_driver_data(context);
+	struct object_config *config_object;
+	struct object_context *context_object;
+	struct object_base *object;
+	VASurfaceID *ids;
+	VAStatus status;
+	int id;
+	int rc;
+	int i;
+
+	status = driver_data->passthrough.vtable.vaCreateContext(context,
+		config_id, picture_width, picture_height, flag, surfaces_ids,
+		surfaces_count, context_id);
+	if (status != VA_STATUS_SUCCESS)
+		return status;
+
+	/* Contexts that cannot be shadowed are still decoded, only not dumped. */
+	config_object = passthrough_config(driver_data, context, config_id);
+	if (config_object == NULL) {
+		log_warning("Unable to shadow config %#x, not dumping context %#x\n",
+			    config_id, *context_id);
+		return VA_STATUS_SUCCESS;
+	}
+
+	for (i = 0; i < surfaces_count; i++)
+		passthrough_surface(driver_data, surfaces_ids[i],
+				    picture_width, picture_height);
+
+	ids = malloc(surfaces_count * sizeof(*ids));
+	if (ids == NULL && surfaces_count > 0)
+		goto error;
+
+	rc = object_heap_allocate_bulk(&driver_data->context_heap, 1, &id, &object);
+	if (rc < 0)
+		goto error;
+
+	if (surfaces_count > 0)
+		memcpy(ids, surfaces_ids, surfaces_count * sizeof(*ids));
+
+	context_object = (struct object_context *) object;
+	context_object->config_id = config_id;
+	context_object->render_surface_id = VA_INVALID_ID;
+	context_object->surfaces_ids = ids;
+	context_object->surfaces_count = surfaces_count;
+	context_object->picture_width = picture_width;
+	context_object->picture_height = picture_height;
+	context_object->flags = flag;
+	context_object->staging_size = context_staging_size(config_object->profile, picture_width, picture_height);
+	context_object->passthrough_index = 0;
+
+	rc = object_heap_alias(&driver_data->context_heap, object, *context_id);
+	if (rc < 0) {
+		object_heap_free(&driver_data->context_heap, object);
+		goto error;
+	}
+
+	return VA_STATUS_SUCCESS;
+
+error:
+	free(ids);
+
+	log_warning("Unable to shadow context %#x, not dumping it\n", *context_id);
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus PassthroughDestroyContext(VADriverContextP context,
+	VAContextID context_id)
+{
+	TRACE_FUNCTION();
+
+	struct dump_driver_data *driver_data = passthrough_driver_data(context);
+	struct object_context *context_object;
+	VAStatus status;
+
+	status = driver_data->passthrough.vtable.vaDestroyContext(context, context_id);
+	if (status != VA_STATUS_SUCCESS)
+		return status;
+
+	passthrough_drain(&driver_data->passthrough);
+
+	context_object = (struct object_context *) object_heap_lookup(&driver_data->context_heap, context_id);
+	if (context_object == NULL)
+		return VA_STATUS_SUCCESS;
+
+	context_staging_release(driver_data, context_object, false);
+	free(context_object->surfaces_ids);
+
+	object_heap_unalias(&driver_data->context_heap, context_id);
+	object_heap_free(&driver_data->context_heap, (struct object_base *) context_object);
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus PassthroughBeginPicture(VADriverContextP context,
+	VAContextID context_id, VASurfaceID surface_id)
+{
+	TRACE_FUNCTION();
+
+	struct dump_driver_data *driver_data = passthrough_driver_data(context);
+	struct passthrough *passthrough = &driver_data->passthrough;
+	struct object_context *context_object;
+	struct object_surface *surface_object = NULL;
+
+	/* Surfaces created after the context are shadowed on first use. */
+	context_object = (struct object_context *) object_heap_lookup(&driver_data->context_heap, context_id);
+	if (context_object != NULL)
+		surface_object = passthrough_surface(driver_data, surface_id,
+						     context_object->picture_width,
+						     context_object->picture_height);
+
+	if (surface_object != NULL) {
+		context_object->passthrough_index =
+			__atomic_fetch_add(&passthrough->pictures, 1,
+					   __ATOMIC_RELAXED);
+		surface_object->passthrough_index =
+			context_object->passthrough_index;
+
+		passthrough_queue_picture(passthrough, PASSTHROUGH_JOB_BEGIN,
+					  context_id, surface_id);
+	}
+
+	return passthrough->vtable.vaBeginPicture(context, context_id,
+						  surface_id);
+}
+
+/*
+ * Buffers are copied before they are handed over, since the other driver may
+ * consume them when rendering. Only pictures that can be dumped are copied.
+ */
+static VAStatus PassthroughRenderPicture(VADriverContextP context,
+	VAContextID context_id, VABufferID *buffers, int buffers_count)
+{
+	TRACE_FUNCTION();
+
+	struct dump_driver_data *driver_data = passthrough_driver_data(context);
+	struct passthrough *passthrough = &driver_data->passthrough;
+	struct VADriverVTable *vtable = &passthrough->vtable;
+	struct object_context *context_object;
+	struct object_buffer *buffer_object;
+	struct passthrough_job *job;
+	unsigned int size;
+	void *data;
+	VAStatus status;
+	int i;
+
+	context_object = (struct object_context *) object_heap_lookup(&driver_data->context_heap, context_id);
+	if (context_object == NULL)
+		goto render;
+
+	PROBE3(render_picture, context_id, buffers_count,
+	       context_object->passthrough_index);
+
+	if (context_object->passthrough_index >= driver_data->dump_count)
+		goto render;
+
+	job = calloc(1, sizeof(*job));
+	if (job == NULL)
+		goto render;
+
+	job->type = PASSTHROUGH_JOB_RENDER;
+	job->context_id = context_id;
+	job->buffers = calloc(buffers_count, sizeof(*job->buffers));
+	if (job->buffers == NULL && buffers_count > 0) {
+		free(job);
+		goto render;
+	}
+
+	TRACE_BEGIN("pass-through copy");
+
+	for (i = 0; i < buffers_count; i++) {
+		buffer_object = &job->buffers[job->buffers_count];
+
+		status = vtable->vaBufferInfo(context, buffers[i],
+			&buffer_object->type, &buffer_object->size,
+			&buffer_object->count);
+		if (status != VA_STATUS_SUCCESS)
+			continue;
+
+		status = vtable->vaMapBuffer(context, buffers[i], &data);
+		if (status != VA_STATUS_SUCCESS)
+			continue;
+
+		size = buffer_object->size * buffer_object->count;
+
+		buffer_object->data = malloc(size);
+		if (buffer_object->data != NULL) {
+			memcpy(buffer_object->data, data, size);
+			buffer_object->initial_count = buffer_object->count;
+
+			job->buffers_count++;
+			job->size += size;
+		}
+
+		vtable->vaUnmapBuffer(context, buffers[i]);
+	}
+
+	TRACE_END("pass-through copy");
+
+	passthrough_queue(passthrough, job);
+
+render:
+	return vtable->vaRenderPicture(context, context_id, buffers,
+				       buffers_count);
+}
+
+/*
+ * The picture is handed over before it is queued, so that the other driver
+ * gets to decode it while it is written out.
+ */
+static VAStatus PassthroughEndPicture(VADriverContextP context,
+	VAContextID context_id)
+{
+	TRACE_FUNCTION();
+
+	struct dump_driver_data *driver_data = passthrough_driver_data(context);
+	VAStatus status;
+
+	status = driver_data->passthrough.vtable.vaEndPicture(context, context_id);
+
+	if (object_heap_lookup(&driver_data->context_heap, context_id) != NULL)
+		passthrough_queue_picture(&driver_data->passthrough,
+					  PASSTHROUGH_JOB_END, context_id,
+					  VA_INVALID_ID);
+
+	return status;
+}
+
+/* Shadow surfaces have no status of their own, the other driver tells it. */
+static VAStatus PassthroughSyncSurface(VADriverContextP context,
+	VASurfaceID surface_id)
+{
+	TRACE_FUNCTION();
+
+	struct dump_driver_data *driver_data = passthrough_driver_data(context);
+	struct object_surface *surface_object;
+
+	surface_object = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, surface_id);
+	if (surface_object != NULL)
+		PROBE2(sync_surface, surface_id,
+		       surface_object->passthrough_index);
+
+	return driver_data->passthrough.vtable.vaSyncSurface(context,
+		surface_id);
+}
+
+/*
+ * Load the driver at the given path on the same context and pass calls through
+ * to it, dumping the pictures it decodes on the way. The other driver owns the
+ * driver data of the context from then on.
+ */
+int passthrough_init(struct dump_driver_data *driver_data,
+		     VADriverContextP context, const char *path)
+{
+	struct passthrough *passthrough = &driver_data->passthrough;
+	struct VADriverVTable *vtable = context->vtable;
+	VAStatus (*init)(VADriverContextP context) = NULL;
+	char symbol[32];
+	VAStatus status;
+	int minor;
+	int rc;
+
+	passthrough->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (passthrough->handle == NULL) {
+		log_error("Unable to open pass-through driver %s: %s\n", path,
+			  dlerror());
+		return -1;
+	}
+
+	/* Drivers built against older versions of the API are compatible. */
+	for (minor = VA_MINOR_VERSION; minor >= 0 && init == NULL; minor--) {
+		snprintf(symbol, sizeof(symbol), "__vaDriverInit_%d_%d",
+			 VA_MAJOR_VERSION, minor);
+		init = dlsym(passthrough->handle, symbol);
+	}
+
+	if (init == NULL) {
+		log_error("Unable to find the init function of pass-through driver %s\n",
+			  path);
+		goto error;
+	}
+
+	context->pDriverData = NULL;
+
+	status = init(context);
+	if (status != VA_STATUS_SUCCESS) {
+		log_error("Unable to initialize pass-through driver %s: %d\n",
+			  path, status);
+		goto error;
+	}
+
+	memcpy(&passthrough->vtable, vtable, sizeof(passthrough->vtable));
+	memcpy(&passthrough->wrappers, vtable, sizeof(passthrough->wrappers));
+
+	rc = object_heap_alias_enable(&driver_data->config_heap);
+	if (rc >= 0)
+		rc = object_heap_alias_enable(&driver_data->context_heap);
+	if (rc >= 0)
+		rc = object_heap_alias_enable(&driver_data->surface_heap);
+
+	if (rc < 0) {
+		passthrough->vtable.vaTerminate(context);
+		goto error;
+	}
+
+	pthread_mutex_init(&passthrough->lock, NULL);
+	pthread_cond_init(&passthrough->cond, NULL);
+	passthrough->jobs = NULL;
+	passthrough->jobs_tail = &passthrough->jobs;
+	passthrough->jobs_size = 0;
+	passthrough->busy = false;
+	passthrough->stop = false;
+	passthrough->pictures = 0;
+
+	rc = pthread_create(&passthrough->thread, NULL, passthrough_thread,
+			    driver_data);
+	if (rc != 0) {
+		log_error("Unable to start pass-through capture thread\n");
+		pthread_cond_destroy(&passthrough->cond);
+		pthread_mutex_destroy(&passthrough->lock);
+		passthrough->vtable.vaTerminate(context);
+		goto error;
+	}
+
+	passthrough->wrappers.vaTerminate = PassthroughTerminate;
+	passthrough->wrappers.vaDestroyConfig = PassthroughDestroyConfig;
+	passthrough->wrappers.vaDestroySurfaces = PassthroughDestroySurfaces;
+	passthrough->wrappers.vaCreateContext = PassthroughCreateContext;
+	passthrough->wrappers.vaDestroyContext = PassthroughDestroyContext;
+	passthrough->wrappers.vaBeginPicture = PassthroughBeginPicture;
+	passthrough->wrappers.vaRenderPicture = PassthroughRenderPicture;
+	passthrough->wrappers.vaEndPicture = PassthroughEndPicture;
+	passthrough->wrappers.vaSyncSurface = PassthroughSyncSurface;
+
+	passthrough->context_vtable = vtable;
+	context->vtable = &passthrough->wrappers;
+
+	log_info("Passing calls through to %s\n", path);
+
+	return 0;
+
+error:
+	object_heap_alias_disable(&driver_data->config_heap);
+	object_heap_alias_disable(&driver_data->context_heap);
+	object_heap_alias_disable(&driver_data->surface_heap);
+
+	context->pDriverData = driver_data;
+
+	dlclose(passthrough->handle);
+	passthrough->handle = NULL;
+
+	return -1;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PASSTHROUGH_H_
+#define _PASSTHROUGH_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include <va/va_backend.h>
+
+#include "buffer.h"
+
+struct dump_driver_data;
+
+/*
+ * Values
+ */
+
+/* Bytes of copied buffers that may wait for capture before rendering waits. */
+#define PASSTHROUGH_QUEUE_SIZE			(64 * 1024 * 1024)
+
+enum passthrough_job_type {
+	PASSTHROUGH_JOB_BEGIN,
+	PASSTHROUGH_JOB_RENDER,
+	PASSTHROUGH_JOB_END,
+};
+
+/*
+ * Structures
+ */
+
+/* Render jobs own copies of the buffers, the other driver keeps the originals. */
+struct passthrough_job {
+	struct passthrough_job *next;
+	enum passthrough_job_type type;
+
+	VAContextID context_id;
+	VASurfaceID surface_id;
+
+	struct object_buffer *buffers;
+	unsigned int buffers_count;
+	unsigned int size;
+};
+
+/*
+ * The context points to the wrappers table while calls are passed through,
+ * which leads back to the driver data. The table allocated by libva is given
+ * back on terminate.
+ *
+ * Pictures are captured in order by a thread, from jobs queued by the
+ * wrappers, so that the other driver is not held up by the capture.
+ */
+struct passthrough {
+	void *handle;
+	struct VADriverVTable vtable;
+	struct VADriverVTable wrappers;
+	struct VADriverVTable *context_vtable;
+	unsigned int pictures;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct passthrough_job *jobs;
+	struct passthrough_job **jobs_tail;
+	unsigned int jobs_size;
+	bool busy;
+	bool stop;
+};
+
+/*
+ * Functions
+ */
+
+int passthrough_init(struct dump_driver_data *driver_data,
+		     VADriverContextP context, const char *path);
+
+#endif
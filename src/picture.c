@@ -16,6 +16,7 @@
  */
 
 #define _GNU_SOURCE
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -31,18 +32,112 @@
 #include "surface.h"
 #include "buffer.h"
 #include "header.h"
+#include "nal.h"
+#include "golden.h"
+#include "governor.h"
+#include "output.h"
+#include "probe.h"
+#include "stats.h"
+#include "timing.h"
+#include "trace.h"
+#include "log.h"
+
+enum nal_codec picture_nal_codec(VAProfile profile)
+{
+	switch (profile) {
+		case VAProfileH264Main:
+		case VAProfileH264High:
+		case VAProfileH264ConstrainedBaseline:
+		case VAProfileH264MultiviewHigh:
+		case VAProfileH264StereoHigh:
+			return NAL_CODEC_H264;
 
-VAStatus DumpBeginPicture(VADriverContextP context, VAContextID context_id,
-	VASurfaceID surface_id)
+		case VAProfileHEVCMain:
+			return NAL_CODEC_H265;
+
+		default:
+			return NAL_CODEC_MPEG2;
+	}
+}
+
+/* Gather the reference surfaces of the current picture, up to 16. */
+unsigned int picture_references(struct dump_driver_data *driver_data,
+				VAProfile profile, VASurfaceID *surfaces)
+{
+	VAPictureParameterBufferMPEG2 *mpeg2 = &driver_data->params.mpeg2.picture;
+	VAPictureParameterBufferH264 *h264 = &driver_data->params.h264.picture;
+	VAPictureParameterBufferHEVC *h265 = &driver_data->params.h265.picture;
+	unsigned int count = 0;
+	unsigned int i;
+
+	switch (profile) {
+		case VAProfileMPEG2Simple:
+		case VAProfileMPEG2Main:
+			surfaces[count++] = mpeg2->forward_reference_picture;
+			surfaces[count++] = mpeg2->backward_reference_picture;
+			break;
+
+		case VAProfileH264Main:
+		case VAProfileH264High:
+		case VAProfileH264ConstrainedBaseline:
+		case VAProfileH264MultiviewHigh:
+		case VAProfileH264StereoHigh:
+			for (i = 0; i < 16; i++)
+				if (!(h264->ReferenceFrames[i].flags & VA_PICTURE_H264_INVALID))
+					surfaces[count++] = h264->ReferenceFrames[i].picture_id;
+			break;
+
+		case VAProfileHEVCMain:
+			for (i = 0; i < 15; i++)
+				if (!(h265->ReferenceFrames[i].flags & VA_PICTURE_HEVC_INVALID))
+					surfaces[count++] = h265->ReferenceFrames[i].picture_id;
+			break;
+
+		default:
+			break;
+	}
+
+	return count;
+}
+
+/* Tell whether the slices gathered so far belong to a keyframe. */
+bool picture_keyframe(struct dump_driver_data *driver_data, VAProfile profile)
+{
+	struct nal_index *nal_index = &driver_data->nal_index;
+	unsigned int type;
+	unsigned int i;
+
+	switch (picture_nal_codec(profile)) {
+		case NAL_CODEC_MPEG2:
+			return driver_data->params.mpeg2.picture.picture_coding_type == 1;
+
+		case NAL_CODEC_H264:
+			for (i = 0; i < nal_index->count; i++)
+				if (nal_index->units[i].type == 5)
+					return true;
+			break;
+
+		case NAL_CODEC_H265:
+			for (i = 0; i < nal_index->count; i++) {
+				type = nal_index->units[i].type;
+				if (type >= 16 && type <= 23)
+					return true;
+			}
+			break;
+	}
+
+	return false;
+}
+
+/* Begin capturing a picture, looking the objects up by their IDs. */
+VAStatus picture_begin(struct dump_driver_data *driver_data,
+		       VAContextID context_id, VASurfaceID surface_id)
 {
-	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_context *context_object;
 	struct object_config *config_object;
 	struct object_surface *surface_object;
-	char *slice_filename;
-	char *slice_path;
 	unsigned int index;
-	int fd;
+	int rc;
 
 	context_object = (struct object_context *) object_heap_lookup(&driver_data->context_heap, context_id);
 	if (context_object == NULL)
@@ -56,27 +151,47 @@ VAStatus DumpBeginPicture(VADriverContextP context, VAContextID context_id,
 	if (surface_object == NULL)
 		return VA_STATUS_ERROR_INVALID_SURFACE;
 
+	PROBE3(begin_picture, context_id, surface_id, driver_data->frame_index);
+
 	surface_object->status = VASurfaceRendering;
+	surface_object->deadline = 0;
+	surface_object->references_count = 0;
+	surface_object->keyframe = false;
 	context_object->render_surface_id = surface_id;
 
+	STATS_ADD(driver_data->stats, frames_seen, 1);
+
+	driver_data->slices_count = 0;
+	STATS_ADD(driver_data->stats, codec_frames[picture_nal_codec(config_object->profile)], 1);
+
 	index = driver_data->frame_index;
-	if (index >= driver_data->dump_count)
+	if (index >= driver_data->dump_count) {
+		STATS_ADD(driver_data->stats, frames_skipped, 1);
 		return VA_STATUS_SUCCESS;
+	}
 
-	asprintf(&slice_filename, driver_data->slices_filename_format, index);
-	asprintf(&slice_path, "%s/%s", driver_data->slices_path, slice_filename);
-
-	fd = open(slice_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (governor_decide(&driver_data->governor) == GOVERNOR_SKIP) {
+		STATS_ADD(driver_data->stats, frames_skipped, 1);
+		return VA_STATUS_SUCCESS;
+	}
 
-	free(slice_path);
-	free(slice_filename);
+	/* Slice staging is only allocated for surfaces of frames that are dumped. */
+	rc = surface_staging_reserve(surface_object, context_object->staging_size);
+	if (rc < 0) {
+		log_error("Unable to allocate %u bytes of slice staging\n", context_object->staging_size);
+		STATS_ADD(driver_data->stats, frames_skipped, 1);
+		return VA_STATUS_SUCCESS;
+	}
 
-	if (fd < 0) {
-		fprintf(stderr, "Unable to open slice dump path %s: %s\n", slice_path, strerror(errno));
+	rc = output_frame_open(driver_data, context_id, index);
+	if (rc < 0) {
+		STATS_ADD(driver_data->stats, frames_skipped, 1);
 		return VA_STATUS_SUCCESS;
 	}
 
-	driver_data->dump_fd = fd;
+	STATS_ADD(driver_data->stats, frames_dumped, 1);
+
+	nal_index_reset(&driver_data->nal_index);
 
 	switch (config_object->profile) {
 		case VAProfileMPEG2Simple:
@@ -97,22 +212,303 @@ VAStatus DumpBeginPicture(VADriverContextP context, VAContextID context_id,
 			break;
 
 		default:
-			fprintf(stderr, "Unsupported profile\n");
+			log_error("Unsupported profile\n");
 			return VA_STATUS_SUCCESS;
 	}
 
 	return VA_STATUS_SUCCESS;
 }
 
+VAStatus DumpBeginPicture(VADriverContextP context, VAContextID context_id,
+	VASurfaceID surface_id)
+{
+	TRACE_FUNCTION();
+
+	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
+
+	return picture_begin(driver_data, context_id, surface_id);
+}
+
+/*
+ * Keep the parameters of each slice of the buffer, along with the offset where
+ * the slice data buffer that follows them is copied.
+ */
+static void picture_slices_append(struct dump_driver_data *driver_data,
+				  struct object_surface *surface_object,
+				  struct object_buffer *buffer_object)
+{
+	struct dump_slice *slices;
+	struct dump_slice *slice;
+	unsigned int allocated;
+	unsigned int size;
+	unsigned int i;
+
+	if (driver_data->slices_count + buffer_object->count >
+	    driver_data->slices_allocated) {
+		allocated = driver_data->slices_allocated * 2;
+		if (allocated < driver_data->slices_count + buffer_object->count)
+			allocated = driver_data->slices_count + buffer_object->count;
+
+		slices = realloc(driver_data->slices,
+				 allocated * sizeof(*slices));
+		if (slices == NULL) {
+			log_error("Unable to allocate %u slice parameters\n", allocated);
+			return;
+		}
+
+		driver_data->slices = slices;
+		driver_data->slices_allocated = allocated;
+	}
+
+	size = buffer_object->size;
+	if (size > sizeof(slice->params))
+		size = sizeof(slice->params);
+
+	for (i = 0; i < buffer_object->count; i++) {
+		slice = &driver_data->slices[driver_data->slices_count++];
+
+		memset(&slice->params, 0, sizeof(slice->params));
+		memcpy(&slice->params, (uint8_t *) buffer_object->data +
+		       i * buffer_object->size, size);
+		slice->offset = surface_object->slice_size;
+	}
+}
+
+/*
+ * Find where to copy the next slice of the picture: in place in the ring record
+ * of the frame when possible, in the slice staging of the surface otherwise.
+ */
+static void *picture_slice_area(struct dump_driver_data *driver_data,
+				struct object_surface *surface_object,
+				unsigned int size, bool *ring)
+{
+	bool in_ring = surface_object->slice_data != surface_object->slice_staging;
+	unsigned int capacity;
+	void *area;
+	int rc;
+
+	if (surface_object->slice_offset == 0 || in_ring) {
+		area = output_slice_reserve(driver_data, size);
+		if (area != NULL) {
+			if (surface_object->slice_offset == 0)
+				surface_object->slice_data = area;
+
+			*ring = true;
+			return area;
+		}
+	}
+
+	*ring = false;
+
+	/* Grow the staging if the picture exceeds its expected worst-case size. */
+	capacity = surface_object->slice_size + size;
+	if (capacity > surface_object->slice_data_size) {
+		if (capacity < surface_object->slice_data_size * 2)
+			capacity = surface_object->slice_data_size * 2;
+
+		rc = surface_staging_reserve(surface_object, capacity);
+		if (rc < 0) {
+			log_error("Unable to allocate %u bytes of slice staging\n", capacity);
+			return NULL;
+		}
+	}
+
+	/* Slices of a frame too large for the ring move over to the staging. */
+	if (in_ring && surface_object->slice_offset > 0)
+		memcpy(surface_object->slice_staging, surface_object->slice_data,
+		       surface_object->slice_size);
+
+	surface_object->slice_data = surface_object->slice_staging;
+
+	return (uint8_t *) surface_object->slice_data + surface_object->slice_size;
+}
+
+/* Capture one of the buffers of the picture that is rendered to the surface. */
+void picture_render_buffer(struct dump_driver_data *driver_data,
+			   struct object_config *config_object,
+			   struct object_surface *surface_object,
+			   struct object_buffer *buffer_object)
+{
+	enum nal_codec codec;
+	void *slice_data;
+	unsigned int slice_size;
+	bool ring;
+	bool rbsp;
+
+	if (buffer_object->type == VAPictureParameterBufferType ||
+	    buffer_object->type == VAIQMatrixBufferType ||
+	    buffer_object->type == VASliceParameterBufferType)
+		output_parameters(driver_data, buffer_object->data,
+				  buffer_object->size * buffer_object->count);
+
+	if (buffer_object->type == VASliceDataBufferType) {
+		log_debug("Dumping %d bytes of slice %d/%d\n", buffer_object->size, driver_data->frame_index + 1, driver_data->dump_count);
+
+		STATS_ADD(driver_data->stats, slices, 1);
+
+		/* Keep track of the last slice, described by the current slice parameters. */
+		surface_object->slice_offset = surface_object->slice_size;
+
+		codec = picture_nal_codec(config_object->profile);
+		rbsp = driver_data->slices_rbsp && codec != NAL_CODEC_MPEG2;
+
+		TRACE_BEGIN("slice copy");
+
+		nal_index_scan(&driver_data->nal_index, codec,
+			       buffer_object->data, buffer_object->size,
+			       surface_object->slice_offset, rbsp);
+
+		/* Frames sampled for keyframes are hashed otherwise. */
+		if (driver_data->governor.level == GOVERNOR_KEYFRAMES &&
+		    surface_object->slice_offset == 0 &&
+		    !picture_keyframe(driver_data, config_object->profile))
+			driver_data->governor.level = GOVERNOR_HASH;
+
+		slice_data = picture_slice_area(driver_data, surface_object,
+						buffer_object->size, &ring);
+		if (slice_data == NULL) {
+			TRACE_END("slice copy");
+			return;
+		}
+
+		/* Strip emulation prevention bytes while copying in RBSP mode. */
+		if (rbsp) {
+			slice_size = nal_unescape(slice_data, buffer_object->data, buffer_object->size);
+		} else {
+			memcpy(slice_data, buffer_object->data, buffer_object->size);
+			slice_size = buffer_object->size;
+		}
+
+		surface_object->slice_size += slice_size;
+
+		TRACE_END("slice copy");
+
+		if (codec == NAL_CODEC_H265)
+			h265_dump_slice_layout(driver_data,
+					       buffer_object->data,
+					       buffer_object->size);
+
+		if (ring)
+			output_slice_commit(driver_data, slice_size);
+		else
+			output_write(driver_data, slice_data, slice_size);
+	} else if (buffer_object->type == VASliceParameterBufferType) {
+		TRACE_BEGIN("parameter copy");
+
+		/* The first slice of the buffer is the current one, all are kept. */
+		picture_slices_append(driver_data, surface_object, buffer_object);
+
+		switch (config_object->profile) {
+			case VAProfileMPEG2Simple:
+			case VAProfileMPEG2Main:
+				memcpy(&driver_data->params.mpeg2.slice,
+				       buffer_object->data,
+				       sizeof(driver_data->params.mpeg2.slice));
+				break;
+
+			case VAProfileH264Main:
+			case VAProfileH264High:
+			case VAProfileH264ConstrainedBaseline:
+			case VAProfileH264MultiviewHigh:
+			case VAProfileH264StereoHigh:
+				memcpy(&driver_data->params.h264.slice,
+				       buffer_object->data,
+				       sizeof(driver_data->params.h264.slice));
+				break;
+
+			case VAProfileHEVCMain:
+				memcpy(&driver_data->params.h265.slice,
+				       buffer_object->data,
+				       sizeof(driver_data->params.h265.slice));
+				break;
+
+			default:
+				break;
+		}
+
+		TRACE_END("parameter copy");
+	} else if (buffer_object->type == VAPictureParameterBufferType) {
+		TRACE_BEGIN("parameter copy");
+
+		switch (config_object->profile) {
+			case VAProfileMPEG2Simple:
+			case VAProfileMPEG2Main:
+				memcpy(&driver_data->params.mpeg2.picture,
+				       buffer_object->data,
+				       sizeof(driver_data->params.mpeg2.picture));
+				break;
+
+			case VAProfileH264Main:
+			case VAProfileH264High:
+			case VAProfileH264ConstrainedBaseline:
+			case VAProfileH264MultiviewHigh:
+			case VAProfileH264StereoHigh:
+				memcpy(&driver_data->params.h264.picture,
+				       buffer_object->data,
+				       sizeof(driver_data->params.h264.picture));
+				break;
+
+			case VAProfileHEVCMain:
+				memcpy(&driver_data->params.h265.picture,
+				       buffer_object->data,
+				       sizeof(driver_data->params.h265.picture));
+				break;
+
+			default:
+				break;
+		}
+
+		TRACE_END("parameter copy");
+	} else if (buffer_object->type == VAIQMatrixBufferType) {
+		TRACE_BEGIN("parameter copy");
+
+		switch (config_object->profile) {
+			case VAProfileMPEG2Simple:
+			case VAProfileMPEG2Main:
+				memcpy(&driver_data->params.mpeg2.quantization,
+				       buffer_object->data,
+				       sizeof(driver_data->params.mpeg2.quantization));
+				break;
+
+			case VAProfileH264Main:
+			case VAProfileH264High:
+			case VAProfileH264ConstrainedBaseline:
+			case VAProfileH264MultiviewHigh:
+			case VAProfileH264StereoHigh:
+				memcpy(&driver_data->params.h264.quantization,
+				       buffer_object->data,
+				       sizeof(driver_data->params.h264.quantization));
+				break;
+
+			case VAProfileHEVCMain:
+				memcpy(&driver_data->params.h265.quantization,
+				       buffer_object->data,
+				       sizeof(driver_data->params.h265.quantization));
+				break;
+
+		default:
+			break;
+		}
+
+		TRACE_END("parameter copy");
+	} else {
+		log_warning("Unknown buffer type %d\n",
+			buffer_object->type);
+	}
+}
+
 VAStatus DumpRenderPicture(VADriverContextP context, VAContextID context_id,
 	VABufferID *buffers, int buffers_count)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_context *context_object;
 	struct object_config *config_object;
 	struct object_surface *surface_object;
 	struct object_buffer *buffer_object;
 	VABufferID buffer_id;
+	struct timespec start;
 	int i;
 
 	context_object = (struct object_context *) object_heap_lookup(&driver_data->context_heap, context_id);
@@ -127,9 +523,14 @@ VAStatus DumpRenderPicture(VADriverContextP context, VAContextID context_id,
 	if (surface_object == NULL)
 		return VA_STATUS_ERROR_INVALID_SURFACE;
 
-	if (driver_data->dump_fd < 0)
+	PROBE3(render_picture, context_id, buffers_count,
+	       driver_data->frame_index);
+
+	if (!driver_data->output.frame_open)
 		return VA_STATUS_SUCCESS;
 
+	governor_clock(&driver_data->governor, &start);
+
 	for (i = 0; i < buffers_count; i++) {
 		buffer_id = buffers[i];
 
@@ -137,112 +538,25 @@ VAStatus DumpRenderPicture(VADriverContextP context, VAContextID context_id,
 		if (buffer_object == NULL)
 			return VA_STATUS_ERROR_INVALID_BUFFER;
 
-		if (buffer_object->type == VASliceDataBufferType) {
-			fprintf(stderr, "Dumping %d bytes of slice %d/%d\n", buffer_object->size, driver_data->frame_index + 1, driver_data->dump_count);
-
-			memcpy(surface_object->slice_data + surface_object->slice_size, buffer_object->data, buffer_object->size);
-			surface_object->slice_size += buffer_object->size;
-
-			write(driver_data->dump_fd, buffer_object->data, buffer_object->size);
-		} else if (buffer_object->type == VASliceParameterBufferType) {
-			switch (config_object->profile) {
-				case VAProfileMPEG2Simple:
-				case VAProfileMPEG2Main:
-					memcpy(&driver_data->params.mpeg2.slice,
-					       buffer_object->data,
-					       sizeof(driver_data->params.mpeg2.slice));
-					break;
-
-				case VAProfileH264Main:
-				case VAProfileH264High:
-				case VAProfileH264ConstrainedBaseline:
-				case VAProfileH264MultiviewHigh:
-				case VAProfileH264StereoHigh:
-					memcpy(&driver_data->params.h264.slice,
-					       buffer_object->data,
-					       sizeof(driver_data->params.h264.slice));
-					break;
-
-				case VAProfileHEVCMain:
-					memcpy(&driver_data->params.h265.slice,
-					       buffer_object->data,
-					       sizeof(driver_data->params.h265.slice));
-					break;
-
-				default:
-					break;
-			}
-		} else if (buffer_object->type == VAPictureParameterBufferType) {
-			switch (config_object->profile) {
-				case VAProfileMPEG2Simple:
-				case VAProfileMPEG2Main:
-					memcpy(&driver_data->params.mpeg2.picture,
-					       buffer_object->data,
-					       sizeof(driver_data->params.mpeg2.picture));
-					break;
-
-				case VAProfileH264Main:
-				case VAProfileH264High:
-				case VAProfileH264ConstrainedBaseline:
-				case VAProfileH264MultiviewHigh:
-				case VAProfileH264StereoHigh:
-					memcpy(&driver_data->params.h264.picture,
-					       buffer_object->data,
-					       sizeof(driver_data->params.h264.picture));
-					break;
-
-				case VAProfileHEVCMain:
-					memcpy(&driver_data->params.h265.picture,
-					       buffer_object->data,
-					       sizeof(driver_data->params.h265.picture));
-					break;
-
-				default:
-					break;
-			}
-		} else if (buffer_object->type == VAIQMatrixBufferType) {
-			switch (config_object->profile) {
-				case VAProfileMPEG2Simple:
-				case VAProfileMPEG2Main:
-					memcpy(&driver_data->params.mpeg2.quantization,
-					       buffer_object->data,
-					       sizeof(driver_data->params.mpeg2.quantization));
-					break;
-
-				case VAProfileH264Main:
-				case VAProfileH264High:
-				case VAProfileH264ConstrainedBaseline:
-				case VAProfileH264MultiviewHigh:
-				case VAProfileH264StereoHigh:
-					memcpy(&driver_data->params.h264.quantization,
-					       buffer_object->data,
-					       sizeof(driver_data->params.h264.quantization));
-					break;
-
-				case VAProfileHEVCMain:
-					memcpy(&driver_data->params.h265.quantization,
-					       buffer_object->data,
-					       sizeof(driver_data->params.h265.quantization));
-					break;
-
-			default:
-				break;
-			}
-		} else {
-			fprintf(stderr, "Unknown buffer type %d\n",
-				buffer_object->type);
-		}
+		picture_render_buffer(driver_data, config_object, surface_object,
+				      buffer_object);
 	}
 
+	governor_charge(&driver_data->governor, 0, &start);
+
 	return VA_STATUS_SUCCESS;
 }
 
-VAStatus DumpEndPicture(VADriverContextP context, VAContextID context_id)
+/* Finish capturing the picture and write it out. */
+VAStatus picture_end(struct dump_driver_data *driver_data,
+		     VAContextID context_id)
 {
-	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_context *context_object;
 	struct object_config *config_object;
 	struct object_surface *surface_object;
+	struct governor *governor = &driver_data->governor;
+	unsigned long long written = 0;
+	struct timespec start;
 
 	context_object = (struct object_context *) object_heap_lookup(&driver_data->context_heap, context_id);
 	if (context_object == NULL)
@@ -256,11 +570,24 @@ VAStatus DumpEndPicture(VADriverContextP context, VAContextID context_id)
 	if (surface_object == NULL)
 		return VA_STATUS_ERROR_INVALID_SURFACE;
 
-	if (driver_data->frame_index < driver_data->dump_count) {
+	PROBE4(end_picture, context_id, context_object->render_surface_id,
+	       driver_data->frame_index, surface_object->slice_size);
+
+	governor_clock(governor, &start);
+
+	if (driver_data->frame_index < driver_data->dump_count &&
+	    governor->level == GOVERNOR_SKIP) {
+		governor_print_skip(driver_data, driver_data->frame_index);
+	} else if (driver_data->frame_index < driver_data->dump_count &&
+		   surface_object->slice_data != NULL) {
+		output_metadata_begin(driver_data);
+
 		switch (config_object->profile) {
 			case VAProfileMPEG2Simple:
 			case VAProfileMPEG2Main:
-				mpeg2_dump_header(driver_data, surface_object->slice_data, surface_object->slice_size);
+				mpeg2_dump_header(driver_data, config_object->profile,
+						  surface_object->slice_data,
+						  surface_object->slice_size);
 				break;
 
 			case VAProfileH264Main:
@@ -268,32 +595,91 @@ VAStatus DumpEndPicture(VADriverContextP context, VAContextID context_id)
 			case VAProfileH264ConstrainedBaseline:
 			case VAProfileH264MultiviewHigh:
 			case VAProfileH264StereoHigh:
-				h264_dump_header(driver_data, surface_object);
+				h264_dump_header(driver_data, config_object->profile,
+						 surface_object);
 				break;
 
 			case VAProfileHEVCMain:
-				h265_dump_header(driver_data, surface_object->slice_data, surface_object->slice_size);
+				h265_dump_header(driver_data, surface_object);
 				break;
 
 			default:
-				fprintf(stderr, "Unsupported profile\n");
+				log_error("Unsupported profile\n");
 				return VA_STATUS_SUCCESS;
 		}
+
+		output_metadata_end(driver_data);
+
+		if (driver_data->output.mode == OUTPUT_MODE_GOLDEN &&
+		    driver_data->output.frame_open)
+			golden_check(driver_data, config_object->profile, surface_object);
+
+		output_index_frame(driver_data, config_object->profile, surface_object);
+
+		if (driver_data->output.frame_open) {
+			written = driver_data->output.metadata_size;
+			if (governor->level != GOVERNOR_HASH)
+				written += surface_object->slice_size;
+		}
 	}
 
+	/* Keep the size of the last frame for the surface, in case it is referenced. */
+	surface_object->dump_size = surface_object->slice_size;
+
 	/* Update last-seen frame index of the surface to stay in sync with current frame index. */
 	surface_object->index = driver_data->frame_index;
 
+	output_frame_close(driver_data, surface_object->slice_data, surface_object->slice_size);
+
+	if (driver_data->frame_index < driver_data->dump_count)
+		governor_end(governor, written, &start);
+
 	surface_object->slice_size = 0;
+	surface_object->slice_offset = 0;
 
-	context_object->render_surface_id = VA_INVALID_ID;
+	/* The ring record of the frame is no longer ours once published. */
+	surface_object->slice_data = surface_object->slice_staging;
 
-	if (driver_data->dump_fd >= 0) {
-		close(driver_data->dump_fd);
-		driver_data->dump_fd = -1;
-	}
+	context_object->render_surface_id = VA_INVALID_ID;
 
 	driver_data->frame_index++;
 
+	context_staging_release(driver_data, context_object,
+				driver_data->frame_index < driver_data->dump_count);
+
+	return VA_STATUS_SUCCESS;
+}
+
+VAStatus DumpEndPicture(VADriverContextP context, VAContextID context_id)
+{
+	TRACE_FUNCTION();
+
+	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
+	struct object_context *context_object;
+	struct object_config *config_object;
+	struct object_surface *surface_object;
+	VASurfaceID surface_id;
+	VAStatus status;
+
+	context_object = (struct object_context *) object_heap_lookup(&driver_data->context_heap, context_id);
+	if (context_object == NULL)
+		return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+	surface_id = context_object->render_surface_id;
+
+	status = picture_end(driver_data, context_id);
+	if (status != VA_STATUS_SUCCESS || !driver_data->timing.enabled)
+		return status;
+
+	config_object = (struct object_config *) object_heap_lookup(&driver_data->config_heap, context_object->config_id);
+	surface_object = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, surface_id);
+	if (config_object == NULL || surface_object == NULL)
+		return VA_STATUS_SUCCESS;
+
+	/* The surface stays rendering until the virtual decoder is done with it. */
+	surface_object->deadline = timing_submit(&driver_data->timing,
+		picture_nal_codec(config_object->profile),
+		context_object->picture_width, context_object->picture_height);
+
 	return VA_STATUS_SUCCESS;
 }
@@ -18,10 +18,32 @@
 #ifndef _PICTURE_H_
 #define _PICTURE_H_
 
+#include <stdbool.h>
+
 #include <va/va_backend.h>
 
+#include "nal.h"
 #include "object_heap.h"
 
+struct dump_driver_data;
+struct object_buffer;
+struct object_config;
+struct object_surface;
+
+enum nal_codec picture_nal_codec(VAProfile profile);
+unsigned int picture_references(struct dump_driver_data *driver_data,
+				VAProfile profile, VASurfaceID *surfaces);
+bool picture_keyframe(struct dump_driver_data *driver_data, VAProfile profile);
+
+VAStatus picture_begin(struct dump_driver_data *driver_data,
+		       VAContextID context_id, VASurfaceID surface_id);
+void picture_render_buffer(struct dump_driver_data *driver_data,
+			   struct object_config *config_object,
+			   struct object_surface *surface_object,
+			   struct object_buffer *buffer_object);
+VAStatus picture_end(struct dump_driver_data *driver_data,
+		     VAContextID context_id);
+
 VAStatus DumpBeginPicture(VADriverContextP context, VAContextID context_id,
 	VASurfaceID surface_id);
 VAStatus DumpRenderPicture(VADriverContextP context, VAContextID context_id,
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROBE_H_
+#define _PROBE_H_
+
+#include "autoconfig.h"
+
+/*
+ * Values
+ */
+
+/*
+ * Static probes of the "dump" provider, that tools such as bpftrace or perf
+ * can attach to. Each one is a single no-op instruction when nothing is
+ * attached, and nothing at all without <sys/sdt.h>.
+ */
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define PROBE1(name, a) \
+	DTRACE_PROBE1(dump, name, a)
+#define PROBE2(name, a, b) \
+	DTRACE_PROBE2(dump, name, a, b)
+#define PROBE3(name, a, b, c) \
+	DTRACE_PROBE3(dump, name, a, b, c)
+#define PROBE4(name, a, b, c, d) \
+	DTRACE_PROBE4(dump, name, a, b, c, d)
+
+#else
+
+#define PROBE1(name, a) \
+	do { } while (0)
+#define PROBE2(name, a, b) \
+	do { } while (0)
+#define PROBE3(name, a, b, c) \
+	do { } while (0)
+#define PROBE4(name, a, b, c, d) \
+	do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#include "ring.h"
+#include "log.h"
+
+static size_t ring_page_align(size_t size)
+{
+	size_t page_size = sysconf(_SC_PAGESIZE);
+
+	return (size + page_size - 1) / page_size * page_size;
+}
+
+/* Map the data area twice in a row after the control area. */
+static int ring_map(struct ring *ring, size_t control_size, uint64_t data_size)
+{
+	uint8_t *base;
+	void *map;
+
+	ring->map_size = control_size + 2 * data_size;
+
+	base = mmap(NULL, ring->map_size, PROT_NONE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		return -1;
+
+	map = mmap(base, control_size + data_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_FIXED, ring->fd, 0);
+	if (map == MAP_FAILED)
+		goto error;
+
+	map = mmap(base + control_size + data_size, data_size,
+		   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, ring->fd,
+		   control_size);
+	if (map == MAP_FAILED)
+		goto error;
+
+	ring->base = base;
+	ring->control = (struct ring_control *) base;
+	ring->slots = (struct ring_slot *) (base + sizeof(struct ring_control));
+	ring->data = base + control_size;
+	ring->data_size = data_size;
+
+	return 0;
+
+error:
+	/* Drop the reservation along with whatever part of it got mapped. */
+	munmap(base, ring->map_size);
+	ring->map_size = 0;
+
+	return -1;
+}
+
+int ring_create(struct ring *ring, const char *name, uint64_t data_size,
+		unsigned int slot_count)
+{
+	struct ring_control *control;
+	size_t control_size;
+	int rc;
+
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+	ring->producer = true;
+
+	if (slot_count == 0)
+		slot_count = RING_SLOT_COUNT;
+
+	control_size = ring_page_align(sizeof(struct ring_control) +
+				       slot_count * sizeof(struct ring_slot));
+	data_size = ring_page_align(data_size);
+
+	ring->name = strdup(name);
+	if (ring->name == NULL)
+		return -1;
+
+	ring->fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (ring->fd < 0)
+		goto error;
+
+	rc = ftruncate(ring->fd, control_size + data_size);
+	if (rc < 0)
+		goto error_unlink;
+
+	rc = ring_map(ring, control_size, data_size);
+	if (rc < 0)
+		goto error_unlink;
+
+	ring->slot_count = slot_count;
+
+	control = ring->control;
+	control->version = RING_VERSION;
+	control->control_size = control_size;
+	control->slot_count = slot_count;
+	control->data_size = data_size;
+
+	/* Readers check the magic last. */
+	__atomic_store_n(&control->magic, RING_MAGIC, __ATOMIC_RELEASE);
+
+	return 0;
+
+error_unlink:
+	shm_unlink(name);
+
+error:
+	log_error("Unable to create dump ring %s: %s\n", name,
+		strerror(errno));
+
+	if (ring->control != NULL) {
+		munmap(ring->base, ring->map_size);
+		ring->control = NULL;
+	}
+
+	if (ring->fd >= 0) {
+		close(ring->fd);
+		ring->fd = -1;
+	}
+
+	free(ring->name);
+	ring->name = NULL;
+
+	return -1;
+}
+
+void ring_begin(struct ring *ring)
+{
+	ring->frame_size = 0;
+	ring->frame_overflow = false;
+}
+
+/*
+ * Return the area for the next size bytes of the record, to be filled in place
+ * and committed with the size actually used, or NULL when the record does not
+ * fit in the ring.
+ */
+void *ring_reserve(struct ring *ring, unsigned int size)
+{
+	uint64_t position;
+
+	if (ring->control == NULL || ring->frame_overflow)
+		return NULL;
+
+	if (ring->frame_size + size > ring->data_size) {
+		ring->frame_overflow = true;
+		return NULL;
+	}
+
+	position = ring->frame_offset + ring->frame_size;
+
+	/*
+	 * Claim the area before overwriting it so that readers notice. Areas
+	 * are committed with at most their size, so the head never moves back.
+	 */
+	if (position + size > ring->control->data_head) {
+		__atomic_store_n(&ring->control->data_head, position + size,
+				 __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+	}
+
+	return ring->data + position % ring->data_size;
+}
+
+void ring_commit(struct ring *ring, unsigned int size)
+{
+	ring->frame_size += size;
+}
+
+void ring_write(struct ring *ring, const void *data, unsigned int size)
+{
+	void *area;
+
+	area = ring_reserve(ring, size);
+	if (area == NULL)
+		return;
+
+	memcpy(area, data, size);
+
+	ring_commit(ring, size);
+}
+
+int ring_publish(struct ring *ring, struct ring_slot *slot)
+{
+	struct ring_control *control = ring->control;
+	struct ring_slot *target;
+	uint64_t sequence;
+
+	if (control == NULL)
+		return -1;
+
+	if (ring->frame_overflow) {
+		__atomic_add_fetch(&control->dropped, 1, __ATOMIC_RELAXED);
+		ring->frame_offset += ring->frame_size;
+		ring_begin(ring);
+		return -1;
+	}
+
+	sequence = control->sequence;
+	target = &ring->slots[sequence % ring->slot_count];
+
+	__atomic_store_n(&target->sequence, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	target->offset = ring->frame_offset;
+	target->size = ring->frame_size;
+	target->flags = slot->flags;
+	target->frame_index = slot->frame_index;
+	target->context_id = slot->context_id;
+	target->slice_size = slot->slice_size;
+	target->metadata_size = slot->metadata_size;
+
+	__atomic_store_n(&target->sequence, sequence + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&control->sequence, sequence + 1, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&control->futex, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&control->waiters, __ATOMIC_SEQ_CST) > 0)
+		syscall(SYS_futex, &control->futex, FUTEX_WAKE, INT_MAX, NULL,
+			NULL, 0);
+
+	ring->frame_offset += ring->frame_size;
+	ring_begin(ring);
+
+	return 0;
+}
+
+void ring_destroy(struct ring *ring)
+{
+	struct ring_control *control = ring->control;
+
+	if (control != NULL && ring->producer) {
+		__atomic_store_n(&control->closed, 1, __ATOMIC_RELEASE);
+		__atomic_add_fetch(&control->futex, 1, __ATOMIC_SEQ_CST);
+		syscall(SYS_futex, &control->futex, FUTEX_WAKE, INT_MAX, NULL,
+			NULL, 0);
+
+		if (control->dropped > 0)
+			log_warning("Dropped %llu frames too large for the dump ring\n",
+				(unsigned long long) control->dropped);
+	}
+
+	if (control != NULL) {
+		munmap(ring->base, ring->map_size);
+		ring->control = NULL;
+	}
+
+	if (ring->name != NULL) {
+		if (ring->producer)
+			shm_unlink(ring->name);
+
+		free(ring->name);
+		ring->name = NULL;
+	}
+
+	if (ring->fd >= 0) {
+		close(ring->fd);
+		ring->fd = -1;
+	}
+}
+
+int ring_attach(struct ring *ring, const char *name)
+{
+	struct ring_control control;
+	ssize_t rc;
+
+	memset(ring, 0, sizeof(*ring));
+
+	ring->fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+	if (ring->fd < 0)
+		return -1;
+
+	rc = pread(ring->fd, &control, sizeof(control), 0);
+	if (rc != sizeof(control) || control.magic != RING_MAGIC ||
+	    control.version != RING_VERSION) {
+		close(ring->fd);
+		ring->fd = -1;
+		errno = EINVAL;
+		return -1;
+	}
+
+	rc = ring_map(ring, control.control_size, control.data_size);
+	if (rc < 0) {
+		close(ring->fd);
+		ring->fd = -1;
+		return -1;
+	}
+
+	ring->slot_count = control.slot_count;
+
+	return 0;
+}
+
+uint64_t ring_sequence(struct ring *ring)
+{
+	return __atomic_load_n(&ring->control->sequence, __ATOMIC_ACQUIRE);
+}
+
+bool ring_closed(struct ring *ring)
+{
+	return __atomic_load_n(&ring->control->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+/*
+ * Return 0 with the slot and a pointer to its data when the record is
+ * available, -EAGAIN when it is not published yet and -ERANGE when it was
+ * already overwritten. The data must be checked with ring_valid after use.
+ */
+int ring_read(struct ring *ring, uint64_t sequence, struct ring_slot *slot,
+	      const uint8_t **data)
+{
+	struct ring_slot *source = &ring->slots[sequence % ring->slot_count];
+	uint64_t published = ring_sequence(ring);
+
+	if (sequence >= published)
+		return -EAGAIN;
+
+	if (published - sequence > ring->slot_count)
+		return -ERANGE;
+
+	if (__atomic_load_n(&source->sequence, __ATOMIC_ACQUIRE) != sequence + 1)
+		return -ERANGE;
+
+	memcpy(slot, source, sizeof(*slot));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	if (__atomic_load_n(&source->sequence, __ATOMIC_RELAXED) != sequence + 1)
+		return -ERANGE;
+
+	if (!ring_valid(ring, slot))
+		return -ERANGE;
+
+	*data = ring->data + slot->offset % ring->data_size;
+
+	return 0;
+}
+
+bool ring_valid(struct ring *ring, struct ring_slot *slot)
+{
+	uint64_t head;
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&ring->control->data_head, __ATOMIC_RELAXED);
+
+	return head - slot->offset <= ring->data_size;
+}
+
+/* Wait for a record to be published, for at most timeout milliseconds. */
+int ring_wait(struct ring *ring, uint64_t sequence, int timeout)
+{
+	struct ring_control *control = ring->control;
+	struct timespec timespec;
+	uint32_t value;
+
+	if (ring_sequence(ring) > sequence)
+		return 0;
+
+	timespec.tv_sec = timeout / 1000;
+	timespec.tv_nsec = (timeout % 1000) * 1000000;
+
+	value = __atomic_load_n(&control->futex, __ATOMIC_ACQUIRE);
+	__atomic_add_fetch(&control->waiters, 1, __ATOMIC_SEQ_CST);
+
+	if (ring_sequence(ring) <= sequence && !ring_closed(ring))
+		syscall(SYS_futex, &control->futex, FUTEX_WAIT, value,
+			timeout < 0 ? NULL : &timespec, NULL, 0);
+
+	__atomic_sub_fetch(&control->waiters, 1, __ATOMIC_SEQ_CST);
+
+	return ring_sequence(ring) > sequence ? 0 : -EAGAIN;
+}
+
+void ring_detach(struct ring *ring)
+{
+	ring_destroy(ring);
+}
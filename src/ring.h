@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Values
+ */
+
+#define RING_MAGIC				0x474e4952
+#define RING_VERSION				1
+
+#define RING_FLAG_RBSP				(1 << 0)
+
+#define RING_DATA_SIZE				(64 * 1024 * 1024)
+#define RING_SLOT_COUNT				256
+
+/*
+ * Structures
+ */
+
+/*
+ * The shared memory segment holds the control structure, followed by the slots
+ * and the data area, which starts on a page boundary. The data area is mapped
+ * twice in a row so that records wrapping around its end stay contiguous.
+ *
+ * Records are published in sequence: a slot is valid while its sequence equals
+ * the record sequence plus one and its data is valid while the data head is no
+ * further than the data area size past its offset.
+ */
+struct ring_control {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t control_size;
+	uint32_t slot_count;
+	uint64_t data_size;
+	uint32_t closed;
+	uint32_t reserved;
+	uint64_t dropped;
+
+	uint64_t sequence __attribute__((aligned(64)));
+	uint64_t data_head;
+
+	uint32_t futex __attribute__((aligned(64)));
+	uint32_t waiters;
+};
+
+struct ring_slot {
+	uint64_t sequence;
+	uint64_t offset;
+	uint32_t size;
+	uint32_t flags;
+	uint32_t frame_index;
+	uint32_t context_id;
+	uint32_t slice_size;
+	uint32_t metadata_size;
+} __attribute__((aligned(64)));
+
+struct ring {
+	char *name;
+	int fd;
+	bool producer;
+
+	void *base;
+	size_t map_size;
+
+	struct ring_control *control;
+	struct ring_slot *slots;
+	uint8_t *data;
+	uint64_t data_size;
+	unsigned int slot_count;
+
+	uint64_t frame_offset;
+	uint64_t frame_size;
+	bool frame_overflow;
+};
+
+/*
+ * Functions
+ */
+
+int ring_create(struct ring *ring, const char *name, uint64_t data_size,
+		unsigned int slot_count);
+void ring_begin(struct ring *ring);
+void *ring_reserve(struct ring *ring, unsigned int size);
+void ring_commit(struct ring *ring, unsigned int size);
+void ring_write(struct ring *ring, const void *data, unsigned int size);
+int ring_publish(struct ring *ring, struct ring_slot *slot);
+void ring_destroy(struct ring *ring);
+
+int ring_attach(struct ring *ring, const char *name);
+uint64_t ring_sequence(struct ring *ring);
+bool ring_closed(struct ring *ring);
+int ring_read(struct ring *ring, uint64_t sequence, struct ring_slot *slot,
+	      const uint8_t **data);
+bool ring_valid(struct ring *ring, struct ring_slot *slot);
+int ring_wait(struct ring *ring, uint64_t sequence, int timeout);
+void ring_detach(struct ring *ring);
+
+#endif
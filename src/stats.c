@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "stats.h"
+#include "log.h"
+
+struct stats *stats_create(const char *name)
+{
+	struct stats *stats;
+	int fd;
+	int rc;
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		goto error;
+
+	rc = ftruncate(fd, sizeof(*stats));
+	if (rc < 0)
+		goto error_unlink;
+
+	stats = mmap(NULL, sizeof(*stats), PROT_READ | PROT_WRITE, MAP_SHARED,
+		     fd, 0);
+	if (stats == MAP_FAILED)
+		goto error_unlink;
+
+	close(fd);
+
+	stats->version = STATS_VERSION;
+	stats->pid = getpid();
+	stats->start_time = time(NULL);
+
+	__atomic_store_n(&stats->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+
+	return stats;
+
+error_unlink:
+	shm_unlink(name);
+
+error:
+	log_error("Unable to create dump stats %s: %s\n", name,
+		strerror(errno));
+
+	if (fd >= 0)
+		close(fd);
+
+	return NULL;
+}
+
+void stats_destroy(struct stats *stats, const char *name)
+{
+	if (stats == NULL)
+		return;
+
+	munmap(stats, sizeof(*stats));
+	shm_unlink(name);
+}
+
+struct stats *stats_attach(const char *name)
+{
+	struct stats *stats;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0)
+		return NULL;
+
+	stats = mmap(NULL, sizeof(*stats), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (stats == MAP_FAILED)
+		return NULL;
+
+	if (stats->magic != STATS_MAGIC || stats->version != STATS_VERSION) {
+		munmap(stats, sizeof(*stats));
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return stats;
+}
+
+void stats_detach(struct stats *stats)
+{
+	munmap(stats, sizeof(*stats));
+}
+
+void stats_write(struct stats *stats, unsigned int size,
+		 struct timespec *start)
+{
+	struct timespec end;
+	uint64_t elapsed;
+	unsigned int bucket;
+
+	if (stats == NULL)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	elapsed = (end.tv_sec - start->tv_sec) * 1000000000ULL +
+		  end.tv_nsec - start->tv_nsec;
+
+	bucket = 63 - __builtin_clzll(elapsed | 1);
+	if (bucket >= STATS_LATENCY_BUCKETS)
+		bucket = STATS_LATENCY_BUCKETS - 1;
+
+	STATS_ADD(stats, writes, 1);
+	STATS_ADD(stats, bytes_written, size);
+	STATS_ADD(stats, write_latency[bucket], 1);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Values
+ */
+
+#define STATS_MAGIC				0x54415453
+#define STATS_VERSION				1
+
+#define STATS_CODEC_COUNT			3
+#define STATS_LATENCY_BUCKETS			40
+
+/* Counters are updated with relaxed atomics and skipped without a segment. */
+#define STATS_ADD(stats, field, value) \
+	do { \
+		if ((stats) != NULL) \
+			__atomic_add_fetch(&(stats)->field, (value), \
+					   __ATOMIC_RELAXED); \
+	} while (0)
+
+#define STATS_SET(stats, field, value) \
+	do { \
+		if ((stats) != NULL) \
+			__atomic_store_n(&(stats)->field, (value), \
+					 __ATOMIC_RELAXED); \
+	} while (0)
+
+/*
+ * Structures
+ */
+
+/*
+ * Shared memory segment layout. Codec counters are indexed by enum nal_codec
+ * and latency bucket n counts writes that took between 2^n and 2^(n+1) - 1
+ * nanoseconds.
+ */
+struct stats {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t pid;
+	uint32_t reserved;
+	uint64_t start_time;
+
+	uint64_t frames_seen;
+	uint64_t frames_dumped;
+	uint64_t frames_skipped;
+	uint64_t slices;
+	uint64_t bytes_written;
+	uint64_t codec_frames[STATS_CODEC_COUNT];
+
+	uint64_t queue_depth;
+	uint64_t queue_dropped;
+
+	uint64_t writes;
+	uint64_t write_latency[STATS_LATENCY_BUCKETS];
+};
+
+/*
+ * Functions
+ */
+
+struct stats *stats_create(const char *name);
+void stats_destroy(struct stats *stats, const char *name);
+struct stats *stats_attach(const char *name);
+void stats_detach(struct stats *stats);
+
+void stats_write(struct stats *stats, unsigned int size,
+		 struct timespec *start);
+
+#endif
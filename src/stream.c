@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include "stream.h"
+#include "trace.h"
+#include "log.h"
+
+static ssize_t stream_write(struct stream *stream, const void *data,
+			    unsigned int size)
+{
+	struct timespec timeout = { 0 };
+	sigset_t set, old;
+	ssize_t rc;
+	int error;
+
+	if (stream->socket)
+		return send(stream->fd, data, size, MSG_NOSIGNAL);
+
+	/* Keep a closed FIFO from killing the process with SIGPIPE. */
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+
+	rc = write(stream->fd, data, size);
+	error = errno;
+
+	if (rc < 0 && error == EPIPE)
+		sigtimedwait(&set, NULL, &timeout);
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	errno = error;
+
+	return rc;
+}
+
+static void stream_release(struct stream *stream)
+{
+	unsigned int index;
+
+	while (stream->count > 0) {
+		index = stream->head;
+		free(stream->queue[index].data);
+
+		stream->head = (index + 1) % stream->queue_size;
+		stream->count--;
+	}
+
+	stream->offset = 0;
+
+	if (stream->fd >= 0) {
+		close(stream->fd);
+		stream->fd = -1;
+	}
+}
+
+/*
+ * Write queued records until no more than target records are left. A zero
+ * timeout never waits for the consumer while a negative one waits forever.
+ */
+static int stream_flush(struct stream *stream, unsigned int target,
+			int timeout)
+{
+	struct stream_entry *entry;
+	struct pollfd pollfd;
+	ssize_t rc;
+
+	while (stream->count > target) {
+		entry = &stream->queue[stream->head];
+
+		rc = stream_write(stream, entry->data + stream->offset,
+				  entry->size - stream->offset);
+		if (rc < 0 && errno == EINTR)
+			continue;
+
+		if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			if (timeout == 0)
+				return 0;
+
+			pollfd.fd = stream->fd;
+			pollfd.events = POLLOUT;
+			pollfd.revents = 0;
+
+			rc = poll(&pollfd, 1, timeout);
+			if (rc < 0 && errno == EINTR)
+				continue;
+			if (rc <= 0)
+				return 0;
+
+			continue;
+		}
+
+		if (rc < 0) {
+			log_error("Unable to write to dump stream: %s\n",
+				strerror(errno));
+			stream_release(stream);
+			return -1;
+		}
+
+		stream->offset += rc;
+
+		if (stream->offset == entry->size) {
+			free(entry->data);
+			entry->data = NULL;
+
+			stream->head = (stream->head + 1) % stream->queue_size;
+			stream->count--;
+			stream->offset = 0;
+		}
+	}
+
+	return 0;
+}
+
+int stream_open(struct stream *stream, const char *path,
+		unsigned int queue_size, enum stream_policy policy)
+{
+	struct sockaddr_un address;
+	struct stat path_stat;
+	int rc;
+
+	memset(stream, 0, sizeof(*stream));
+	stream->fd = -1;
+	stream->policy = policy;
+	stream->queue_size = queue_size > 0 ? queue_size : 1;
+
+	stream->queue = calloc(stream->queue_size, sizeof(*stream->queue));
+	if (stream->queue == NULL)
+		return -1;
+
+	rc = stat(path, &path_stat);
+	if (rc < 0)
+		goto error;
+
+	if (S_ISFIFO(path_stat.st_mode)) {
+		/* This fails with ENXIO until a consumer opened the FIFO. */
+		stream->fd = open(path, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+		if (stream->fd < 0)
+			goto error;
+
+		return 0;
+	}
+
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		errno = ENAMETOOLONG;
+		goto error;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	stream->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (stream->fd < 0)
+		goto error;
+
+	rc = connect(stream->fd, (struct sockaddr *) &address, sizeof(address));
+	if (rc < 0)
+		goto error;
+
+	rc = fcntl(stream->fd, F_SETFL, fcntl(stream->fd, F_GETFL) | O_NONBLOCK);
+	if (rc < 0)
+		goto error;
+
+	stream->socket = true;
+
+	return 0;
+
+error:
+	log_error("Unable to open dump stream %s: %s\n", path,
+		strerror(errno));
+
+	if (stream->fd >= 0)
+		close(stream->fd);
+
+	stream->fd = -1;
+
+	free(stream->queue);
+	stream->queue = NULL;
+
+	return -1;
+}
+
+int stream_send(struct stream *stream, struct stream_record *record,
+		const void *metadata, const void *slice_data)
+{
+	struct stream_entry *entry;
+	unsigned int size;
+	uint8_t *data;
+	int rc;
+
+	if (stream->fd < 0)
+		return -1;
+
+	if (stream->count == stream->queue_size) {
+		if (stream->policy == STREAM_POLICY_BLOCK) {
+			TRACE_BEGIN("stream wait");
+			rc = stream_flush(stream, stream->queue_size - 1, -1);
+			TRACE_END("stream wait");
+		} else {
+			rc = stream_flush(stream, 0, 0);
+		}
+
+		if (rc < 0)
+			return -1;
+	}
+
+	/* Drop the new record when the consumer cannot keep up. */
+	if (stream->count == stream->queue_size) {
+		stream->dropped++;
+		stream->dropped_total++;
+		return 0;
+	}
+
+	record->magic = STREAM_MAGIC;
+	record->version = STREAM_VERSION;
+	record->header_size = sizeof(*record);
+	record->dropped = stream->dropped;
+
+	size = sizeof(*record) + record->metadata_size + record->slice_size;
+
+	data = malloc(size);
+	if (data == NULL)
+		return -1;
+
+	memcpy(data, record, sizeof(*record));
+	memcpy(data + sizeof(*record), metadata, record->metadata_size);
+	memcpy(data + sizeof(*record) + record->metadata_size, slice_data,
+	       record->slice_size);
+
+	entry = &stream->queue[(stream->head + stream->count) %
+			       stream->queue_size];
+	entry->data = data;
+	entry->size = size;
+
+	stream->count++;
+	stream->dropped = 0;
+
+	return stream_flush(stream, 0, 0);
+}
+
+void stream_close(struct stream *stream)
+{
+	int timeout;
+
+	if (stream->fd >= 0) {
+		timeout = stream->policy == STREAM_POLICY_BLOCK ? -1 :
+			  STREAM_CLOSE_TIMEOUT;
+
+		stream_flush(stream, 0, timeout);
+	}
+
+	if (stream->dropped_total > 0)
+		log_warning("Dropped %llu dump stream records\n",
+			stream->dropped_total);
+
+	if (stream->queue != NULL)
+		stream_release(stream);
+
+	free(stream->queue);
+	stream->queue = NULL;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Values
+ */
+
+#define STREAM_MAGIC				0x504d5544
+#define STREAM_VERSION				1
+
+#define STREAM_FLAG_RBSP			(1 << 0)
+
+#define STREAM_QUEUE_SIZE			16
+#define STREAM_CLOSE_TIMEOUT			1000
+
+enum stream_policy {
+	STREAM_POLICY_DROP,
+	STREAM_POLICY_BLOCK,
+};
+
+/*
+ * Structures
+ */
+
+/*
+ * Each record starts with this header, in host byte order, followed by
+ * metadata_size bytes of metadata text and slice_size bytes of slice data.
+ */
+struct stream_record {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t header_size;
+	uint32_t flags;
+	uint32_t frame_index;
+	uint32_t context_id;
+	uint32_t dropped;
+	uint32_t metadata_size;
+	uint32_t slice_size;
+};
+
+struct stream_entry {
+	uint8_t *data;
+	unsigned int size;
+};
+
+struct stream {
+	int fd;
+	bool socket;
+	enum stream_policy policy;
+
+	struct stream_entry *queue;
+	unsigned int queue_size;
+	unsigned int head;
+	unsigned int count;
+	unsigned int offset;
+
+	unsigned int dropped;
+	unsigned long long dropped_total;
+};
+
+/*
+ * Functions
+ */
+
+int stream_open(struct stream *stream, const char *path,
+		unsigned int queue_size, enum stream_policy policy);
+int stream_send(struct stream *stream, struct stream_record *record,
+		const void *metadata, const void *slice_data);
+void stream_close(struct stream *stream);
+
+#endif
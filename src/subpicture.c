@@ -16,16 +16,21 @@
  */
 
 #include "subpicture.h"
+#include "trace.h"
 
 VAStatus DumpCreateSubpicture(VADriverContextP context, VAImageID image_id,
 	VASubpictureID *subpicture_id)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
 
 VAStatus DumpDestroySubpicture(VADriverContextP context,
 	VASubpictureID subpicture_id)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
 
@@ -33,18 +38,24 @@ VAStatus DumpQuerySubpictureFormats(VADriverContextP context,
 	VAImageFormat *formats, unsigned int *flags,
 	unsigned int *formats_count)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
 
 VAStatus DumpSetSubpictureImage(VADriverContextP context,
 	VASubpictureID subpicture_id, VAImageID image_id)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
 
 VAStatus DumpSetSubpicturePalette(VADriverContextP context,
 	VASubpictureID subpicture_id, unsigned char *palette)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
 
@@ -52,12 +63,16 @@ VAStatus DumpSetSubpictureChromakey(VADriverContextP context,
 	VASubpictureID subpicture_id, unsigned int chromakey_min,
 	unsigned int chromakey_max, unsigned int chromakey_mask)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
 
 VAStatus DumpSetSubpictureGlobalAlpha(VADriverContextP ctx,
 	VASubpictureID subpicture, float global_alpha)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
 
@@ -67,6 +82,8 @@ VAStatus DumpAssociateSubpicture(VADriverContextP context,
 	unsigned short src_height, short dst_x, short dst_y,
 	unsigned short dst_width, unsigned short dst_height, unsigned int flags)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
 
@@ -74,5 +91,7 @@ VAStatus DumpDeassociateSubpicture(VADriverContextP context,
 	VASubpictureID subpicture_id, VASurfaceID *surfaces_ids,
 	int surfaces_count)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_SUCCESS;
 }
@@ -22,69 +22,163 @@
 
 #include "dump.h"
 #include "surface.h"
+#include "probe.h"
+#include "timing.h"
+#include "trace.h"
+
+/*
+ * Make sure the slice staging of the surface can hold at least size bytes,
+ * keeping the data it already holds.
+ */
+int surface_staging_reserve(struct object_surface *surface, unsigned int size)
+{
+	void *slice_staging;
+
+	if (surface->slice_staging != NULL && surface->slice_data_size >= size)
+		return 0;
+
+	slice_staging = realloc(surface->slice_staging, size);
+	if (slice_staging == NULL)
+		return -1;
+
+	if (surface->slice_data == surface->slice_staging)
+		surface->slice_data = slice_staging;
+
+	surface->slice_staging = slice_staging;
+	surface->slice_data_size = size;
+
+	return 0;
+}
+
+void surface_staging_release(struct object_surface *surface)
+{
+	free(surface->slice_staging);
+	surface->slice_staging = NULL;
+	surface->slice_data = NULL;
+	surface->slice_data_size = 0;
+
+	/* The last frame of the surface can no longer be saved as a reference. */
+	surface->dump_size = 0;
+}
 
 VAStatus DumpCreateSurfaces2(VADriverContextP context, unsigned int format,
 	unsigned int width, unsigned int height, VASurfaceID *surfaces_ids,
 	unsigned int surfaces_count, VASurfaceAttrib *attributes,
 	unsigned int attributes_count)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_surface *surface_object;
-	VASurfaceID id;
+	struct object_base **objects;
+	int rc;
 	int i;
 
 	if (format != VA_RT_FORMAT_YUV420)
 		return VA_STATUS_ERROR_UNSUPPORTED_RT_FORMAT;
 
-	for (i = 0; i < surfaces_count; i++) {
-		id = object_heap_allocate(&driver_data->surface_heap);
+	objects = malloc(surfaces_count * sizeof(*objects));
+	if (objects == NULL)
+		return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
-		surface_object = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, id);
-		if (surface_object == NULL)
-			return VA_STATUS_ERROR_ALLOCATION_FAILED;
+	rc = object_heap_allocate_bulk(&driver_data->surface_heap, surfaces_count, (int *) surfaces_ids, objects);
+	if (rc < 0) {
+		free(objects);
+		return VA_STATUS_ERROR_ALLOCATION_FAILED;
+	}
+
+	for (i = 0; i < surfaces_count; i++) {
+		surface_object = (struct object_surface *) objects[i];
 
 		surface_object->status = VASurfaceReady;
+		surface_object->deadline = 0;
 		surface_object->width = width;
 		surface_object->height = height;
 		surface_object->index = i;
 
-		surface_object->slice_data = malloc(1024 * 1024);
+		surface_object->slice_data = NULL;
+		surface_object->slice_staging = NULL;
+		surface_object->slice_data_size = 0;
 		surface_object->slice_size = 0;
+		surface_object->slice_offset = 0;
 
-		surfaces_ids[i] = id;
+		surface_object->dump_size = 0;
+		surface_object->metadata = NULL;
+		surface_object->metadata_size = 0;
 	}
 
+	free(objects);
+
 	return VA_STATUS_SUCCESS;
 }
 
 VAStatus DumpCreateSurfaces(VADriverContextP context, int width, int height,
 	int format, int surfaces_count, VASurfaceID *surfaces_ids)
 {
+	TRACE_FUNCTION();
+
 	return DumpCreateSurfaces2(context, format, width, height, surfaces_ids, surfaces_count, NULL, 0);
 }
 
+static int surface_object_compare(const void *a, const void *b)
+{
+	const struct object_base *first = *(struct object_base * const *) a;
+	const struct object_base *second = *(struct object_base * const *) b;
+
+	return first->id < second->id ? -1 : first->id > second->id;
+}
+
 VAStatus DumpDestroySurfaces(VADriverContextP context,
 	VASurfaceID *surfaces_ids, int surfaces_count)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_surface *surface_object;
+	struct object_base **objects;
 	int i;
 
+	objects = malloc(surfaces_count * sizeof(*objects));
+	if (objects == NULL)
+		return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+	/* Check all the surfaces before destroying any of them. */
 	for (i = 0; i < surfaces_count; i++) {
-		surface_object = (struct object_surface *) object_heap_lookup(&driver_data->surface_heap, surfaces_ids[i]);
-		if (surface_object == NULL)
+		objects[i] = object_heap_lookup(&driver_data->surface_heap, surfaces_ids[i]);
+		if (objects[i] == NULL) {
+			free(objects);
+			return VA_STATUS_ERROR_INVALID_SURFACE;
+		}
+	}
+
+	/* A surface given twice would be freed twice. */
+	qsort(objects, surfaces_count, sizeof(*objects), surface_object_compare);
+
+	for (i = 1; i < surfaces_count; i++) {
+		if (objects[i] == objects[i - 1]) {
+			free(objects);
 			return VA_STATUS_ERROR_INVALID_SURFACE;
+		}
+	}
 
-		free(surface_object->slice_data);
+	for (i = 0; i < surfaces_count; i++) {
+		surface_object = (struct object_surface *) objects[i];
 
-		object_heap_free(&driver_data->surface_heap, (struct object_base *) surface_object);
+		surface_staging_release(surface_object);
+		free(surface_object->metadata);
 	}
 
+	object_heap_free_bulk(&driver_data->surface_heap, objects, surfaces_count);
+
+	free(objects);
+
 	return VA_STATUS_SUCCESS;
 }
 
 VAStatus DumpSyncSurface(VADriverContextP context, VASurfaceID surface_id)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_surface *surface_object;
 
@@ -92,6 +186,13 @@ VAStatus DumpSyncSurface(VADriverContextP context, VASurfaceID surface_id)
 	if (surface_object == NULL)
 		return VA_STATUS_ERROR_INVALID_SURFACE;
 
+	PROBE2(sync_surface, surface_id, surface_object->index);
+
+	/* Pictures decoded by the timing model complete on their own. */
+	if (surface_object->status == VASurfaceRendering &&
+	    surface_object->deadline != 0)
+		timing_wait(surface_object->deadline);
+
 	surface_object->status = VASurfaceReady;
 
 	return VA_STATUS_SUCCESS;
@@ -100,6 +201,8 @@ VAStatus DumpSyncSurface(VADriverContextP context, VASurfaceID surface_id)
 VAStatus DumpQuerySurfaceStatus(VADriverContextP context,
 	VASurfaceID surface_id, VASurfaceStatus *status)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_surface *surface_object;
 
@@ -107,6 +210,11 @@ VAStatus DumpQuerySurfaceStatus(VADriverContextP context,
 	if (surface_object == NULL)
 		return VA_STATUS_ERROR_INVALID_SURFACE;
 
+	if (surface_object->status == VASurfaceRendering &&
+	    surface_object->deadline != 0 &&
+	    timing_done(surface_object->deadline))
+		surface_object->status = VASurfaceReady;
+
 	*status = surface_object->status;
 
 	return VA_STATUS_SUCCESS;
@@ -116,6 +224,8 @@ VAStatus DumpQuerySurfaceAttributes(VADriverContextP context,
 	VAConfigID config_id, VASurfaceAttrib *attributes,
 	unsigned int *attributes_count)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_config *config_object;
 
@@ -140,6 +250,8 @@ VAStatus DumpGetSurfaceAttributes(VADriverContextP context,
 	VAConfigID config_id, VASurfaceAttrib *attributes,
 	unsigned int attributes_count)
 {
+	TRACE_FUNCTION();
+
 	unsigned int i;
 
 	for (i = 0; i < attributes_count; i++) {
@@ -165,6 +277,8 @@ VAStatus DumpPutSurface(VADriverContextP context, VASurfaceID surface_id,
 	VARectangle *cliprects, unsigned int cliprects_count,
 	unsigned int flags)
 {
+	TRACE_FUNCTION();
+
 	struct dump_driver_data *driver_data = (struct dump_driver_data *) context->pDriverData;
 	struct object_surface *surface_object;
 
@@ -172,6 +286,11 @@ VAStatus DumpPutSurface(VADriverContextP context, VASurfaceID surface_id,
 	if (surface_object == NULL)
 		return VA_STATUS_ERROR_INVALID_SURFACE;
 
+	/* The picture must be decoded before it is displayed. */
+	if (surface_object->status == VASurfaceRendering &&
+	    surface_object->deadline != 0)
+		timing_wait(surface_object->deadline);
+
 	surface_object->status = VASurfaceReady;
 
 	return VA_STATUS_SUCCESS;
@@ -183,10 +302,14 @@ VAStatus DumpLockSurface(VADriverContextP context, VASurfaceID surface_id,
 	unsigned int *luma_offset, unsigned int *chroma_u_offset,
 	unsigned int *chroma_v_offset, unsigned int *buffer_name, void **buffer)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_ERROR_UNIMPLEMENTED;
 }
 
 VAStatus DumpUnlockSurface(VADriverContextP context, VASurfaceID surface)
 {
+	TRACE_FUNCTION();
+
 	return VA_STATUS_ERROR_UNIMPLEMENTED;
 }
@@ -18,6 +18,8 @@
 #ifndef _SURFACE_H_
 #define _SURFACE_H_
 
+#include <stdint.h>
+
 #include <va/va_backend.h>
 
 #include "object_heap.h"
@@ -29,6 +31,9 @@
 
 #define SURFACE_ID_OFFSET		0x04000000
 
+/* Frames after which the slice staging of a surface that was not rendered to is released. */
+#define SURFACE_STAGING_IDLE_FRAMES	32
+
 /*
  * Structures
  */
@@ -37,18 +42,42 @@ struct object_surface {
 	struct object_base base;
 
 	VAStatus status;
+	uint64_t deadline;
 	unsigned int width;
 	unsigned int height;
 	unsigned int index;
 
+	/*
+	 * Slices of the picture, either in the staging or in place in the ring
+	 * record of the frame.
+	 */
 	void *slice_data;
+	void *slice_staging;
+	unsigned int slice_data_size;
 	unsigned int slice_size;
+	unsigned int slice_offset;
+
+	unsigned int dump_size;
+	char *metadata;
+	size_t metadata_size;
+
+	/* Frames referenced by the picture, followed in golden mode. */
+	VASurfaceID references[16];
+	unsigned int references_indexes[16];
+	unsigned int references_count;
+	bool keyframe;
+
+	/* Last picture begun on the surface, as counted ahead of the capture. */
+	unsigned int passthrough_index;
 };
 
 /*
  * Functions
  */
 
+int surface_staging_reserve(struct object_surface *surface,
+	unsigned int size);
+void surface_staging_release(struct object_surface *surface);
 VAStatus DumpCreateSurfaces2(VADriverContextP context, unsigned int format,
 	unsigned int width, unsigned int height, VASurfaceID *surfaces,
 	unsigned int surfaces_count, VASurfaceAttrib *attributes,
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "timing.h"
+#include "trace.h"
+#include "log.h"
+
+static uint64_t timing_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* Xorshift, seeded the same way every time for reproducible runs. */
+static uint32_t timing_random(struct timing *timing)
+{
+	uint32_t x = timing->seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	timing->seed = x;
+
+	return x;
+}
+
+static void timing_sleep(uint64_t deadline)
+{
+	struct timespec ts;
+	int rc;
+
+	ts.tv_sec = deadline / 1000000000ULL;
+	ts.tv_nsec = deadline % 1000000000ULL;
+
+	do {
+		rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	} while (rc == EINTR);
+}
+
+void timing_init(struct timing *timing)
+{
+	memset(timing, 0, sizeof(*timing));
+
+	timing->picture_us[NAL_CODEC_MPEG2] = TIMING_MPEG2_US;
+	timing->picture_us[NAL_CODEC_H264] = TIMING_H264_US;
+	timing->picture_us[NAL_CODEC_H265] = TIMING_H265_US;
+	timing->depth = TIMING_DEPTH;
+	timing->seed = 2463534242U;
+
+	pthread_mutex_init(&timing->mutex, NULL);
+}
+
+void timing_destroy(struct timing *timing)
+{
+	if (timing->enabled && timing->stalls > 0)
+		log_info("Waited %llu ms for the decoder queue %u times\n",
+			 (unsigned long long) timing->stalled_ns / 1000000,
+			 timing->stalls);
+
+	pthread_mutex_destroy(&timing->mutex);
+}
+
+/*
+ * Queue a picture to the virtual decoder and return the time it completes at,
+ * first waiting for room in the queue like a driver would once the hardware
+ * is full.
+ */
+uint64_t timing_submit(struct timing *timing, enum nal_codec codec,
+		       unsigned int width, unsigned int height)
+{
+	uint64_t pixels = (uint64_t) width * height;
+	uint64_t deadline;
+	uint64_t duration;
+	uint64_t oldest;
+	uint64_t start;
+	uint64_t now;
+	int jitter;
+
+	if (pixels == 0)
+		pixels = TIMING_REFERENCE_PIXELS;
+
+	duration = timing->picture_us[codec] * 1000ULL * pixels /
+		   TIMING_REFERENCE_PIXELS;
+
+	pthread_mutex_lock(&timing->mutex);
+
+	if (timing->jitter > 0) {
+		jitter = timing_random(timing) % (2 * timing->jitter + 1);
+		jitter -= timing->jitter;
+		duration = duration * (100 + jitter) / 100;
+	}
+
+	/*
+	 * Other threads may submit while this one sleeps without the lock, so
+	 * the oldest picture is checked again once awake.
+	 */
+	while (true) {
+		now = timing_now();
+
+		oldest = timing->deadlines[timing->head];
+		if (oldest <= now)
+			break;
+
+		timing->stalls++;
+		timing->stalled_ns += oldest - now;
+
+		pthread_mutex_unlock(&timing->mutex);
+
+		TRACE_BEGIN("queue wait");
+		timing_sleep(oldest);
+		TRACE_END("queue wait");
+
+		pthread_mutex_lock(&timing->mutex);
+	}
+
+	start = timing->busy > now ? timing->busy : now;
+	deadline = start + duration;
+
+	timing->busy = deadline;
+	timing->deadlines[timing->head] = deadline;
+	timing->head = (timing->head + 1) % timing->depth;
+
+	pthread_mutex_unlock(&timing->mutex);
+
+	return deadline;
+}
+
+bool timing_done(uint64_t deadline)
+{
+	return timing_now() >= deadline;
+}
+
+void timing_wait(uint64_t deadline)
+{
+	if (timing_done(deadline))
+		return;
+
+	TRACE_BEGIN("decode wait");
+	timing_sleep(deadline);
+	TRACE_END("decode wait");
+}
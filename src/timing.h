@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nal.h"
+
+/*
+ * Values
+ */
+
+/* Decoding times are given for a picture of this size and scaled by area. */
+#define TIMING_REFERENCE_PIXELS			(1920 * 1088)
+
+#define TIMING_MPEG2_US				2000
+#define TIMING_H264_US				4000
+#define TIMING_H265_US				5000
+
+#define TIMING_DEPTH				4
+#define TIMING_DEPTH_MAX			32
+
+/*
+ * Structures
+ */
+
+/*
+ * Pictures are decoded one after the other by a virtual decoder that holds up
+ * to depth pictures, so that submitting one more waits for the oldest one.
+ * Times are in nanoseconds on the monotonic clock.
+ */
+struct timing {
+	bool enabled;
+	unsigned int picture_us[NAL_CODEC_H265 + 1];
+	unsigned int depth;
+	unsigned int jitter;
+
+	pthread_mutex_t mutex;
+	uint64_t deadlines[TIMING_DEPTH_MAX];
+	unsigned int head;
+	uint64_t busy;
+	uint32_t seed;
+
+	unsigned int stalls;
+	uint64_t stalled_ns;
+};
+
+/*
+ * Functions
+ */
+
+void timing_init(struct timing *timing);
+void timing_destroy(struct timing *timing);
+uint64_t timing_submit(struct timing *timing, enum nal_codec codec,
+		       unsigned int width, unsigned int height);
+bool timing_done(uint64_t deadline);
+void timing_wait(uint64_t deadline);
+
+#endif
@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "log.h"
+
+bool trace_enabled;
+
+static struct trace_buffer *trace_buffers;
+
+/* The file and text are only used by the flush thread while it runs. */
+static FILE *trace_file;
+static char *trace_text;
+static size_t trace_text_size;
+
+static pthread_t trace_thread;
+static pthread_mutex_t trace_thread_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t trace_thread_cond;
+static bool trace_thread_stop;
+
+/* Buffers are retired by the key destructor when their thread exits. */
+static pthread_key_t trace_key;
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+static bool trace_key_ready;
+
+static __thread struct trace_buffer *trace_local;
+
+static int trace_text_grow(size_t size)
+{
+	char *text;
+
+	if (size < trace_text_size * 2)
+		size = trace_text_size * 2;
+
+	text = realloc(trace_text, size);
+	if (text == NULL)
+		return -1;
+
+	trace_text = text;
+	trace_text_size = size;
+
+	return 0;
+}
+
+/*
+ * Format the published events as one block and write it out. Timestamps are
+ * given in microseconds, as Chrome trace events expect. The events are only
+ * given back to their thread once formatted.
+ */
+static void trace_buffer_flush(struct trace_buffer *buffer)
+{
+	struct trace_event *event;
+	pid_t pid = getpid();
+	unsigned int head;
+	unsigned int tail = buffer->tail;
+	size_t size = 0;
+	int length;
+	int rc;
+
+	head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+	if (head == tail)
+		return;
+
+	if (trace_text == NULL) {
+		rc = trace_text_grow(TRACE_TEXT_SIZE);
+		if (rc < 0)
+			goto complete;
+	}
+
+	for (; tail != head; tail++) {
+		event = &buffer->events[tail % TRACE_BUFFER_EVENTS];
+
+		while (true) {
+			length = snprintf(trace_text + size,
+					  trace_text_size - size,
+					  "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%d,\"tid\":%d},\n",
+					  event->name, event->phase,
+					  (unsigned long long) event->timestamp / 1000,
+					  (unsigned int) (event->timestamp % 1000),
+					  pid, event->tid);
+			if (length < 0 || size + length < trace_text_size)
+				break;
+
+			rc = trace_text_grow(size + length + 1);
+			if (rc < 0)
+				goto write;
+		}
+
+		if (length > 0)
+			size += length;
+	}
+
+write:
+	fwrite(trace_text, 1, size, trace_file);
+
+complete:
+	__atomic_store_n(&buffer->tail, head, __ATOMIC_RELEASE);
+}
+
+static void trace_flush(void)
+{
+	struct trace_buffer *buffer;
+
+	buffer = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+
+	for (; buffer != NULL; buffer = buffer->next)
+		trace_buffer_flush(buffer);
+}
+
+/* Format and write the events in the background, away from decode threads. */
+static void *trace_thread_run(void *data)
+{
+	struct timespec deadline;
+
+	pthread_mutex_lock(&trace_thread_lock);
+
+	while (!trace_thread_stop) {
+		pthread_mutex_unlock(&trace_thread_lock);
+
+		trace_flush();
+
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_nsec += TRACE_FLUSH_INTERVAL * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		pthread_mutex_lock(&trace_thread_lock);
+
+		if (!trace_thread_stop)
+			pthread_cond_timedwait(&trace_thread_cond,
+					       &trace_thread_lock, &deadline);
+	}
+
+	pthread_mutex_unlock(&trace_thread_lock);
+
+	return NULL;
+}
+
+static void trace_buffer_retire(void *data)
+{
+	struct trace_buffer *buffer = data;
+
+	__atomic_store_n(&buffer->retired, true, __ATOMIC_RELEASE);
+}
+
+static void trace_key_create(void)
+{
+	pthread_condattr_t attr;
+
+	trace_key_ready = pthread_key_create(&trace_key,
+					     trace_buffer_retire) == 0;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&trace_thread_cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+/*
+ * Reuse the buffer of a thread that exited or chain a new one. Events left in
+ * a reused buffer keep the thread id they were recorded with.
+ */
+static struct trace_buffer *trace_buffer_claim(void)
+{
+	struct trace_buffer *buffer;
+	bool retired;
+
+	buffer = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+
+	for (; buffer != NULL; buffer = buffer->next) {
+		retired = true;
+		if (__atomic_compare_exchange_n(&buffer->retired, &retired,
+						false, false, __ATOMIC_ACQUIRE,
+						__ATOMIC_RELAXED))
+			break;
+	}
+
+	if (buffer == NULL) {
+		buffer = calloc(1, sizeof(*buffer));
+		if (buffer == NULL)
+			return NULL;
+
+		buffer->next = __atomic_load_n(&trace_buffers, __ATOMIC_RELAXED);
+
+		while (!__atomic_compare_exchange_n(&trace_buffers,
+						    &buffer->next, buffer, true,
+						    __ATOMIC_RELEASE,
+						    __ATOMIC_RELAXED));
+	}
+
+	buffer->tid = syscall(SYS_gettid);
+
+	if (trace_key_ready)
+		pthread_setspecific(trace_key, buffer);
+
+	return buffer;
+}
+
+/* Threads may still hold their buffer until the backend is unloaded. */
+static void __attribute__((destructor)) trace_unload(void)
+{
+	struct trace_buffer *buffer;
+	struct trace_buffer *next;
+
+	if (trace_key_ready)
+		pthread_key_delete(trace_key);
+
+	buffer = __atomic_exchange_n(&trace_buffers, NULL, __ATOMIC_ACQUIRE);
+
+	while (buffer != NULL) {
+		next = buffer->next;
+		free(buffer);
+		buffer = next;
+	}
+}
+
+/*
+ * Write events in the Chrome trace event array format, that can be loaded in
+ * chrome://tracing or Perfetto. The array is closed when the trace is
+ * destroyed, which also happens before a new trace starts.
+ */
+int trace_init(const char *path)
+{
+	FILE *file;
+	int rc;
+
+	trace_destroy();
+
+	pthread_once(&trace_key_once, trace_key_create);
+
+	file = fopen(path, "w");
+	if (file == NULL) {
+		log_error("Unable to open trace %s: %s\n", path,
+			strerror(errno));
+		return -1;
+	}
+
+	fprintf(file, "[\n");
+
+	trace_file = file;
+	trace_thread_stop = false;
+
+	rc = pthread_create(&trace_thread, NULL, trace_thread_run, NULL);
+	if (rc != 0) {
+		log_error("Unable to start trace thread: %s\n", strerror(rc));
+		fclose(file);
+		trace_file = NULL;
+		return -1;
+	}
+
+	__atomic_store_n(&trace_enabled, true, __ATOMIC_SEQ_CST);
+
+	return 0;
+}
+
+/*
+ * Wait for the threads that saw the trace enabled to publish their event, so
+ * that the final flush is the only reader left.
+ */
+void trace_destroy(void)
+{
+	struct trace_buffer *buffer;
+	unsigned int dropped = 0;
+
+	if (!__atomic_exchange_n(&trace_enabled, false, __ATOMIC_SEQ_CST))
+		return;
+
+	buffer = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+
+	for (; buffer != NULL; buffer = buffer->next) {
+		while (__atomic_load_n(&buffer->busy, __ATOMIC_SEQ_CST))
+			sched_yield();
+
+		dropped += __atomic_exchange_n(&buffer->dropped, 0,
+					       __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_lock(&trace_thread_lock);
+	trace_thread_stop = true;
+	pthread_cond_signal(&trace_thread_cond);
+	pthread_mutex_unlock(&trace_thread_lock);
+
+	pthread_join(trace_thread, NULL);
+
+	trace_flush();
+
+	if (dropped > 0)
+		log_warning("Dropped %u trace events with full buffers\n",
+			    dropped);
+
+	fprintf(trace_file,
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"dump_drv_video\"}}\n]\n",
+		getpid());
+
+	fclose(trace_file);
+	trace_file = NULL;
+
+	free(trace_text);
+	trace_text = NULL;
+	trace_text_size = 0;
+}
+
+/*
+ * Only the calling thread writes to its buffer, so recording takes no lock.
+ * The busy flag is raised before checking that the trace is enabled, so that
+ * destroying the trace either waits for the event or is seen here.
+ */
+void trace_event(const char *name, char phase)
+{
+	struct trace_buffer *buffer = trace_local;
+	struct trace_event *event;
+	struct timespec now;
+	unsigned int head;
+	unsigned int tail;
+
+	if (buffer == NULL) {
+		buffer = trace_buffer_claim();
+		if (buffer == NULL)
+			return;
+
+		trace_local = buffer;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	__atomic_store_n(&buffer->busy, true, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (!__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED))
+		goto complete;
+
+	head = buffer->head;
+	tail = __atomic_load_n(&buffer->tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail >= TRACE_BUFFER_EVENTS) {
+		__atomic_store_n(&buffer->dropped, buffer->dropped + 1,
+				 __ATOMIC_RELAXED);
+		goto complete;
+	}
+
+	event = &buffer->events[head % TRACE_BUFFER_EVENTS];
+	event->name = name;
+	event->timestamp = now.tv_sec * 1000000000ULL + now.tv_nsec;
+	event->tid = buffer->tid;
+	event->phase = phase;
+
+	__atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+
+complete:
+	__atomic_store_n(&buffer->busy, false, __ATOMIC_RELEASE);
+}
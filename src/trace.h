@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Values
+ */
+
+#define TRACE_BUFFER_EVENTS			16384
+#define TRACE_TEXT_SIZE				(TRACE_BUFFER_EVENTS * 80)
+#define TRACE_FLUSH_INTERVAL			10
+
+/*
+ * Events are only recorded when tracing is enabled. Names must outlive the
+ * trace, which holds for string literals and __func__.
+ */
+#define TRACE_BEGIN(name) \
+	do { \
+		if (__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED)) \
+			trace_event((name), 'B'); \
+	} while (0)
+
+#define TRACE_END(name) \
+	do { \
+		if (__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED)) \
+			trace_event((name), 'E'); \
+	} while (0)
+
+/*
+ * Trace the enclosing function until it returns. Both ends are inlined, so
+ * that nothing is called when tracing is disabled.
+ */
+#define TRACE_FUNCTION() \
+	const char *trace_function __attribute__((cleanup(trace_function_end))) = \
+		trace_function_begin(__func__)
+
+/*
+ * Structures
+ */
+
+struct trace_event {
+	const char *name;
+	uint64_t timestamp;
+	pid_t tid;
+	char phase;
+};
+
+/*
+ * Each thread appends to its own buffer without any lock or system call: the
+ * thread is the only writer of head and the flush thread the only writer of
+ * tail, both published with release stores. Events are dropped while the
+ * buffer is full. Buffers are chained for the flush thread and kept until the
+ * backend is unloaded: they are retired when their thread exits and reused by
+ * later threads.
+ */
+struct trace_buffer {
+	struct trace_buffer *next;
+	bool retired;
+	bool busy;
+	pid_t tid;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int dropped;
+	struct trace_event events[TRACE_BUFFER_EVENTS];
+};
+
+/*
+ * Functions
+ */
+
+extern bool trace_enabled;
+
+int trace_init(const char *path);
+void trace_destroy(void);
+
+void trace_event(const char *name, char phase);
+
+/* Functions traced while the trace is enabled get both of their events. */
+static inline const char *trace_function_begin(const char *name)
+{
+	if (!__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED))
+		return NULL;
+
+	trace_event(name, 'B');
+
+	return name;
+}
+
+static inline void trace_function_end(const char **name)
+{
+	if (*name != NULL)
+		trace_event(*name, 'E');
+}
+
+#endif
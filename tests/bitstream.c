@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Check that Exp-Golomb codes of every length are read back at every bit
+ * alignment, from both the RBSP and the escaped data, including codes that
+ * end with the data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitstream.h"
+
+#define BITSTREAM_SIZE_MAX	64
+#define BITSTREAM_MARKER	0xa5
+
+static const unsigned int values[] = {
+	0, 1, 2, 254, 65535, 131071, 16777215, 0x7ffffffe, 0xfffffffe,
+};
+
+static unsigned int bitstream_escape(uint8_t *escaped, const uint8_t *data,
+				     unsigned int size)
+{
+	unsigned int zeros = 0;
+	unsigned int count = 0;
+	unsigned int i;
+
+	for (i = 0; i < size; i++) {
+		if (zeros >= 2 && data[i] <= 0x03) {
+			escaped[count++] = 0x03;
+			zeros = 0;
+		}
+
+		escaped[count++] = data[i];
+		zeros = data[i] == 0 ? zeros + 1 : 0;
+	}
+
+	return count;
+}
+
+static int bitstream_check(bool raw, const uint8_t *data, unsigned int size,
+			   unsigned int offset, unsigned int value,
+			   bool tail)
+{
+	struct bitstream bitstream;
+	unsigned int result;
+
+	if (raw)
+		bitstream_init_raw(&bitstream, data, size);
+	else
+		bitstream_init(&bitstream, data, size);
+
+	bitstream_skip(&bitstream, offset);
+
+	result = bitstream_read_ue(&bitstream);
+	if (bitstream_error(&bitstream) || result != value) {
+		fprintf(stderr, "%s ue(%u) at bit %u%s read as %u%s\n",
+			raw ? "RBSP" : "Escaped", value, offset,
+			tail ? " at the tail" : "", result,
+			bitstream_error(&bitstream) ? " with an overflow" : "");
+		return -1;
+	}
+
+	if (!tail && bitstream_read(&bitstream, 8) != BITSTREAM_MARKER) {
+		fprintf(stderr, "%s ue(%u) at bit %u has a wrong length\n",
+			raw ? "RBSP" : "Escaped", value, offset);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	struct bitstream_writer writer;
+	uint8_t rbsp[BITSTREAM_SIZE_MAX];
+	uint8_t escaped[BITSTREAM_SIZE_MAX * 2];
+	unsigned int offset;
+	unsigned int size;
+	unsigned int tail;
+	unsigned int i;
+	int rc = 0;
+
+	for (offset = 0; offset < 64; offset++) {
+		for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+			for (tail = 0; tail < 2; tail++) {
+				memset(rbsp, 0, sizeof(rbsp));
+				bitstream_writer_init(&writer, rbsp,
+						      sizeof(rbsp));
+
+				bitstream_write(&writer, 0, offset % 32);
+				bitstream_write(&writer, ~0U, offset / 32 * 32);
+				bitstream_write_ue(&writer, values[i]);
+
+				if (!tail)
+					bitstream_write(&writer,
+							BITSTREAM_MARKER, 8);
+
+				size = bitstream_writer_size(&writer);
+
+				if (bitstream_check(true, rbsp, size, offset,
+						    values[i], tail) < 0)
+					rc = 1;
+
+				size = bitstream_escape(escaped, rbsp, size);
+
+				if (bitstream_check(false, escaped, size,
+						    offset, values[i],
+						    tail) < 0)
+					rc = 1;
+			}
+		}
+	}
+
+	return rc;
+}
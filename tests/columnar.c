@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Write rows with sparse, string and late columns over several row groups
+ * and read them back from the footer to check that every value and every
+ * missing value ends up where it was emitted.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "columnar.h"
+
+#define COLUMNAR_TEST_PATH	"columnar.out"
+#define COLUMNAR_TEST_ROWS	10
+#define COLUMNAR_TEST_GROUP	4
+#define COLUMNAR_TEST_LATE	6
+
+struct columnar_file {
+	uint8_t *data;
+	long size;
+};
+
+static int columnar_file_read(struct columnar_file *file, const char *path)
+{
+	FILE *fp;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return -1;
+
+	fseek(fp, 0, SEEK_END);
+	file->size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	file->data = malloc(file->size);
+	if (file->data == NULL ||
+	    fread(file->data, 1, file->size, fp) != (size_t) file->size) {
+		free(file->data);
+		fclose(fp);
+		return -1;
+	}
+
+	fclose(fp);
+
+	return 0;
+}
+
+static void columnar_test_write(struct columnar *columnar)
+{
+	char name[16];
+	unsigned int i;
+
+	for (i = 0; i < COLUMNAR_TEST_ROWS; i++) {
+		columnar_row_begin(columnar);
+
+		columnar_int(columnar, "frame", i);
+		/* Later values and values of another type are dropped. */
+		columnar_int(columnar, "frame", 1000 + i);
+		columnar_string(columnar, "frame", "x", 1);
+
+		if (i % 2 == 0) {
+			snprintf(name, sizeof(name), "frame-%u", i);
+			columnar_string(columnar, "name", name, strlen(name));
+		}
+
+		if (i % 3 == 0)
+			columnar_int(columnar, "slices", -(int64_t) i);
+
+		if (i >= COLUMNAR_TEST_LATE)
+			columnar_string(columnar, "late", "", 0);
+
+		columnar_row_end(columnar);
+	}
+}
+
+static int columnar_test_column(const uint8_t *group,
+				const struct columnar_column_entry *entry,
+				unsigned int first, unsigned int rows)
+{
+	const char *name = (const char *) group + entry->name_offset;
+	const uint8_t *validity = group + entry->validity_offset;
+	const int64_t *values = (const int64_t *) (group + entry->values_offset);
+	const uint32_t *offsets = (const uint32_t *) (group + entry->values_offset);
+	const char *data = (const char *) group + entry->data_offset;
+	char expected[16];
+	unsigned int size;
+	unsigned int row;
+	unsigned int i;
+	bool valid;
+
+	for (i = 0; i < rows; i++) {
+		row = first + i;
+		valid = validity[i / 8] & (1 << (i % 8));
+
+		if (entry->name_size == 5 && memcmp(name, "frame", 5) == 0) {
+			if (entry->type != COLUMNAR_TYPE_INT64 || !valid ||
+			    values[i] != row)
+				goto error;
+		} else if (entry->name_size == 6 &&
+			   memcmp(name, "slices", 6) == 0) {
+			if (entry->type != COLUMNAR_TYPE_INT64 ||
+			    valid != (row % 3 == 0) ||
+			    (valid && values[i] != -(int64_t) row))
+				goto error;
+		} else if (entry->name_size == 4 &&
+			   memcmp(name, "name", 4) == 0) {
+			size = offsets[i + 1] - offsets[i];
+
+			if (entry->type != COLUMNAR_TYPE_STRING ||
+			    valid != (row % 2 == 0) || (!valid && size != 0) ||
+			    offsets[i + 1] > entry->data_size)
+				goto error;
+
+			snprintf(expected, sizeof(expected), "frame-%u", row);
+			if (valid && (size != strlen(expected) ||
+				      memcmp(data + offsets[i], expected,
+					     size) != 0))
+				goto error;
+		} else if (entry->name_size == 4 &&
+			   memcmp(name, "late", 4) == 0) {
+			if (entry->type != COLUMNAR_TYPE_STRING ||
+			    valid != (row >= COLUMNAR_TEST_LATE) ||
+			    offsets[i + 1] != offsets[i])
+				goto error;
+		} else {
+			fprintf(stderr, "Unexpected column %.*s\n",
+				entry->name_size, name);
+			return -1;
+		}
+	}
+
+	return 0;
+
+error:
+	fprintf(stderr, "Column %.*s is wrong at row %u\n", entry->name_size,
+		name, first + i);
+	return -1;
+}
+
+int main(void)
+{
+	const struct columnar_header *header;
+	const struct columnar_group_header *group;
+	const struct columnar_column_entry *entries;
+	const struct columnar_footer_entry *footer;
+	const struct columnar_trailer *trailer;
+	struct columnar columnar;
+	struct columnar_file file;
+	unsigned int first = 0;
+	unsigned int columns;
+	unsigned int i, j;
+	int rc;
+
+	rc = columnar_open(&columnar, COLUMNAR_TEST_PATH, COLUMNAR_TEST_GROUP);
+	if (rc < 0)
+		return 1;
+
+	columnar_test_write(&columnar);
+	columnar_close(&columnar);
+
+	rc = columnar_file_read(&file, COLUMNAR_TEST_PATH);
+	if (rc < 0) {
+		fprintf(stderr, "Unable to read %s\n", COLUMNAR_TEST_PATH);
+		return 1;
+	}
+
+	header = (const struct columnar_header *) file.data;
+	trailer = (const struct columnar_trailer *)
+		  (file.data + file.size - sizeof(*trailer));
+
+	if (header->magic != COLUMNAR_MAGIC ||
+	    header->version != COLUMNAR_VERSION ||
+	    trailer->magic != COLUMNAR_TRAILER_MAGIC ||
+	    trailer->groups_count != 3 ||
+	    trailer->footer_offset + trailer->groups_count * sizeof(*footer) !=
+	    file.size - sizeof(*trailer)) {
+		fprintf(stderr, "Invalid columnar header or trailer\n");
+		rc = -1;
+		goto complete;
+	}
+
+	footer = (const struct columnar_footer_entry *)
+		 (file.data + trailer->footer_offset);
+
+	for (i = 0; i < trailer->groups_count; i++) {
+		group = (const struct columnar_group_header *)
+			(file.data + footer[i].offset);
+		entries = (const struct columnar_column_entry *) (group + 1);
+
+		if (group->magic != COLUMNAR_GROUP_MAGIC ||
+		    group->rows != footer[i].rows ||
+		    footer[i].offset % COLUMNAR_ALIGNMENT != 0 ||
+		    footer[i].offset + group->size > trailer->footer_offset) {
+			fprintf(stderr, "Invalid row group %u\n", i);
+			rc = -1;
+			goto complete;
+		}
+
+		/* The late column only shows up once it was first emitted. */
+		columns = first + group->rows > COLUMNAR_TEST_LATE ? 4 : 3;
+		if (group->columns_count != columns) {
+			fprintf(stderr, "Row group %u has %u columns instead of %u\n",
+				i, group->columns_count, columns);
+			rc = -1;
+			goto complete;
+		}
+
+		for (j = 0; j < group->columns_count; j++) {
+			rc = columnar_test_column((const uint8_t *) group,
+						  &entries[j], first,
+						  group->rows);
+			if (rc < 0)
+				goto complete;
+		}
+
+		first += group->rows;
+	}
+
+	if (first != COLUMNAR_TEST_ROWS) {
+		fprintf(stderr, "Read %u rows instead of %u\n", first,
+			COLUMNAR_TEST_ROWS);
+		rc = -1;
+	}
+
+complete:
+	free(file.data);
+
+	return rc < 0 ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Write controls records for a few frames and check the file layout: payload
+ * alignment and offsets, empty records for frames that were not dumped, one
+ * record per slice, records growing past the base size and dropped records.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "controls.h"
+#include "index.h"
+
+#define CONTROLS_TEST_DIRECTORY	"controls.out"
+#define CONTROLS_TEST_LARGE	10000
+
+static void controls_test_add(struct controls *controls, uint32_t id,
+			      unsigned int size)
+{
+	uint8_t *payload;
+
+	payload = controls_add(controls, id, size);
+	if (payload != NULL)
+		memset(payload, id & 0xff, size);
+}
+
+static void controls_test_write(struct controls *controls)
+{
+	unsigned int i;
+
+	controls_begin(controls, 0, INDEX_CODEC_H264);
+	controls_test_add(controls, 0x10, 13);
+	controls_test_add(controls, 0x11, 100);
+	controls_end(controls);
+
+	/* Frame 1 was not dumped. */
+
+	controls_begin(controls, 2, INDEX_CODEC_H264);
+	controls_slice(controls, 0, 2);
+	controls_test_add(controls, 0x20, 7);
+	controls_end(controls);
+
+	controls_begin(controls, 2, INDEX_CODEC_H264);
+	controls_slice(controls, 1, 2);
+	controls_test_add(controls, 0x21, 7);
+	controls_end(controls);
+
+	controls_begin(controls, 3, INDEX_CODEC_H265);
+	controls_test_add(controls, 0x30, 16);
+	controls_test_add(controls, 0x31, CONTROLS_TEST_LARGE);
+	controls_end(controls);
+
+	/* A frame that was already written is dropped. */
+	controls_begin(controls, 3, INDEX_CODEC_H265);
+	controls_test_add(controls, 0x3f, 16);
+	controls_end(controls);
+
+	/* Payloads past the maximum count are dropped. */
+	controls_begin(controls, 4, INDEX_CODEC_MPEG2);
+	for (i = 0; i <= CONTROLS_COUNT_MAX; i++)
+		controls_test_add(controls, 0x40 + i, 8);
+	controls_end(controls);
+}
+
+struct controls_test_record {
+	unsigned int frame;
+	unsigned int codec;
+	unsigned int flags;
+	unsigned int size;
+	unsigned int slice;
+	unsigned int slices_count;
+	unsigned int count;
+	uint32_t first_id;
+	unsigned int first_size;
+	unsigned int last_size;
+};
+
+static const struct controls_test_record controls_test_records[] = {
+	{ 0, INDEX_CODEC_H264, CONTROLS_FLAG_VALID, 4096, 0, 1, 2, 0x10, 13, 100 },
+	{ 1, INDEX_CODEC_MPEG2, 0, 4096, 0, 1, 0, 0, 0, 0 },
+	{ 2, INDEX_CODEC_H264, CONTROLS_FLAG_VALID, 4096, 0, 2, 1, 0x20, 7, 7 },
+	{ 2, INDEX_CODEC_H264, CONTROLS_FLAG_VALID, 4096, 1, 2, 1, 0x21, 7, 7 },
+	{ 3, INDEX_CODEC_H265, CONTROLS_FLAG_VALID, 3 * 4096, 0, 1, 2, 0x30, 16,
+	  CONTROLS_TEST_LARGE },
+	{ 4, INDEX_CODEC_MPEG2, CONTROLS_FLAG_VALID, 4096, 0, 1,
+	  CONTROLS_COUNT_MAX, 0x40, 8, 8 },
+};
+
+static int controls_test_record(const uint8_t *data,
+				const struct controls_test_record *expected,
+				unsigned int index)
+{
+	const struct controls_record *record =
+		(const struct controls_record *) data;
+	const struct controls_entry *entry;
+	unsigned int end = sizeof(*record);
+	unsigned int i, j;
+
+	if (record->frame != expected->frame ||
+	    record->codec != expected->codec ||
+	    record->flags != expected->flags ||
+	    record->size != expected->size ||
+	    record->slice != expected->slice ||
+	    record->slices_count != expected->slices_count ||
+	    record->count != expected->count) {
+		fprintf(stderr, "Record %u has wrong fields\n", index);
+		return -1;
+	}
+
+	for (i = 0; i < record->count; i++) {
+		entry = &record->entries[i];
+
+		if (entry->id != expected->first_id + i ||
+		    entry->size != (i == 0 ? expected->first_size :
+				    expected->last_size) ||
+		    entry->offset % CONTROLS_ALIGNMENT != 0 ||
+		    entry->offset < end ||
+		    entry->offset + entry->size > record->size) {
+			fprintf(stderr, "Record %u has a wrong entry %u\n",
+				index, i);
+			return -1;
+		}
+
+		for (j = 0; j < entry->size; j++) {
+			if (data[entry->offset + j] != (entry->id & 0xff)) {
+				fprintf(stderr, "Record %u has a wrong payload %u\n",
+					index, i);
+				return -1;
+			}
+		}
+
+		end = entry->offset + entry->size;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	const struct controls_header *header;
+	struct controls controls;
+	uint8_t *data = NULL;
+	unsigned int offset;
+	unsigned int count;
+	unsigned int i;
+	long size;
+	FILE *fp;
+	int rc;
+
+	rc = mkdir(CONTROLS_TEST_DIRECTORY, 0755);
+	if (rc < 0 && errno != EEXIST)
+		return 1;
+
+	memset(&controls, 0, sizeof(controls));
+
+	/* Builds without the V4L2 stateless headers have no controls output. */
+	rc = controls_open(&controls, CONTROLS_TEST_DIRECTORY);
+	if (rc < 0)
+		return 77;
+
+	controls_test_write(&controls);
+	controls_close(&controls);
+
+	fp = fopen(CONTROLS_TEST_DIRECTORY "/" CONTROLS_FILENAME, "rb");
+	if (fp == NULL)
+		return 1;
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	data = malloc(size);
+	if (data == NULL || fread(data, 1, size, fp) != (size_t) size) {
+		fclose(fp);
+		free(data);
+		return 1;
+	}
+
+	fclose(fp);
+
+	header = (const struct controls_header *) data;
+	if (size < sizeof(*header) || header->magic != CONTROLS_MAGIC ||
+	    header->version != CONTROLS_VERSION ||
+	    header->layout_version != CONTROLS_LAYOUT_VERSION ||
+	    header->record_size != CONTROLS_RECORD_SIZE) {
+		fprintf(stderr, "Invalid controls header\n");
+		rc = -1;
+		goto complete;
+	}
+
+	count = sizeof(controls_test_records) /
+		sizeof(controls_test_records[0]);
+	offset = sizeof(*header);
+
+	for (i = 0; i < count; i++) {
+		if (offset + controls_test_records[i].size > size) {
+			fprintf(stderr, "Controls file ends at record %u\n", i);
+			rc = -1;
+			goto complete;
+		}
+
+		rc = controls_test_record(data + offset,
+					  &controls_test_records[i], i);
+		if (rc < 0)
+			goto complete;
+
+		offset += controls_test_records[i].size;
+	}
+
+	if (offset != size) {
+		fprintf(stderr, "Controls file has %ld bytes instead of %u\n",
+			size, offset);
+		rc = -1;
+	}
+
+complete:
+	free(data);
+
+	return rc < 0 ? 1 : 0;
+}
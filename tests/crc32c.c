@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Check CRC32C checksums against the iSCSI test vectors and a bitwise
+ * reference, at every alignment and when the data is hashed in two parts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+
+#define CRC32C_SIZE_MAX		96
+#define CRC32C_ALIGNMENT	16
+
+struct crc32c_vector {
+	const char *name;
+	uint8_t data[32];
+	unsigned int size;
+	uint32_t crc;
+};
+
+static uint32_t crc32c_reference(const uint8_t *data, unsigned int size)
+{
+	uint32_t crc = ~0U;
+	unsigned int i, j;
+
+	for (i = 0; i < size; i++) {
+		crc ^= data[i];
+
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+	}
+
+	return ~crc;
+}
+
+int main(void)
+{
+	struct crc32c_vector vectors[] = {
+		{ "empty", { 0 }, 0, 0x00000000 },
+		{ "check", "123456789", 9, 0xe3069283 },
+		{ "zeros", { 0 }, 32, 0x8a9136aa },
+		{ "ones", { 0 }, 32, 0x62a8ab43 },
+		{ "ascending", { 0 }, 32, 0x46dd794e },
+		{ "descending", { 0 }, 32, 0x113fdb5c },
+	};
+	uint8_t buffer[CRC32C_ALIGNMENT + CRC32C_SIZE_MAX];
+	uint8_t *data;
+	unsigned int alignment;
+	unsigned int size;
+	unsigned int split;
+	uint32_t expected;
+	uint32_t crc;
+	unsigned int i;
+	int rc = 0;
+
+	for (i = 0; i < 32; i++) {
+		vectors[3].data[i] = 0xff;
+		vectors[4].data[i] = i;
+		vectors[5].data[i] = 31 - i;
+	}
+
+	for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		crc = hash_crc32c(0, vectors[i].data, vectors[i].size);
+		if (crc != vectors[i].crc) {
+			fprintf(stderr, "CRC32C of %s is %08x instead of %08x\n",
+				vectors[i].name, crc, vectors[i].crc);
+			rc = 1;
+		}
+	}
+
+	for (i = 0; i < sizeof(buffer); i++)
+		buffer[i] = i * 167 + 13;
+
+	for (alignment = 0; alignment < CRC32C_ALIGNMENT; alignment++) {
+		data = buffer + alignment;
+
+		for (size = 0; size <= CRC32C_SIZE_MAX; size++) {
+			expected = crc32c_reference(data, size);
+
+			crc = hash_crc32c(0, data, size);
+			if (crc != expected) {
+				fprintf(stderr, "CRC32C of %u bytes at alignment %u is %08x instead of %08x\n",
+					size, alignment, crc, expected);
+				rc = 1;
+			}
+
+			for (split = 0; split <= size; split++) {
+				crc = hash_crc32c(0, data, split);
+				crc = hash_crc32c(crc, data + split,
+						  size - split);
+				if (crc != expected) {
+					fprintf(stderr, "CRC32C of %u bytes split at %u is %08x instead of %08x\n",
+						size, split, crc, expected);
+					rc = 1;
+				}
+			}
+		}
+	}
+
+	return rc;
+}
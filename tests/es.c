@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Write a few frames of each codec to elementary streams and check that the
+ * parameter sets and picture headers rebuilt from the VA-API parameters come
+ * with the expected fields, ahead of the slices, with start codes added where
+ * the slices have none.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "dump.h"
+#include "bitstream.h"
+#include "es.h"
+
+#define ES_TEST_DIRECTORY	"es.out"
+#define ES_TEST_UNITS_MAX	16
+#define ES_TEST_SIZE_MAX	4096
+
+struct es_test_unit {
+	unsigned int offset;
+	unsigned int start_code_size;
+	const uint8_t *data;
+	unsigned int size;
+};
+
+struct es_test_stream {
+	uint8_t data[ES_TEST_SIZE_MAX];
+	unsigned int size;
+
+	struct es_test_unit units[ES_TEST_UNITS_MAX];
+	unsigned int units_count;
+};
+
+static struct dump_driver_data driver_data;
+
+static int es_test_check(bool condition, const char *message)
+{
+	if (!condition)
+		fprintf(stderr, "%s\n", message);
+
+	return condition ? 0 : -1;
+}
+
+/* Split a stream at its start codes, as a demuxer would. */
+static int es_test_read(struct es_test_stream *stream, const char *filename)
+{
+	struct es_test_unit *unit = NULL;
+	char path[64];
+	unsigned int i;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s", ES_TEST_DIRECTORY, filename);
+
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "Unable to open %s\n", path);
+		return -1;
+	}
+
+	stream->size = fread(stream->data, 1, sizeof(stream->data), fp);
+	stream->units_count = 0;
+	fclose(fp);
+
+	for (i = 0; i + 3 <= stream->size; i++) {
+		if (stream->data[i] != 0x00 || stream->data[i + 1] != 0x00 ||
+		    stream->data[i + 2] != 0x01)
+			continue;
+
+		if (stream->units_count == ES_TEST_UNITS_MAX)
+			return -1;
+
+		if (unit != NULL)
+			unit->size = i - (unit->data - stream->data);
+
+		unit = &stream->units[stream->units_count++];
+		unit->offset = i;
+		unit->start_code_size = 3;
+
+		if (i > 0 && stream->data[i - 1] == 0x00) {
+			unit->offset--;
+			unit->start_code_size++;
+
+			if (stream->units_count > 1)
+				stream->units[stream->units_count - 2].size--;
+		}
+
+		unit->data = stream->data + i + 3;
+		i += 2;
+	}
+
+	if (unit != NULL)
+		unit->size = stream->size - (unit->data - stream->data);
+
+	return 0;
+}
+
+static int es_test_h264(void)
+{
+	VAPictureParameterBufferH264 *picture = &driver_data.params.h264.picture;
+	/* IDR slice with a zero first_mb_in_slice, an I slice type and PPS 3. */
+	static const uint8_t slice[] = { 0x65, 0x88, 0x24, 0x80 };
+	struct es_test_stream stream;
+	struct es_test_unit *unit;
+	struct bitstream bitstream;
+	unsigned long long offset;
+	unsigned int frame;
+	int rc = 0;
+	int size;
+
+	memset(&driver_data, 0, sizeof(driver_data));
+	picture->picture_width_in_mbs_minus1 = 3;
+	picture->picture_height_in_mbs_minus1 = 3;
+	picture->seq_fields.bits.chroma_format_idc = 1;
+	picture->seq_fields.bits.frame_mbs_only_flag = 1;
+	picture->num_ref_frames = 2;
+	picture->pic_init_qp_minus26 = -2;
+
+	if (es_open(&driver_data.output.es, ES_TEST_DIRECTORY, 0) < 0)
+		return -1;
+
+	for (frame = 0; frame < 2; frame++) {
+		es_frame_begin(&driver_data.output.es, VAProfileH264High);
+
+		size = es_write(&driver_data, slice, sizeof(slice), &offset);
+		rc |= es_test_check(size == sizeof(slice) + 4,
+				    "H.264 slice size is wrong");
+	}
+
+	es_close(&driver_data.output.es);
+
+	if (rc < 0 || es_test_read(&stream, ES_H264_FILENAME) < 0)
+		return -1;
+
+	/* Parameter sets are repeated ahead of each frame. */
+	rc |= es_test_check(stream.units_count == 6 &&
+			    offset == stream.units[5].offset,
+			    "H.264 stream has wrong units");
+	if (rc < 0)
+		return -1;
+
+	for (frame = 0; frame < 2; frame++) {
+		unit = &stream.units[frame * 3];
+		rc |= es_test_check(unit->start_code_size == 4 &&
+				    unit->data[0] == 0x67,
+				    "H.264 SPS is missing");
+
+		bitstream_init(&bitstream, unit->data + 1, unit->size - 1);
+		rc |= es_test_check(bitstream_read(&bitstream, 8) == 100 &&
+				    bitstream_read(&bitstream, 8) == 0 &&
+				    bitstream_read(&bitstream, 8) == ES_H264_LEVEL_IDC &&
+				    bitstream_read_ue(&bitstream) == 0 &&
+				    bitstream_read_ue(&bitstream) == 1 &&
+				    bitstream_read_ue(&bitstream) == 0 &&
+				    bitstream_read_ue(&bitstream) == 0 &&
+				    bitstream_read(&bitstream, 2) == 0 &&
+				    bitstream_read_ue(&bitstream) == 0 &&
+				    bitstream_read_ue(&bitstream) == 0 &&
+				    bitstream_read_ue(&bitstream) == 0 &&
+				    bitstream_read_ue(&bitstream) == 2 &&
+				    bitstream_read_flag(&bitstream) == false &&
+				    bitstream_read_ue(&bitstream) == 3 &&
+				    bitstream_read_ue(&bitstream) == 3 &&
+				    bitstream_read_flag(&bitstream) == true &&
+				    !bitstream_error(&bitstream),
+				    "H.264 SPS has wrong fields");
+
+		unit = &stream.units[frame * 3 + 1];
+		rc |= es_test_check(unit->start_code_size == 4 &&
+				    unit->data[0] == 0x68,
+				    "H.264 PPS is missing");
+
+		bitstream_init(&bitstream, unit->data + 1, unit->size - 1);
+		rc |= es_test_check(bitstream_read_ue(&bitstream) == 3 &&
+				    bitstream_read_ue(&bitstream) == 0 &&
+				    bitstream_read(&bitstream, 2) == 0 &&
+				    bitstream_read_ue(&bitstream) == 0 &&
+				    bitstream_read_ue(&bitstream) == 0 &&
+				    bitstream_read_ue(&bitstream) == 0 &&
+				    bitstream_read(&bitstream, 3) == 0 &&
+				    bitstream_read_se(&bitstream) == -2 &&
+				    !bitstream_error(&bitstream),
+				    "H.264 PPS has wrong fields");
+
+		unit = &stream.units[frame * 3 + 2];
+		rc |= es_test_check(unit->start_code_size == 4 &&
+				    unit->size == sizeof(slice) &&
+				    memcmp(unit->data, slice, sizeof(slice)) == 0,
+				    "H.264 slice is wrong");
+	}
+
+	return rc;
+}
+
+static int es_test_h265(void)
+{
+	VAPictureParameterBufferHEVC *picture = &driver_data.params.h265.picture;
+	/* IDR slice with a start code, first in the picture, with PPS 0. */
+	static const uint8_t slice[] = { 0x00, 0x00, 0x01, 0x26, 0x01, 0xaf,
+					 0x08, 0x40 };
+	static const unsigned int types[] = { 32, 33, 34, 19, 19 };
+	struct es_test_stream stream;
+	struct es_test_unit *unit;
+	struct bitstream bitstream;
+	unsigned int frame;
+	unsigned int i;
+	int rc = 0;
+	int size;
+
+	memset(&driver_data, 0, sizeof(driver_data));
+	picture->pic_width_in_luma_samples = 64;
+	picture->pic_height_in_luma_samples = 48;
+	picture->pic_fields.bits.chroma_format_idc = 1;
+	picture->init_qp_minus26 = 5;
+
+	if (es_open(&driver_data.output.es, ES_TEST_DIRECTORY, 0) < 0)
+		return -1;
+
+	/* Parameter sets are skipped with reference picture sets. */
+	for (frame = 0; frame < 2; frame++) {
+		picture->num_short_term_ref_pic_sets = frame;
+
+		es_frame_begin(&driver_data.output.es, VAProfileHEVCMain);
+
+		size = es_write(&driver_data, slice, sizeof(slice), NULL);
+		rc |= es_test_check(size == sizeof(slice),
+				    "H.265 slice size is wrong");
+	}
+
+	/* Frames of another codec are not written to the stream. */
+	rc |= es_test_check(es_frame_begin(&driver_data.output.es,
+					   VAProfileH264High) < 0,
+			    "H.264 frame was accepted in an H.265 stream");
+
+	es_close(&driver_data.output.es);
+
+	if (rc < 0 || es_test_read(&stream, ES_H265_FILENAME) < 0)
+		return -1;
+
+	rc |= es_test_check(stream.units_count ==
+			    sizeof(types) / sizeof(types[0]),
+			    "H.265 stream has wrong units");
+	if (rc < 0)
+		return -1;
+
+	for (i = 0; i < stream.units_count; i++)
+		rc |= es_test_check(((stream.units[i].data[0] >> 1) & 0x3f) ==
+				    types[i], "H.265 unit has a wrong type");
+
+	unit = &stream.units[1];
+	bitstream_init(&bitstream, unit->data + 2, unit->size - 2);
+
+	/* Skip the sub-layer count and the profile, tier and level. */
+	bitstream_skip(&bitstream, 8 + 96 + 16);
+	rc |= es_test_check(bitstream_read_ue(&bitstream) == 0 &&
+			    bitstream_read_ue(&bitstream) == 1 &&
+			    bitstream_read_ue(&bitstream) == 64 &&
+			    bitstream_read_ue(&bitstream) == 48 &&
+			    !bitstream_error(&bitstream),
+			    "H.265 SPS has wrong fields");
+
+	unit = &stream.units[2];
+	bitstream_init(&bitstream, unit->data + 2, unit->size - 2);
+	bitstream_read_ue(&bitstream);
+	bitstream_read_ue(&bitstream);
+	bitstream_skip(&bitstream, 7);
+	bitstream_read_ue(&bitstream);
+	bitstream_read_ue(&bitstream);
+	rc |= es_test_check(bitstream_read_se(&bitstream) == 5 &&
+			    !bitstream_error(&bitstream),
+			    "H.265 PPS has wrong fields");
+
+	unit = &stream.units[3];
+	rc |= es_test_check(unit->start_code_size == 3 &&
+			    unit->size == sizeof(slice) - 3 &&
+			    memcmp(unit->data, slice + 3, unit->size) == 0,
+			    "H.265 slice is wrong");
+
+	return rc;
+}
+
+static int es_test_mpeg2(void)
+{
+	VAPictureParameterBufferMPEG2 *picture = &driver_data.params.mpeg2.picture;
+	static const uint8_t slice[] = { 0x13, 0xf8, 0x7d };
+	static const unsigned int types[] = { 1, 2, 1 };
+	static const uint8_t codes[] = {
+		0xb3, 0xb5, 0x00, 0xb5, 0x05,
+		0x00, 0xb5, 0x05,
+		0xb3, 0xb5, 0x00, 0xb5, 0x05,
+		0xb7,
+	};
+	struct es_test_stream stream;
+	struct es_test_unit *unit;
+	struct bitstream bitstream;
+	unsigned int frame;
+	unsigned int i;
+	int rc = 0;
+	int size;
+
+	memset(&driver_data, 0, sizeof(driver_data));
+	picture->horizontal_size = 64;
+	picture->vertical_size = 48;
+	picture->f_code = 0xffff;
+	driver_data.params.mpeg2.slice.slice_vertical_position = 4;
+
+	if (es_open(&driver_data.output.es, ES_TEST_DIRECTORY, 0) < 0)
+		return -1;
+
+	/* Sequence headers are only repeated ahead of I pictures. */
+	for (frame = 0; frame < sizeof(types) / sizeof(types[0]); frame++) {
+		picture->picture_coding_type = types[frame];
+
+		es_frame_begin(&driver_data.output.es, VAProfileMPEG2Main);
+
+		size = es_write(&driver_data, slice, sizeof(slice), NULL);
+		rc |= es_test_check(size == sizeof(slice) + 4,
+				    "MPEG-2 slice size is wrong");
+	}
+
+	es_close(&driver_data.output.es);
+
+	if (rc < 0 || es_test_read(&stream, ES_MPEG2_FILENAME) < 0)
+		return -1;
+
+	rc |= es_test_check(stream.units_count == sizeof(codes),
+			    "MPEG-2 stream has wrong start codes");
+	if (rc < 0)
+		return -1;
+
+	/* Headers may end with zero bytes, taken here as a longer start code. */
+	for (i = 0; i < stream.units_count; i++)
+		rc |= es_test_check(stream.units[i].data[0] == codes[i],
+				    "MPEG-2 start code is wrong");
+
+	unit = &stream.units[0];
+	bitstream_init_raw(&bitstream, unit->data + 1, unit->size - 1);
+	rc |= es_test_check(bitstream_read(&bitstream, 12) == 64 &&
+			    bitstream_read(&bitstream, 12) == 48 &&
+			    bitstream_read(&bitstream, 4) == 1 &&
+			    bitstream_read(&bitstream, 4) ==
+			    ES_MPEG2_FRAME_RATE_CODE,
+			    "MPEG-2 sequence header has wrong fields");
+
+	for (frame = 0; frame < 3; frame++) {
+		unit = &stream.units[frame == 0 ? 2 : frame == 1 ? 5 : 10];
+		bitstream_init_raw(&bitstream, unit->data + 1, unit->size - 1);
+		bitstream_skip(&bitstream, 10);
+		rc |= es_test_check(bitstream_read(&bitstream, 3) ==
+				    types[frame],
+				    "MPEG-2 picture header has a wrong type");
+	}
+
+	unit = &stream.units[4];
+	rc |= es_test_check(unit->size == 1 + sizeof(slice) &&
+			    memcmp(unit->data + 1, slice, sizeof(slice)) == 0,
+			    "MPEG-2 slice is wrong");
+
+	return rc;
+}
+
+int main(void)
+{
+	int rc;
+
+	rc = mkdir(ES_TEST_DIRECTORY, 0755);
+	if (rc < 0 && errno != EEXIST)
+		return 1;
+
+	rc = es_test_h264();
+	rc |= es_test_h265();
+	rc |= es_test_mpeg2();
+
+	return rc < 0 ? 1 : 0;
+}
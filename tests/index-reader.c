@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Write small index files by hand and check that the reader finds frames and
+ * their slices, skips frames that were not dumped, sorts the display order,
+ * copes with truncated captures and rejects files it does not understand.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "index-reader.h"
+
+#define INDEX_TEST_DIRECTORY	"index-reader.out"
+#define INDEX_TEST_FRAMES	5
+#define INDEX_TEST_SLICES	5
+
+struct index_test_frame {
+	uint32_t sequence;
+	int32_t order;
+	uint32_t slices_count;
+};
+
+/* Frame 2 was not dumped and frame 4 claims more slices than written. */
+static const struct index_test_frame index_test_frames[] = {
+	{ 0, 0, 1 },
+	{ 0, 4, 2 },
+	{ 0, 0, 0 },
+	{ 0, 2, 1 },
+	{ 1, -2, 2 },
+};
+
+static const unsigned int index_test_display[] = { 0, 3, 1, 4 };
+
+static int index_test_write(const char *filename, enum index_kind kind,
+			    uint32_t magic, const void *records,
+			    unsigned int record_size, unsigned int count,
+			    unsigned int partial)
+{
+	struct index_header header;
+	char path[64];
+	FILE *fp;
+	int rc = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", INDEX_TEST_DIRECTORY, filename);
+
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+		return -1;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = magic;
+	header.version = INDEX_VERSION;
+	header.kind = kind;
+	header.record_size = record_size;
+
+	if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+	    fwrite(records, record_size, count, fp) != count ||
+	    fwrite(records, 1, partial, fp) != partial)
+		rc = -1;
+
+	fclose(fp);
+
+	return rc;
+}
+
+static int index_test_setup(uint32_t slices_magic)
+{
+	struct index_frame frames[INDEX_TEST_FRAMES];
+	struct index_slice slices[INDEX_TEST_SLICES];
+	uint64_t first = 0;
+	unsigned int i;
+	int rc;
+
+	memset(frames, 0, sizeof(frames));
+	memset(slices, 0, sizeof(slices));
+
+	for (i = 0; i < INDEX_TEST_FRAMES; i++) {
+		if (index_test_frames[i].slices_count == 0)
+			continue;
+
+		frames[i].frame = i;
+		frames[i].flags = INDEX_FLAG_VALID;
+		frames[i].codec = INDEX_CODEC_H264;
+		frames[i].sequence = index_test_frames[i].sequence;
+		frames[i].order = index_test_frames[i].order;
+		frames[i].slices_count = index_test_frames[i].slices_count;
+		frames[i].slice_first = first;
+
+		first += frames[i].slices_count;
+	}
+
+	for (i = 0; i < INDEX_TEST_SLICES; i++) {
+		slices[i].offset = i * 100;
+		slices[i].size = 100;
+		slices[i].substreams = 1;
+	}
+
+	/* A capture in progress may end with a partial record. */
+	rc = index_test_write(INDEX_FRAMES_FILENAME, INDEX_KIND_FRAMES,
+			      INDEX_MAGIC, frames, sizeof(*frames),
+			      INDEX_TEST_FRAMES, sizeof(*frames) / 2);
+	if (rc < 0)
+		return -1;
+
+	return index_test_write(INDEX_SLICES_FILENAME, INDEX_KIND_SLICES,
+				slices_magic, slices, sizeof(*slices),
+				INDEX_TEST_SLICES, 0);
+}
+
+static int index_test_read(struct index_reader *reader)
+{
+	const struct index_frame *frame;
+	const struct index_slice *slices;
+	unsigned int count;
+	unsigned int i;
+
+	count = index_reader_count(reader, INDEX_READER_DECODE);
+	if (count != INDEX_TEST_FRAMES) {
+		fprintf(stderr, "Found %u frames instead of %u\n", count,
+			INDEX_TEST_FRAMES);
+		return -1;
+	}
+
+	for (i = 0; i < INDEX_TEST_FRAMES; i++) {
+		frame = index_reader_frame(reader, i);
+
+		if (index_test_frames[i].slices_count == 0) {
+			if (frame != NULL ||
+			    index_reader_at(reader, INDEX_READER_DECODE, i) !=
+			    &reader->frames[i]) {
+				fprintf(stderr, "Frame %u should not be valid\n",
+					i);
+				return -1;
+			}
+
+			continue;
+		}
+
+		if (frame == NULL || frame->frame != i) {
+			fprintf(stderr, "Frame %u is missing\n", i);
+			return -1;
+		}
+
+		slices = index_reader_slices(reader, frame);
+
+		if (frame->slice_first + frame->slices_count >
+		    INDEX_TEST_SLICES) {
+			if (slices != NULL) {
+				fprintf(stderr, "Frame %u slices are truncated\n",
+					i);
+				return -1;
+			}
+
+			continue;
+		}
+
+		if (slices == NULL ||
+		    slices[0].offset != frame->slice_first * 100 ||
+		    slices[frame->slices_count - 1].offset !=
+		    (frame->slice_first + frame->slices_count - 1) * 100) {
+			fprintf(stderr, "Frame %u slices are wrong\n", i);
+			return -1;
+		}
+	}
+
+	count = index_reader_count(reader, INDEX_READER_DISPLAY);
+	if (count != sizeof(index_test_display) / sizeof(index_test_display[0])) {
+		fprintf(stderr, "Found %u frames in display order\n", count);
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		frame = index_reader_at(reader, INDEX_READER_DISPLAY, i);
+		if (frame == NULL || frame->frame != index_test_display[i]) {
+			fprintf(stderr, "Display position %u is not frame %u\n",
+				i, index_test_display[i]);
+			return -1;
+		}
+	}
+
+	if (index_reader_at(reader, INDEX_READER_DISPLAY, count) != NULL ||
+	    index_reader_at(reader, INDEX_READER_DECODE,
+			    INDEX_TEST_FRAMES) != NULL ||
+	    index_reader_frame(reader, INDEX_TEST_FRAMES) != NULL) {
+		fprintf(stderr, "Positions past the end should not be found\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	struct index_reader reader;
+	int rc;
+
+	rc = mkdir(INDEX_TEST_DIRECTORY, 0755);
+	if (rc < 0 && errno != EEXIST)
+		return 1;
+
+	rc = index_test_setup(INDEX_MAGIC);
+	if (rc < 0)
+		return 1;
+
+	rc = index_reader_open(&reader, INDEX_TEST_DIRECTORY);
+	if (rc < 0) {
+		fprintf(stderr, "Unable to open index: %s\n", strerror(errno));
+		return 1;
+	}
+
+	rc = index_test_read(&reader);
+	index_reader_close(&reader);
+
+	if (rc < 0)
+		return 1;
+
+	rc = index_test_setup(~INDEX_MAGIC);
+	if (rc < 0)
+		return 1;
+
+	rc = index_reader_open(&reader, INDEX_TEST_DIRECTORY);
+	if (rc == 0 || errno != EINVAL) {
+		fprintf(stderr, "Index with an invalid magic was opened\n");
+		if (rc == 0)
+			index_reader_close(&reader);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Check that every start code scan kernel supported by the CPU finds the same
+ * start codes and counts the same emulation prevention sequences as the scalar
+ * one, at every alignment of the data and with sequences cut by its end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nal.h"
+
+#define NAL_SCAN_SIZE_MAX	160
+#define NAL_SCAN_ALIGNMENT	64
+#define NAL_SCAN_ROUNDS		2000
+
+static uint32_t seed = 2463534242U;
+
+static uint32_t nal_scan_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+
+	return seed;
+}
+
+/* Mostly zeros, ones and threes, so that sequences are frequent. */
+static void nal_scan_fill(uint8_t *data, unsigned int size)
+{
+	static const uint8_t bytes[] = { 0, 0, 0, 0, 1, 3, 2, 0xff };
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		data[i] = bytes[nal_scan_random() % sizeof(bytes)];
+}
+
+static int nal_scan_compare(const struct nal_scanner *scalar,
+			    const struct nal_scanner *scanner,
+			    const uint8_t *data, unsigned int size,
+			    unsigned int alignment)
+{
+	unsigned int expected_count;
+	unsigned int expected;
+	unsigned int count;
+	unsigned int offset;
+	unsigned int epb_stop;
+
+	for (epb_stop = 0; epb_stop < 2; epb_stop++) {
+		expected_count = 0;
+		expected = scalar->scan(data, size, &expected_count, epb_stop);
+
+		count = 0;
+		offset = scanner->scan(data, size, &count, epb_stop);
+
+		if (offset != expected || count != expected_count) {
+			fprintf(stderr, "%s found %u with %u EPB instead of %u with %u EPB (size %u, alignment %u%s)\n",
+				scanner->name, offset, count, expected,
+				expected_count, size, alignment,
+				epb_stop ? ", stopping at EPB" : "");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	static const uint8_t sequences[][3] = {
+		{ 0, 0, 1 }, { 0, 0, 3 }, { 0, 0, 0 },
+	};
+	const struct nal_scanner *scanners;
+	uint8_t *buffer;
+	uint8_t *data;
+	unsigned int count;
+	unsigned int alignment;
+	unsigned int size;
+	unsigned int round;
+	unsigned int cut;
+	unsigned int i, j;
+	int rc = 0;
+
+	count = nal_scanners(&scanners);
+	if (count == 0 || strcmp(scanners[0].name, "scalar") != 0)
+		return 1;
+
+	buffer = aligned_alloc(NAL_SCAN_ALIGNMENT,
+			       2 * NAL_SCAN_ALIGNMENT + NAL_SCAN_SIZE_MAX);
+	if (buffer == NULL)
+		return 1;
+
+	for (i = 0; i < count; i++)
+		printf("Checking the %s kernel\n", scanners[i].name);
+
+	for (alignment = 0; alignment < NAL_SCAN_ALIGNMENT; alignment++) {
+		data = buffer + alignment;
+
+		for (round = 0; round < NAL_SCAN_ROUNDS; round++) {
+			size = nal_scan_random() % (NAL_SCAN_SIZE_MAX + 1);
+			nal_scan_fill(data, size);
+
+			/* Sparse data only has a sequence far from the start. */
+			if (round % 4 == 0 && size > 0) {
+				memset(data, 0xff, size);
+				j = nal_scan_random() % size;
+				memcpy(data + j, sequences[round % 3],
+				       size - j < 3 ? size - j : 3);
+			}
+
+			for (i = 1; i < count; i++)
+				if (nal_scan_compare(&scanners[0],
+						     &scanners[i], data, size,
+						     alignment) < 0)
+					rc = 1;
+		}
+
+		/* Sequences ending at the tail of the data or cut by it. */
+		for (size = 0; size <= NAL_SCAN_SIZE_MAX; size++) {
+			for (j = 0; j < 3; j++) {
+				for (cut = 0; cut < 3 && cut <= size; cut++) {
+					memset(data, 0x80, size);
+					if (size >= 3 - cut)
+						memcpy(data + size - (3 - cut),
+						       sequences[j], 3 - cut);
+
+					for (i = 1; i < count; i++)
+						if (nal_scan_compare(&scanners[0],
+								     &scanners[i],
+								     data, size,
+								     alignment) < 0)
+							rc = 1;
+				}
+			}
+		}
+	}
+
+	free(buffer);
+
+	return rc;
+}
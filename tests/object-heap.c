@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Check that objects allocated and freed in bulk keep stable and unique IDs
+ * while the heap grows over several buckets, that emptied buckets are given
+ * back and that objects freed twice do not corrupt the free lists.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "object_heap.h"
+
+#define OBJECT_HEAP_TEST_OFFSET		0x04000000
+#define OBJECT_HEAP_TEST_COUNT		1000
+
+struct object_test {
+	struct object_base base;
+	int value;
+};
+
+static int object_heap_count(struct object_heap *heap)
+{
+	struct object_base *object;
+	int iterator;
+	int count = 0;
+
+	object = object_heap_first(heap, &iterator);
+	while (object != NULL) {
+		count++;
+		object = object_heap_next(heap, &iterator);
+	}
+
+	return count;
+}
+
+static int object_heap_buckets(struct object_heap *heap)
+{
+	int count = 0;
+	int i;
+
+	for (i = 0; i < heap->num_buckets; i++)
+		if (heap->bucket[i] != NULL)
+			count++;
+
+	return count;
+}
+
+static int object_heap_check(struct object_heap *heap, int *ids, int count)
+{
+	struct object_test *object;
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		if ((ids[i] & OBJECT_HEAP_OFFSET_MASK) != OBJECT_HEAP_TEST_OFFSET) {
+			fprintf(stderr, "Object %d has ID %#x without the offset\n",
+				i, ids[i]);
+			return -1;
+		}
+
+		object = (struct object_test *) object_heap_lookup(heap, ids[i]);
+		if (object == NULL || object->base.id != ids[i]) {
+			fprintf(stderr, "Object %#x is not found\n", ids[i]);
+			return -1;
+		}
+
+		object->value = ids[i];
+	}
+
+	for (i = 0; i < count; i++) {
+		object = (struct object_test *) object_heap_lookup(heap, ids[i]);
+		if (object->value != ids[i]) {
+			fprintf(stderr, "Object %#x was overwritten\n", ids[i]);
+			return -1;
+		}
+
+		for (j = 0; j < i; j++) {
+			if (ids[j] == ids[i]) {
+				fprintf(stderr, "Object %#x is allocated twice\n",
+					ids[i]);
+				return -1;
+			}
+		}
+	}
+
+	if (object_heap_count(heap) != count || heap->used_count != count) {
+		fprintf(stderr, "Heap holds %d objects instead of %d\n",
+			object_heap_count(heap), count);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	struct object_base *objects[OBJECT_HEAP_TEST_COUNT + 1];
+	struct object_heap heap;
+	int ids[OBJECT_HEAP_TEST_COUNT];
+	int again[OBJECT_HEAP_TEST_COUNT];
+	int buckets;
+	int kept = 10;
+	int rc;
+	int i;
+
+	rc = object_heap_init(&heap, sizeof(struct object_test),
+			      OBJECT_HEAP_TEST_OFFSET);
+	if (rc < 0)
+		return 1;
+
+	/* Bucket n holds 16 << n objects: 1000 objects need 6 buckets. */
+	rc = object_heap_allocate_bulk(&heap, OBJECT_HEAP_TEST_COUNT, ids,
+				       objects);
+	if (rc < 0 || object_heap_check(&heap, ids, OBJECT_HEAP_TEST_COUNT) < 0)
+		return 1;
+
+	buckets = object_heap_buckets(&heap);
+	if (heap.num_buckets != 6 || buckets != 6) {
+		fprintf(stderr, "Heap has %d buckets instead of 6\n", buckets);
+		return 1;
+	}
+
+	/* Only the first two buckets are kept for the objects left. */
+	object_heap_free_bulk(&heap, &objects[kept],
+			      OBJECT_HEAP_TEST_COUNT - kept);
+	if (object_heap_check(&heap, ids, kept) < 0)
+		return 1;
+
+	for (i = kept; i < OBJECT_HEAP_TEST_COUNT; i++) {
+		if (object_heap_lookup(&heap, ids[i]) != NULL) {
+			fprintf(stderr, "Object %#x is found once freed\n",
+				ids[i]);
+			return 1;
+		}
+	}
+
+	buckets = object_heap_buckets(&heap);
+	if (buckets != 2) {
+		fprintf(stderr, "Heap has %d buckets instead of 2\n", buckets);
+		return 1;
+	}
+
+	/* Reclaimed buckets are populated again with the same IDs. */
+	rc = object_heap_allocate_bulk(&heap, OBJECT_HEAP_TEST_COUNT - kept,
+				       again, NULL);
+	if (rc < 0)
+		return 1;
+
+	memcpy(&again[OBJECT_HEAP_TEST_COUNT - kept], ids,
+	       kept * sizeof(*ids));
+	if (object_heap_check(&heap, again, OBJECT_HEAP_TEST_COUNT) < 0)
+		return 1;
+
+	for (i = 0; i < OBJECT_HEAP_TEST_COUNT; i++) {
+		if ((again[i] & OBJECT_HEAP_ID_MASK) >= OBJECT_HEAP_TEST_COUNT) {
+			fprintf(stderr, "Object %#x is past the first %d\n",
+				again[i], OBJECT_HEAP_TEST_COUNT);
+			return 1;
+		}
+	}
+
+	/* Objects given twice are only freed once. */
+	for (i = 0; i < OBJECT_HEAP_TEST_COUNT; i++)
+		objects[i] = object_heap_lookup(&heap, again[i]);
+	objects[OBJECT_HEAP_TEST_COUNT] = objects[0];
+
+	object_heap_free_bulk(&heap, objects, OBJECT_HEAP_TEST_COUNT + 1);
+	object_heap_free(&heap, objects[1]);
+
+	if (heap.used_count != 0 || object_heap_count(&heap) != 0) {
+		fprintf(stderr, "Heap holds %d objects once emptied\n",
+			heap.used_count);
+		return 1;
+	}
+
+	rc = object_heap_allocate_bulk(&heap, OBJECT_HEAP_TEST_COUNT, ids,
+				       NULL);
+	if (rc < 0 || object_heap_check(&heap, ids, OBJECT_HEAP_TEST_COUNT) < 0)
+		return 1;
+
+	object_heap_destroy(&heap);
+
+	return 0;
+}
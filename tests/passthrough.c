@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decode a few H.264 pictures through the backend in pass-through mode, with
+ * the stub driver behind it, and check that the slices and the index written
+ * by the capture thread match what was submitted.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <va/va_backend.h>
+
+#include "autoconfig.h"
+#include "index-reader.h"
+
+#define PASSTHROUGH_DIRECTORY	"passthrough.out"
+#define PASSTHROUGH_FRAMES	3
+#define PASSTHROUGH_SURFACES	4
+
+VAStatus VA_DRIVER_INIT_FUNC(VADriverContextP context);
+
+static uint8_t slice_data[PASSTHROUGH_FRAMES][9] = {
+	{ 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x33, 0x00 },
+	{ 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x33, 0x01 },
+	{ 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x33, 0x02 },
+};
+
+#define CHECK(call) \
+	do { \
+		VAStatus status = (call); \
+		if (status != VA_STATUS_SUCCESS) { \
+			fprintf(stderr, "%s failed with %#x\n", #call, status); \
+			return -1; \
+		} \
+	} while (0)
+
+static int passthrough_decode(VADriverContextP context,
+			      VAContextID *context_id)
+{
+	struct VADriverVTable *vtable = context->vtable;
+	VAPictureParameterBufferH264 picture = { 0 };
+	VASliceParameterBufferH264 slice = { 0 };
+	VASurfaceID surfaces[PASSTHROUGH_SURFACES];
+	VABufferID buffers[3];
+	VAConfigID config_id;
+	unsigned int i, j;
+
+	picture.picture_width_in_mbs_minus1 = 3;
+	picture.picture_height_in_mbs_minus1 = 3;
+	picture.seq_fields.bits.frame_mbs_only_flag = 1;
+
+	slice.slice_type = 2;
+	slice.slice_data_size = sizeof(slice_data[0]);
+
+	CHECK(vtable->vaCreateConfig(context, VAProfileH264High,
+				     VAEntrypointVLD, NULL, 0, &config_id));
+	CHECK(vtable->vaCreateSurfaces(context, 64, 64, VA_RT_FORMAT_YUV420,
+				       PASSTHROUGH_SURFACES, surfaces));
+	CHECK(vtable->vaCreateContext(context, config_id, 64, 64, 0, surfaces,
+				      PASSTHROUGH_SURFACES, context_id));
+
+	for (i = 0; i < PASSTHROUGH_FRAMES; i++) {
+		picture.CurrPic.picture_id = surfaces[i % PASSTHROUGH_SURFACES];
+
+		CHECK(vtable->vaCreateBuffer(context, *context_id,
+					     VAPictureParameterBufferType,
+					     sizeof(picture), 1, &picture,
+					     &buffers[0]));
+		CHECK(vtable->vaCreateBuffer(context, *context_id,
+					     VASliceParameterBufferType,
+					     sizeof(slice), 1, &slice,
+					     &buffers[1]));
+		CHECK(vtable->vaCreateBuffer(context, *context_id,
+					     VASliceDataBufferType,
+					     sizeof(slice_data[i]), 1,
+					     slice_data[i], &buffers[2]));
+
+		CHECK(vtable->vaBeginPicture(context, *context_id,
+					     surfaces[i % PASSTHROUGH_SURFACES]));
+		CHECK(vtable->vaRenderPicture(context, *context_id, buffers, 3));
+		CHECK(vtable->vaEndPicture(context, *context_id));
+		CHECK(vtable->vaSyncSurface(context,
+					    surfaces[i % PASSTHROUGH_SURFACES]));
+
+		for (j = 0; j < 3; j++)
+			CHECK(vtable->vaDestroyBuffer(context, buffers[j]));
+	}
+
+	CHECK(vtable->vaDestroyContext(context, *context_id));
+	CHECK(vtable->vaDestroySurfaces(context, surfaces,
+					PASSTHROUGH_SURFACES));
+	CHECK(vtable->vaDestroyConfig(context, config_id));
+
+	return 0;
+}
+
+static int passthrough_check_slices(unsigned int frame)
+{
+	uint8_t data[sizeof(slice_data[0]) + 1];
+	char path[64];
+	size_t size;
+	FILE *file;
+
+	snprintf(path, sizeof(path), PASSTHROUGH_DIRECTORY "/slice-%u.dump",
+		 frame);
+
+	file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open %s: %s\n", path,
+			strerror(errno));
+		return -1;
+	}
+
+	size = fread(data, 1, sizeof(data), file);
+	fclose(file);
+
+	if (size != sizeof(slice_data[frame]) ||
+	    memcmp(data, slice_data[frame], size) != 0) {
+		fprintf(stderr, "Slices of frame %u differ\n", frame);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int passthrough_check_index(VAContextID context_id)
+{
+	const struct index_frame *frame;
+	const struct index_slice *slice;
+	struct index_reader reader;
+	unsigned int i;
+	int rc = 0;
+
+	if (index_reader_open(&reader, PASSTHROUGH_DIRECTORY) < 0) {
+		fprintf(stderr, "Unable to open the index\n");
+		return -1;
+	}
+
+	if (reader.frames_count != PASSTHROUGH_FRAMES) {
+		fprintf(stderr, "Index has %u frames instead of %u\n",
+			reader.frames_count, PASSTHROUGH_FRAMES);
+		rc = -1;
+		goto complete;
+	}
+
+	for (i = 0; i < PASSTHROUGH_FRAMES; i++) {
+		frame = index_reader_frame(&reader, i);
+		if (frame == NULL || frame->frame != i ||
+		    frame->codec != INDEX_CODEC_H264 ||
+		    frame->context_id != context_id ||
+		    !(frame->flags & INDEX_FLAG_KEYFRAME) ||
+		    frame->slices_count != 1 ||
+		    frame->slice_size != sizeof(slice_data[i])) {
+			fprintf(stderr, "Index record of frame %u is wrong\n",
+				i);
+			rc = -1;
+			continue;
+		}
+
+		slice = index_reader_slices(&reader, frame);
+		if (slice == NULL || slice->offset != 0 ||
+		    slice->size != sizeof(slice_data[i])) {
+			fprintf(stderr, "Index slice of frame %u is wrong\n",
+				i);
+			rc = -1;
+		}
+	}
+
+complete:
+	index_reader_close(&reader);
+
+	return rc;
+}
+
+int main(void)
+{
+	struct VADriverVTable vtable;
+	struct VADriverContext context;
+	VAContextID context_id;
+	unsigned int i;
+	int rc = 0;
+
+	if (mkdir(PASSTHROUGH_DIRECTORY, 0755) < 0 && errno != EEXIST)
+		return 1;
+
+	setenv("DUMP_BACKEND", STUB_DRIVER_PATH, 1);
+	setenv("DUMP_PATH", PASSTHROUGH_DIRECTORY, 1);
+
+	memset(&vtable, 0, sizeof(vtable));
+	memset(&context, 0, sizeof(context));
+	context.vtable = &vtable;
+
+	if (VA_DRIVER_INIT_FUNC(&context) != VA_STATUS_SUCCESS) {
+		fprintf(stderr, "Unable to initialize the backend\n");
+		return 1;
+	}
+
+	/* The calls to wrap are only reached through the table of the context. */
+	if (context.vtable == &vtable) {
+		fprintf(stderr, "Pass-through mode is not enabled\n");
+		return 1;
+	}
+
+	if (passthrough_decode(&context, &context_id) < 0)
+		rc = 1;
+
+	if (context.vtable->vaTerminate(&context) != VA_STATUS_SUCCESS)
+		rc = 1;
+
+	if (rc != 0)
+		return rc;
+
+	for (i = 0; i < PASSTHROUGH_FRAMES; i++)
+		if (passthrough_check_slices(i) < 0)
+			rc = 1;
+
+	if (passthrough_check_index(context_id) < 0)
+		rc = 1;
+
+	return rc;
+}
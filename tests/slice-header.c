@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Check that slice header sizes are found in both the escaped slice data and
+ * the RBSP, with a header whose RBSP contains the 00 00 03 sequence.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dump.h"
+#include "bitstream.h"
+#include "header.h"
+#include "surface.h"
+
+#define SLICE_SIZE_MAX		64
+
+/*
+ * IDR slice header with a zero frame_num and an idr_pic_id whose Exp-Golomb
+ * code starts with enough zeros to be followed by 00 00 03 in the RBSP.
+ */
+static unsigned int slice_rbsp(uint8_t *data)
+{
+	struct bitstream_writer writer;
+	unsigned int bit_size;
+
+	bitstream_writer_init(&writer, data, SLICE_SIZE_MAX);
+
+	bitstream_write(&writer, 0x65, 8);
+	bitstream_write_ue(&writer, 0);
+	bitstream_write_ue(&writer, 7);
+	bitstream_write_ue(&writer, 0);
+	bitstream_write(&writer, 0, 16);
+	bitstream_write_ue(&writer, 12287);
+	bitstream_write(&writer, 0x1234, 16);
+	bitstream_write(&writer, 0, 2);
+	bitstream_write_se(&writer, -3);
+
+	bit_size = writer.position;
+
+	bitstream_write(&writer, 0xff, 8);
+	bitstream_write(&writer, 0xff, 8);
+
+	return bit_size;
+}
+
+static unsigned int slice_escape(uint8_t *escaped, const uint8_t *data,
+				 unsigned int size)
+{
+	unsigned int zeros = 0;
+	unsigned int count = 0;
+	unsigned int i;
+
+	for (i = 0; i < size; i++) {
+		if (zeros >= 2 && data[i] <= 0x03) {
+			escaped[count++] = 0x03;
+			zeros = 0;
+		}
+
+		escaped[count++] = data[i];
+		zeros = data[i] == 0 ? zeros + 1 : 0;
+	}
+
+	return count;
+}
+
+static int slice_check(bool rbsp, uint8_t *data, unsigned int size,
+		       unsigned int expected)
+{
+	struct dump_driver_data *driver_data;
+	VAPictureParameterBufferH264 *picture_params;
+	struct object_surface surface;
+	unsigned int header_bit_size = 0;
+	char *output = NULL;
+	size_t output_size;
+	FILE *file;
+	char *field;
+
+	driver_data = calloc(1, sizeof(*driver_data));
+	if (driver_data == NULL)
+		return -1;
+
+	driver_data->slices_rbsp = rbsp;
+
+	picture_params = &driver_data->params.h264.picture;
+	picture_params->seq_fields.bits.chroma_format_idc = 1;
+	picture_params->seq_fields.bits.frame_mbs_only_flag = 1;
+	picture_params->seq_fields.bits.log2_max_frame_num_minus4 = 12;
+	picture_params->seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4 = 12;
+
+	driver_data->params.h264.slice.slice_data_size = size;
+
+	memset(&surface, 0, sizeof(surface));
+	surface.slice_data = data;
+	surface.slice_size = size;
+
+	file = open_memstream(&output, &output_size);
+	if (file == NULL) {
+		free(driver_data);
+		return -1;
+	}
+
+	print_set_output(file);
+	h264_dump_header(driver_data, VAProfileH264High, &surface);
+	print_set_output(NULL);
+	fclose(file);
+
+	field = strstr(output, ".header_bit_size = ");
+	if (field != NULL)
+		sscanf(field, ".header_bit_size = %u", &header_bit_size);
+
+	free(output);
+	free(driver_data);
+
+	if (header_bit_size != expected) {
+		fprintf(stderr, "%s header size is %u bits instead of %u\n",
+			rbsp ? "RBSP" : "Escaped", header_bit_size, expected);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	uint8_t rbsp[SLICE_SIZE_MAX];
+	uint8_t escaped[SLICE_SIZE_MAX * 2];
+	unsigned int bit_size;
+	unsigned int size;
+	int rc = 0;
+
+	bit_size = slice_rbsp(rbsp);
+	size = (bit_size + 7) / 8 + 2;
+
+	if (memmem(rbsp, size, "\x00\x00\x03", 3) == NULL) {
+		fprintf(stderr, "Slice header RBSP lacks 00 00 03\n");
+		return 1;
+	}
+
+	if (slice_check(true, rbsp, size, bit_size) < 0)
+		rc = 1;
+
+	/* The escaped header carries one emulation prevention byte. */
+	size = slice_escape(escaped, rbsp, size);
+
+	if (slice_check(false, escaped, size, bit_size + 8) < 0)
+		rc = 1;
+
+	return rc;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reference reader for columnar parameter exports: lists the columns of a file
+ * or prints the values of selected columns, only mapping the data it reads.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "columnar.h"
+
+struct column_summary {
+	char *name;
+	unsigned int type;
+	unsigned long long values;
+};
+
+static const struct columnar_column_entry *find_column(const uint8_t *group,
+						       const char *name)
+{
+	const struct columnar_group_header *header = (const void *) group;
+	const struct columnar_column_entry *entries = (const void *) (header + 1);
+	unsigned int i;
+
+	for (i = 0; i < header->columns_count; i++)
+		if (strlen(name) == entries[i].name_size &&
+		    memcmp(group + entries[i].name_offset, name,
+			   entries[i].name_size) == 0)
+			return &entries[i];
+
+	return NULL;
+}
+
+static unsigned int count_values(const uint8_t *group,
+				 const struct columnar_column_entry *entry,
+				 unsigned int rows)
+{
+	const uint8_t *validity = group + entry->validity_offset;
+	unsigned int count = 0;
+	unsigned int i;
+
+	for (i = 0; i < rows; i++)
+		if (validity[i / 8] & (1 << (i % 8)))
+			count++;
+
+	return count;
+}
+
+static void list_columns(const uint8_t *base,
+			 const struct columnar_footer_entry *footer,
+			 unsigned int groups_count)
+{
+	const struct columnar_group_header *header;
+	const struct columnar_column_entry *entries;
+	struct column_summary *summaries = NULL;
+	unsigned int summaries_count = 0;
+	unsigned int i, j, k;
+	const uint8_t *group;
+	const char *name;
+
+	for (i = 0; i < groups_count; i++) {
+		group = base + footer[i].offset;
+		header = (const void *) group;
+		entries = (const void *) (header + 1);
+
+		for (j = 0; j < header->columns_count; j++) {
+			name = (const char *) group + entries[j].name_offset;
+
+			for (k = 0; k < summaries_count; k++)
+				if (strlen(summaries[k].name) == entries[j].name_size &&
+				    memcmp(summaries[k].name, name,
+					   entries[j].name_size) == 0)
+					break;
+
+			if (k == summaries_count) {
+				summaries = realloc(summaries, (k + 1) *
+						    sizeof(*summaries));
+				if (summaries == NULL)
+					return;
+
+				summaries[k].name = strndup(name,
+							    entries[j].name_size);
+				summaries[k].type = entries[j].type;
+				summaries[k].values = 0;
+				summaries_count++;
+			}
+
+			if (entries[j].type == COLUMNAR_TYPE_STRING)
+				summaries[k].type = COLUMNAR_TYPE_STRING;
+
+			summaries[k].values += count_values(group, &entries[j],
+							    header->rows);
+		}
+	}
+
+	for (k = 0; k < summaries_count; k++) {
+		printf("%s\t%s\t%llu\n", summaries[k].name,
+		       summaries[k].type == COLUMNAR_TYPE_INT64 ? "int64" :
+		       "string", summaries[k].values);
+		free(summaries[k].name);
+	}
+
+	free(summaries);
+}
+
+static void print_value(const uint8_t *group,
+			const struct columnar_column_entry *entry,
+			unsigned int row)
+{
+	const uint8_t *validity;
+	const uint32_t *offsets;
+
+	if (entry == NULL)
+		return;
+
+	validity = group + entry->validity_offset;
+	if (!(validity[row / 8] & (1 << (row % 8))))
+		return;
+
+	if (entry->type == COLUMNAR_TYPE_INT64) {
+		printf("%" PRId64,
+		       ((const int64_t *) (group + entry->values_offset))[row]);
+	} else {
+		offsets = (const uint32_t *) (group + entry->values_offset);
+		printf("%.*s", (int) (offsets[row + 1] - offsets[row]),
+		       (const char *) group + entry->data_offset + offsets[row]);
+	}
+}
+
+static void print_columns(const uint8_t *base,
+			  const struct columnar_footer_entry *footer,
+			  unsigned int groups_count, char **names,
+			  unsigned int names_count)
+{
+	const struct columnar_column_entry **entries;
+	const uint8_t *group;
+	unsigned int i, j, row;
+
+	entries = calloc(names_count, sizeof(*entries));
+	if (entries == NULL)
+		return;
+
+	for (j = 0; j < names_count; j++)
+		printf("%s%s", j > 0 ? "\t" : "", names[j]);
+	printf("\n");
+
+	for (i = 0; i < groups_count; i++) {
+		group = base + footer[i].offset;
+
+		for (j = 0; j < names_count; j++)
+			entries[j] = find_column(group, names[j]);
+
+		for (row = 0; row < footer[i].rows; row++) {
+			for (j = 0; j < names_count; j++) {
+				if (j > 0)
+					printf("\t");
+
+				print_value(group, entries[j], row);
+			}
+
+			printf("\n");
+		}
+	}
+
+	free(entries);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s file [column...]\n\n"
+		"Without columns, lists the columns of the file with their type\n"
+		"and number of values. Otherwise, prints the selected columns\n"
+		"with one row per frame or slice.\n",
+		name);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct columnar_header *header;
+	const struct columnar_trailer *trailer;
+	const struct columnar_footer_entry *footer;
+	struct stat st;
+	uint8_t *base;
+	int fd;
+
+	if (argc < 2 || strcmp(argv[1], "-h") == 0) {
+		usage(argv[0]);
+		return argc < 2 ? 1 : 0;
+	}
+
+	fd = open(argv[1], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "Unable to open %s: %s\n", argv[1],
+			strerror(errno));
+		return 1;
+	}
+
+	if (st.st_size < sizeof(*header) + sizeof(*trailer)) {
+		fprintf(stderr, "%s is not a complete columnar file\n", argv[1]);
+		return 1;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "Unable to map %s: %s\n", argv[1],
+			strerror(errno));
+		return 1;
+	}
+
+	header = (const void *) base;
+	trailer = (const void *) (base + st.st_size - sizeof(*trailer));
+
+	if (header->magic != COLUMNAR_MAGIC ||
+	    header->version != COLUMNAR_VERSION ||
+	    trailer->magic != COLUMNAR_TRAILER_MAGIC ||
+	    trailer->footer_offset + trailer->groups_count * sizeof(*footer) +
+	    sizeof(*trailer) != st.st_size) {
+		fprintf(stderr, "%s is not a complete columnar file\n", argv[1]);
+		return 1;
+	}
+
+	footer = (const void *) (base + trailer->footer_offset);
+
+	if (argc == 2)
+		list_columns(base, footer, trailer->groups_count);
+	else
+		print_columns(base, footer, trailer->groups_count, argv + 2,
+			      argc - 2);
+
+	munmap(base, st.st_size);
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Prints the frame index of a capture, in decode or display order, or the
+ * slices of selected frames.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "index-reader.h"
+
+static const char *codec_name(uint32_t codec)
+{
+	switch (codec) {
+	case INDEX_CODEC_MPEG2:
+		return "mpeg2";
+	case INDEX_CODEC_H264:
+		return "h264";
+	case INDEX_CODEC_H265:
+		return "h265";
+	default:
+		return "unknown";
+	}
+}
+
+static void print_frame(const struct index_frame *frame)
+{
+	unsigned int i;
+
+	printf("%u %s %c %u %d %u %" PRIu64 " %" PRIu64, frame->frame,
+	       codec_name(frame->codec),
+	       frame->flags & INDEX_FLAG_KEYFRAME ? 'K' : '-',
+	       frame->sequence, frame->order, frame->slices_count,
+	       frame->slice_offset, frame->slice_size);
+
+	if (frame->metadata_offset != INDEX_OFFSET_NONE)
+		printf(" %" PRIu64 ":%" PRIu64, frame->metadata_offset,
+		       frame->metadata_size);
+	else
+		printf(" -");
+
+	for (i = 0; i < frame->references_count; i++)
+		printf("%c%u", i == 0 ? ' ' : ',', frame->references[i]);
+
+	printf("\n");
+}
+
+static void print_slices(struct index_reader *reader,
+			 const struct index_frame *frame)
+{
+	const struct index_slice *slices;
+	unsigned int i;
+
+	slices = index_reader_slices(reader, frame);
+	if (slices == NULL)
+		return;
+
+	if (frame->tile_columns > 1 || frame->tile_rows > 1 ||
+	    frame->flags & INDEX_FLAG_WPP)
+		printf("\ttiles %ux%u%s\n", frame->tile_columns,
+		       frame->tile_rows,
+		       frame->flags & INDEX_FLAG_WPP ? " wpp" : "");
+
+	for (i = 0; i < frame->slices_count; i++)
+		printf("\t%u %" PRIu64 " %u %u %u %u\n", i,
+		       frame->slice_offset + slices[i].offset, slices[i].size,
+		       slices[i].header_size, slices[i].substreams,
+		       slices[i].substream_max);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-d] directory [frame...]\n\n"
+		"Without frames, lists the indexed frames in decode order, or\n"
+		"display order with -d. Otherwise, prints the selected frames\n"
+		"with the offset and size of their slices.\n\n"
+		"Columns: frame codec keyframe sequence order slices offset size\n"
+		"metadata_offset:size references\n\n"
+		"Slice columns: slice offset size header_size substreams\n"
+		"largest_substream\n",
+		name);
+}
+
+int main(int argc, char *argv[])
+{
+	enum index_reader_order order = INDEX_READER_DECODE;
+	const struct index_frame *frame;
+	struct index_reader reader;
+	unsigned int count;
+	unsigned int i;
+	int rc;
+
+	if (argc > 1 && strcmp(argv[1], "-d") == 0) {
+		order = INDEX_READER_DISPLAY;
+		argv++;
+		argc--;
+	}
+
+	if (argc < 2 || strcmp(argv[1], "-h") == 0) {
+		usage(argv[0]);
+		return argc < 2 ? 1 : 0;
+	}
+
+	rc = index_reader_open(&reader, argv[1]);
+	if (rc < 0) {
+		fprintf(stderr, "Unable to open frame index in %s: %s\n",
+			argv[1], strerror(errno));
+		return 1;
+	}
+
+	if (argc == 2) {
+		count = index_reader_count(&reader, order);
+
+		for (i = 0; i < count; i++) {
+			frame = index_reader_at(&reader, order, i);
+			if (frame->flags & INDEX_FLAG_VALID)
+				print_frame(frame);
+		}
+	} else {
+		for (i = 2; i < argc; i++) {
+			frame = index_reader_frame(&reader, atoi(argv[i]));
+			if (frame == NULL) {
+				fprintf(stderr, "Frame %s is not indexed\n",
+					argv[i]);
+				continue;
+			}
+
+			print_frame(frame);
+			print_slices(&reader, frame);
+		}
+	}
+
+	index_reader_close(&reader);
+
+	return 0;
+}
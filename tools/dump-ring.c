@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reference reader for the dump ring: follows the records published by the
+ * backend in shared memory, without copying them.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ring.h"
+
+static int save_slices(const char *directory, struct ring_slot *slot,
+		       const uint8_t *data)
+{
+	char *path;
+	FILE *file;
+	int rc;
+
+	rc = asprintf(&path, "%s/slice-%u.dump", directory, slot->frame_index);
+	if (rc < 0)
+		return -1;
+
+	file = fopen(path, "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+		free(path);
+		return -1;
+	}
+
+	fwrite(data, 1, slot->slice_size, file);
+	fclose(file);
+	free(path);
+
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options] name\n\n"
+		"Options:\n"
+		" -a            start from the oldest available record\n"
+		" -o directory  save the slices of each frame to directory\n"
+		" -m            print the metadata of each frame to stdout\n",
+		name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct ring ring;
+	struct ring_slot slot;
+	const char *directory = NULL;
+	const uint8_t *data;
+	unsigned long long overruns = 0;
+	unsigned int count = 0;
+	bool metadata = false;
+	bool oldest = false;
+	uint64_t published;
+	uint64_t sequence;
+	int rc;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "ao:mh")) != -1) {
+		switch (opt) {
+		case 'a':
+			oldest = true;
+			break;
+		case 'o':
+			directory = optarg;
+			break;
+		case 'm':
+			metadata = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	rc = ring_attach(&ring, argv[optind]);
+	if (rc < 0) {
+		fprintf(stderr, "Unable to attach to %s: %s\n", argv[optind],
+			strerror(errno));
+		return 1;
+	}
+
+	sequence = ring_sequence(&ring);
+	if (oldest)
+		sequence = sequence > ring.slot_count ?
+			   sequence - ring.slot_count : 0;
+
+	while (1) {
+		rc = ring_read(&ring, sequence, &slot, &data);
+		if (rc == -EAGAIN) {
+			if (ring_closed(&ring))
+				break;
+
+			ring_wait(&ring, sequence, 1000);
+			continue;
+		}
+
+		if (rc == -ERANGE) {
+			overruns++;
+
+			/* Catch up with the oldest record still available. */
+			published = ring_sequence(&ring);
+			if (published - sequence > ring.slot_count)
+				sequence = published - ring.slot_count;
+			else
+				sequence++;
+
+			continue;
+		}
+
+		if (metadata)
+			fwrite(data + slot.slice_size, 1, slot.metadata_size,
+			       stdout);
+
+		if (directory != NULL)
+			save_slices(directory, &slot, data);
+
+		/* The producer may have overwritten the data in the meantime. */
+		if (!ring_valid(&ring, &slot)) {
+			overruns++;
+			sequence++;
+			continue;
+		}
+
+		fprintf(stderr, "Frame %u (context %#x): %u bytes of metadata, "
+			"%u bytes of %s slices\n", slot.frame_index,
+			slot.context_id, slot.metadata_size, slot.slice_size,
+			(slot.flags & RING_FLAG_RBSP) ? "RBSP" : "raw");
+
+		count++;
+		sequence++;
+	}
+
+	fprintf(stderr, "Read %u frames, %llu overrun\n", count, overruns);
+
+	ring_detach(&ring);
+
+	return 0;
+}
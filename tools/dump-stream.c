@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reference consumer for the dump stream: receives the records sent by the
+ * backend over a Unix socket or FIFO and optionally saves their content.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include "stream.h"
+
+static int read_full(int fd, void *data, unsigned int size)
+{
+	unsigned int count = 0;
+	ssize_t rc;
+
+	while (count < size) {
+		rc = read(fd, (char *) data + count, size - count);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc < 0)
+			return -1;
+		if (rc == 0)
+			return count == 0 ? 0 : -1;
+
+		count += rc;
+	}
+
+	return 1;
+}
+
+static int open_socket(const char *path)
+{
+	struct sockaddr_un address;
+	int server_fd;
+	int fd;
+	int rc;
+
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server_fd < 0)
+		return -1;
+
+	unlink(path);
+
+	rc = bind(server_fd, (struct sockaddr *) &address, sizeof(address));
+	if (rc < 0)
+		goto error;
+
+	rc = listen(server_fd, 1);
+	if (rc < 0)
+		goto error;
+
+	fprintf(stderr, "Waiting for the backend on %s\n", path);
+
+	fd = accept(server_fd, NULL, NULL);
+	if (fd < 0)
+		goto error;
+
+	close(server_fd);
+	unlink(path);
+
+	return fd;
+
+error:
+	close(server_fd);
+	unlink(path);
+
+	return -1;
+}
+
+static int open_fifo(const char *path)
+{
+	int rc;
+
+	rc = mkfifo(path, 0644);
+	if (rc < 0 && errno != EEXIST)
+		return -1;
+
+	fprintf(stderr, "Waiting for the backend on %s\n", path);
+
+	return open(path, O_RDONLY);
+}
+
+static int save_slices(const char *directory, struct stream_record *record,
+		       void *data)
+{
+	char *path;
+	FILE *file;
+	int rc;
+
+	rc = asprintf(&path, "%s/slice-%u.dump", directory, record->frame_index);
+	if (rc < 0)
+		return -1;
+
+	file = fopen(path, "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+		free(path);
+		return -1;
+	}
+
+	fwrite(data, 1, record->slice_size, file);
+	fclose(file);
+	free(path);
+
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options] path\n\n"
+		"Options:\n"
+		" -f            read from a FIFO instead of a Unix socket\n"
+		" -o directory  save the slices of each frame to directory\n"
+		" -m            print the metadata of each frame to stdout\n"
+		" -d delay      wait delay milliseconds after each record\n",
+		name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct stream_record record;
+	const char *directory = NULL;
+	unsigned long long dropped = 0;
+	unsigned int delay = 0;
+	unsigned int count = 0;
+	bool metadata = false;
+	bool fifo = false;
+	size_t allocated = 0;
+	void *data = NULL;
+	size_t size;
+	int fd;
+	int rc;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "fo:md:h")) != -1) {
+		switch (opt) {
+		case 'f':
+			fifo = true;
+			break;
+		case 'o':
+			directory = optarg;
+			break;
+		case 'm':
+			metadata = true;
+			break;
+		case 'd':
+			delay = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (fifo)
+		fd = open_fifo(argv[optind]);
+	else
+		fd = open_socket(argv[optind]);
+
+	if (fd < 0) {
+		fprintf(stderr, "Unable to open %s: %s\n", argv[optind],
+			strerror(errno));
+		return 1;
+	}
+
+	while (1) {
+		rc = read_full(fd, &record, sizeof(record));
+		if (rc == 0)
+			break;
+		if (rc < 0)
+			goto error;
+
+		if (record.magic != STREAM_MAGIC ||
+		    record.version != STREAM_VERSION ||
+		    record.header_size != sizeof(record)) {
+			fprintf(stderr, "Invalid stream record\n");
+			goto error;
+		}
+
+		size = (size_t) record.metadata_size + record.slice_size;
+		if (size > allocated) {
+			free(data);
+
+			data = malloc(size);
+			if (data == NULL)
+				goto error;
+
+			allocated = size;
+		}
+
+		rc = read_full(fd, data, size);
+		if (rc <= 0 && size > 0)
+			goto error;
+
+		dropped += record.dropped;
+		count++;
+
+		fprintf(stderr, "Frame %u (context %#x): %u bytes of metadata, "
+			"%u bytes of %s slices, %u dropped before\n",
+			record.frame_index, record.context_id,
+			record.metadata_size, record.slice_size,
+			(record.flags & STREAM_FLAG_RBSP) ? "RBSP" : "raw",
+			record.dropped);
+
+		if (metadata)
+			fwrite(data, 1, record.metadata_size, stdout);
+
+		if (directory != NULL)
+			save_slices(directory, &record,
+				    (char *) data + record.metadata_size);
+
+		if (delay > 0)
+			usleep(delay * 1000);
+	}
+
+	fprintf(stderr, "Received %u frames, %llu dropped\n", count, dropped);
+
+	free(data);
+	close(fd);
+
+	return 0;
+
+error:
+	fprintf(stderr, "Stream interrupted after %u frames\n", count);
+
+	free(data);
+	close(fd);
+
+	return 1;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Live viewer for the counters exported by the backend in shared memory.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+static const char *codec_names[STATS_CODEC_COUNT] = {
+	"MPEG-2",
+	"H.264",
+	"HEVC",
+};
+
+static void snapshot(struct stats *stats, struct stats *copy)
+{
+	uint64_t *source = (uint64_t *) stats;
+	uint64_t *destination = (uint64_t *) copy;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(*stats) / sizeof(uint64_t); i++)
+		destination[i] = __atomic_load_n(&source[i], __ATOMIC_RELAXED);
+}
+
+/* Return the upper bound in nanoseconds of the bucket holding the quantile. */
+static uint64_t percentile(struct stats *stats, unsigned int quantile)
+{
+	uint64_t total = 0;
+	uint64_t count = 0;
+	uint64_t target;
+	unsigned int i;
+
+	for (i = 0; i < STATS_LATENCY_BUCKETS; i++)
+		total += stats->write_latency[i];
+
+	if (total == 0)
+		return 0;
+
+	target = (total * quantile + 99) / 100;
+
+	for (i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+		count += stats->write_latency[i];
+		if (count >= target)
+			break;
+	}
+
+	return (2ULL << i) - 1;
+}
+
+static void print_latency(const char *name, uint64_t value)
+{
+	if (value >= 1000000)
+		printf("  %s < %.1f ms", name, value / 1000000.0);
+	else
+		printf("  %s < %.1f us", name, value / 1000.0);
+}
+
+static void display(struct stats *current, struct stats *previous,
+		    double elapsed, bool clear)
+{
+	unsigned int i;
+	bool running;
+
+	running = kill(current->pid, 0) == 0 || errno == EPERM;
+
+	if (clear)
+		printf("\033[H\033[2J");
+
+	printf("dump backend, pid %u (%s), up %llu s\n\n", current->pid,
+	       running ? "running" : "exited",
+	       (unsigned long long) (time(NULL) - current->start_time));
+
+	printf("frames   seen %10llu  dumped %10llu  skipped %10llu  %8.1f/s\n",
+	       (unsigned long long) current->frames_seen,
+	       (unsigned long long) current->frames_dumped,
+	       (unsigned long long) current->frames_skipped,
+	       (current->frames_seen - previous->frames_seen) / elapsed);
+
+	printf("codecs  ");
+	for (i = 0; i < STATS_CODEC_COUNT; i++)
+		printf(" %s %llu ", codec_names[i],
+		       (unsigned long long) current->codec_frames[i]);
+	printf("\n");
+
+	printf("slices  %10llu\n", (unsigned long long) current->slices);
+
+	printf("written %10.1f MiB  %8.1f MiB/s  %llu writes\n",
+	       current->bytes_written / 1048576.0,
+	       (current->bytes_written - previous->bytes_written) /
+	       1048576.0 / elapsed,
+	       (unsigned long long) current->writes);
+
+	printf("queue    depth %llu  dropped %llu\n",
+	       (unsigned long long) current->queue_depth,
+	       (unsigned long long) current->queue_dropped);
+
+	printf("latency");
+	print_latency("p50", percentile(current, 50));
+	print_latency("p90", percentile(current, 90));
+	print_latency("p99", percentile(current, 99));
+	print_latency("max", percentile(current, 100));
+	printf("\n");
+
+	fflush(stdout);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options] name\n\n"
+		"Options:\n"
+		" -i interval   refresh interval in milliseconds\n"
+		" -n count      exit after count refreshes\n"
+		" -b            batch mode, without clearing the screen\n",
+		name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct stats *stats;
+	struct stats current;
+	struct stats previous;
+	unsigned int interval = 1000;
+	unsigned int count = 0;
+	unsigned int iteration;
+	bool clear = true;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:n:bh")) != -1) {
+		switch (opt) {
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'b':
+			clear = false;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind != argc - 1 || interval == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	stats = stats_attach(argv[optind]);
+	if (stats == NULL) {
+		fprintf(stderr, "Unable to attach to %s: %s\n", argv[optind],
+			strerror(errno));
+		return 1;
+	}
+
+	snapshot(stats, &previous);
+
+	for (iteration = 0; count == 0 || iteration < count; iteration++) {
+		usleep(interval * 1000);
+
+		snapshot(stats, &current);
+		display(&current, &previous, interval / 1000.0, clear);
+		previous = current;
+	}
+
+	stats_detach(stats);
+
+	return 0;
+}
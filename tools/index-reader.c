@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reader library for frame indexes: both index files are mapped so that a
+ * frame and its slices are found in constant time, whatever the capture size.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "index-reader.h"
+
+static int index_reader_map(struct index_reader_map *map,
+			    const char *directory, const char *filename,
+			    enum index_kind kind, unsigned int record_size,
+			    const void **records, uint64_t *count)
+{
+	const struct index_header *header;
+	char path[PATH_MAX];
+	struct stat st;
+	int fd;
+	int rc;
+
+	rc = snprintf(path, sizeof(path), "%s/%s", directory, filename);
+	if (rc < 0 || rc >= sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	rc = fstat(fd, &st);
+	if (rc < 0 || st.st_size < sizeof(*header)) {
+		close(fd);
+		errno = rc < 0 ? errno : EINVAL;
+		return -1;
+	}
+
+	map->size = st.st_size;
+	map->base = mmap(NULL, map->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map->base == MAP_FAILED) {
+		map->base = NULL;
+		return -1;
+	}
+
+	header = map->base;
+	if (header->magic != INDEX_MAGIC || header->version != INDEX_VERSION ||
+	    header->kind != kind || header->record_size != record_size) {
+		munmap(map->base, map->size);
+		map->base = NULL;
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* A capture in progress may end with a partial record. */
+	*records = header + 1;
+	*count = (map->size - sizeof(*header)) / record_size;
+
+	return 0;
+}
+
+static void index_reader_unmap(struct index_reader_map *map)
+{
+	if (map->base != NULL)
+		munmap(map->base, map->size);
+
+	map->base = NULL;
+	map->size = 0;
+}
+
+int index_reader_open(struct index_reader *reader, const char *directory)
+{
+	const void *records;
+	uint64_t count;
+	int rc;
+
+	memset(reader, 0, sizeof(*reader));
+
+	rc = index_reader_map(&reader->frames_map, directory,
+			      INDEX_FRAMES_FILENAME, INDEX_KIND_FRAMES,
+			      sizeof(struct index_frame), &records, &count);
+	if (rc < 0)
+		return -1;
+
+	reader->frames = records;
+	reader->frames_count = count;
+
+	rc = index_reader_map(&reader->slices_map, directory,
+			      INDEX_SLICES_FILENAME, INDEX_KIND_SLICES,
+			      sizeof(struct index_slice), &records, &count);
+	if (rc < 0) {
+		index_reader_unmap(&reader->frames_map);
+		return -1;
+	}
+
+	reader->slices = records;
+	reader->slices_count = count;
+
+	return 0;
+}
+
+void index_reader_close(struct index_reader *reader)
+{
+	index_reader_unmap(&reader->frames_map);
+	index_reader_unmap(&reader->slices_map);
+
+	free(reader->display);
+	memset(reader, 0, sizeof(*reader));
+}
+
+/* Frames that were not dumped have no record. */
+const struct index_frame *index_reader_frame(struct index_reader *reader,
+					     unsigned int frame)
+{
+	if (frame >= reader->frames_count ||
+	    !(reader->frames[frame].flags & INDEX_FLAG_VALID))
+		return NULL;
+
+	return &reader->frames[frame];
+}
+
+/* The slices of a frame are consecutive, NULL is returned if truncated. */
+const struct index_slice *index_reader_slices(struct index_reader *reader,
+					      const struct index_frame *frame)
+{
+	if (frame->slice_first + frame->slices_count > reader->slices_count)
+		return NULL;
+
+	return &reader->slices[frame->slice_first];
+}
+
+static int index_reader_compare(const void *a, const void *b, void *data)
+{
+	const struct index_frame *frames = data;
+	const struct index_frame *first = &frames[*(const unsigned int *) a];
+	const struct index_frame *second = &frames[*(const unsigned int *) b];
+
+	if (first->sequence != second->sequence)
+		return first->sequence < second->sequence ? -1 : 1;
+
+	if (first->order != second->order)
+		return first->order < second->order ? -1 : 1;
+
+	return first->frame < second->frame ? -1 : first->frame > second->frame;
+}
+
+static int index_reader_display(struct index_reader *reader)
+{
+	unsigned int i;
+
+	if (reader->display != NULL)
+		return 0;
+
+	reader->display = malloc(reader->frames_count *
+				 sizeof(*reader->display) + 1);
+	if (reader->display == NULL)
+		return -1;
+
+	reader->display_count = 0;
+
+	for (i = 0; i < reader->frames_count; i++)
+		if (reader->frames[i].flags & INDEX_FLAG_VALID)
+			reader->display[reader->display_count++] = i;
+
+	qsort_r(reader->display, reader->display_count,
+		sizeof(*reader->display), index_reader_compare,
+		(void *) reader->frames);
+
+	return 0;
+}
+
+unsigned int index_reader_count(struct index_reader *reader,
+				enum index_reader_order order)
+{
+	if (order == INDEX_READER_DECODE)
+		return reader->frames_count;
+
+	if (index_reader_display(reader) < 0)
+		return 0;
+
+	return reader->display_count;
+}
+
+/*
+ * Get the frame at a given position in decode or display order. Positions in
+ * decode order are frame numbers, so records of frames that were not dumped
+ * are returned as-is, without the valid flag. The display order is sorted once
+ * on first use and only holds valid frames.
+ */
+const struct index_frame *index_reader_at(struct index_reader *reader,
+					  enum index_reader_order order,
+					  unsigned int position)
+{
+	if (order == INDEX_READER_DECODE) {
+		if (position >= reader->frames_count)
+			return NULL;
+
+		return &reader->frames[position];
+	}
+
+	if (index_reader_display(reader) < 0 ||
+	    position >= reader->display_count)
+		return NULL;
+
+	return &reader->frames[reader->display[position]];
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _INDEX_READER_H_
+#define _INDEX_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "index.h"
+
+/*
+ * Values
+ */
+
+enum index_reader_order {
+	INDEX_READER_DECODE,
+	INDEX_READER_DISPLAY,
+};
+
+/*
+ * Structures
+ */
+
+struct index_reader_map {
+	void *base;
+	size_t size;
+};
+
+struct index_reader {
+	struct index_reader_map frames_map;
+	struct index_reader_map slices_map;
+
+	const struct index_frame *frames;
+	unsigned int frames_count;
+	const struct index_slice *slices;
+	uint64_t slices_count;
+
+	/* Positions of the valid frames in display order, built on demand. */
+	unsigned int *display;
+	unsigned int display_count;
+};
+
+/*
+ * Functions
+ */
+
+int index_reader_open(struct index_reader *reader, const char *directory);
+void index_reader_close(struct index_reader *reader);
+const struct index_frame *index_reader_frame(struct index_reader *reader,
+					     unsigned int frame);
+const struct index_slice *index_reader_slices(struct index_reader *reader,
+					      const struct index_frame *frame);
+unsigned int index_reader_count(struct index_reader *reader,
+				enum index_reader_order order);
+const struct index_frame *index_reader_at(struct index_reader *reader,
+					  enum index_reader_order order,
+					  unsigned int position);
+
+#endif
@@ -0,0 +1,592 @@
+/*
+ * Copyright (C) 2018 Paul Kocialkowski <paul.kocialkowski@bootlin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Minimal VA driver that accepts decoding calls without decoding anything,
+ * to exercise the pass-through mode of the dump driver without hardware:
+ *   DUMP_BACKEND=tools/.libs/stub_drv_video.so
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <va/va_backend.h>
+
+#include "autoconfig.h"
+
+#define STUB_CONFIGS_MAX			16
+#define STUB_BUFFERS_MAX			256
+
+struct stub_config {
+	bool used;
+	VAProfile profile;
+	VAEntrypoint entrypoint;
+};
+
+struct stub_buffer {
+	bool used;
+	VABufferType type;
+	unsigned int size;
+	unsigned int count;
+	void *data;
+};
+
+/* IDs start low on purpose, to tell them apart from the ones of the dump driver. */
+struct stub_driver_data {
+	struct stub_config configs[STUB_CONFIGS_MAX];
+	struct stub_buffer buffers[STUB_BUFFERS_MAX];
+	VASurfaceID surface_id;
+	VAContextID context_id;
+};
+
+static const VAProfile stub_profiles[] = {
+	VAProfileMPEG2Simple,
+	VAProfileMPEG2Main,
+	VAProfileH264Main,
+	VAProfileH264High,
+	VAProfileH264ConstrainedBaseline,
+	VAProfileHEVCMain,
+};
+
+static struct stub_buffer *stub_buffer(VADriverContextP context,
+	VABufferID buffer_id)
+{
+	struct stub_driver_data *driver_data = context->pDriverData;
+
+	if (buffer_id == 0 || buffer_id > STUB_BUFFERS_MAX ||
+	    !driver_data->buffers[buffer_id - 1].used)
+		return NULL;
+
+	return &driver_data->buffers[buffer_id - 1];
+}
+
+static VAStatus StubTerminate(VADriverContextP context)
+{
+	struct stub_driver_data *driver_data = context->pDriverData;
+	unsigned int i;
+
+	for (i = 0; i < STUB_BUFFERS_MAX; i++)
+		free(driver_data->buffers[i].data);
+
+	free(driver_data);
+	context->pDriverData = NULL;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubQueryConfigProfiles(VADriverContextP context,
+	VAProfile *profiles, int *profiles_count)
+{
+	unsigned int count = sizeof(stub_profiles) / sizeof(stub_profiles[0]);
+
+	memcpy(profiles, stub_profiles, sizeof(stub_profiles));
+	*profiles_count = count;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubQueryConfigEntrypoints(VADriverContextP context,
+	VAProfile profile, VAEntrypoint *entrypoints, int *entrypoints_count)
+{
+	entrypoints[0] = VAEntrypointVLD;
+	*entrypoints_count = 1;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubGetConfigAttributes(VADriverContextP context,
+	VAProfile profile, VAEntrypoint entrypoint, VAConfigAttrib *attributes,
+	int attributes_count)
+{
+	int i;
+
+	for (i = 0; i < attributes_count; i++)
+		attributes[i].value = VA_ATTRIB_NOT_SUPPORTED;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubCreateConfig(VADriverContextP context, VAProfile profile,
+	VAEntrypoint entrypoint, VAConfigAttrib *attributes,
+	int attributes_count, VAConfigID *config_id)
+{
+	struct stub_driver_data *driver_data = context->pDriverData;
+	unsigned int i;
+
+	for (i = 0; i < STUB_CONFIGS_MAX; i++) {
+		if (driver_data->configs[i].used)
+			continue;
+
+		driver_data->configs[i].used = true;
+		driver_data->configs[i].profile = profile;
+		driver_data->configs[i].entrypoint = entrypoint;
+
+		*config_id = i + 1;
+
+		return VA_STATUS_SUCCESS;
+	}
+
+	return VA_STATUS_ERROR_ALLOCATION_FAILED;
+}
+
+static VAStatus StubDestroyConfig(VADriverContextP context,
+	VAConfigID config_id)
+{
+	struct stub_driver_data *driver_data = context->pDriverData;
+
+	if (config_id == 0 || config_id > STUB_CONFIGS_MAX)
+		return VA_STATUS_ERROR_INVALID_CONFIG;
+
+	driver_data->configs[config_id - 1].used = false;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubQueryConfigAttributes(VADriverContextP context,
+	VAConfigID config_id, VAProfile *profile, VAEntrypoint *entrypoint,
+	VAConfigAttrib *attributes, int *attributes_count)
+{
+	struct stub_driver_data *driver_data = context->pDriverData;
+
+	if (config_id == 0 || config_id > STUB_CONFIGS_MAX ||
+	    !driver_data->configs[config_id - 1].used)
+		return VA_STATUS_ERROR_INVALID_CONFIG;
+
+	*profile = driver_data->configs[config_id - 1].profile;
+	*entrypoint = driver_data->configs[config_id - 1].entrypoint;
+	*attributes_count = 0;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubCreateSurfaces2(VADriverContextP context,
+	unsigned int format, unsigned int width, unsigned int height,
+	VASurfaceID *surfaces_ids, unsigned int surfaces_count,
+	VASurfaceAttrib *attributes, unsigned int attributes_count)
+{
+	struct stub_driver_data *driver_data = context->pDriverData;
+	unsigned int i;
+
+	for (i = 0; i < surfaces_count; i++)
+		surfaces_ids[i] = ++driver_data->surface_id;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubCreateSurfaces(VADriverContextP context, int width,
+	int height, int format, int surfaces_count, VASurfaceID *surfaces_ids)
+{
+	return StubCreateSurfaces2(context, format, width, height,
+				   surfaces_ids, surfaces_count, NULL, 0);
+}
+
+static VAStatus StubDestroySurfaces(VADriverContextP context,
+	VASurfaceID *surfaces_ids, int surfaces_count)
+{
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubCreateContext(VADriverContextP context,
+	VAConfigID config_id, int picture_width, int picture_height, int flag,
+	VASurfaceID *surfaces_ids, int surfaces_count, VAContextID *context_id)
+{
+	struct stub_driver_data *driver_data = context->pDriverData;
+
+	*context_id = ++driver_data->context_id;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubDestroyContext(VADriverContextP context,
+	VAContextID context_id)
+{
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubCreateBuffer(VADriverContextP context,
+	VAContextID context_id, VABufferType type, unsigned int size,
+	unsigned int count, void *data, VABufferID *buffer_id)
+{
+	struct stub_driver_data *driver_data = context->pDriverData;
+	struct stub_buffer *buffer;
+	unsigned int i;
+
+	for (i = 0; i < STUB_BUFFERS_MAX; i++) {
+		buffer = &driver_data->buffers[i];
+		if (buffer->used)
+			continue;
+
+		buffer->data = malloc(size * count);
+		if (buffer->data == NULL)
+			return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+		if (data != NULL)
+			memcpy(buffer->data, data, size * count);
+
+		buffer->used = true;
+		buffer->type = type;
+		buffer->size = size;
+		buffer->count = count;
+
+		*buffer_id = i + 1;
+
+		return VA_STATUS_SUCCESS;
+	}
+
+	return VA_STATUS_ERROR_ALLOCATION_FAILED;
+}
+
+static VAStatus StubBufferSetNumElements(VADriverContextP context,
+	VABufferID buffer_id, unsigned int count)
+{
+	struct stub_buffer *buffer = stub_buffer(context, buffer_id);
+
+	if (buffer == NULL)
+		return VA_STATUS_ERROR_INVALID_BUFFER;
+
+	if (count > buffer->count)
+		return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+	buffer->count = count;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubMapBuffer(VADriverContextP context, VABufferID buffer_id,
+	void **data_map)
+{
+	struct stub_buffer *buffer = stub_buffer(context, buffer_id);
+
+	if (buffer == NULL)
+		return VA_STATUS_ERROR_INVALID_BUFFER;
+
+	*data_map = buffer->data;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubUnmapBuffer(VADriverContextP context,
+	VABufferID buffer_id)
+{
+	if (stub_buffer(context, buffer_id) == NULL)
+		return VA_STATUS_ERROR_INVALID_BUFFER;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubDestroyBuffer(VADriverContextP context,
+	VABufferID buffer_id)
+{
+	struct stub_buffer *buffer = stub_buffer(context, buffer_id);
+
+	if (buffer == NULL)
+		return VA_STATUS_ERROR_INVALID_BUFFER;
+
+	free(buffer->data);
+	memset(buffer, 0, sizeof(*buffer));
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubBufferInfo(VADriverContextP context, VABufferID buffer_id,
+	VABufferType *type, unsigned int *size, unsigned int *count)
+{
+	struct stub_buffer *buffer = stub_buffer(context, buffer_id);
+
+	if (buffer == NULL)
+		return VA_STATUS_ERROR_INVALID_BUFFER;
+
+	*type = buffer->type;
+	*size = buffer->size;
+	*count = buffer->count;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubBeginPicture(VADriverContextP context,
+	VAContextID context_id, VASurfaceID surface_id)
+{
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubRenderPicture(VADriverContextP context,
+	VAContextID context_id, VABufferID *buffers, int buffers_count)
+{
+	int i;
+
+	for (i = 0; i < buffers_count; i++)
+		if (stub_buffer(context, buffers[i]) == NULL)
+			return VA_STATUS_ERROR_INVALID_BUFFER;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubEndPicture(VADriverContextP context,
+	VAContextID context_id)
+{
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubSyncSurface(VADriverContextP context,
+	VASurfaceID surface_id)
+{
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubQuerySurfaceStatus(VADriverContextP context,
+	VASurfaceID surface_id, VASurfaceStatus *status)
+{
+	*status = VASurfaceReady;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubPutSurface(VADriverContextP context,
+	VASurfaceID surface_id, void *draw, short src_x, short src_y,
+	unsigned short src_width, unsigned short src_height, short dst_x,
+	short dst_y, unsigned short dst_width, unsigned short dst_height,
+	VARectangle *cliprects, unsigned int cliprects_count,
+	unsigned int flags)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubQueryImageFormats(VADriverContextP context,
+	VAImageFormat *formats, int *formats_count)
+{
+	*formats_count = 0;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubCreateImage(VADriverContextP context,
+	VAImageFormat *format, int width, int height, VAImage *image)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubDeriveImage(VADriverContextP context,
+	VASurfaceID surface_id, VAImage *image)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubDestroyImage(VADriverContextP context, VAImageID image_id)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubSetImagePalette(VADriverContextP context,
+	VAImageID image_id, unsigned char *palette)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubGetImage(VADriverContextP context, VASurfaceID surface_id,
+	int x, int y, unsigned int width, unsigned int height,
+	VAImageID image_id)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubPutImage(VADriverContextP context, VASurfaceID surface_id,
+	VAImageID image, int src_x, int src_y, unsigned int src_width,
+	unsigned int src_height, int dst_x, int dst_y, unsigned int dst_width,
+	unsigned int dst_height)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubQuerySubpictureFormats(VADriverContextP context,
+	VAImageFormat *formats, unsigned int *flags,
+	unsigned int *formats_count)
+{
+	*formats_count = 0;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubCreateSubpicture(VADriverContextP context,
+	VAImageID image_id, VASubpictureID *subpicture_id)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubDestroySubpicture(VADriverContextP context,
+	VASubpictureID subpicture_id)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubSetSubpictureImage(VADriverContextP context,
+	VASubpictureID subpicture_id, VAImageID image_id)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubSetSubpictureChromakey(VADriverContextP context,
+	VASubpictureID subpicture_id, unsigned int chromakey_min,
+	unsigned int chromakey_max, unsigned int chromakey_mask)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubSetSubpictureGlobalAlpha(VADriverContextP context,
+	VASubpictureID subpicture_id, float global_alpha)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubAssociateSubpicture(VADriverContextP context,
+	VASubpictureID subpicture_id, VASurfaceID *surfaces_ids,
+	int surfaces_count, short src_x, short src_y,
+	unsigned short src_width, unsigned short src_height, short dst_x,
+	short dst_y, unsigned short dst_width, unsigned short dst_height,
+	unsigned int flags)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubDeassociateSubpicture(VADriverContextP context,
+	VASubpictureID subpicture_id, VASurfaceID *surfaces_ids,
+	int surfaces_count)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubQueryDisplayAttributes(VADriverContextP context,
+	VADisplayAttribute *attributes, int *attributes_count)
+{
+	*attributes_count = 0;
+
+	return VA_STATUS_SUCCESS;
+}
+
+static VAStatus StubGetDisplayAttributes(VADriverContextP context,
+	VADisplayAttribute *attributes, int attributes_count)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubSetDisplayAttributes(VADriverContextP context,
+	VADisplayAttribute *attributes, int attributes_count)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubLockSurface(VADriverContextP context,
+	VASurfaceID surface_id, unsigned int *fourcc, unsigned int *luma_stride,
+	unsigned int *chroma_u_stride, unsigned int *chroma_v_stride,
+	unsigned int *luma_offset, unsigned int *chroma_u_offset,
+	unsigned int *chroma_v_offset, unsigned int *buffer_name,
+	void **buffer)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubUnlockSurface(VADriverContextP context,
+	VASurfaceID surface_id)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubGetSurfaceAttributes(VADriverContextP context,
+	VAConfigID config_id, VASurfaceAttrib *attributes,
+	unsigned int attributes_count)
+{
+	return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus StubQuerySurfaceAttributes(VADriverContextP context,
+	VAConfigID config_id, VASurfaceAttrib *attributes,
+	unsigned int *attributes_count)
+{
+	*attributes_count = 0;
+
+	return VA_STATUS_SUCCESS;
+}
+
+VAStatus __attribute__((visibility("default"))) VA_DRIVER_INIT_FUNC(VADriverContextP context);
+
+VAStatus VA_DRIVER_INIT_FUNC(VADriverContextP context)
+{
+	struct VADriverVTable *vtable = context->vtable;
+
+	context->pDriverData = calloc(1, sizeof(struct stub_driver_data));
+	if (context->pDriverData == NULL)
+		return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+	context->version_major = VA_MAJOR_VERSION;
+	context->version_minor = VA_MINOR_VERSION;
+	context->max_profiles = sizeof(stub_profiles) / sizeof(stub_profiles[0]);
+	context->max_entrypoints = 1;
+	context->max_attributes = 1;
+	context->max_image_formats = 1;
+	context->max_subpic_formats = 1;
+	context->max_display_attributes = 1;
+	context->str_vendor = "Stub Driver";
+
+	vtable->vaTerminate = StubTerminate;
+	vtable->vaQueryConfigProfiles = StubQueryConfigProfiles;
+	vtable->vaQueryConfigEntrypoints = StubQueryConfigEntrypoints;
+	vtable->vaQueryConfigAttributes = StubQueryConfigAttributes;
+	vtable->vaCreateConfig = StubCreateConfig;
+	vtable->vaDestroyConfig = StubDestroyConfig;
+	vtable->vaGetConfigAttributes = StubGetConfigAttributes;
+	vtable->vaCreateSurfaces = StubCreateSurfaces;
+	vtable->vaCreateSurfaces2 = StubCreateSurfaces2;
+	vtable->vaDestroySurfaces = StubDestroySurfaces;
+	vtable->vaCreateContext = StubCreateContext;
+	vtable->vaDestroyContext = StubDestroyContext;
+	vtable->vaCreateBuffer = StubCreateBuffer;
+	vtable->vaBufferSetNumElements = StubBufferSetNumElements;
+	vtable->vaMapBuffer = StubMapBuffer;
+	vtable->vaUnmapBuffer = StubUnmapBuffer;
+	vtable->vaDestroyBuffer = StubDestroyBuffer;
+	vtable->vaBeginPicture = StubBeginPicture;
+	vtable->vaRenderPicture = StubRenderPicture;
+	vtable->vaEndPicture = StubEndPicture;
+	vtable->vaSyncSurface = StubSyncSurface;
+	vtable->vaQuerySurfaceStatus = StubQuerySurfaceStatus;
+	vtable->vaPutSurface = StubPutSurface;
+	vtable->vaQueryImageFormats = StubQueryImageFormats;
+	vtable->vaCreateImage = StubCreateImage;
+	vtable->vaDeriveImage = StubDeriveImage;
+	vtable->vaDestroyImage = StubDestroyImage;
+	vtable->vaSetImagePalette = StubSetImagePalette;
+	vtable->vaGetImage = StubGetImage;
+	vtable->vaPutImage = StubPutImage;
+	vtable->vaQuerySubpictureFormats = StubQuerySubpictureFormats;
+	vtable->vaCreateSubpicture = StubCreateSubpicture;
+	vtable->vaDestroySubpicture = StubDestroySubpicture;
+	vtable->vaSetSubpictureImage = StubSetSubpictureImage;
+	vtable->vaSetSubpictureChromakey = StubSetSubpictureChromakey;
+	vtable->vaSetSubpictureGlobalAlpha = StubSetSubpictureGlobalAlpha;
+	vtable->vaAssociateSubpicture = StubAssociateSubpicture;
+	vtable->vaDeassociateSubpicture = StubDeassociateSubpicture;
+	vtable->vaQueryDisplayAttributes = StubQueryDisplayAttributes;
+	vtable->vaGetDisplayAttributes = StubGetDisplayAttributes;
+	vtable->vaSetDisplayAttributes = StubSetDisplayAttributes;
+	vtable->vaLockSurface = StubLockSurface;
+	vtable->vaUnlockSurface = StubUnlockSurface;
+	vtable->vaGetSurfaceAttributes = StubGetSurfaceAttributes;
+	vtable->vaQuerySurfaceAttributes = StubQuerySurfaceAttributes;
+	vtable->vaBufferInfo = StubBufferInfo;
+
+	return VA_STATUS_SUCCESS;
+}